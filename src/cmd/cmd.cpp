@@ -15,15 +15,19 @@
  */
 
 #include <iostream>
+#include <memory>
 #include <random>
+#include <vector>
 #include <qcoreapplication.h>
 #include <QStringList>
 #include <QUrl>
+#include <QDir>
 #include <QFile>
 #include <QFileInfo>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QNetworkProxy>
+#include <QVector>
 #include <qdebug.h>
 
 #include "account.h"
@@ -34,6 +38,7 @@
 # include "creds/httpcredentials.h"
 #endif
 #include "simplesslerrorhandler.h"
+#include "syncdaemon.h"
 #include "syncengine.h"
 #include "common/syncjournaldb.h"
 #include "config.h"
@@ -81,6 +86,12 @@ struct CmdOptions
     int restartTimes = 0;
     int downlimit = 0;
     int uplimit = 0;
+    bool daemon = false;
+    int pollInterval = 30;
+    // local folder and remote path of the folders synced next to source_dir in daemon mode
+    QVector<QPair<QString, QString>> extraFolders;
+    // sync journal, or folder containing one, to report on instead of syncing
+    QString inspectJournal;
 };
 
 // we can't use csync_set_userdata because the SyncEngine sets it already.
@@ -193,6 +204,13 @@ void help()
     std::cout << "  --version, -v          Display version and exit" << std::endl;
     std::cout << "  --logdebug             More verbose logging" << std::endl;
     std::cout << "  --path                 Path to a folder on a remote server" << std::endl;
+    std::cout << "  --daemon               Keep running and sync again whenever files change" << std::endl;
+    std::cout << "  --poll-interval [n]    In daemon mode, check the server for changes every n seconds" << std::endl;
+    std::cout << "                         when it has no push notifications (default to 30)" << std::endl;
+    std::cout << "  --folder [dir] [path]  In daemon mode, also sync the local folder dir with the" << std::endl;
+    std::cout << "                         remote path. Can be given more than once" << std::endl;
+    std::cout << "  --inspect-journal [path]  Print the table sizes and query plans of the sync journal" << std::endl;
+    std::cout << "                         path, or of the one in the folder path, and exit" << std::endl;
     std::cout << "" << std::endl;
     exit(0);
 }
@@ -203,6 +221,20 @@ void showVersion()
     exit(0);
 }
 
+QString absoluteSourceDir(const QString &dir)
+{
+    QString sourceDir = dir;
+    if (!sourceDir.endsWith('/')) {
+        sourceDir.append('/');
+    }
+    QFileInfo fi(sourceDir);
+    if (!fi.exists()) {
+        std::cerr << "Source dir '" << qPrintable(sourceDir) << "' does not exist." << std::endl;
+        exit(1);
+    }
+    return fi.absoluteFilePath();
+}
+
 void parseOptions(const QStringList &app_args, CmdOptions *options)
 {
     QStringList args(app_args);
@@ -219,18 +251,8 @@ void parseOptions(const QStringList &app_args, CmdOptions *options)
         help();
     }
 
-    options->target_url = args.takeLast();
-
-    options->source_dir = args.takeLast();
-    if (!options->source_dir.endsWith('/')) {
-        options->source_dir.append('/');
-    }
-    QFileInfo fi(options->source_dir);
-    if (!fi.exists()) {
-        std::cerr << "Source dir '" << qPrintable(options->source_dir) << "' does not exist." << std::endl;
-        exit(1);
-    }
-    options->source_dir = fi.absoluteFilePath();
+    // source_dir and server_url, the last two arguments unless only a journal is inspected
+    QStringList positionalArgs;
 
     QStringListIterator it(args);
     // skip file name;
@@ -271,15 +293,47 @@ void parseOptions(const QStringList &app_args, CmdOptions *options)
             Logger::instance()->setLogDebug(true);
         } else if (option == "--path" && !it.peekNext().startsWith("-")) {
             options->remotePath = it.next();
+        } else if (option == "--daemon") {
+            options->daemon = true;
+        } else if (option == "--poll-interval" && !it.peekNext().startsWith("-")) {
+            options->pollInterval = qMax(1, it.next().toInt());
+        } else if (option == "--folder" && !it.peekNext().startsWith("-")) {
+            const auto localDir = absoluteSourceDir(it.next());
+            if (!it.hasNext() || it.peekNext().startsWith("-")) {
+                help();
+            }
+            options->extraFolders.append({localDir, it.next()});
+        } else if (option == "--inspect-journal" && it.hasNext()) {
+            options->inspectJournal = it.next();
+        } else if (!option.startsWith("-") && positionalArgs.size() < 2) {
+            positionalArgs.append(option);
         }
         else {
             help();
         }
     }
 
+    if (!options->inspectJournal.isEmpty()) {
+        if (!positionalArgs.isEmpty()) {
+            help();
+        }
+        return;
+    }
+
+    if (positionalArgs.size() != 2) {
+        help();
+    }
+    options->source_dir = absoluteSourceDir(positionalArgs.at(0));
+    options->target_url = positionalArgs.at(1);
+
     if (options->target_url.isEmpty() || options->source_dir.isEmpty()) {
         help();
     }
+
+    if (!options->extraFolders.isEmpty() && !options->daemon) {
+        std::cerr << "--folder can only be used together with --daemon." << std::endl;
+        exit(1);
+    }
 }
 
 /* If the selective sync list is different from before, we need to disable the read from db
@@ -307,6 +361,134 @@ void selectiveSyncFixup(OCC::SyncJournalDb *journal, const QStringList &newList)
     }
 }
 
+QStringList readSelectiveSyncList(const CmdOptions &options)
+{
+    QStringList selectiveSyncList;
+    if (!options.unsyncedfolders.isEmpty()) {
+        QFile f(options.unsyncedfolders);
+        if (!f.open(QFile::ReadOnly)) {
+            qCritical() << "Could not open file containing the list of unsynced folders: " << options.unsyncedfolders;
+        } else {
+            // filter out empty lines and comments
+            selectiveSyncList = QString::fromUtf8(f.readAll()).split('\n').filter(QRegularExpression("\\S+")).filter(QRegularExpression("^[^#]"));
+
+            for (int i = 0; i < selectiveSyncList.count(); ++i) {
+                if (!selectiveSyncList.at(i).endsWith(QLatin1Char('/'))) {
+                    selectiveSyncList[i].append(QLatin1Char('/'));
+                }
+            }
+        }
+    }
+    return selectiveSyncList;
+}
+
+bool loadExcludeFiles(SyncEngine &engine, const CmdOptions &options)
+{
+    bool hasUserExcludeFile = !options.exclude.isEmpty();
+    QString systemExcludeFile = ConfigFile::excludeFileFromSystem();
+
+    // Always try to load the user-provided exclude list if one is specified
+    if (hasUserExcludeFile) {
+        engine.excludedFiles().addExcludeFilePath(options.exclude);
+    }
+    // Load the system list if available, or if there's no user-provided list
+    if (!hasUserExcludeFile || QFile::exists(systemExcludeFile)) {
+        engine.excludedFiles().addExcludeFilePath(systemExcludeFile);
+    }
+
+    return engine.excludedFiles().reloadExcludeFiles();
+}
+
+/* Prints the size of the journal and its tables and how sqlite runs the
+   lookups done for every item of a sync, to investigate slow syncs.
+ */
+int inspectJournal(const QString &path)
+{
+    QString dbPath = path;
+    if (QFileInfo(path).isDir()) {
+        const auto journals = QDir(path).entryInfoList({ QStringLiteral(".sync_*.db"), QStringLiteral("._sync_*.db") }, QDir::Files | QDir::Hidden);
+        if (journals.isEmpty()) {
+            std::cerr << "No sync journal in " << qPrintable(path) << std::endl;
+            return EXIT_FAILURE;
+        }
+        dbPath = journals.first().absoluteFilePath();
+    }
+    if (!QFileInfo::exists(dbPath)) {
+        std::cerr << "Sync journal " << qPrintable(dbPath) << " does not exist" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // Read-only, to neither upgrade the schema nor get in the way of a running client
+    const auto stats = SyncJournalDb::readOnlyStatistics(dbPath);
+    if (stats.pageCount <= 0) {
+        std::cerr << "Could not open the sync journal " << qPrintable(dbPath)
+                  << ", it may be in use by a running client" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "Journal:     " << qPrintable(dbPath) << std::endl;
+    std::cout << "Size:        " << qPrintable(Utility::octetsToString(stats.pageCount * stats.pageSize))
+              << " in " << stats.pageCount << " pages, " << stats.freePages << " free" << std::endl;
+    std::cout << "WAL:         " << qPrintable(Utility::octetsToString(stats.walBytes)) << std::endl;
+    std::cout << "Auto vacuum: " << qPrintable(stats.autoVacuum) << std::endl;
+
+    std::cout << std::endl << "Tables:" << std::endl;
+    for (const auto &table : stats.tables) {
+        std::cout << "  " << qPrintable(table.name.leftJustified(28)) << qPrintable(QString::number(table.rows).rightJustified(10)) << " rows";
+        if (table.bytes >= 0) {
+            std::cout << "  " << qPrintable(Utility::octetsToString(table.bytes));
+        }
+        std::cout << std::endl;
+    }
+
+    std::cout << std::endl << "Query plans:" << std::endl;
+    for (const auto &plan : stats.queryPlans) {
+        std::cout << "  " << qPrintable(plan.name) << std::endl;
+        for (const auto &step : plan.steps) {
+            std::cout << "    " << qPrintable(step) << std::endl;
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+/* Keeps the account and one journal and sync engine per folder open and
+   syncs whenever something changes locally or on the server, until killed.
+ */
+int runDaemon(QCoreApplication &app, const AccountPtr &account, const CmdOptions &options, const QUrl &credentialFreeUrl, const QString &user)
+{
+    const QStringList selectiveSyncList = readSelectiveSyncList(options);
+
+    SyncOptions opt;
+    opt.fillFromEnvironmentVariables();
+    opt.verifyChunkSizes();
+
+    auto folders = options.extraFolders;
+    folders.prepend({options.source_dir, options.remotePath});
+
+    std::vector<std::unique_ptr<SyncDaemon>> daemons;
+    for (const auto &folder : qAsConst(folders)) {
+        const QString dbPath = folder.first + SyncJournalDb::makeDbName(folder.first, credentialFreeUrl, folder.second, user);
+        auto daemon = std::make_unique<SyncDaemon>(account, folder.first, folder.second, dbPath, opt, std::chrono::seconds(options.pollInterval));
+
+        if (!selectiveSyncList.empty()) {
+            selectiveSyncFixup(daemon->journal(), selectiveSyncList);
+        }
+
+        auto &engine = daemon->syncEngine();
+        engine.setIgnoreHiddenFiles(options.ignoreHiddenFiles);
+        engine.setNetworkLimits(options.uplimit, options.downlimit);
+        if (!loadExcludeFiles(engine, options)) {
+            qFatal("Cannot load system exclude list or list supplied via --exclude");
+            return EXIT_FAILURE;
+        }
+
+        daemon->start();
+        daemons.push_back(std::move(daemon));
+    }
+
+    return app.exec();
+}
+
 int main(int argc, char **argv)
 {
 #ifdef Q_OS_WIN
@@ -338,6 +520,10 @@ int main(int argc, char **argv)
         qSetMessagePattern("%{time MM-dd hh:mm:ss:zzz} [ %{type} %{category} ]%{if-debug}\t[ %{function} ]%{endif}:\t%{message}");
     }
 
+    if (!options.inspectJournal.isEmpty()) {
+        return inspectJournal(options.inspectJournal);
+    }
+
     AccountPtr account = Account::create();
 
     if (!account) {
@@ -468,6 +654,11 @@ int main(int argc, char **argv)
     job->start();
     loop.exec();
 
+    // A daemon sees files while they are being written, so it keeps the default minimum age
+    if (options.daemon) {
+        return runDaemon(app, account, options, credentialFreeUrl, user);
+    }
+
     // much lower age than the default since this utility is usually made to be run right after a change in the tests
     SyncEngine::minimumFileAgeForUpload = std::chrono::milliseconds(0);
 
@@ -476,22 +667,7 @@ restart_sync:
 
     opts = &options;
 
-    QStringList selectiveSyncList;
-    if (!options.unsyncedfolders.isEmpty()) {
-        QFile f(options.unsyncedfolders);
-        if (!f.open(QFile::ReadOnly)) {
-            qCritical() << "Could not open file containing the list of unsynced folders: " << options.unsyncedfolders;
-        } else {
-            // filter out empty lines and comments
-            selectiveSyncList = QString::fromUtf8(f.readAll()).split('\n').filter(QRegularExpression("\\S+")).filter(QRegularExpression("^[^#]"));
-
-            for (int i = 0; i < selectiveSyncList.count(); ++i) {
-                if (!selectiveSyncList.at(i).endsWith(QLatin1Char('/'))) {
-                    selectiveSyncList[i].append(QLatin1Char('/'));
-                }
-            }
-        }
-    }
+    const QStringList selectiveSyncList = readSelectiveSyncList(options);
 
     Cmd cmd;
     QString dbPath = options.source_dir + SyncJournalDb::makeDbName(options.source_dir, credentialFreeUrl, folder, user);
@@ -515,20 +691,7 @@ restart_sync:
 
 
     // Exclude lists
-
-    bool hasUserExcludeFile = !options.exclude.isEmpty();
-    QString systemExcludeFile = ConfigFile::excludeFileFromSystem();
-
-    // Always try to load the user-provided exclude list if one is specified
-    if (hasUserExcludeFile) {
-        engine.excludedFiles().addExcludeFilePath(options.exclude);
-    }
-    // Load the system list if available, or if there's no user-provided list
-    if (!hasUserExcludeFile || QFile::exists(systemExcludeFile)) {
-        engine.excludedFiles().addExcludeFilePath(systemExcludeFile);
-    }
-
-    if (!engine.excludedFiles().reloadExcludeFiles()) {
+    if (!loadExcludeFiles(engine, options)) {
         qFatal("Cannot load system exclude list or list supplied via --exclude");
         return EXIT_FAILURE;
     }
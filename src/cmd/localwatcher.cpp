@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) by Nextcloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "localwatcher.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QLoggingCategory>
+#include <QStringList>
+
+namespace OCC {
+
+Q_LOGGING_CATEGORY(lcLocalWatcher, "nextcloud.cmd.localwatcher", QtInfoMsg)
+
+LocalWatcher::LocalWatcher(const QString &root, QObject *parent)
+    : QObject(parent)
+    , _root(QDir(root).absolutePath())
+{
+#if defined(Q_OS_UNIX) && !defined(Q_OS_MAC)
+    if (!_watcher.isValid()) {
+        _isReliable = false;
+    }
+    connect(&_watcher, &InotifyWatcher::pathChanged, this, &LocalWatcher::pathChanged);
+    connect(&_watcher, &InotifyWatcher::watchesExhausted, this, &LocalWatcher::slotBecameUnreliable);
+    connect(&_watcher, &InotifyWatcher::eventsLost, this, &LocalWatcher::slotBecameUnreliable);
+#else
+    connect(&_watcher, &QFileSystemWatcher::directoryChanged, this, &LocalWatcher::slotDirectoryChanged);
+#endif
+
+    _watcher.addFolderRecursive(_root);
+}
+
+LocalWatcher::~LocalWatcher() = default;
+
+bool LocalWatcher::isReliable() const
+{
+    return _isReliable;
+}
+
+void LocalWatcher::slotBecameUnreliable()
+{
+    if (_isReliable) {
+        qCWarning(lcLocalWatcher) << "Local changes may be missed, falling back to full local discovery";
+        _isReliable = false;
+    }
+}
+
+#if !defined(Q_OS_UNIX) || defined(Q_OS_MAC)
+void LocalWatcher::findFoldersBelow(const QDir &dir, QStringList &fullList)
+{
+    const auto filter = QDir::Dirs | QDir::NoDotAndDotDot | QDir::NoSymLinks | QDir::Hidden;
+    const auto subDirs = dir.entryList(filter);
+    for (const auto &subDir : subDirs) {
+        const QString fullPath = dir.path() + QLatin1Char('/') + subDir;
+        fullList.append(fullPath);
+        findFoldersBelow(QDir(fullPath), fullList);
+    }
+}
+
+void LocalWatcher::addFolderRecursive(const QString &path)
+{
+    QStringList paths = { path };
+    findFoldersBelow(QDir(path), paths);
+    for (const auto &folder : qAsConst(paths)) {
+        const auto absolutePath = QDir(folder).absolutePath();
+        if (_watcher.directories().contains(absolutePath)) {
+            continue;
+        }
+        if (!_watcher.addPath(absolutePath)) {
+            qCWarning(lcLocalWatcher) << "Could not watch" << absolutePath;
+            slotBecameUnreliable();
+        }
+    }
+}
+
+void LocalWatcher::slotDirectoryChanged(const QString &path)
+{
+    // QFileSystemWatcher does not say which entry changed, so the whole
+    // directory gets rediscovered; removed directories drop their watch
+    // on their own.
+    emit pathChanged(path);
+    if (QFileInfo(path).isDir()) {
+        addFolderRecursive(path);
+    }
+}
+#endif
+
+}
@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) by Nextcloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#pragma once
+
+#include <QObject>
+#include <QString>
+
+#if defined(Q_OS_UNIX) && !defined(Q_OS_MAC)
+#include "inotifywatcher.h"
+#else
+#include <QFileSystemWatcher>
+#endif
+
+class QDir;
+
+namespace OCC {
+
+/**
+ * @brief Recursively watches a local sync folder for the command line client
+ *
+ * The client's FolderWatcher depends on a gui Folder. Where inotify is
+ * available this uses the same InotifyWatcher as the client; on other
+ * platforms it falls back to QFileSystemWatcher, which only reports
+ * directory changes.
+ *
+ * @ingroup cmd
+ */
+class LocalWatcher : public QObject
+{
+    Q_OBJECT
+public:
+    explicit LocalWatcher(const QString &root, QObject *parent = nullptr);
+    ~LocalWatcher() override;
+
+    /**
+     * Returns false if the watcher can't be trusted to capture all
+     * notifications, for example because the inotify watches are exhausted.
+     */
+    [[nodiscard]] bool isReliable() const;
+
+signals:
+    /** Emitted with the absolute path of a changed file or directory. */
+    void pathChanged(const QString &path);
+
+private slots:
+    void slotBecameUnreliable();
+#if !defined(Q_OS_UNIX) || defined(Q_OS_MAC)
+    void slotDirectoryChanged(const QString &path);
+#endif
+
+private:
+    QString _root;
+    bool _isReliable = true;
+#if defined(Q_OS_UNIX) && !defined(Q_OS_MAC)
+    InotifyWatcher _watcher;
+#else
+    void addFolderRecursive(const QString &path);
+    static void findFoldersBelow(const QDir &dir, QStringList &fullList);
+
+    QFileSystemWatcher _watcher;
+#endif
+};
+
+}
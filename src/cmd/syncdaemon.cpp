@@ -0,0 +1,251 @@
+/*
+ * Copyright (C) by Nextcloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "syncdaemon.h"
+
+#include <QLoggingCategory>
+
+#include <algorithm>
+#include <utility>
+
+#include "account.h"
+#include "capabilities.h"
+#include "common/syncjournaldb.h"
+#include "localwatcher.h"
+#include "pushnotifications.h"
+#include "syncengine.h"
+
+namespace OCC {
+
+Q_LOGGING_CATEGORY(lcSyncDaemon, "nextcloud.cmd.syncdaemon", QtInfoMsg)
+
+namespace {
+
+// Like the desktop client, rediscover everything now and then in case
+// the watcher missed something
+constexpr auto fullLocalDiscoveryInterval = std::chrono::hours(1);
+
+// Failed syncs are retried at least this often, also while push
+// notifications would tell about remote changes
+constexpr auto maximumRetryDelay = std::chrono::minutes(10);
+
+}
+
+std::chrono::milliseconds SyncDaemon::syncCoalescingInterval = std::chrono::seconds(2);
+std::chrono::milliseconds SyncDaemon::minimumRetryDelay = std::chrono::seconds(10);
+
+SyncDaemon::SyncDaemon(AccountPtr account, const QString &localPath, const QString &remotePath,
+    const QString &journalPath, const SyncOptions &syncOptions,
+    std::chrono::seconds pollInterval, QObject *parent)
+    : QObject(parent)
+    , _account(account)
+    , _localPath(localPath.endsWith(QLatin1Char('/')) ? localPath : localPath + QLatin1Char('/'))
+    , _journal(new SyncJournalDb(journalPath))
+{
+    _engine.reset(new SyncEngine(_account, _localPath, syncOptions, remotePath, _journal.data()));
+
+    connect(_engine.data(), &SyncEngine::finished, &_localDiscoveryTracker, &LocalDiscoveryTracker::slotSyncFinished);
+    connect(_engine.data(), &SyncEngine::itemCompleted, &_localDiscoveryTracker, &LocalDiscoveryTracker::slotItemCompleted);
+    connect(_engine.data(), &SyncEngine::finished, this, &SyncDaemon::slotSyncFinished);
+    connect(_engine.data(), &SyncEngine::syncError,
+        [](const QString &error) { qCWarning(lcSyncDaemon) << "Sync error:" << error; });
+
+    _scheduleTimer.setSingleShot(true);
+    connect(&_scheduleTimer, &QTimer::timeout, this, &SyncDaemon::startSync);
+
+    _pollTimer.setInterval(pollInterval);
+    connect(&_pollTimer, &QTimer::timeout, this, &SyncDaemon::slotPollRemote);
+
+    _retryTimer.setSingleShot(true);
+    connect(&_retryTimer, &QTimer::timeout, this, [this] {
+        // What the failed sync should have discovered is not known anymore
+        _fullRemoteDiscovery = true;
+        scheduleSync();
+    });
+
+    connect(_account.data(), &Account::pushNotificationsReady, this, &SyncDaemon::slotConnectToPushNotifications);
+}
+
+SyncDaemon::~SyncDaemon() = default;
+
+SyncEngine &SyncDaemon::syncEngine() const
+{
+    return *_engine;
+}
+
+SyncJournalDb *SyncDaemon::journal() const
+{
+    return _journal.data();
+}
+
+void SyncDaemon::start()
+{
+    _watcher.reset(new LocalWatcher(_localPath));
+    connect(_watcher.data(), &LocalWatcher::pathChanged, this, &SyncDaemon::slotPathChanged);
+
+    slotConnectToPushNotifications(_account.data());
+    _pollTimer.start();
+
+    // Have to be done async, else, an error before exec() does not terminate the event loop.
+    QMetaObject::invokeMethod(this, &SyncDaemon::startSync, Qt::QueuedConnection);
+}
+
+void SyncDaemon::scheduleSync()
+{
+    if (!_scheduleTimer.isActive()) {
+        _scheduleTimer.start(syncCoalescingInterval);
+    }
+}
+
+void SyncDaemon::startSync()
+{
+    if (_engine->isSyncRunning()) {
+        _syncPending = true;
+        return;
+    }
+
+    const auto periodicFullLocalDiscoveryNow = !_timeSinceLastFullLocalDiscovery.isValid()
+        || _timeSinceLastFullLocalDiscovery.hasExpired(std::chrono::milliseconds(fullLocalDiscoveryInterval).count());
+    if (_watcher && _watcher->isReliable() && !periodicFullLocalDiscoveryNow) {
+        qCInfo(lcSyncDaemon) << "Allowing local discovery of" << _localPath << "to read from the database";
+        _engine->setLocalDiscoveryOptions(LocalDiscoveryStyle::DatabaseAndFilesystem,
+            _localDiscoveryTracker.localDiscoveryPaths());
+        _localDiscoveryTracker.startSyncPartialDiscovery();
+    } else {
+        qCInfo(lcSyncDaemon) << "Forbidding local discovery of" << _localPath << "to read from the database";
+        _engine->setLocalDiscoveryOptions(LocalDiscoveryStyle::FilesystemOnly);
+        _localDiscoveryTracker.startSyncFullDiscovery();
+    }
+
+    if (!_fullRemoteDiscovery && !_remoteDiscoveryPaths.empty()) {
+        qCInfo(lcSyncDaemon) << "Limiting remote discovery to the folders changed on the server";
+        _engine->setRemoteDiscoveryPaths(_remoteDiscoveryPaths);
+    }
+    _remoteDiscoveryPaths.clear();
+    _fullRemoteDiscovery = false;
+
+    _engine->startSync();
+}
+
+void SyncDaemon::slotSyncFinished(bool success)
+{
+    qCInfo(lcSyncDaemon) << "Sync of" << _localPath << (success ? "finished" : "failed");
+
+    if (success && _engine->lastLocalDiscoveryStyle() == LocalDiscoveryStyle::FilesystemOnly) {
+        _timeSinceLastFullLocalDiscovery.start();
+    }
+
+    if (_engine->isAnotherSyncNeeded() != NoFollowUpSync) {
+        _fullRemoteDiscovery = true;
+        _syncPending = true;
+    }
+    if (success) {
+        _consecutiveFailedSyncs = 0;
+        _retryTimer.stop();
+    } else {
+        // Also the remote changes the failed run was limited to must be found again
+        _fullRemoteDiscovery = true;
+        const auto delay = std::min<std::chrono::milliseconds>(minimumRetryDelay * (1 << std::min(_consecutiveFailedSyncs, 10)), maximumRetryDelay);
+        ++_consecutiveFailedSyncs;
+        qCInfo(lcSyncDaemon) << "Retrying the sync of" << _localPath << "in" << delay.count() << "ms";
+        _retryTimer.start(delay);
+    }
+
+    if (std::exchange(_syncPending, false)) {
+        scheduleSync();
+    } else if (success) {
+        // Compacts the journal every few hours, while no sync is using it
+        _journal->performMaintenance();
+    }
+}
+
+void SyncDaemon::slotPathChanged(const QString &path)
+{
+    if (!path.startsWith(_localPath)) {
+        return;
+    }
+
+    // Add to the tracker before filtering out our own changes, to make
+    // extra sure to not miss relevant ones.
+    _localDiscoveryTracker.addTouchedPath(path.mid(_localPath.size()));
+
+    if (_engine->wasFileTouched(path)) {
+        qCDebug(lcSyncDaemon) << "Changed path was touched by SyncEngine, ignoring:" << path;
+        return;
+    }
+
+    // Local changes don't widen a remote discovery limited by push notifications
+    scheduleSync();
+}
+
+void SyncDaemon::slotPollRemote()
+{
+    // With push notifications the server tells us about its changes
+    if (pushNotificationsFilesReady()) {
+        return;
+    }
+    _fullRemoteDiscovery = true;
+    scheduleSync();
+}
+
+bool SyncDaemon::pushNotificationsFilesReady() const
+{
+    const auto pushNotifications = _account->pushNotifications();
+    const auto pushFilesAvailable = _account->capabilities().availablePushNotifications() & PushNotificationType::Files;
+
+    return pushFilesAvailable && pushNotifications && pushNotifications->isReady();
+}
+
+void SyncDaemon::slotConnectToPushNotifications(Account *account)
+{
+    if (account != _account.data() || !pushNotificationsFilesReady()) {
+        return;
+    }
+
+    qCInfo(lcSyncDaemon) << "Push notifications ready for" << _localPath;
+    const auto pushNotifications = _account->pushNotifications();
+    connect(pushNotifications, &PushNotifications::filesChanged, this, &SyncDaemon::slotFilesPushNotification, Qt::UniqueConnection);
+    connect(pushNotifications, &PushNotifications::fileIdsChanged, this, &SyncDaemon::slotFileIdsPushNotification, Qt::UniqueConnection);
+}
+
+void SyncDaemon::slotFilesPushNotification(Account *account)
+{
+    Q_UNUSED(account);
+    _fullRemoteDiscovery = true;
+    scheduleSync();
+}
+
+void SyncDaemon::slotFileIdsPushNotification(Account *account, const QVector<qint64> &fileIds)
+{
+    Q_UNUSED(account);
+
+    // A file that is unknown to this journal may be new anywhere in the
+    // folder, which only the usual remote discovery finds.
+    for (const auto fileId : fileIds) {
+        auto known = false;
+        const auto ok = _journal->getFileRecordsByNumericFileId(fileId, [&](const SyncJournalFileRecord &record) {
+            known = true;
+            // A changed file shows up in the listing of its parent folder
+            const auto path = record.path();
+            const auto slash = path.lastIndexOf(QLatin1Char('/'));
+            _remoteDiscoveryPaths.insert(record.isDirectory() ? path : slash < 0 ? QString() : path.left(slash));
+        });
+        if (!known || !ok) {
+            _fullRemoteDiscovery = true;
+        }
+    }
+    scheduleSync();
+}
+
+}
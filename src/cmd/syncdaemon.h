@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) by Nextcloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#pragma once
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QScopedPointer>
+#include <QTimer>
+
+#include <chrono>
+#include <set>
+
+#include "accountfwd.h"
+#include "localdiscoverytracker.h"
+
+namespace OCC {
+
+class LocalWatcher;
+class SyncEngine;
+class SyncJournalDb;
+class SyncOptions;
+
+/**
+ * @brief Keeps one local folder in sync for nextcloudcmd --daemon
+ *
+ * The journal and the sync engine stay open between sync runs. Local
+ * changes reported by a LocalWatcher only rediscover the touched paths,
+ * like the desktop client does with its folder watcher. Remote changes
+ * are picked up from files push notifications when the server offers
+ * them and by polling otherwise.
+ *
+ * @ingroup cmd
+ */
+class SyncDaemon : public QObject
+{
+    Q_OBJECT
+public:
+    SyncDaemon(AccountPtr account, const QString &localPath, const QString &remotePath,
+        const QString &journalPath, const SyncOptions &syncOptions,
+        std::chrono::seconds pollInterval, QObject *parent = nullptr);
+    ~SyncDaemon() override;
+
+    [[nodiscard]] SyncEngine &syncEngine() const;
+    [[nodiscard]] SyncJournalDb *journal() const;
+
+    /** Starts watching the local folder and runs the first, full sync. */
+    void start();
+
+    /// Collects bursts of local and remote notifications into one sync run
+    static std::chrono::milliseconds syncCoalescingInterval;
+
+    /// How long to wait before retrying the first failed sync, doubled after every further failure
+    static std::chrono::milliseconds minimumRetryDelay;
+
+public slots:
+    /** Runs a sync soon. Requests arriving meanwhile share the run. */
+    void scheduleSync();
+
+private slots:
+    void startSync();
+    void slotSyncFinished(bool success);
+    void slotPathChanged(const QString &path);
+    void slotPollRemote();
+    void slotConnectToPushNotifications(OCC::Account *account);
+    void slotFilesPushNotification(OCC::Account *account);
+    void slotFileIdsPushNotification(OCC::Account *account, const QVector<qint64> &fileIds);
+
+private:
+    [[nodiscard]] bool pushNotificationsFilesReady() const;
+
+    AccountPtr _account;
+    QString _localPath;
+    QScopedPointer<SyncJournalDb> _journal;
+    QScopedPointer<SyncEngine> _engine;
+    QScopedPointer<LocalWatcher> _watcher;
+    LocalDiscoveryTracker _localDiscoveryTracker;
+
+    QTimer _scheduleTimer;
+    QTimer _pollTimer;
+    QTimer _retryTimer;
+    int _consecutiveFailedSyncs = 0;
+    QElapsedTimer _timeSinceLastFullLocalDiscovery;
+
+    /// A sync was requested while one was running
+    bool _syncPending = false;
+
+    /// Server folders named by push notifications since the last sync
+    std::set<QString> _remoteDiscoveryPaths;
+    bool _fullRemoteDiscovery = true;
+};
+
+}
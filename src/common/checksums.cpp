@@ -208,6 +208,65 @@ static bool checksumComputationEnabled()
     return enabled;
 }
 
+ChecksumCalculator::ChecksumCalculator(const QByteArray &checksumType)
+    : _checksumType(checksumType)
+{
+    if (!checksumComputationEnabled()) {
+        return;
+    }
+    if (checksumType == checkSumMD5C) {
+        _cryptoHash = std::make_unique<QCryptographicHash>(QCryptographicHash::Md5);
+    } else if (checksumType == checkSumSHA1C) {
+        _cryptoHash = std::make_unique<QCryptographicHash>(QCryptographicHash::Sha1);
+    } else if (checksumType == checkSumSHA2C) {
+        _cryptoHash = std::make_unique<QCryptographicHash>(QCryptographicHash::Sha256);
+    }
+#if QT_VERSION >= QT_VERSION_CHECK(5, 9, 0)
+    else if (checksumType == checkSumSHA3C) {
+        _cryptoHash = std::make_unique<QCryptographicHash>(QCryptographicHash::Sha3_256);
+    }
+#endif
+#ifdef ZLIB_FOUND
+    else if (checksumType == checkSumAdlerC) {
+        _isAdler32 = true;
+        _adler32 = adler32(0L, Z_NULL, 0);
+    }
+#endif
+}
+
+ChecksumCalculator::ChecksumCalculator(ChecksumCalculator &&) noexcept = default;
+ChecksumCalculator &ChecksumCalculator::operator=(ChecksumCalculator &&) noexcept = default;
+ChecksumCalculator::~ChecksumCalculator() = default;
+
+bool ChecksumCalculator::isValid() const
+{
+    return _cryptoHash || _isAdler32;
+}
+
+void ChecksumCalculator::addData(const char *data, qint64 length)
+{
+    _size += length;
+    if (_cryptoHash) {
+        _cryptoHash->addData(data, static_cast<int>(length));
+    }
+#ifdef ZLIB_FOUND
+    else if (_isAdler32) {
+        _adler32 = adler32(_adler32, reinterpret_cast<const Bytef *>(data), static_cast<uInt>(length));
+    }
+#endif
+}
+
+QByteArray ChecksumCalculator::result() const
+{
+    if (_cryptoHash) {
+        return _cryptoHash->result().toHex();
+    }
+    if (_isAdler32 && _size > 0) { // like calcAdler32(), which has no checksum for empty files
+        return QByteArray::number(static_cast<qulonglong>(_adler32), 16);
+    }
+    return QByteArray();
+}
+
 ComputeChecksum::ComputeChecksum(QObject *parent)
     : QObject(parent)
 {
@@ -327,17 +386,25 @@ ValidateChecksumHeader::ValidateChecksumHeader(QObject *parent)
 {
 }
 
-ComputeChecksum *ValidateChecksumHeader::prepareStart(const QByteArray &checksumHeader)
+bool ValidateChecksumHeader::parseExpectedChecksum(const QByteArray &checksumHeader)
 {
     // If the incoming header is empty no validation can happen. Just continue.
     if (checksumHeader.isEmpty()) {
         emit validated(QByteArray(), QByteArray());
-        return nullptr;
+        return false;
     }
 
     if (!parseChecksumHeader(checksumHeader, &_expectedChecksumType, &_expectedChecksum)) {
         qCWarning(lcChecksums) << "Checksum header malformed:" << checksumHeader;
         emit validationFailed(tr("The checksum header is malformed."), _calculatedChecksumType, _calculatedChecksum, ChecksumHeaderMalformed);
+        return false;
+    }
+    return true;
+}
+
+ComputeChecksum *ValidateChecksumHeader::prepareStart(const QByteArray &checksumHeader)
+{
+    if (!parseExpectedChecksum(checksumHeader)) {
         return nullptr;
     }
 
@@ -360,6 +427,13 @@ void ValidateChecksumHeader::start(std::unique_ptr<QIODevice> device, const QByt
         calculator->start(std::move(device));
 }
 
+void ValidateChecksumHeader::validate(const QByteArray &checksumHeader, const QByteArray &calculatedChecksumType, const QByteArray &calculatedChecksum)
+{
+    if (parseExpectedChecksum(checksumHeader)) {
+        slotChecksumCalculated(calculatedChecksumType, calculatedChecksum);
+    }
+}
+
 QByteArray ValidateChecksumHeader::calculatedChecksumType() const
 {
     return _calculatedChecksumType;
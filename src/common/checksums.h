@@ -28,6 +28,7 @@
 #include <memory>
 
 class QFile;
+class QCryptographicHash;
 
 namespace OCC {
 
@@ -72,6 +73,36 @@ QByteArray OCSYNC_EXPORT calcSha1(QIODevice *device);
 QByteArray OCSYNC_EXPORT calcAdler32(QIODevice *device);
 #endif
 
+/**
+ * Computes a checksum from data that is fed in piece by piece, for
+ * example while it is written to or read from the network.
+ * \ingroup libsync
+ */
+class OCSYNC_EXPORT ChecksumCalculator
+{
+public:
+    explicit ChecksumCalculator(const QByteArray &checksumType);
+    ChecksumCalculator(ChecksumCalculator &&) noexcept;
+    ChecksumCalculator &operator=(ChecksumCalculator &&) noexcept;
+    ~ChecksumCalculator();
+
+    /// False for unknown checksum types or when checksum computations are disabled
+    [[nodiscard]] bool isValid() const;
+    [[nodiscard]] QByteArray checksumType() const { return _checksumType; }
+
+    void addData(const char *data, qint64 length);
+
+    /// The checksum of all data added so far, in the same format as ComputeChecksum
+    [[nodiscard]] QByteArray result() const;
+
+private:
+    QByteArray _checksumType;
+    std::unique_ptr<QCryptographicHash> _cryptoHash;
+    bool _isAdler32 = false;
+    unsigned long _adler32 = 0;
+    qint64 _size = 0;
+};
+
 /**
  * Computes the checksum of a file.
  * \ingroup libsync
@@ -169,6 +200,14 @@ public:
      */
     void start(std::unique_ptr<QIODevice> device, const QByteArray &checksumHeader);
 
+    /**
+     * Check a checksum that was already computed, for example while
+     * downloading, against the provided checksumHeader
+     *
+     * Emits the same signals as start(), but synchronously.
+     */
+    void validate(const QByteArray &checksumHeader, const QByteArray &calculatedChecksumType, const QByteArray &calculatedChecksum);
+
     [[nodiscard]] QByteArray calculatedChecksumType() const;
     [[nodiscard]] QByteArray calculatedChecksum() const;
 
@@ -181,6 +220,7 @@ private slots:
     void slotChecksumCalculated(const QByteArray &checksumType, const QByteArray &checksum);
 
 private:
+    bool parseExpectedChecksum(const QByteArray &checksumHeader);
     ComputeChecksum *prepareStart(const QByteArray &checksumHeader);
 
     QByteArray _expectedChecksumType;
@@ -28,6 +28,8 @@
 #include "common/asserts.h"
 #include <sqlite3.h>
 
+#include <cstring>
+
 #define SQLITE_SLEEP_TIME_USEC 100000
 #define SQLITE_REPEAT_COUNT 20
 
@@ -356,6 +358,50 @@ auto SqlQuery::next() -> NextResult
     return result;
 }
 
+void SqlQuery::bindInt(int pos, int value)
+{
+    ASSERT(_stmt);
+    checkBindResult(pos, sqlite3_bind_int(_stmt, pos, value));
+}
+
+void SqlQuery::bindInt64(int pos, qint64 value)
+{
+    ASSERT(_stmt);
+    checkBindResult(pos, sqlite3_bind_int64(_stmt, pos, value));
+}
+
+void SqlQuery::bindDouble(int pos, double value)
+{
+    ASSERT(_stmt);
+    checkBindResult(pos, sqlite3_bind_double(_stmt, pos, value));
+}
+
+void SqlQuery::bindString(int pos, const QString &value)
+{
+    ASSERT(_stmt);
+    if (value.isNull()) {
+        checkBindResult(pos, sqlite3_bind_null(_stmt, pos));
+        return;
+    }
+    // SQLITE_TRANSIENT makes sure that sqlite buffers the data
+    checkBindResult(pos, sqlite3_bind_text16(_stmt, pos, value.utf16(),
+        value.size() * static_cast<int>(sizeof(QChar)), SQLITE_TRANSIENT));
+}
+
+void SqlQuery::bindByteArray(int pos, const QByteArray &value)
+{
+    ASSERT(_stmt);
+    checkBindResult(pos, sqlite3_bind_text(_stmt, pos, value.constData(), value.size(), SQLITE_TRANSIENT));
+}
+
+void SqlQuery::checkBindResult(int pos, int res)
+{
+    if (res != SQLITE_OK) {
+        qCWarning(lcSql) << "ERROR binding SQL value at" << pos << "error:" << res;
+    }
+    ASSERT(res == SQLITE_OK);
+}
+
 void SqlQuery::bindValueInternal(int pos, const QVariant &value)
 {
     int res = -1;
@@ -426,9 +472,20 @@ bool SqlQuery::nullValue(int index)
     return sqlite3_column_type(_stmt, index) == SQLITE_NULL;
 }
 
+int SqlQuery::columnCount() const
+{
+    return sqlite3_column_count(_stmt);
+}
+
 QString SqlQuery::stringValue(int index)
 {
-    return QString::fromUtf16(static_cast<const ushort *>(sqlite3_column_text16(_stmt, index)));
+    // Decode the UTF-8 text ourselves: asking sqlite for UTF-16 would make
+    // it convert into a buffer of its own first.
+    const auto text = reinterpret_cast<const char *>(sqlite3_column_text(_stmt, index));
+    if (!text) {
+        return {};
+    }
+    return QString::fromUtf8(text, sqlite3_column_bytes(_stmt, index));
 }
 
 int SqlQuery::intValue(int index)
@@ -441,12 +498,37 @@ quint64 SqlQuery::int64Value(int index)
     return sqlite3_column_int64(_stmt, index);
 }
 
+double SqlQuery::doubleValue(int index)
+{
+    return sqlite3_column_double(_stmt, index);
+}
+
 QByteArray SqlQuery::baValue(int index)
 {
     return QByteArray(static_cast<const char *>(sqlite3_column_blob(_stmt, index)),
         sqlite3_column_bytes(_stmt, index));
 }
 
+void SqlQuery::baValue(int index, QByteArray &out)
+{
+    const auto data = static_cast<const char *>(sqlite3_column_blob(_stmt, index));
+    const auto size = sqlite3_column_bytes(_stmt, index);
+    if (size == 0) {
+        // keep the null/empty distinction of baValue(int)
+        out = data ? QByteArray("") : QByteArray();
+        return;
+    }
+    // resize() only allocates if the buffer is shared or too small
+    out.resize(size);
+    std::memcpy(out.data(), data, static_cast<size_t>(size));
+}
+
+QByteArray SqlQuery::baView(int index)
+{
+    const auto text = reinterpret_cast<const char *>(sqlite3_column_text(_stmt, index));
+    return QByteArray::fromRawData(text, sqlite3_column_bytes(_stmt, index));
+}
+
 QString SqlQuery::error() const
 {
     return _error;
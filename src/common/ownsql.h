@@ -25,6 +25,8 @@
 
 #include "ocsynclib.h"
 
+#include <type_traits>
+
 struct sqlite3;
 struct sqlite3_stmt;
 
@@ -116,11 +118,51 @@ public:
 
     /// Checks whether the value at the given column index is NULL
     bool nullValue(int index);
+    [[nodiscard]] int columnCount() const;
 
     QString stringValue(int index);
     int intValue(int index);
     quint64 int64Value(int index);
+    double doubleValue(int index);
     QByteArray baValue(int index);
+
+    /**
+     * Reads the column into @a out, reusing its buffer when it is not shared,
+     * so filling the same record row after row doesn't allocate for every value.
+     */
+    void baValue(int index, QByteArray &out);
+
+    /**
+     * The column's UTF-8 text without copying it.
+     *
+     * The data is owned by SQLite and zero terminated; it stays valid until
+     * the next call to next(), reset_and_clear_bindings() or another accessor
+     * converting the same column.
+     */
+    QByteArray baView(int index);
+
+    /// Reads the column as @a T, picking the matching accessor at compile time
+    template <class T>
+    T value(int index)
+    {
+        if constexpr (std::is_same_v<T, bool>) {
+            return intValue(index) != 0;
+        } else if constexpr (std::is_enum_v<T>) {
+            return static_cast<T>(intValue(index));
+        } else if constexpr (std::is_integral_v<T> && sizeof(T) <= sizeof(int) && std::is_signed_v<T>) {
+            return static_cast<T>(intValue(index));
+        } else if constexpr (std::is_integral_v<T>) {
+            return static_cast<T>(int64Value(index));
+        } else if constexpr (std::is_floating_point_v<T>) {
+            return static_cast<T>(doubleValue(index));
+        } else if constexpr (std::is_same_v<T, QString>) {
+            return stringValue(index);
+        } else {
+            static_assert(std::is_same_v<T, QByteArray>, "no column accessor for this type");
+            return baValue(index);
+        }
+    }
+
     bool isSelect();
     bool isPragma();
     bool exec();
@@ -132,21 +174,35 @@ public:
     };
     NextResult next();
 
-    template<class T, typename std::enable_if<std::is_enum<T>::value, int>::type = 0>
-    void bindValue(int pos, const T &value)
-    {
-        bindValueInternal(pos, static_cast<int>(value));
-    }
-
-    template<class T, typename std::enable_if<!std::is_enum<T>::value, int>::type = 0>
+    /**
+     * Binds @a value to the parameter at @a pos.
+     *
+     * Numbers and strings are bound directly; only other types go through
+     * a QVariant.
+     */
+    template <class T>
     void bindValue(int pos, const T &value)
     {
-        bindValueInternal(pos, value);
-    }
-
-    void bindValue(int pos, const QByteArray &value)
-    {
-        bindValueInternal(pos, value);
+        if constexpr (std::is_same_v<T, bool>) {
+            bindInt(pos, value ? 1 : 0);
+        } else if constexpr (std::is_enum_v<T>) {
+            bindInt(pos, static_cast<int>(value));
+        } else if constexpr (std::is_integral_v<T> && sizeof(T) <= sizeof(int) && std::is_signed_v<T>) {
+            bindInt(pos, value);
+        } else if constexpr (std::is_integral_v<T>) {
+            bindInt64(pos, static_cast<qint64>(value));
+        } else if constexpr (std::is_floating_point_v<T>) {
+            bindDouble(pos, value);
+        } else if constexpr (std::is_same_v<T, QString>) {
+            bindString(pos, value);
+        } else if constexpr (std::is_same_v<T, QByteArray>) {
+            bindByteArray(pos, value);
+        } else if constexpr (std::is_convertible_v<const T &, QByteArray> && !std::is_convertible_v<const T &, QString>) {
+            // QStringBuilder expressions of byte arrays
+            bindByteArray(pos, value);
+        } else {
+            bindValueInternal(pos, value);
+        }
     }
 
     [[nodiscard]] const QByteArray &lastQuery() const;
@@ -154,7 +210,13 @@ public:
     void reset_and_clear_bindings();
 
 private:
+    void bindInt(int pos, int value);
+    void bindInt64(int pos, qint64 value);
+    void bindDouble(int pos, double value);
+    void bindString(int pos, const QString &value);
+    void bindByteArray(int pos, const QByteArray &value);
     void bindValueInternal(int pos, const QVariant &value);
+    void checkBindResult(int pos, int res);
     void finish();
 
     SqlDatabase *_sqldb = nullptr;
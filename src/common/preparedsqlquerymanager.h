@@ -63,6 +63,8 @@ public:
         GetFileRecordQueryByMangledName,
         GetFileRecordQueryByInode,
         GetFileRecordQueryByFileId,
+        GetFileRecordQueryBySize,
+        GetFileRecordQueryByNumericFileId,
         GetFilesBelowPathQuery,
         GetAllFilesQuery,
         ListFilesInPathQuery,
@@ -75,6 +77,9 @@ public:
         GetUploadInfoQuery,
         SetUploadInfoQuery,
         DeleteUploadInfoQuery,
+        GetBlockSignatureQuery,
+        SetBlockSignatureQuery,
+        DeleteBlockSignatureQuery,
         DeleteFileRecordPhash,
         DeleteFileRecordRecursively,
         GetErrorBlacklistQuery,
@@ -107,6 +112,9 @@ public:
         GetE2EeLockedFolderQuery,
         GetE2EeLockedFoldersQuery,
         DeleteE2EeLockedFolderQuery,
+        SetE2EeFolderMetadataCacheQuery,
+        GetE2EeFolderMetadataCacheQuery,
+        DeleteE2EeFolderMetadataCacheQuery,
 
         PreparedQueryCount
     };
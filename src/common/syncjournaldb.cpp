@@ -18,12 +18,14 @@
 
 #include <QCryptographicHash>
 #include <QFile>
+#include <QFileInfo>
 #include <QLoggingCategory>
 #include <QStringList>
 #include <QElapsedTimer>
 #include <QUrl>
 #include <QDir>
 #include <sqlite3.h>
+#include <algorithm>
 #include <cstring>
 
 #include "common/syncjournaldb.h"
@@ -46,37 +48,139 @@ namespace OCC {
 
 Q_LOGGING_CATEGORY(lcDb, "nextcloud.sync.database", QtInfoMsg)
 
+namespace {
+
+constexpr qint64 walSizeLimit = 16 * 1024 * 1024;
+
+// How often performMaintenance() does its work without being forced
+constexpr qint64 maintenanceIntervalSecs = 6 * 60 * 60;
+
+// Free pages given back to the file system per maintenance run, a few MiB
+constexpr qint64 incrementalVacuumPages = 1024;
+
+// Rows PRAGMA optimize looks at per index, to keep its ANALYZE quick on big journals
+constexpr int analysisLimit = 400;
+
+const auto lastMaintenanceKey = QStringLiteral("lastJournalMaintenance");
+
+// Bounds of the sizes picked for a PerformanceProfile, the smallest cache is sqlite's default.
+// The cache only grows for journals that aren't memory mapped.
+constexpr qint64 minCacheSize = 2 * 1024 * 1024;
+constexpr qint64 maxCacheSize = 64 * 1024 * 1024;
+constexpr qint64 minMmapSize = 64 * 1024 * 1024;
+constexpr qint64 maxMmapSize = sizeof(void *) > 4 ? 1024 * 1024 * 1024 : 256 * 1024 * 1024;
+
+}
+
 #define GET_FILE_RECORD_QUERY \
         "SELECT path, inode, modtime, type, md5, fileid, remotePerm, filesize," \
-        "  ignoredChildrenRemote, contentchecksumtype.name || ':' || contentChecksum, e2eMangledName, isE2eEncrypted, " \
+        "  ignoredChildrenRemote, contentchecksumtype.name, contentChecksum, e2eMangledName, isE2eEncrypted, " \
         "  lock, lockOwnerDisplayName, lockOwnerId, lockType, lockOwnerEditor, lockTime, lockTimeout, isShared, lastShareStateFetchedTimestmap, sharedByMe" \
         " FROM metadata" \
         "  LEFT JOIN checksumtype as contentchecksumtype ON metadata.contentChecksumTypeId == contentchecksumtype.id"
 
+// The lookups done for every item of a sync. They are named so that
+// statistics() can report their query plans.
+#define GET_FILE_RECORD_BY_PHASH_QUERY GET_FILE_RECORD_QUERY " WHERE phash=?1"
+#define GET_FILE_RECORD_BY_INODE_QUERY GET_FILE_RECORD_QUERY " WHERE inode=?1"
+#define GET_FILE_RECORD_BY_FILEID_QUERY GET_FILE_RECORD_QUERY " WHERE fileid=?1"
+#define GET_FILE_RECORD_BY_SIZE_QUERY GET_FILE_RECORD_QUERY " WHERE filesize=?1 AND contentChecksum != ''"
+// We want to ensure that the contents of a directory are sorted
+// directly behind the directory itself. Without this ORDER BY
+// an ordering like foo, foo-2, foo/file would be returned.
+// With the trailing /, we get foo-2, foo, foo/file. This property
+// is used in fill_tree_from_db().
+#define GET_FILES_BELOW_PATH_QUERY GET_FILE_RECORD_QUERY " WHERE " IS_PREFIX_PATH_OF("?1", "path") \
+        " OR " IS_PREFIX_PATH_OF("?1", "e2eMangledName") \
+        " ORDER BY path||'/' ASC"
+#define LIST_FILES_IN_PATH_QUERY GET_FILE_RECORD_QUERY " WHERE parent_hash(path) = ?1 ORDER BY path||'/' ASC"
+#define GET_ERROR_BLACKLIST_QUERY \
+        "SELECT lastTryEtag, lastTryModtime, retrycount, errorstring, lastTryTime, ignoreDuration, renameTarget, errorCategory, requestId " \
+        "FROM blacklist WHERE path=?1"
+// explicitly allow "" to represent the root path
+// (it'd be great if paths started with a / and "/" could be the root)
+#define GET_EFFECTIVE_PIN_STATE_QUERY \
+        "SELECT pinState FROM flags WHERE" \
+        " (" IS_PREFIX_PATH_OR_EQUAL("path", "?1") " OR path == '')" \
+        " AND pinState is not null AND pinState != 0" \
+        " ORDER BY length(path) DESC LIMIT 1;"
+
+// Column indices of GET_FILE_RECORD_QUERY, in the order of its SELECT
+namespace GetFileRecordColumn {
+enum : int {
+    Path,
+    Inode,
+    Modtime,
+    Type,
+    Etag,
+    FileId,
+    RemotePerm,
+    FileSize,
+    IgnoredChildrenRemote,
+    ChecksumTypeName,
+    Checksum,
+    E2eMangledName,
+    E2eEncryptionStatus,
+    Locked,
+    LockOwnerDisplayName,
+    LockOwnerId,
+    LockOwnerType,
+    LockEditorApp,
+    LockTime,
+    LockTimeout,
+    IsShared,
+    LastShareStateFetchedTimestamp,
+    SharedByMe,
+    Count
+};
+}
+
+/**
+ * Fills @a rec from the current row of a GET_FILE_RECORD_QUERY.
+ *
+ * The byte arrays of @a rec are overwritten in place, so a record reused
+ * across rows only allocates when a value outgrows its buffer.
+ */
 static void fillFileRecordFromGetQuery(SyncJournalFileRecord &rec, SqlQuery &query)
 {
-    rec._path = query.baValue(0);
-    rec._inode = query.int64Value(1);
-    rec._modtime = query.int64Value(2);
-    rec._type = static_cast<ItemType>(query.intValue(3));
-    rec._etag = query.baValue(4);
-    rec._fileId = query.baValue(5);
-    rec._remotePerm = RemotePermissions::fromDbValue(query.baValue(6));
-    rec._fileSize = query.int64Value(7);
-    rec._serverHasIgnoredFiles = (query.intValue(8) > 0);
-    rec._checksumHeader = query.baValue(9);
-    rec._e2eMangledName = query.baValue(10);
-    rec._e2eEncryptionStatus = static_cast<SyncJournalFileRecord::EncryptionStatus>(query.intValue(11));
-    rec._lockstate._locked = query.intValue(12) > 0;
-    rec._lockstate._lockOwnerDisplayName = query.stringValue(13);
-    rec._lockstate._lockOwnerId = query.stringValue(14);
-    rec._lockstate._lockOwnerType = query.int64Value(15);
-    rec._lockstate._lockEditorApp = query.stringValue(16);
-    rec._lockstate._lockTime = query.int64Value(17);
-    rec._lockstate._lockTimeout = query.int64Value(18);
-    rec._isShared = query.intValue(19) > 0;
-    rec._lastShareStateFetchedTimestamp = query.int64Value(20);
-    rec._sharedByMe = query.intValue(21) > 0;
+    using namespace GetFileRecordColumn;
+    Q_ASSERT(query.columnCount() == Count);
+
+    query.baValue(Path, rec._path);
+    rec._inode = query.value<quint64>(Inode);
+    rec._modtime = query.value<qint64>(Modtime);
+    rec._type = query.value<ItemType>(Type);
+    query.baValue(Etag, rec._etag);
+    query.baValue(FileId, rec._fileId);
+    rec._remotePerm = RemotePermissions::fromDbValue(query.baView(RemotePerm));
+    rec._fileSize = query.value<qint64>(FileSize);
+    rec._serverHasIgnoredFiles = query.value<int>(IgnoredChildrenRemote) > 0;
+
+    // Joined here rather than in SQL, which would build a temporary string per row
+    if (query.nullValue(ChecksumTypeName) || query.nullValue(Checksum)) {
+        rec._checksumHeader.clear();
+    } else {
+        const auto checksumType = query.baView(ChecksumTypeName);
+        const auto checksum = query.baView(Checksum);
+        rec._checksumHeader.resize(checksumType.size() + 1 + checksum.size());
+        auto out = rec._checksumHeader.data();
+        std::memcpy(out, checksumType.constData(), static_cast<size_t>(checksumType.size()));
+        out[checksumType.size()] = ':';
+        std::memcpy(out + checksumType.size() + 1, checksum.constData(), static_cast<size_t>(checksum.size()));
+    }
+
+    query.baValue(E2eMangledName, rec._e2eMangledName);
+    rec._e2eEncryptionStatus = query.value<SyncJournalFileRecord::EncryptionStatus>(E2eEncryptionStatus);
+    rec._lockstate._locked = query.value<int>(Locked) > 0;
+    rec._lockstate._lockOwnerDisplayName = query.value<QString>(LockOwnerDisplayName);
+    rec._lockstate._lockOwnerId = query.value<QString>(LockOwnerId);
+    rec._lockstate._lockOwnerType = query.value<qint64>(LockOwnerType);
+    rec._lockstate._lockEditorApp = query.value<QString>(LockEditorApp);
+    rec._lockstate._lockTime = query.value<qint64>(LockTime);
+    rec._lockstate._lockTimeout = query.value<qint64>(LockTimeout);
+    rec._isShared = query.value<int>(IsShared) > 0;
+    rec._lastShareStateFetchedTimestamp = query.value<qint64>(LastShareStateFetchedTimestamp);
+    rec._sharedByMe = query.value<int>(SharedByMe) > 0;
 }
 
 static QByteArray defaultJournalMode(const QString &dbPath)
@@ -230,6 +334,237 @@ void SyncJournalDb::walCheckpoint()
     }
 }
 
+void SyncJournalDb::setPerformanceProfile(const PerformanceProfile &profile)
+{
+    QMutexLocker locker(&_mutex);
+    _performanceProfile = profile;
+    if (_db.isOpen()) {
+        applyPerformanceProfile();
+    }
+}
+
+void SyncJournalDb::applyPerformanceProfile()
+{
+    const auto dbSize = QFileInfo(_dbFile).size();
+    const auto memory = Utility::physicalMemory();
+
+    // For debugging purposes, allow the sizes to be forced
+    const auto envMmapSize = qEnvironmentVariable("OWNCLOUD_SQLITE_MMAP_SIZE");
+    const auto envCacheSize = qEnvironmentVariable("OWNCLOUD_SQLITE_CACHE_SIZE");
+
+    auto mmapSize = envMmapSize.isEmpty() ? _performanceProfile.mmapSize : envMmapSize.toLongLong();
+    if (QString::fromUtf8(_journalMode).compare(QStringLiteral("wal"), Qt::CaseInsensitive) != 0) {
+        // The journal modes other than WAL are picked for FAT and mounted
+        // volumes, where an I/O error on a mapped page kills the process
+        mmapSize = 0;
+    } else if (mmapSize < 0) {
+        // Only the existing part of the file is mapped, the rest is room
+        // for the journal to grow while it is open
+        mmapSize = qBound(minMmapSize, dbSize * 2, maxMmapSize);
+        if (memory > 0) {
+            mmapSize = std::min(mmapSize, memory / 8);
+        }
+    }
+
+    // sqlite caps the value at its compile time maximum and returns what it applied
+    SqlQuery mmapQuery("PRAGMA mmap_size = " + QByteArray::number(mmapSize) + ";", _db);
+    const auto mmapResult = mmapQuery.next();
+    if (!mmapResult.ok) {
+        qCWarning(lcDb) << "Could not set PRAGMA mmap_size" << mmapQuery.error();
+        mmapSize = 0;
+    } else if (mmapResult.hasData) {
+        mmapSize = mmapQuery.int64Value(0);
+        qCInfo(lcDb) << "sqlite3 mmap_size=" << mmapSize;
+    }
+
+    auto cacheSize = envCacheSize.isEmpty() ? _performanceProfile.cacheSize : envCacheSize.toLongLong();
+    if (cacheSize < 0 && mmapSize > 0) {
+        // The mapped pages are read without going through the page cache,
+        // so it only holds the pages changed by the running transaction
+        cacheSize = minCacheSize;
+    } else if (cacheSize < 0) {
+        cacheSize = qBound(minCacheSize, dbSize / 4, maxCacheSize);
+        if (memory > 0) {
+            cacheSize = std::max(minCacheSize, std::min(cacheSize, memory / 32));
+        }
+    }
+
+    // A negative cache_size is in KiB instead of pages
+    SqlQuery cacheQuery("PRAGMA cache_size = " + QByteArray::number(-std::max<qint64>(cacheSize / 1024, 1)) + ";", _db);
+    if (cacheQuery.next().ok) {
+        qCInfo(lcDb) << "sqlite3 cache_size=" << cacheSize << "bytes";
+    } else {
+        qCWarning(lcDb) << "Could not set PRAGMA cache_size" << cacheQuery.error();
+    }
+}
+
+static qint64 pragmaValue(SqlDatabase &db, const QByteArray &pragma)
+{
+    SqlQuery query("PRAGMA " + pragma + ";", db);
+    if (!query.exec() || !query.next().hasData) {
+        return -1;
+    }
+    return query.int64Value(0);
+}
+
+SyncJournalDb::PerformanceProfile SyncJournalDb::appliedPerformanceProfile()
+{
+    QMutexLocker locker(&_mutex);
+    PerformanceProfile profile;
+    if (!checkConnect()) {
+        return profile;
+    }
+    profile.mmapSize = pragmaValue(_db, "mmap_size");
+    const auto cacheSize = pragmaValue(_db, "cache_size");
+    profile.cacheSize = cacheSize < 0 ? -cacheSize * 1024 : cacheSize * pragmaValue(_db, "page_size");
+    return profile;
+}
+
+void SyncJournalDb::performMaintenance(bool force)
+{
+    QMutexLocker locker(&_mutex);
+    if (!checkConnect()) {
+        return;
+    }
+
+    const auto now = QDateTime::currentSecsSinceEpoch();
+    if (!force && now - keyValueStoreGetInt(lastMaintenanceKey, 0) < maintenanceIntervalSecs) {
+        return;
+    }
+
+    QElapsedTimer t;
+    t.start();
+
+    // The checkpoint can't run inside a transaction
+    commitTransaction();
+
+    // Only a bounded number of pages, so the run stays short on any journal. Journals
+    // created without incremental auto vacuum would need a full VACUUM, which rewrites
+    // the whole file and is too slow to run while the client is in use.
+    const auto freePages = pragmaValue(_db, "freelist_count");
+    if (pragmaValue(_db, "auto_vacuum") != 2) {
+        qCDebug(lcDb) << "Not compacting the database, it has no incremental auto vacuum," << freePages << "pages are free";
+    } else if (freePages > 0) {
+        SqlQuery query("PRAGMA incremental_vacuum(" + QByteArray::number(incrementalVacuumPages) + ");", _db);
+        // Pragmas only run when stepped, and each freed page is a step
+        while (query.next().hasData) { }
+    }
+
+    // Runs ANALYZE on the tables whose statistics are outdated, on a sample of their rows
+    SqlQuery optimize("PRAGMA analysis_limit = " + QByteArray::number(analysisLimit) + ";", _db);
+    optimize.next();
+    optimize.prepare("PRAGMA optimize;");
+    optimize.next();
+
+    SqlQuery checkpoint("PRAGMA wal_checkpoint(TRUNCATE);", _db);
+    checkpoint.next();
+
+    // The journal may have grown a lot since it was opened
+    applyPerformanceProfile();
+
+    keyValueStoreSet(lastMaintenanceKey, now);
+    qCInfo(lcDb) << "Maintenance took" << t.elapsed() << "msec, the database has"
+                 << pragmaValue(_db, "page_count") << "pages of which" << pragmaValue(_db, "freelist_count") << "are free";
+}
+
+SyncJournalDb::Statistics SyncJournalDb::statistics()
+{
+    QMutexLocker locker(&_mutex);
+    if (!checkConnect()) {
+        return {};
+    }
+    return collectStatistics(_db, _dbFile);
+}
+
+SyncJournalDb::Statistics SyncJournalDb::readOnlyStatistics(const QString &dbFile)
+{
+    SqlDatabase db;
+    if (!db.openReadOnly(dbFile)) {
+        return {};
+    }
+    return collectStatistics(db, dbFile);
+}
+
+SyncJournalDb::Statistics SyncJournalDb::collectStatistics(SqlDatabase &db, const QString &dbFile)
+{
+    Statistics stats;
+    stats.pageSize = pragmaValue(db, "page_size");
+    stats.pageCount = pragmaValue(db, "page_count");
+    stats.freePages = pragmaValue(db, "freelist_count");
+    const QString walFile = dbFile + QStringLiteral("-wal");
+    stats.walBytes = QFileInfo(walFile).size();
+    switch (pragmaValue(db, "auto_vacuum")) {
+    case 0:
+        stats.autoVacuum = QStringLiteral("none");
+        break;
+    case 1:
+        stats.autoVacuum = QStringLiteral("full");
+        break;
+    case 2:
+        stats.autoVacuum = QStringLiteral("incremental");
+        break;
+    }
+
+    SqlQuery tablesQuery("SELECT name FROM sqlite_master WHERE type='table' AND name NOT LIKE 'sqlite_%' ORDER BY name;", db);
+    if (!tablesQuery.exec()) {
+        return stats;
+    }
+    while (tablesQuery.next().hasData) {
+        Statistics::Table table;
+        table.name = tablesQuery.stringValue(0);
+        stats.tables.append(table);
+    }
+    for (auto &table : stats.tables) {
+        SqlQuery countQuery(db);
+        countQuery.prepare("SELECT count(*) FROM \"" + table.name.toUtf8() + "\";");
+        if (countQuery.exec() && countQuery.next().hasData) {
+            table.rows = countQuery.int64Value(0);
+        }
+    }
+
+    // The dbstat table is only there when sqlite was built with SQLITE_ENABLE_DBSTAT_VTAB
+    SqlQuery sizeQuery(db);
+    if (sizeQuery.prepare("SELECT master.tbl_name, SUM(stat.pgsize) FROM dbstat AS stat"
+                          " JOIN sqlite_master AS master ON stat.name = master.name GROUP BY master.tbl_name;",
+            /*allow_failure=*/true)
+        == 0) {
+        if (sizeQuery.exec()) {
+            while (sizeQuery.next().hasData) {
+                const auto name = sizeQuery.stringValue(0);
+                for (auto &table : stats.tables) {
+                    if (table.name == name) {
+                        table.bytes = sizeQuery.int64Value(1);
+                    }
+                }
+            }
+        }
+    }
+
+    const QVector<QPair<QString, QByteArray>> hotQueries = {
+        { QStringLiteral("GetFileRecordQuery"), QByteArrayLiteral(GET_FILE_RECORD_BY_PHASH_QUERY) },
+        { QStringLiteral("GetFileRecordQueryByInode"), QByteArrayLiteral(GET_FILE_RECORD_BY_INODE_QUERY) },
+        { QStringLiteral("GetFileRecordQueryByFileId"), QByteArrayLiteral(GET_FILE_RECORD_BY_FILEID_QUERY) },
+        { QStringLiteral("GetFileRecordQueryBySize"), QByteArrayLiteral(GET_FILE_RECORD_BY_SIZE_QUERY) },
+        { QStringLiteral("GetFilesBelowPathQuery"), QByteArrayLiteral(GET_FILES_BELOW_PATH_QUERY) },
+        { QStringLiteral("ListFilesInPathQuery"), QByteArrayLiteral(LIST_FILES_IN_PATH_QUERY) },
+        { QStringLiteral("GetErrorBlacklistQuery"), QByteArrayLiteral(GET_ERROR_BLACKLIST_QUERY) },
+        { QStringLiteral("GetEffectivePinStateQuery"), QByteArrayLiteral(GET_EFFECTIVE_PIN_STATE_QUERY) },
+    };
+    for (const auto &hotQuery : hotQueries) {
+        Statistics::QueryPlan plan{ hotQuery.first, hotQuery.second };
+        SqlQuery explain(db);
+        // Not a select, so exec() would already consume the first row
+        if (explain.prepare("EXPLAIN QUERY PLAN " + hotQuery.second, /*allow_failure=*/true) == 0) {
+            // The columns are id, parent, notused and detail
+            while (explain.next().hasData) {
+                plan.steps.append(explain.stringValue(3));
+            }
+        }
+        stats.queryPlans.append(plan);
+    }
+    return stats;
+}
+
 void SyncJournalDb::startTransaction()
 {
     if (_transaction == 0) {
@@ -323,6 +658,13 @@ bool SyncJournalDb::checkConnect()
         qCInfo(lcDb) << "sqlite3 locking_mode=" << pragma1.stringValue(0);
     }
 
+    // Only takes effect for a new database, and only before anything was written
+    // to it. Switching to WAL already writes the database header.
+    pragma1.prepare("PRAGMA auto_vacuum = INCREMENTAL;");
+    if (!pragma1.next().ok) {
+        return sqlFail(QStringLiteral("Set PRAGMA auto_vacuum"), pragma1);
+    }
+
     pragma1.prepare("PRAGMA journal_mode=" + _journalMode + ";");
     if (!pragma1.exec()) {
         return sqlFail(QStringLiteral("Set PRAGMA journal_mode"), pragma1);
@@ -358,6 +700,14 @@ bool SyncJournalDb::checkConnect()
         return sqlFail(QStringLiteral("Set PRAGMA case_sensitivity"), pragma1);
     }
 
+    // Shrink the -wal file back to this size after checkpoints, it is never truncated otherwise
+    pragma1.prepare("PRAGMA journal_size_limit = " + QByteArray::number(walSizeLimit) + ";");
+    if (!pragma1.next().ok) {
+        return sqlFail(QStringLiteral("Set PRAGMA journal_size_limit"), pragma1);
+    }
+
+    applyPerformanceProfile();
+
     sqlite3_create_function(_db.sqliteDb(), "parent_hash", 1, SQLITE_UTF8 | SQLITE_DETERMINISTIC, nullptr,
                                 [] (sqlite3_context *ctx,int, sqlite3_value **argv) {
                                     auto text = reinterpret_cast<const char*>(sqlite3_value_text(argv[0]));
@@ -447,6 +797,17 @@ bool SyncJournalDb::checkConnect()
         return sqlFail(QStringLiteral("Create table uploadinfo"), createQuery);
     }
 
+    createQuery.prepare("CREATE TABLE IF NOT EXISTS blocksignatures("
+                        "path VARCHAR(4096),"
+                        "transferid INTEGER,"
+                        "signature BLOB,"
+                        "PRIMARY KEY(path)"
+                        ");");
+
+    if (!createQuery.exec()) {
+        return sqlFail(QStringLiteral("Create table blocksignatures"), createQuery);
+    }
+
     // create the blacklist table.
     createQuery.prepare("CREATE TABLE IF NOT EXISTS blacklist ("
                         "path VARCHAR(4096),"
@@ -549,6 +910,17 @@ bool SyncJournalDb::checkConnect()
         return sqlFail(QStringLiteral("Create table e2EeLockedFolders"), createQuery);
     }
 
+    // create the e2EeFolderMetadataCache table.
+    createQuery.prepare(
+        "CREATE TABLE IF NOT EXISTS e2EeFolderMetadataCache("
+        "folderId VARCHAR(128) PRIMARY KEY,"
+        "etag VARCHAR(32),"
+        "metadata BLOB"
+        ");");
+    if (!createQuery.exec()) {
+        return sqlFail(QStringLiteral("Create table e2EeFolderMetadataCache"), createQuery);
+    }
+
     bool forceRemoteDiscovery = false;
 
     SqlQuery versionQuery("SELECT major, minor, patch FROM version;", _db);
@@ -628,8 +1000,7 @@ bool SyncJournalDb::checkConnect()
         return sqlFail(QStringLiteral("prepare _deleteUploadInfoQuery"), *deleteUploadInfoQuery);
     }
 
-    QByteArray sql("SELECT lastTryEtag, lastTryModtime, retrycount, errorstring, lastTryTime, ignoreDuration, renameTarget, errorCategory, requestId "
-                   "FROM blacklist WHERE path=?1");
+    QByteArray sql(GET_ERROR_BLACKLIST_QUERY);
     if (Utility::fsCasePreserving()) {
         // if the file system is case preserving we have to check the blacklist
         // case insensitively
@@ -745,6 +1116,16 @@ bool SyncJournalDb::updateMetadataTableStructure()
         commitInternal(QStringLiteral("update database structure: add parent index"));
     }
 
+    if (true) {
+        SqlQuery query(_db);
+        query.prepare("CREATE INDEX IF NOT EXISTS metadata_filesize ON metadata(filesize);");
+        if (!query.exec()) {
+            sqlFail(QStringLiteral("updateMetadataTableStructure: create index filesize"), query);
+            re = false;
+        }
+        commitInternal(QStringLiteral("update database structure: add filesize index"));
+    }
+
     addColumn(QStringLiteral("ignoredChildrenRemote"), QStringLiteral("INT"));
     addColumn(QStringLiteral("contentChecksum"), QStringLiteral("TEXT"));
     addColumn(QStringLiteral("contentChecksumTypeId"), QStringLiteral("INTEGER"));
@@ -1070,6 +1451,7 @@ bool SyncJournalDb::deleteFileRecord(const QString &filename, bool recursively)
             if (!query->exec()) {
                 return false;
             }
+            _fileRecordsDeletedSinceFlagsCleanup = true;
         }
 
         if (recursively) {
@@ -1105,7 +1487,7 @@ bool SyncJournalDb::getFileRecord(const QByteArray &filename, SyncJournalFileRec
         return false;
 
     if (!filename.isEmpty()) {
-        const auto query = _queryManager.get(PreparedSqlQueryManager::GetFileRecordQuery, QByteArrayLiteral(GET_FILE_RECORD_QUERY " WHERE phash=?1"), _db);
+        const auto query = _queryManager.get(PreparedSqlQueryManager::GetFileRecordQuery, QByteArrayLiteral(GET_FILE_RECORD_BY_PHASH_QUERY), _db);
         if (!query) {
             return false;
         }
@@ -1189,7 +1571,7 @@ bool SyncJournalDb::getFileRecordByInode(quint64 inode, SyncJournalFileRecord *r
 
     if (!checkConnect())
         return false;
-    const auto query = _queryManager.get(PreparedSqlQueryManager::GetFileRecordQueryByInode, QByteArrayLiteral(GET_FILE_RECORD_QUERY " WHERE inode=?1"), _db);
+    const auto query = _queryManager.get(PreparedSqlQueryManager::GetFileRecordQueryByInode, QByteArrayLiteral(GET_FILE_RECORD_BY_INODE_QUERY), _db);
     if (!query)
         return false;
 
@@ -1217,7 +1599,7 @@ bool SyncJournalDb::getFileRecordsByFileId(const QByteArray &fileId, const std::
     if (!checkConnect())
         return false;
 
-    const auto query = _queryManager.get(PreparedSqlQueryManager::GetFileRecordQueryByFileId, QByteArrayLiteral(GET_FILE_RECORD_QUERY " WHERE fileid=?1"), _db);
+    const auto query = _queryManager.get(PreparedSqlQueryManager::GetFileRecordQueryByFileId, QByteArrayLiteral(GET_FILE_RECORD_BY_FILEID_QUERY), _db);
     if (!query) {
         return false;
     }
@@ -1227,6 +1609,84 @@ bool SyncJournalDb::getFileRecordsByFileId(const QByteArray &fileId, const std::
     if (!query->exec())
         return false;
 
+    SyncJournalFileRecord rec;
+
+    forever {
+        auto next = query->next();
+        if (!next.ok)
+            return false;
+        if (!next.hasData)
+            break;
+
+        fillFileRecordFromGetQuery(rec, *query);
+        rowCallback(rec);
+    }
+
+    return true;
+}
+
+bool SyncJournalDb::getFileRecordsByNumericFileId(qint64 numericFileId, const std::function<void(const SyncJournalFileRecord &)> &rowCallback)
+{
+    QMutexLocker locker(&_mutex);
+
+    if (numericFileId <= 0 || _metadataTableIsEmpty)
+        return true; // no error, yet nothing found
+
+    if (!checkConnect())
+        return false;
+
+    // The server builds oc:id as sprintf("%08d", fileid) followed by the instance id,
+    // which always starts with "oc". A range keeps the fileid index usable.
+    const auto prefix = QByteArray::number(numericFileId).rightJustified(8, '0');
+    const auto query = _queryManager.get(PreparedSqlQueryManager::GetFileRecordQueryByNumericFileId, QByteArrayLiteral(GET_FILE_RECORD_QUERY " WHERE fileid >= ?1 AND fileid < ?2"), _db);
+    if (!query) {
+        return false;
+    }
+
+    query->bindValue(1, prefix + "oc");
+    query->bindValue(2, prefix + "od");
+
+    if (!query->exec())
+        return false;
+
+    SyncJournalFileRecord rec;
+
+    forever {
+        auto next = query->next();
+        if (!next.ok)
+            return false;
+        if (!next.hasData)
+            break;
+
+        fillFileRecordFromGetQuery(rec, *query);
+        rowCallback(rec);
+    }
+
+    return true;
+}
+
+bool SyncJournalDb::getFileRecordsBySize(qint64 size, const std::function<void(const SyncJournalFileRecord &)> &rowCallback)
+{
+    QMutexLocker locker(&_mutex);
+
+    if (_metadataTableIsEmpty)
+        return true; // no error, yet nothing found
+
+    if (!checkConnect())
+        return false;
+
+    const auto query = _queryManager.get(PreparedSqlQueryManager::GetFileRecordQueryBySize, QByteArrayLiteral(GET_FILE_RECORD_BY_SIZE_QUERY), _db);
+    if (!query) {
+        return false;
+    }
+
+    query->bindValue(1, size);
+
+    if (!query->exec())
+        return false;
+
+    SyncJournalFileRecord rec;
+
     forever {
         auto next = query->next();
         if (!next.ok)
@@ -1234,7 +1694,6 @@ bool SyncJournalDb::getFileRecordsByFileId(const QByteArray &fileId, const std::
         if (!next.hasData)
             break;
 
-        SyncJournalFileRecord rec;
         fillFileRecordFromGetQuery(rec, *query);
         rowCallback(rec);
     }
@@ -1257,6 +1716,8 @@ bool SyncJournalDb::getFilesBelowPath(const QByteArray &path, const std::functio
             return false;
         }
 
+        SyncJournalFileRecord rec;
+
         forever {
             auto next = query.next();
             if (!next.ok)
@@ -1264,7 +1725,6 @@ bool SyncJournalDb::getFilesBelowPath(const QByteArray &path, const std::functio
             if (!next.hasData)
                 break;
 
-            SyncJournalFileRecord rec;
             fillFileRecordFromGetQuery(rec, query);
             rowCallback(rec);
         }
@@ -1285,15 +1745,7 @@ bool SyncJournalDb::getFilesBelowPath(const QByteArray &path, const std::functio
     } else {
         // This query is used to skip discovery and fill the tree from the
         // database instead
-        const auto query = _queryManager.get(PreparedSqlQueryManager::GetFilesBelowPathQuery, QByteArrayLiteral(GET_FILE_RECORD_QUERY " WHERE " IS_PREFIX_PATH_OF("?1", "path")
-                                                                                                                " OR " IS_PREFIX_PATH_OF("?1", "e2eMangledName")
-                                                                                                                // We want to ensure that the contents of a directory are sorted
-                                                                                                                // directly behind the directory itself. Without this ORDER BY
-                                                                                                                // an ordering like foo, foo-2, foo/file would be returned.
-                                                                                                                // With the trailing /, we get foo-2, foo, foo/file. This property
-                                                                                                                // is used in fill_tree_from_db().
-                                                                                                                " ORDER BY path||'/' ASC"),
-            _db);
+        const auto query = _queryManager.get(PreparedSqlQueryManager::GetFilesBelowPathQuery, QByteArrayLiteral(GET_FILES_BELOW_PATH_QUERY), _db);
         if (!query) {
             return false;
         }
@@ -1313,7 +1765,7 @@ bool SyncJournalDb::listFilesInPath(const QByteArray& path,
     if (!checkConnect())
         return false;
 
-    const auto query = _queryManager.get(PreparedSqlQueryManager::ListFilesInPathQuery, QByteArrayLiteral(GET_FILE_RECORD_QUERY " WHERE parent_hash(path) = ?1 ORDER BY path||'/' ASC"), _db);
+    const auto query = _queryManager.get(PreparedSqlQueryManager::ListFilesInPathQuery, QByteArrayLiteral(LIST_FILES_IN_PATH_QUERY), _db);
     if (!query) {
         return false;
     }
@@ -1322,6 +1774,8 @@ bool SyncJournalDb::listFilesInPath(const QByteArray& path,
     if (!query->exec())
         return false;
 
+    SyncJournalFileRecord rec;
+
     forever {
         auto next = query->next();
         if (!next.ok)
@@ -1329,7 +1783,6 @@ bool SyncJournalDb::listFilesInPath(const QByteArray& path,
         if (!next.hasData)
             break;
 
-        SyncJournalFileRecord rec;
         fillFileRecordFromGetQuery(rec, *query);
         if (!rec._path.startsWith(path) || rec._path.indexOf("/", path.size() + 1) > 0) {
             qWarning(lcDb) << "hash collision" << path << rec.path();
@@ -1702,6 +2155,89 @@ QVector<uint> SyncJournalDb::deleteStaleUploadInfos(const QSet<QString> &keep)
     return ids;
 }
 
+SyncJournalDb::BlockSignatureInfo SyncJournalDb::getBlockSignature(const QString &file)
+{
+    QMutexLocker locker(&_mutex);
+
+    BlockSignatureInfo res;
+
+    if (checkConnect()) {
+        const auto query = _queryManager.get(PreparedSqlQueryManager::GetBlockSignatureQuery, QByteArrayLiteral("SELECT transferid, signature FROM blocksignatures WHERE path=?1"), _db);
+        if (!query) {
+            return res;
+        }
+        query->bindValue(1, file);
+
+        if (!query->exec()) {
+            return res;
+        }
+
+        if (query->next().hasData) {
+            res._transferid = query->int64Value(0);
+            res._signature = query->baValue(1);
+            res._valid = true;
+        }
+    }
+    return res;
+}
+
+void SyncJournalDb::setBlockSignature(const QString &file, const SyncJournalDb::BlockSignatureInfo &i)
+{
+    QMutexLocker locker(&_mutex);
+
+    if (!checkConnect()) {
+        return;
+    }
+
+    if (i._valid) {
+        const auto query = _queryManager.get(PreparedSqlQueryManager::SetBlockSignatureQuery, QByteArrayLiteral("INSERT OR REPLACE INTO blocksignatures "
+                                                                                                                "(path, transferid, signature) VALUES ( ?1 , ?2, ?3 )"),
+            _db);
+        if (!query) {
+            return;
+        }
+
+        query->bindValue(1, file);
+        query->bindValue(2, i._transferid);
+        query->bindValue(3, i._signature);
+        query->exec();
+    } else {
+        const auto query = _queryManager.get(PreparedSqlQueryManager::DeleteBlockSignatureQuery, QByteArrayLiteral("DELETE FROM blocksignatures WHERE path=?1"), _db);
+        if (!query) {
+            return;
+        }
+
+        query->bindValue(1, file);
+        query->exec();
+    }
+}
+
+QVector<uint> SyncJournalDb::deleteStaleBlockSignatures()
+{
+    QMutexLocker locker(&_mutex);
+    QVector<uint> ids;
+
+    if (!checkConnect()) {
+        return ids;
+    }
+
+    SqlQuery query("SELECT transferid FROM blocksignatures WHERE path NOT IN (SELECT path FROM metadata);", _db);
+    if (!query.exec()) {
+        return ids;
+    }
+    while (query.next().hasData) {
+        ids.append(query.int64Value(0));
+    }
+
+    if (!ids.isEmpty()) {
+        SqlQuery delQuery("DELETE FROM blocksignatures WHERE path NOT IN (SELECT path FROM metadata);", _db);
+        if (!delQuery.exec()) {
+            sqlFail(QStringLiteral("deleteStaleBlockSignatures"), delQuery);
+        }
+    }
+    return ids;
+}
+
 SyncJournalErrorBlacklistRecord SyncJournalDb::errorBlacklistEntry(const QString &file)
 {
     QMutexLocker locker(&_mutex);
@@ -1765,13 +2301,15 @@ bool SyncJournalDb::deleteStaleErrorBlacklistEntries(const QSet<QString> &keep)
 void SyncJournalDb::deleteStaleFlagsEntries()
 {
     QMutexLocker locker(&_mutex);
-    if (!checkConnect())
+    if (!_fileRecordsDeletedSinceFlagsCleanup || !checkConnect())
         return;
 
     SqlQuery delQuery("DELETE FROM flags WHERE path != '' AND path NOT IN (SELECT path from metadata);", _db);
     if (!delQuery.exec()) {
         sqlFail(QStringLiteral("deleteStaleFlagsEntries"), delQuery);
+        return;
     }
+    _fileRecordsDeletedSinceFlagsCleanup = false;
 }
 
 int SyncJournalDb::errorBlackListEntryCount()
@@ -2378,6 +2916,7 @@ void SyncJournalDb::clearFileTable()
     if (!query.exec()) {
         sqlFail(QStringLiteral("clearFileTable"), query);
     }
+    _fileRecordsDeletedSinceFlagsCleanup = true;
 }
 
 void SyncJournalDb::markVirtualFileForDownloadRecursively(const QByteArray &path)
@@ -2481,6 +3020,58 @@ void SyncJournalDb::deleteE2EeLockedFolder(const QByteArray &folderId)
     ASSERT(query->exec())
 }
 
+void SyncJournalDb::setE2EeFolderMetadataCache(const QByteArray &folderId, const QByteArray &etag, const QByteArray &metadata)
+{
+    QMutexLocker locker(&_mutex);
+    if (!checkConnect()) {
+        return;
+    }
+
+    const auto query = _queryManager.get(PreparedSqlQueryManager::SetE2EeFolderMetadataCacheQuery,
+                                         QByteArrayLiteral("INSERT OR REPLACE INTO e2EeFolderMetadataCache "
+                                                           "(folderId, etag, metadata) "
+                                                           "VALUES (?1, ?2, ?3);"),
+                                         _db);
+    ASSERT(query)
+    query->bindValue(1, folderId);
+    query->bindValue(2, etag);
+    query->bindValue(3, metadata);
+    ASSERT(query->exec())
+}
+
+QByteArray SyncJournalDb::e2EeFolderMetadataCache(const QByteArray &folderId, const QByteArray &etag)
+{
+    QMutexLocker locker(&_mutex);
+    if (!checkConnect()) {
+        return {};
+    }
+    const auto query = _queryManager.get(PreparedSqlQueryManager::GetE2EeFolderMetadataCacheQuery,
+                                         QByteArrayLiteral("SELECT metadata FROM e2EeFolderMetadataCache WHERE folderId=?1 AND etag=?2;"),
+                                         _db);
+    ASSERT(query)
+    query->bindValue(1, folderId);
+    query->bindValue(2, etag);
+    ASSERT(query->exec())
+    if (!query->next().hasData) {
+        return {};
+    }
+
+    return query->baValue(0);
+}
+
+void SyncJournalDb::deleteE2EeFolderMetadataCache(const QByteArray &folderId)
+{
+    QMutexLocker locker(&_mutex);
+    if (!checkConnect()) {
+        return;
+    }
+
+    const auto query = _queryManager.get(PreparedSqlQueryManager::DeleteE2EeFolderMetadataCacheQuery, QByteArrayLiteral("DELETE FROM e2EeFolderMetadataCache WHERE folderId=?1;"), _db);
+    ASSERT(query)
+    query->bindValue(1, folderId);
+    ASSERT(query->exec())
+}
+
 Optional<PinState> SyncJournalDb::PinStateInterface::rawForPath(const QByteArray &path)
 {
     QMutexLocker lock(&_db->_mutex);
@@ -2508,13 +3099,7 @@ Optional<PinState> SyncJournalDb::PinStateInterface::effectiveForPath(const QByt
     if (!_db->checkConnect())
         return {};
 
-    const auto query = _db->_queryManager.get(PreparedSqlQueryManager::GetEffectivePinStateQuery, QByteArrayLiteral("SELECT pinState FROM flags WHERE"
-                                                                                                                    // explicitly allow "" to represent the root path
-                                                                                                                    // (it'd be great if paths started with a / and "/" could be the root)
-                                                                                                                    " (" IS_PREFIX_PATH_OR_EQUAL("path", "?1") " OR path == '')"
-                                                                                                                                                               " AND pinState is not null AND pinState != 0"
-                                                                                                                                                               " ORDER BY length(path) DESC LIMIT 1;"),
-        _db->_db);
+    const auto query = _db->_queryManager.get(PreparedSqlQueryManager::GetEffectivePinStateQuery, QByteArrayLiteral(GET_EFFECTIVE_PIN_STATE_QUERY), _db->_db);
     ASSERT(query)
     query->bindValue(1, path);
     query->exec();
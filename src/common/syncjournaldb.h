@@ -64,6 +64,10 @@ public:
     [[nodiscard]] bool getFileRecordByE2eMangledName(const QString &mangledName, SyncJournalFileRecord *rec);
     [[nodiscard]] bool getFileRecordByInode(quint64 inode, SyncJournalFileRecord *rec);
     [[nodiscard]] bool getFileRecordsByFileId(const QByteArray &fileId, const std::function<void(const SyncJournalFileRecord &)> &rowCallback);
+    /// Files of the given size that have a content checksum
+    [[nodiscard]] bool getFileRecordsBySize(qint64 size, const std::function<void(const SyncJournalFileRecord &)> &rowCallback);
+    /// Files whose server file id (oc:id) is made of the given numeric oc:fileid and the instance id
+    [[nodiscard]] bool getFileRecordsByNumericFileId(qint64 numericFileId, const std::function<void(const SyncJournalFileRecord &)> &rowCallback);
     [[nodiscard]] bool getFilesBelowPath(const QByteArray &path, const std::function<void(const SyncJournalFileRecord&)> &rowCallback);
     [[nodiscard]] bool listFilesInPath(const QByteArray &path, const std::function<void(const SyncJournalFileRecord&)> &rowCallback);
     [[nodiscard]] Result<void, QString> setFileRecord(const SyncJournalFileRecord &record);
@@ -93,6 +97,71 @@ public:
     bool exists();
     void walCheckpoint();
 
+    /**
+     * @brief How much memory sqlite may use for the journal
+     *
+     * Discovery looks up every file in the journal, so once the journal
+     * outgrows sqlite's small default page cache most lookups read from disk.
+     * Negative values are sized from the journal and the physical memory
+     * when the database is opened. Only journals in WAL mode are memory
+     * mapped, the others are on file systems where that isn't safe.
+     */
+    struct PerformanceProfile
+    {
+        qint64 mmapSize = -1; // bytes of the database file that are memory mapped, 0 turns it off
+        qint64 cacheSize = -1; // bytes of sqlite's own page cache
+    };
+
+    /// Applied when the database is opened, or right away if it already is
+    void setPerformanceProfile(const PerformanceProfile &profile);
+
+    /// The sizes sqlite uses for the open database, after the caps of sqlite and of the journal mode
+    [[nodiscard]] PerformanceProfile appliedPerformanceProfile();
+
+    /**
+     * Compacts the database file and refreshes the statistics of the query
+     * planner, unless that was done recently or @a force is set.
+     *
+     * Meant to be called while no sync is running: it commits the open
+     * transaction. The work is bounded, only a few MiB of free pages are
+     * given back per run.
+     */
+    void performMaintenance(bool force = false);
+
+    /// Sizes and query plans reported by statistics()
+    struct Statistics
+    {
+        struct Table
+        {
+            QString name;
+            qint64 rows = 0;
+            qint64 bytes = -1; // with its indexes, -1 when sqlite lacks the dbstat table
+        };
+        struct QueryPlan
+        {
+            QString name;
+            QByteArray sql;
+            QStringList steps;
+        };
+
+        qint64 pageSize = 0;
+        qint64 pageCount = 0;
+        qint64 freePages = 0;
+        qint64 walBytes = 0;
+        QString autoVacuum;
+        QVector<Table> tables;
+        QVector<QueryPlan> queryPlans; // of the lookups done for every item of a sync
+    };
+    [[nodiscard]] Statistics statistics();
+
+    /**
+     * The statistics() of the database file @a dbFile, opened read-only
+     *
+     * Unlike a SyncJournalDb, that neither changes its schema nor locks it.
+     * Fails while a client holds its exclusive lock.
+     */
+    [[nodiscard]] static Statistics readOnlyStatistics(const QString &dbFile);
+
     [[nodiscard]] QString databaseFilePath() const;
 
     static qint64 getPHash(const QByteArray &);
@@ -127,6 +196,13 @@ public:
         [[nodiscard]] bool isChunked() const { return _transferid != 0; }
     };
 
+    struct BlockSignatureInfo
+    {
+        uint _transferid = 0; // the chunked upload whose chunks are kept on the server
+        QByteArray _signature; // see BlockSignature::serialize()
+        bool _valid = false;
+    };
+
     struct PollInfo
     {
         QString _file; // The relative path of a file
@@ -145,10 +221,20 @@ public:
     // Return the list of transfer ids that were removed.
     QVector<uint> deleteStaleUploadInfos(const QSet<QString> &keep);
 
+    BlockSignatureInfo getBlockSignature(const QString &file);
+    void setBlockSignature(const QString &file, const BlockSignatureInfo &i);
+    /// Delete block signatures of files that have no metadata correspondent, returns their transfer ids
+    QVector<uint> deleteStaleBlockSignatures();
+
     SyncJournalErrorBlacklistRecord errorBlacklistEntry(const QString &);
     [[nodiscard]] bool deleteStaleErrorBlacklistEntries(const QSet<QString> &keep);
 
-    /// Delete flags table entries that have no metadata correspondent
+    /**
+     * Delete flags table entries that have no metadata correspondent
+     *
+     * That scans the whole metadata table, so it's only done if file records
+     * were deleted since the last time.
+     */
     void deleteStaleFlagsEntries();
 
     void avoidRenamesOnNextSync(const QString &path) { avoidRenamesOnNextSync(path.toUtf8()); }
@@ -292,6 +378,17 @@ public:
     QList<QPair<QByteArray, QByteArray>> e2EeLockedFolders();
     void deleteE2EeLockedFolder(const QByteArray &folderId);
 
+    /**
+     * Caches the metadata of the encrypted folder @a folderId as of its @a etag.
+     *
+     * The caller is responsible for encrypting @a metadata, the journal
+     * stores it as it is.
+     */
+    void setE2EeFolderMetadataCache(const QByteArray &folderId, const QByteArray &etag, const QByteArray &metadata);
+    /// The cached metadata of @a folderId if it was stored for @a etag, empty otherwise
+    QByteArray e2EeFolderMetadataCache(const QByteArray &folderId, const QByteArray &etag);
+    void deleteE2EeFolderMetadataCache(const QByteArray &folderId);
+
     /** Grouping for all functions relating to pin states,
      *
      * Use internalPinStates() to get at them.
@@ -409,6 +506,11 @@ private:
     // Same as forceRemoteDiscoveryNextSync but without acquiring the lock
     void forceRemoteDiscoveryNextSyncLocked();
 
+    // Sets the mmap and page cache size of the open database
+    void applyPerformanceProfile();
+
+    static Statistics collectStatistics(SqlDatabase &db, const QString &dbFile);
+
     // Returns the integer id of the checksum type
     //
     // Returns 0 on failure and for empty checksum types.
@@ -420,6 +522,9 @@ private:
     QMap<QByteArray, int> _checksymTypeCache;
     int _transaction = 0;
     bool _metadataTableIsEmpty = false;
+    // Set by deleteFileRecord() and clearFileTable(), cleared by deleteStaleFlagsEntries().
+    // Starts out set, records may have been deleted before the journal was opened.
+    bool _fileRecordsDeletedSinceFlagsCleanup = true;
 
     /* Storing etags to these folders, or their parent folders, is filtered out.
      *
@@ -443,6 +548,8 @@ private:
      */
     QByteArray _journalMode;
 
+    PerformanceProfile _performanceProfile;
+
     PreparedSqlQueryManager _queryManager;
 };
 
@@ -242,6 +242,24 @@ qint64 Utility::freeDiskSpace(const QString &path)
     return -1;
 }
 
+qint64 Utility::physicalMemory()
+{
+#if defined(Q_OS_UNIX)
+    const auto pages = sysconf(_SC_PHYS_PAGES);
+    const auto pageSize = sysconf(_SC_PAGESIZE);
+    if (pages > 0 && pageSize > 0) {
+        return static_cast<qint64>(pages) * pageSize;
+    }
+#elif defined(Q_OS_WIN)
+    MEMORYSTATUSEX status;
+    status.dwLength = sizeof(status);
+    if (GlobalMemoryStatusEx(&status)) {
+        return status.ullTotalPhys;
+    }
+#endif
+    return -1;
+}
+
 QString Utility::compactFormatDouble(double value, int prec, const QString &unit)
 {
     QLocale locale = QLocale::system();
@@ -85,6 +85,11 @@ namespace Utility {
      */
     OCSYNC_EXPORT qint64 freeDiskSpace(const QString &path);
 
+    /**
+     * Return the amount of physical memory of the machine, or -1 when it is unknown.
+     */
+    OCSYNC_EXPORT qint64 physicalMemory();
+
     /**
      * @brief compactFormatDouble - formats a double value human readable.
      *
@@ -1002,7 +1002,7 @@ void AccountSettings::slotSetSubFolderAvailability(Folder *folder, const QString
     }
 
     // Trigger sync
-    folder->schedulePathForLocalDiscovery(path);
+    folder->schedulePathForUserTriggeredSync(path);
     folder->scheduleThisFolderSoon();
 }
 
@@ -169,6 +169,7 @@ bool Application::configVersionMigration()
             }
         }
     }
+    ConfigFile::reloadSettings();
 
     // We want to message the user either for destructive changes,
     // or if we're ignoring something and the client version changed.
@@ -291,6 +292,7 @@ Application::Application(int &argc, char **argv)
                 QFile::link(confDir, oldDir);
 #endif
             }
+            ConfigFile::reloadSettings();
         }
     }
 
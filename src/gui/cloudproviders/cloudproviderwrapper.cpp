@@ -51,6 +51,7 @@ CloudProviderWrapper::CloudProviderWrapper(QObject *parent, Folder *folder, int
     cloud_providers_account_exporter_set_action_group (_cloudProviderAccount, action_group);
 
     connect(ProgressDispatcher::instance(), &ProgressDispatcher::progressInfo, this, &CloudProviderWrapper::slotUpdateProgress);
+    connect(ProgressDispatcher::instance(), &ProgressDispatcher::itemCompleted, this, &CloudProviderWrapper::slotItemCompleted);
     connect(_folder, &Folder::syncStarted, this, &CloudProviderWrapper::slotSyncStarted);
     connect(_folder, &Folder::syncFinished, this, &CloudProviderWrapper::slotSyncFinished);
     connect(_folder, &Folder::syncPausedChanged, this, &CloudProviderWrapper::slotSyncPausedChanged);
@@ -98,24 +99,6 @@ void CloudProviderWrapper::slotUpdateProgress(const QString &folder, const Progr
     if (f != _folder)
         return;
 
-    // Build recently changed files list
-    if (!progress._lastCompletedItem.isEmpty() && shouldShowInRecentsMenu(progress._lastCompletedItem)) {
-        QString kindStr = Progress::asResultString(progress._lastCompletedItem);
-        QString timeStr = QTime::currentTime().toString("hh:mm");
-        QString actionText = tr("%1 (%2, %3)").arg(progress._lastCompletedItem._file, kindStr, timeStr);
-        if (f) {
-            QString fullPath = f->path() + '/' + progress._lastCompletedItem._file;
-            if (QFile(fullPath).exists()) {
-                if (_recentlyChanged.length() > 5)
-                    _recentlyChanged.removeFirst();
-                _recentlyChanged.append(qMakePair(actionText, fullPath));
-            } else {
-                _recentlyChanged.append(qMakePair(actionText, QString("")));
-            }
-        }
-
-    }
-
     // Build status details text
     QString msg;
     if (!progress._currentDiscoveredRemoteFolder.isEmpty()) {
@@ -144,26 +127,37 @@ void CloudProviderWrapper::slotUpdateProgress(const QString &folder, const Progr
         }
     }
     updateStatusText(msg);
+}
 
-    if (!progress._lastCompletedItem.isEmpty()
-            && shouldShowInRecentsMenu(progress._lastCompletedItem)) {
-        GMenuItem* item = nullptr;
-        g_menu_remove_all (G_MENU(_recentMenu));
-        if(!_recentlyChanged.isEmpty()) {
-            QList<QPair<QString, QString>>::iterator i;
-            for (i = _recentlyChanged.begin(); i != _recentlyChanged.end(); i++) {
-                QString label = i->first;
-                QString fullPath = i->second;
-                item = menu_item_new(label, "cloudprovider.showfile");
-                g_menu_item_set_action_and_target_value(item, "cloudprovider.showfile", g_variant_new_string(fullPath.toUtf8().data()));
-                g_menu_append_item(_recentMenu, item);
-                g_clear_object (&item);
-            }
-        } else {
-            item = menu_item_new(tr("No recently changed files"), nullptr);
-            g_menu_append_item(_recentMenu, item);
-            g_clear_object (&item);
-        }
+void CloudProviderWrapper::slotItemCompleted(const QString &folder, const SyncFileItemPtr &item)
+{
+    Folder *f = FolderMan::instance()->folder(folder);
+    if (f != _folder || !shouldShowInRecentsMenu(*item))
+        return;
+
+    // Build recently changed files list
+    QString kindStr = Progress::asResultString(*item);
+    QString timeStr = QTime::currentTime().toString("hh:mm");
+    QString actionText = tr("%1 (%2, %3)").arg(item->_file, kindStr, timeStr);
+    QString fullPath = f->path() + '/' + item->_file;
+    if (QFile(fullPath).exists()) {
+        if (_recentlyChanged.length() > 5)
+            _recentlyChanged.removeFirst();
+        _recentlyChanged.append(qMakePair(actionText, fullPath));
+    } else {
+        _recentlyChanged.append(qMakePair(actionText, QString("")));
+    }
+
+    GMenuItem* menuItem = nullptr;
+    g_menu_remove_all (G_MENU(_recentMenu));
+    QList<QPair<QString, QString>>::iterator i;
+    for (i = _recentlyChanged.begin(); i != _recentlyChanged.end(); i++) {
+        QString label = i->first;
+        QString path = i->second;
+        menuItem = menu_item_new(label, "cloudprovider.showfile");
+        g_menu_item_set_action_and_target_value(menuItem, "cloudprovider.showfile", g_variant_new_string(path.toUtf8().data()));
+        g_menu_append_item(_recentMenu, menuItem);
+        g_clear_object (&menuItem);
     }
 }
 
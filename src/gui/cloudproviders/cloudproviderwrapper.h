@@ -51,6 +51,7 @@ public slots:
     void slotSyncStarted();
     void slotSyncFinished(const OCC::SyncResult &);
     void slotUpdateProgress(const QString &folder, const OCC::ProgressInfo &progress);
+    void slotItemCompleted(const QString &folder, const OCC::SyncFileItemPtr &item);
     void slotSyncPausedChanged(OCC::Folder*, bool);
 
 private:
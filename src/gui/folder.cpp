@@ -69,6 +69,7 @@ Folder::Folder(const FolderDefinition &definition,
 {
     _timeSinceLastSyncStart.start();
     _timeSinceLastSyncDone.start();
+    _journal.setPerformanceProfile(_definition.journalPerformance);
 
     SyncResult::Status status = SyncResult::NotYetStarted;
     if (definition.paused) {
@@ -114,6 +115,16 @@ Folder::Folder(const FolderDefinition &definition,
     connect(&_scheduleSelfTimer, &QTimer::timeout,
         this, &Folder::slotScheduleThisFolder);
 
+    _journalMaintenanceTimer.setSingleShot(true);
+    _journalMaintenanceTimer.setInterval(std::chrono::minutes(1));
+    connect(&_journalMaintenanceTimer, &QTimer::timeout,
+        this, &Folder::slotPerformJournalMaintenance);
+
+    _progressPublishTimer.setSingleShot(true);
+    _progressPublishTimer.setInterval(std::chrono::milliseconds(100));
+    connect(&_progressPublishTimer, &QTimer::timeout,
+        this, &Folder::slotPublishPendingProgress);
+
     connect(ProgressDispatcher::instance(), &ProgressDispatcher::folderConflicts,
         this, &Folder::slotFolderConflicts);
 
@@ -687,8 +698,8 @@ void Folder::implicitlyHydrateFile(const QString &relativepath)
         }
     }
 
-    // Add to local discovery
-    schedulePathForLocalDiscovery(relativepath);
+    // Add to local discovery, the user is waiting for the file
+    schedulePathForUserTriggeredSync(relativepath);
     slotScheduleThisFolder();
 }
 
@@ -880,6 +891,7 @@ void Folder::startSync(const QStringList &pathList)
         return;
     }
 
+    _journalMaintenanceTimer.stop();
     _timeSinceLastSyncStart.start();
     _syncResult.setStatus(SyncResult::SyncPrepare);
     emit syncStateChange();
@@ -929,6 +941,15 @@ void Folder::startSync(const QStringList &pathList)
         _localDiscoveryTracker->startSyncFullDiscovery();
     }
 
+    if (!singleItemDiscoveryOptions.isValid() && !_remoteDiscoveryPaths.empty()) {
+        qCInfo(lcFolder) << "Limiting remote discovery to the folders changed on the server";
+        _engine->setRemoteDiscoveryPaths(_remoteDiscoveryPaths);
+    }
+    _remoteDiscoveryPaths.clear();
+
+    _engine->setUserTriggeredPaths(std::move(_userTriggeredPaths));
+    _userTriggeredPaths.clear();
+
     _engine->setIgnoreHiddenFiles(_definition.ignoreHiddenFiles);
 
     correctPlaceholderFiles();
@@ -984,6 +1005,8 @@ void Folder::setDirtyNetworkLimits()
         downloadLimit = cfg.downloadLimit() * 1000;
     } else if (useDownLimit == 0) {
         downloadLimit = 0;
+    } else if (useDownLimit == -2) {
+        downloadLimit = BandwidthSchedule::AdaptiveLimit;
     }
 
     int uploadLimit = -75; // 75%
@@ -992,9 +1015,14 @@ void Folder::setDirtyNetworkLimits()
         uploadLimit = cfg.uploadLimit() * 1000;
     } else if (useUpLimit == 0) {
         uploadLimit = 0;
+    } else if (useUpLimit == -2) {
+        uploadLimit = BandwidthSchedule::AdaptiveLimit;
     }
 
     _engine->setNetworkLimits(uploadLimit, downloadLimit);
+    _engine->setNetworkLimitSchedules(
+        BandwidthSchedule::fromString(cfg.uploadLimitSchedule()),
+        BandwidthSchedule::fromString(cfg.downloadLimitSchedule()));
 }
 
 void Folder::slotSyncError(const QString &message, ErrorCategory category)
@@ -1063,6 +1091,10 @@ void Folder::slotSyncFinished(bool success)
         journalDb()->setSelectiveSyncList(SyncJournalDb::SelectiveSyncWhiteList, QStringList());
     }
 
+    if (success && anotherSyncNeeded == NoFollowUpSync) {
+        _journalMaintenanceTimer.start();
+    }
+
     if ((_syncResult.status() == SyncResult::Success
             || _syncResult.status() == SyncResult::Problem)
         && success) {
@@ -1123,10 +1155,32 @@ void Folder::slotEmitFinishedDelayed()
 // and hand the result over to the progress dispatcher.
 void Folder::slotTransmissionProgress(const ProgressInfo &pi)
 {
+    // The engine reports every transferred chunk and every completed item, which
+    // is far more than the GUI can show. During propagation only the latest
+    // progress is passed on, at most once per timer interval; completed items reach
+    // the GUI one by one through itemCompleted. Phase changes go out right away.
+    if (pi.status() == ProgressInfo::Propagation && _progressPublishTimer.isActive()) {
+        _progressPublishPending = true;
+        return;
+    }
+
+    _progressPublishPending = false;
+    if (pi.status() == ProgressInfo::Propagation) {
+        _progressPublishTimer.start();
+    } else {
+        _progressPublishTimer.stop();
+    }
     emit progressInfo(pi);
     ProgressDispatcher::instance()->setProgressInfo(alias(), pi);
 }
 
+void Folder::slotPublishPendingProgress()
+{
+    if (_progressPublishPending && _engine) {
+        slotTransmissionProgress(_engine->progressInfo());
+    }
+}
+
 // a item is completed: count the errors and forward to the ProgressDispatcher
 void Folder::slotItemCompleted(const SyncFileItemPtr &item, ErrorCategory errorCategory)
 {
@@ -1194,6 +1248,15 @@ void Folder::slotScheduleThisFolder()
     FolderMan::instance()->scheduleFolder(this);
 }
 
+void Folder::slotPerformJournalMaintenance()
+{
+    if (isBusy()) {
+        return;
+    }
+    // Does the work every few hours, and blocks while it runs
+    journalDb()->performMaintenance();
+}
+
 void Folder::slotNextSyncFullLocalDiscovery()
 {
     _timeSinceLastFullLocalDiscovery.invalidate();
@@ -1209,6 +1272,22 @@ void Folder::schedulePathForLocalDiscovery(const QString &relativePath)
     _localDiscoveryTracker->addTouchedPath(relativePath.toUtf8());
 }
 
+void Folder::schedulePathForUserTriggeredSync(const QString &relativePath)
+{
+    _userTriggeredPaths.insert(relativePath);
+    schedulePathForLocalDiscovery(relativePath);
+}
+
+void Folder::addRemoteDiscoveryPaths(const std::set<QString> &relativePaths)
+{
+    _remoteDiscoveryPaths.insert(relativePaths.begin(), relativePaths.end());
+}
+
+void Folder::clearRemoteDiscoveryPaths()
+{
+    _remoteDiscoveryPaths.clear();
+}
+
 void Folder::slotFolderConflicts(const QString &folder, const QStringList &conflictPaths)
 {
     if (folder != _definition.alias)
@@ -1492,6 +1571,16 @@ void FolderDefinition::save(QSettings &settings, const FolderDefinition &folder)
         settings.setValue(QLatin1String("navigationPaneClsid"), folder.navigationPaneClsid);
     else
         settings.remove(QLatin1String("navigationPaneClsid"));
+
+    // Only set by hand, for folders with unusually large journals
+    if (folder.journalPerformance.mmapSize >= 0)
+        settings.setValue(QStringLiteral("journalMmapSize"), folder.journalPerformance.mmapSize);
+    else
+        settings.remove(QStringLiteral("journalMmapSize"));
+    if (folder.journalPerformance.cacheSize >= 0)
+        settings.setValue(QStringLiteral("journalCacheSize"), folder.journalPerformance.cacheSize);
+    else
+        settings.remove(QStringLiteral("journalCacheSize"));
 }
 
 bool FolderDefinition::load(QSettings &settings, const QString &alias,
@@ -1504,6 +1593,8 @@ bool FolderDefinition::load(QSettings &settings, const QString &alias,
     folder->paused = settings.value(QLatin1String("paused")).toBool();
     folder->ignoreHiddenFiles = settings.value(QLatin1String("ignoreHiddenFiles"), QVariant(true)).toBool();
     folder->navigationPaneClsid = settings.value(QLatin1String("navigationPaneClsid")).toUuid();
+    folder->journalPerformance.mmapSize = settings.value(QStringLiteral("journalMmapSize"), -1).toLongLong();
+    folder->journalPerformance.cacheSize = settings.value(QStringLiteral("journalCacheSize"), -1).toLongLong();
 
     folder->virtualFilesMode = Vfs::Off;
     QString vfsModeString = settings.value(QStringLiteral("virtualFilesMode")).toString();
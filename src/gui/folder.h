@@ -65,6 +65,8 @@ public:
     Vfs::Mode virtualFilesMode = Vfs::Off;
     /// The CLSID where this folder appears in registry for the Explorer navigation pane entry.
     QUuid navigationPaneClsid;
+    /// Memory sqlite may use for the journal, sized automatically unless set in the config file
+    SyncJournalDb::PerformanceProfile journalPerformance;
 
     /// Whether the vfs mode shall silently be updated if possible
     bool upgradeVfsMode = false;
@@ -372,9 +374,29 @@ public slots:
      */
     void schedulePathForLocalDiscovery(const QString &relativePath);
 
+    /** Like schedulePathForLocalDiscovery(), for a path the user explicitly asked for
+     *
+     * The changes below the path are propagated before the other changes of
+     * the next sync.
+     */
+    void schedulePathForUserTriggeredSync(const QString &relativePath);
+
     /** Ensures that the next sync performs a full local discovery. */
     void slotNextSyncFullLocalDiscovery();
 
+    /** Adds folders to the remote discovery list of the next sync
+     *
+     * See SyncEngine::setRemoteDiscoveryPaths(). Used when a push notification
+     * told which folders changed on the server. The paths are reset when a
+     * sync starts or with clearRemoteDiscoveryPaths().
+     */
+    void addRemoteDiscoveryPaths(const std::set<QString> &relativePaths);
+
+    /** Ensures that the next sync performs the usual remote discovery from the root etag */
+    void clearRemoteDiscoveryPaths();
+
+    [[nodiscard]] bool hasRemoteDiscoveryPaths() const { return !_remoteDiscoveryPaths.empty(); }
+
     void setSilenceErrorsUntilNextSync(bool silenceErrors);
 
     /** Deletes local copies of E2EE files.
@@ -393,6 +415,7 @@ private slots:
     void slotAddErrorToGui(OCC::SyncFileItem::Status status, const QString &errorMessage, const QString &subject, OCC::ErrorCategory category);
 
     void slotTransmissionProgress(const OCC::ProgressInfo &pi);
+    void slotPublishPendingProgress();
     void slotItemCompleted(const OCC::SyncFileItemPtr &, OCC::ErrorCategory errorCategory);
 
     void slotRunEtagJob();
@@ -410,6 +433,9 @@ private slots:
      */
     void slotScheduleThisFolder();
 
+    /** Compacts the journal, runs on the GUI thread once no sync used it for a while */
+    void slotPerformJournalMaintenance();
+
     /** Adjust sync result based on conflict data from IssuesWidget.
      *
      * This is pretty awkward, but IssuesWidget just keeps better track
@@ -491,6 +517,13 @@ private:
 
     QTimer _scheduleSelfTimer;
 
+    // Defers the journal maintenance until the folder was idle for a while, see slotPerformJournalMaintenance()
+    QTimer _journalMaintenanceTimer;
+
+    // Limits how often the propagation progress is passed on to the GUI, see slotTransmissionProgress()
+    QTimer _progressPublishTimer;
+    bool _progressPublishPending = false;
+
     /**
      * When the same local path is synced to multiple accounts, only one
      * of them can be stored in the settings in a way that's compatible
@@ -536,6 +569,17 @@ private:
      */
     QScopedPointer<LocalDiscoveryTracker> _localDiscoveryTracker;
 
+    /**
+     * Folders the next sync's remote discovery is limited to, empty for a full
+     * remote discovery. See addRemoteDiscoveryPaths().
+     */
+    std::set<QString> _remoteDiscoveryPaths;
+
+    /**
+     * Paths the next sync propagates first, see schedulePathForUserTriggeredSync().
+     */
+    std::set<QString> _userTriggeredPaths;
+
     /**
      * The vfs mode instance (created by plugin) to use. Never null.
      */
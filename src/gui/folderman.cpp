@@ -43,6 +43,7 @@ constexpr auto settingsAccountsC = "Accounts";
 constexpr auto settingsFoldersC = "Folders";
 constexpr auto settingsVersionC = "version";
 constexpr auto maxFoldersVersion = 1;
+constexpr auto pushNotificationsCoalescingInterval = std::chrono::seconds(2);
 }
 
 namespace OCC {
@@ -72,6 +73,12 @@ FolderMan::FolderMan(QObject *parent)
     connect(&_startScheduledSyncTimer, &QTimer::timeout,
         this, &FolderMan::slotStartScheduledFolderSync);
 
+    // Bursts of files push notifications result in one sync
+    _pushNotificationTimer.setInterval(pushNotificationsCoalescingInterval);
+    _pushNotificationTimer.setSingleShot(true);
+    connect(&_pushNotificationTimer, &QTimer::timeout,
+        this, &FolderMan::slotProcessPendingPushNotifications);
+
     _timeScheduler.setInterval(5000);
     _timeScheduler.setSingleShot(false);
     connect(&_timeScheduler, &QTimer::timeout,
@@ -682,10 +689,33 @@ void FolderMan::slotSyncOnceFileUnlocks(const QString &path)
   * to the queue. The slot to actually start a sync is called afterwards.
   */
 void FolderMan::scheduleFolder(Folder *f)
+{
+    if (f) {
+        // Only files push notifications may limit the remote discovery
+        f->clearRemoteDiscoveryPaths();
+    }
+    enqueueFolder(f);
+}
+
+void FolderMan::scheduleFolderForRemoteDiscovery(Folder *f, const std::set<QString> &relativePaths)
+{
+    // A sync that was scheduled for other reasons discovers everything anyway
+    const auto alreadyScheduled = _scheduledFolders.contains(f);
+    if (alreadyScheduled && !f->hasRemoteDiscoveryPaths()) {
+        qCInfo(lcFolderMan) << "Sync for folder" << f->alias() << "already scheduled with a full remote discovery";
+        return;
+    }
+
+    if (enqueueFolder(f)) {
+        f->addRemoteDiscoveryPaths(relativePaths);
+    }
+}
+
+bool FolderMan::enqueueFolder(Folder *f)
 {
     if (!f) {
         qCCritical(lcFolderMan) << "slotScheduleSync called with null folder";
-        return;
+        return false;
     }
     auto alias = f->alias();
 
@@ -695,7 +725,7 @@ void FolderMan::scheduleFolder(Folder *f)
         if (!f->canSync()) {
             qCInfo(lcFolderMan) << "Folder is not ready to sync, not scheduled!";
             _socketApi->slotUpdateFolderView(f);
-            return;
+            return false;
         }
         f->prepareToSync();
         emit folderSyncStateChange(f);
@@ -706,6 +736,7 @@ void FolderMan::scheduleFolder(Folder *f)
     }
 
     startScheduledSyncSoon();
+    return true;
 }
 
 void FolderMan::scheduleFolderForImmediateSync(Folder *f)
@@ -726,6 +757,7 @@ void FolderMan::scheduleFolderNext(Folder *f)
 
     _scheduledFolders.removeAll(f);
 
+    f->clearRemoteDiscoveryPaths();
     f->prepareToSync();
     emit folderSyncStateChange(f);
     _scheduledFolders.prepend(f);
@@ -1844,14 +1876,68 @@ void FolderMan::slotProcessFilesPushNotification(Account *account)
 {
     qCInfo(lcFolderMan) << "Got files push notification for account" << account;
 
-    for (auto folder : qAsConst(_folderMap)) {
-        // Just run on the folders that belong to this account
-        if (folder->accountState()->account() != account) {
-            continue;
+    _pendingPushNotifications[account].anyFileChanged = true;
+    if (!_pushNotificationTimer.isActive()) {
+        _pushNotificationTimer.start();
+    }
+}
+
+void FolderMan::slotProcessFileIdsPushNotification(Account *account, const QVector<qint64> &fileIds)
+{
+    qCInfo(lcFolderMan) << "Got files push notification for account" << account << "and" << fileIds.size() << "files";
+
+    auto &pending = _pendingPushNotifications[account];
+    for (const auto fileId : fileIds) {
+        pending.fileIds.insert(fileId);
+    }
+    if (!_pushNotificationTimer.isActive()) {
+        _pushNotificationTimer.start();
+    }
+}
+
+void FolderMan::slotProcessPendingPushNotifications()
+{
+    const auto pendingPushNotifications = std::exchange(_pendingPushNotifications, {});
+    for (auto it = pendingPushNotifications.cbegin(); it != pendingPushNotifications.cend(); ++it) {
+        QVector<Folder *> folders;
+        for (auto folder : qAsConst(_folderMap)) {
+            // Just run on the folders that belong to this account
+            if (folder->accountState()->account().data() == it.key()) {
+                folders.append(folder);
+            }
         }
 
-        qCInfo(lcFolderMan) << "Schedule folder" << folder << "for sync";
-        scheduleFolder(folder);
+        // Find the folders the changed files are in. A file that is unknown in all of
+        // them may be new anywhere, which only the usual remote discovery finds.
+        auto fullRemoteDiscovery = it->anyFileChanged;
+        QHash<Folder *, std::set<QString>> changedFolders;
+        for (auto fileIdIt = it->fileIds.cbegin(); !fullRemoteDiscovery && fileIdIt != it->fileIds.cend(); ++fileIdIt) {
+            auto known = false;
+            auto ok = true;
+            for (auto folder : qAsConst(folders)) {
+                ok &= folder->journalDb()->getFileRecordsByNumericFileId(*fileIdIt, [&](const SyncJournalFileRecord &record) {
+                    known = true;
+                    // A changed file shows up in the listing of its parent folder
+                    const auto path = record.path();
+                    const auto slash = path.lastIndexOf(QLatin1Char('/'));
+                    changedFolders[folder].insert(record.isDirectory() ? path : slash < 0 ? QString() : path.left(slash));
+                });
+            }
+            if (!known || !ok) {
+                qCInfo(lcFolderMan) << "File id" << *fileIdIt << "is unknown, discovering all remote changes";
+                fullRemoteDiscovery = true;
+            }
+        }
+
+        for (auto folder : qAsConst(folders)) {
+            if (fullRemoteDiscovery) {
+                qCInfo(lcFolderMan) << "Schedule folder" << folder << "for sync";
+                scheduleFolder(folder);
+            } else if (changedFolders.contains(folder)) {
+                qCInfo(lcFolderMan) << "Schedule folder" << folder << "for sync of" << changedFolders[folder].size() << "changed folders";
+                scheduleFolderForRemoteDiscovery(folder, changedFolders[folder]);
+            }
+        }
     }
 }
 
@@ -1862,6 +1948,7 @@ void FolderMan::slotConnectToPushNotifications(Account *account)
     if (pushNotificationsFilesReady(account)) {
         qCInfo(lcFolderMan) << "Push notifications ready";
         connect(pushNotifications, &PushNotifications::filesChanged, this, &FolderMan::slotProcessFilesPushNotification, Qt::UniqueConnection);
+        connect(pushNotifications, &PushNotifications::fileIdsChanged, this, &FolderMan::slotProcessFileIdsPushNotification, Qt::UniqueConnection);
     }
 }
 
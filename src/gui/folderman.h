@@ -216,6 +216,13 @@ public:
     /** Puts a folder in the very front of the queue. */
     void scheduleFolderNext(Folder *);
 
+    /** Queues a folder for a sync that only discovers the given folders on the server.
+     *
+     * See Folder::addRemoteDiscoveryPaths(). Has no effect on syncs that were
+     * already scheduled with a full remote discovery.
+     */
+    void scheduleFolderForRemoteDiscovery(Folder *, const std::set<QString> &relativePaths);
+
     /** Queues all folders for syncing. */
     void scheduleAllFolders();
 
@@ -320,6 +327,8 @@ private slots:
 
     void slotSetupPushNotifications(const OCC::Folder::Map &);
     void slotProcessFilesPushNotification(OCC::Account *account);
+    void slotProcessFileIdsPushNotification(OCC::Account *account, const QVector<qint64> &fileIds);
+    void slotProcessPendingPushNotifications();
     void slotConnectToPushNotifications(OCC::Account *account);
 
 private:
@@ -332,6 +341,9 @@ private:
     /* unloads a folder object, does not delete it */
     void unloadFolder(Folder *);
 
+    /** Queues a folder without changing its remote discovery, returns whether it is scheduled */
+    bool enqueueFolder(Folder *);
+
     /** Will start a sync after a bit of delay. */
     void startScheduledSyncSoon();
 
@@ -383,6 +395,17 @@ private:
 
     bool _nextSyncShouldStartImmediately = false;
 
+    struct PendingPushNotifications
+    {
+        bool anyFileChanged = false;
+        QSet<qint64> fileIds;
+    };
+    /// Files push notifications that arrived while _pushNotificationTimer was running
+    QHash<const Account *, PendingPushNotifications> _pendingPushNotifications;
+
+    /// Coalesces bursts of files push notifications
+    QTimer _pushNotificationTimer;
+
     QScopedPointer<SocketApi> _socketApi;
     NavigationPaneHelper _navigationPaneHelper;
 
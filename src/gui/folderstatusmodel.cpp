@@ -24,16 +24,10 @@
 #include <QVarLengthArray>
 #include <set>
 
-Q_DECLARE_METATYPE(QPersistentModelIndex)
-
 namespace OCC {
 
 Q_LOGGING_CATEGORY(lcFolderStatus, "nextcloud.gui.folder.model", QtInfoMsg)
 
-static const char propertyParentIndexC[] = "oc_parentIndex";
-static const char propertyPermissionMap[] = "oc_permissionMap";
-static const char propertyEncryptionMap[] = "nc_encryptionMap";
-
 static QString removeTrailingSlash(const QString &s)
 {
     if (s.endsWith('/')) {
@@ -45,7 +39,8 @@ static QString removeTrailingSlash(const QString &s)
 FolderStatusModel::FolderStatusModel(QObject *parent)
     : QAbstractItemModel(parent)
 {
-
+    connect(ProgressDispatcher::instance(), &ProgressDispatcher::itemCompleted,
+        this, &FolderStatusModel::slotItemCompleted);
 }
 
 FolderStatusModel::~FolderStatusModel() = default;
@@ -65,8 +60,15 @@ void FolderStatusModel::setAccountState(const AccountState *accountState)
     beginResetModel();
     _dirty = false;
     _folders.clear();
+    _pendingListings.clear();
     _accountState = accountState;
 
+    const auto cache = RemoteDirectoryCache::forAccount(accountState->account());
+    connect(cache, &RemoteDirectoryCache::fetched,
+        this, &FolderStatusModel::slotListingFetched, Qt::UniqueConnection);
+    connect(cache, &RemoteDirectoryCache::fetchFailed,
+        this, &FolderStatusModel::slotListingFetchFailed, Qt::UniqueConnection);
+
     connect(FolderMan::instance(), &FolderMan::folderSyncStateChange,
         this, &FolderStatusModel::slotFolderSyncStateChange, Qt::UniqueConnection);
     connect(FolderMan::instance(), &FolderMan::scheduleQueueChanged,
@@ -587,7 +589,7 @@ bool FolderStatusModel::canFetchMore(const QModelIndex &parent) const
         return false;
     }
     auto info = infoForIndex(parent);
-    if (!info || info->_fetched || info->_fetchingJob)
+    if (!info || info->_fetched || info->_fetching)
         return false;
     if (info->_hasError) {
         // Keep showing the error to the user, it will be hidden when the account reconnects
@@ -597,47 +599,51 @@ bool FolderStatusModel::canFetchMore(const QModelIndex &parent) const
 }
 
 
-void FolderStatusModel::fetchMore(const QModelIndex &parent)
+QString FolderStatusModel::listingPath(const SubFolderInfo &info) const
 {
-    auto info = infoForIndex(parent);
+    QString path = info._folder->remotePathTrailingSlash();
 
-    if (!info || info->_fetched || info->_fetchingJob)
-        return;
-    info->resetSubs(this, parent);
-    QString path = info->_folder->remotePathTrailingSlash();
-
-    // info->_path always contains non-mangled name, so we need to use mangled when requesting nested folders for encrypted subfolders as required by LsColJob
-    const QString infoPath = (info->isEncrypted() && !info->_e2eMangledName.isEmpty()) ? info->_e2eMangledName : info->_path;
+    // info._path always contains non-mangled name, so we need to use mangled when requesting nested folders for encrypted subfolders as required by LsColJob
+    const QString infoPath = (info.isEncrypted() && !info._e2eMangledName.isEmpty()) ? info._e2eMangledName : info._path;
 
     if (infoPath != QLatin1String("/")) {
         path += infoPath;
     }
+    return path;
+}
 
-    auto *job = new LsColJob(_accountState->account(), path, this);
-    info->_fetchingJob = job;
-    auto props = QList<QByteArray>() << "resourcetype"
-                                     << "http://owncloud.org/ns:size"
-                                     << "http://owncloud.org/ns:permissions"
-                                     << "http://owncloud.org/ns:fileid";
-    if (_accountState->account()->capabilities().clientSideEncryptionAvailable()) {
-        props << "http://nextcloud.org/ns:is-encrypted";
+QByteArray FolderStatusModel::journalEtag(const SubFolderInfo &info) const
+{
+    if (info._path == QLatin1String("/")) {
+        // The root of the folder has no record
+        return {};
     }
-    job->setProperties(props);
+    SyncJournalFileRecord rec;
+    if (!info._folder->journalDb()->getFileRecord(removeTrailingSlash(info._path), &rec) || !rec.isValid() || !rec.isDirectory()) {
+        return {};
+    }
+    return rec._etag;
+}
 
-    job->setTimeout(60 * 1000);
-    connect(job, &LsColJob::directoryListingSubfolders,
-        this, &FolderStatusModel::slotUpdateDirectories);
-    connect(job, &LsColJob::finishedWithError,
-        this, &FolderStatusModel::slotLscolFinishedWithError);
-    connect(job, &LsColJob::directoryListingIterated,
-        this, &FolderStatusModel::slotGatherPermissions);
-    connect(job, &LsColJob::directoryListingIterated,
-            this, &FolderStatusModel::slotGatherEncryptionStatus);
+void FolderStatusModel::fetchMore(const QModelIndex &parent)
+{
+    auto info = infoForIndex(parent);
 
-    job->start();
+    if (!info || info->_fetched || info->_fetching)
+        return;
+    info->resetSubs(this, parent);
+
+    const auto path = listingPath(*info);
+    const auto cache = RemoteDirectoryCache::forAccount(_accountState->account());
+    if (const auto listing = cache->listing(path, journalEtag(*info))) {
+        insertSubfolders(parent, *listing);
+        return;
+    }
 
+    info->_fetching = true;
     QPersistentModelIndex persistentIndex(parent);
-    job->setProperty(propertyParentIndexC, QVariant::fromValue(persistentIndex));
+    _pendingListings.insert(RemoteDirectoryCache::normalizedPath(path), persistentIndex);
+    cache->fetch(path);
 
     // Show 'fetching data...' hint after a while.
     _fetchingItems[persistentIndex].start();
@@ -648,47 +654,30 @@ void FolderStatusModel::resetAndFetch(const QModelIndex &parent)
 {
     auto info = infoForIndex(parent);
     info->resetSubs(this, parent);
+    RemoteDirectoryCache::forAccount(_accountState->account())->invalidate(listingPath(*info));
     fetchMore(parent);
 }
 
-void FolderStatusModel::slotGatherPermissions(const QString &href, const QMap<QString, QString> &map)
+void FolderStatusModel::slotListingFetched(const QString &path)
 {
-    auto it = map.find("permissions");
-    if (it == map.end())
+    const QModelIndex idx = _pendingListings.take(path);
+    auto parentInfo = infoForIndex(idx);
+    if (!parentInfo || !parentInfo->_fetching) {
         return;
-
-    auto job = sender();
-    auto permissionMap = job->property(propertyPermissionMap).toMap();
-    job->setProperty(propertyPermissionMap, QVariant()); // avoid a detach of the map while it is modified
-    ASSERT(!href.endsWith(QLatin1Char('/')), "LsColXMLParser::parse should remove the trailing slash before calling us.");
-    permissionMap[href] = *it;
-    job->setProperty(propertyPermissionMap, permissionMap);
-}
-
-void FolderStatusModel::slotGatherEncryptionStatus(const QString &href, const QMap<QString, QString> &properties)
-{
-    auto it = properties.find("is-encrypted");
-    if (it == properties.end())
+    }
+    const auto listing = RemoteDirectoryCache::forAccount(_accountState->account())->listing(path);
+    if (!listing) {
         return;
-
-    auto job = sender();
-    auto encryptionMap = job->property(propertyEncryptionMap).toMap();
-    job->setProperty(propertyEncryptionMap, QVariant()); // avoid a detach of the map while it is modified
-    ASSERT(!href.endsWith(QLatin1Char('/')), "LsColXMLParser::parse should remove the trailing slash before calling us.");
-    encryptionMap[href] = *it;
-    job->setProperty(propertyEncryptionMap, encryptionMap);
+    }
+    insertSubfolders(idx, *listing);
 }
 
-void FolderStatusModel::slotUpdateDirectories(const QStringList &list)
+void FolderStatusModel::insertSubfolders(const QModelIndex &idx, const RemoteDirectoryCache::Listing &listing)
 {
-    auto job = qobject_cast<LsColJob *>(sender());
-    ASSERT(job);
-    QModelIndex idx = qvariant_cast<QPersistentModelIndex>(job->property(propertyParentIndexC));
     auto parentInfo = infoForIndex(idx);
     if (!parentInfo) {
         return;
     }
-    ASSERT(parentInfo->_fetchingJob == job);
     ASSERT(parentInfo->_subs.isEmpty());
 
     if (parentInfo->hasLabel()) {
@@ -699,7 +688,7 @@ void FolderStatusModel::slotUpdateDirectories(const QStringList &list)
     }
 
     parentInfo->_lastErrorString.clear();
-    parentInfo->_fetchingJob = nullptr;
+    parentInfo->_fetching = false;
     parentInfo->_fetched = true;
 
     QUrl url = parentInfo->_folder->remoteUrl();
@@ -726,10 +715,7 @@ void FolderStatusModel::slotUpdateDirectories(const QStringList &list)
             selectiveSyncUndecidedSet.insert(str);
         }
     }
-    const auto permissionMap = job->property(propertyPermissionMap).toMap();
-    const auto encryptionMap = job->property(propertyEncryptionMap).toMap();
-
-    QStringList sortedSubfolders = list;
+    QStringList sortedSubfolders = listing.subfolders;
     if (!sortedSubfolders.isEmpty())
         sortedSubfolders.removeFirst(); // skip the parent item (first in the list)
     Utility::sortFilenames(sortedSubfolders);
@@ -748,16 +734,17 @@ void FolderStatusModel::slotUpdateDirectories(const QStringList &list)
         newInfo._folder = parentInfo->_folder;
         newInfo._pathIdx = parentInfo->_pathIdx;
         newInfo._pathIdx << newSubs.size();
-        newInfo._isExternal = permissionMap.value(removeTrailingSlash(path)).toString().contains("M");
-        newInfo._isEncrypted = encryptionMap.value(removeTrailingSlash(path)).toString() == QStringLiteral("1");
+        newInfo._isExternal = listing.permissions.value(removeTrailingSlash(path)).contains("M");
+        newInfo._isEncrypted = listing.encrypted.contains(removeTrailingSlash(path));
         newInfo._path = relativePath;
 
         newInfo._isNonDecryptable = newInfo.isEncrypted()
             && _accountState->account()->e2e() && !_accountState->account()->e2e()->_publicKey.isNull()
             && _accountState->account()->e2e()->_privateKey.isNull();
 
+        // Only encrypted folders have mangled names, don't query the journal for every other one
         SyncJournalFileRecord rec;
-        if (!parentInfo->_folder->journalDb()->getFileRecordByE2eMangledName(removeTrailingSlash(relativePath), &rec)) {
+        if (newInfo.isEncrypted() && !parentInfo->_folder->journalDb()->getFileRecordByE2eMangledName(removeTrailingSlash(relativePath), &rec)) {
             qCWarning(lcFolderStatus) << "Could not get file record by E2E Mangled Name from local DB" << removeTrailingSlash(relativePath);
         }
         if (rec.isValid()) {
@@ -775,7 +762,7 @@ void FolderStatusModel::slotUpdateDirectories(const QStringList &list)
             newInfo._name = removeTrailingSlash(relativePath).split('/').last();
         }
 
-        const auto& folderInfo = job->_folderInfos.value(path);
+        const auto &folderInfo = listing.folderInfos.value(path);
         newInfo._size = folderInfo.size;
         newInfo._fileId = folderInfo.fileId;
         if (relativePath.isEmpty())
@@ -834,16 +821,14 @@ void FolderStatusModel::slotUpdateDirectories(const QStringList &list)
     }
 }
 
-void FolderStatusModel::slotLscolFinishedWithError(QNetworkReply *r)
+void FolderStatusModel::slotListingFetchFailed(const QString &path, QNetworkReply *r)
 {
-    auto job = qobject_cast<LsColJob *>(sender());
-    ASSERT(job);
-    QModelIndex idx = qvariant_cast<QPersistentModelIndex>(job->property(propertyParentIndexC));
+    const QModelIndex idx = _pendingListings.take(path);
     if (!idx.isValid()) {
         return;
     }
     auto parentInfo = infoForIndex(idx);
-    if (parentInfo) {
+    if (parentInfo && parentInfo->_fetching) {
         qCDebug(lcFolderStatus) << r->errorString();
         parentInfo->_lastErrorString = r->errorString();
         auto error = r->error();
@@ -954,6 +939,21 @@ void FolderStatusModel::slotApplySelectiveSync()
     resetFolders();
 }
 
+void FolderStatusModel::slotItemCompleted(const QString &folder, const SyncFileItemPtr &item)
+{
+    if (!Progress::isWarningKind(item->_status)) {
+        return;
+    }
+
+    for (int i = 0; i < _folders.count(); ++i) {
+        if (_folders.at(i)._folder && _folders.at(i)._folder->alias() == folder) {
+            _folders[i]._progress._warningCount++;
+            emit dataChanged(index(i), index(i), { FolderStatusDelegate::WarningCount });
+            return;
+        }
+    }
+}
+
 void FolderStatusModel::slotSetProgress(const ProgressInfo &progress)
 {
     auto par = qobject_cast<QWidget *>(QObject::parent());
@@ -1008,11 +1008,6 @@ void FolderStatusModel::slotSetProgress(const ProgressInfo &progress)
 
     // Status is Starting, Propagation or Done
 
-    if (!progress._lastCompletedItem.isEmpty()
-        && Progress::isWarningKind(progress._lastCompletedItem._status)) {
-        pi->_warningCount++;
-    }
-
     // find the single item to display:  This is going to be the bigger item, or the last completed
     // item if no items are in progress.
     SyncFileItem curItem = progress._lastCompletedItem;
@@ -1324,7 +1319,7 @@ void FolderStatusModel::slotShowFetchProgress()
         if (it.value().elapsed() > 800) {
             auto idx = it.key();
             auto *info = infoForIndex(idx);
-            if (info && info->_fetchingJob) {
+            if (info && info->_fetching) {
                 bool add = !info->hasLabel();
                 if (add) {
                     beginInsertRows(idx, 0, 0);
@@ -1347,11 +1342,8 @@ bool FolderStatusModel::SubFolderInfo::hasLabel() const
 void FolderStatusModel::SubFolderInfo::resetSubs(FolderStatusModel *model, QModelIndex index)
 {
     _fetched = false;
-    if (_fetchingJob) {
-        disconnect(_fetchingJob, nullptr, model, nullptr);
-        _fetchingJob->deleteLater();
-        _fetchingJob.clear();
-    }
+    // A listing that is still being fetched is ignored when it arrives
+    _fetching = false;
     if (hasLabel()) {
         model->beginRemoveRows(index, 0, 0);
         _fetchingLabel = false;
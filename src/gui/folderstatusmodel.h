@@ -16,6 +16,8 @@
 #define FOLDERSTATUSMODEL_H
 
 #include <accountfwd.h>
+#include "remotedirectorycache.h"
+#include "syncfileitem.h"
 #include <QAbstractItemModel>
 #include <QLoggingCategory>
 #include <QVector>
@@ -29,7 +31,6 @@ Q_DECLARE_LOGGING_CATEGORY(lcFolderStatus)
 
 class Folder;
 class ProgressInfo;
-class LsColJob;
 
 /**
  * @brief The FolderStatusModel class
@@ -70,7 +71,7 @@ public:
         bool _isEncrypted = false;
 
         bool _fetched = false; // If we did the LSCOL for this folder already
-        QPointer<LsColJob> _fetchingJob; // Currently running LsColJob
+        bool _fetching = false; // If the listing of this folder is being fetched
         bool _hasError = false; // If the last fetching job ended in an error
         QString _lastErrorString;
         bool _fetchingLabel = false; // Whether a 'fetching in progress' label is shown.
@@ -129,13 +130,12 @@ public slots:
     void slotSyncAllPendingBigFolders();
     void slotSyncNoPendingBigFolders();
     void slotSetProgress(const OCC::ProgressInfo &progress);
+    void slotItemCompleted(const QString &folder, const OCC::SyncFileItemPtr &item);
     void e2eInitializationFinished(bool isNewMnemonicGenerated);
 
 private slots:
-    void slotUpdateDirectories(const QStringList &);
-    void slotGatherPermissions(const QString &name, const QMap<QString, QString> &properties);
-    void slotGatherEncryptionStatus(const QString &href, const QMap<QString, QString> &properties);
-    void slotLscolFinishedWithError(QNetworkReply *r);
+    void slotListingFetched(const QString &path);
+    void slotListingFetchFailed(const QString &path, QNetworkReply *r);
     void slotFolderSyncStateChange(OCC::Folder *f);
     void slotFolderScheduleQueueChanged();
     void slotNewBigFolder();
@@ -147,6 +147,12 @@ private slots:
     void slotShowFetchProgress();
 
 private:
+    /// The server path to list the subfolders of @a info, relative to the dav root
+    [[nodiscard]] QString listingPath(const SubFolderInfo &info) const;
+    /// The etag of @a info from the last sync, if the journal has it
+    [[nodiscard]] QByteArray journalEtag(const SubFolderInfo &info) const;
+    void insertSubfolders(const QModelIndex &idx, const RemoteDirectoryCache::Listing &listing);
+
     [[nodiscard]] QStringList createBlackList(const OCC::FolderStatusModel::SubFolderInfo &root,
         const QStringList &oldBlackList) const;
     const AccountState *_accountState = nullptr;
@@ -161,6 +167,9 @@ private:
      */
     QMap<QPersistentModelIndex, QElapsedTimer> _fetchingItems;
 
+    /// Items waiting for a listing from the RemoteDirectoryCache, by normalized path
+    QHash<QString, QPersistentModelIndex> _pendingListings;
+
 signals:
     void dirtyChanged();
 
@@ -17,50 +17,37 @@
 
 #include <QObject>
 #include <QString>
-#include <QSocketNotifier>
-#include <QHash>
-#include <QDir>
 
 #include "folderwatcher.h"
-
-class QTimer;
+#include "inotifywatcher.h"
 
 namespace OCC {
 
 /**
  * @brief Linux (inotify) API implementation of FolderWatcher
+ *
+ * The inotify handling itself is done by InotifyWatcher.
+ *
  * @ingroup gui
  */
 class FolderWatcherPrivate : public QObject
 {
     Q_OBJECT
 public:
-    FolderWatcherPrivate() = default;
     FolderWatcherPrivate(FolderWatcher *p, const QString &path);
     ~FolderWatcherPrivate() override;
 
-    [[nodiscard]] int testWatchCount() const { return _pathToWatch.size(); }
+    [[nodiscard]] int testWatchCount() const { return _watcher.watchCount(); }
 
     /// On linux the watcher is ready when the ctor finished.
     bool _ready = true;
 
-protected slots:
-    void slotReceivedNotification(int fd);
-    void slotAddFolderRecursive(const QString &path);
-
-protected:
-    bool findFoldersBelow(const QDir &dir, QStringList &fullList);
-    void inotifyRegisterPath(const QString &path);
-    void removeFoldersBelow(const QString &path);
+private slots:
+    void slotWatchesExhausted();
 
 private:
     FolderWatcher *_parent = nullptr;
-
-    QString _folder;
-    QHash<int, QString> _watchToPath;
-    QMap<QString, int> _pathToWatch;
-    QScopedPointer<QSocketNotifier> _socket;
-    int _fd = 0;
+    InotifyWatcher _watcher;
 };
 }
 
@@ -16,13 +16,38 @@
 
 #include <theme.h>
 
+#include <QCache>
 #include <QFile>
+#include <QGuiApplication>
 #include <QLoggingCategory>
+#include <QMutex>
 #include <QPainter>
-#include <QPixmapCache>
 #include <QSvgRenderer>
 
 namespace {
+// Rendered images are cached up to this many KiB
+constexpr auto imageCacheMaxCostKiB = 32 * 1024;
+
+struct CachedImage
+{
+    QImage image;
+    QSize originalSize;
+};
+
+// The image providers of QML render from their own threads
+QMutex imageCacheMutex;
+QCache<QString, CachedImage> imageCache(imageCacheMaxCostKiB);
+
+QString imageCacheKey(const QString &source, const QColor &color, const QSize &requestedSize)
+{
+    const auto devicePixelRatio = qGuiApp ? qGuiApp->devicePixelRatio() : 1.0;
+    return QStringLiteral("%1,%2,%3x%4@%5")
+        .arg(source, color.isValid() ? color.name(QColor::HexArgb) : QString())
+        .arg(requestedSize.width())
+        .arg(requestedSize.height())
+        .arg(devicePixelRatio);
+}
+
 QString findSvgFilePath(const QString &fileName, const QStringList &possibleColors)
 {
     QString result;
@@ -59,17 +84,62 @@ QPixmap pixmapForBackground(const QString &fileName, const QColor &backgroundCol
     return createSvgPixmapWithCustomColorCached(fileName, pixmapColor);
 }
 
+QImage findCachedImage(const QString &source, const QColor &color, const QSize &requestedSize, QSize *originalSize)
+{
+    const auto key = imageCacheKey(source, color, requestedSize);
+    QMutexLocker locker(&imageCacheMutex);
+    const auto cached = imageCache.object(key);
+    if (!cached) {
+        return {};
+    }
+    if (originalSize) {
+        *originalSize = cached->originalSize;
+    }
+    return cached->image;
+}
+
+void insertCachedImage(const QString &source, const QColor &color, const QSize &requestedSize, const QImage &image, const QSize &originalSize)
+{
+    if (image.isNull()) {
+        return;
+    }
+    const auto key = imageCacheKey(source, color, requestedSize);
+    const auto costKiB = std::max<qsizetype>(image.sizeInBytes() / 1024, 1);
+    QMutexLocker locker(&imageCacheMutex);
+    imageCache.insert(key, new CachedImage{image, originalSize}, costKiB);
+}
+
+void clearImageCache()
+{
+    QMutexLocker locker(&imageCacheMutex);
+    imageCache.clear();
+}
+
 QImage createSvgImageWithCustomColor(const QString &fileName, const QColor &customColor, QSize *originalSize, const QSize &requestedSize)
 {
     Q_ASSERT(!fileName.isEmpty());
     Q_ASSERT(customColor.isValid());
 
-    QImage result{};
-
     if (fileName.isEmpty() || !customColor.isValid()) {
         qCWarning(lcIconUtils) << "invalid fileName or customColor";
-        return result;
+        return {};
+    }
+
+    QSize renderedOriginalSize;
+    auto result = findCachedImage(fileName, customColor, requestedSize, &renderedOriginalSize);
+    if (result.isNull()) {
+        result = renderSvgImageWithCustomColor(fileName, customColor, &renderedOriginalSize, requestedSize);
+        insertCachedImage(fileName, customColor, requestedSize, result, renderedOriginalSize);
     }
+    if (originalSize) {
+        *originalSize = renderedOriginalSize;
+    }
+    return result;
+}
+
+QImage renderSvgImageWithCustomColor(const QString &fileName, const QColor &customColor, QSize *originalSize, const QSize &requestedSize)
+{
+    QImage result{};
 
     // some icons are present in white or black only, so, we need to check both when needed
     const auto iconBaseColors = QStringList{QStringLiteral("black"), QStringLiteral("white")};
@@ -122,27 +192,7 @@ QImage createSvgImageWithCustomColor(const QString &fileName, const QColor &cust
 
 QPixmap createSvgPixmapWithCustomColorCached(const QString &fileName, const QColor &customColor, QSize *originalSize, const QSize &requestedSize)
 {
-    QPixmap cachedPixmap;
-
-    const auto customColorName = customColor.name();
-
-    const QString cacheKey = fileName + QStringLiteral(",") + customColorName;
-
-    // check for existing QPixmap in cache
-    if (QPixmapCache::find(cacheKey, &cachedPixmap)) {
-        if (originalSize) {
-            *originalSize = {};
-        }
-        return cachedPixmap;
-    }
-
-    cachedPixmap = QPixmap::fromImage(createSvgImageWithCustomColor(fileName, customColor, originalSize, requestedSize));
-
-    if (!cachedPixmap.isNull()) {
-        QPixmapCache::insert(cacheKey, cachedPixmap);
-    }
-
-    return cachedPixmap;
+    return QPixmap::fromImage(createSvgImageWithCustomColor(fileName, customColor, originalSize, requestedSize));
 }
 
 QImage drawSvgWithCustomFillColor(
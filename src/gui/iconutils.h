@@ -22,7 +22,21 @@ namespace OCC {
 namespace Ui {
 namespace IconUtils {
 QPixmap pixmapForBackground(const QString &fileName, const QColor &backgroundColor);
+
+/**
+ * Rendered images by source, color and requested size, shared by the widgets
+ * and the QML image providers.
+ *
+ * The cache is bounded in size and safe to use from any thread. The device
+ * pixel ratio of the application is part of the key.
+ */
+QImage findCachedImage(const QString &source, const QColor &color, const QSize &requestedSize, QSize *originalSize = nullptr);
+void insertCachedImage(const QString &source, const QColor &color, const QSize &requestedSize, const QImage &image, const QSize &originalSize = {});
+void clearImageCache();
+
+/// Served from the image cache, see findCachedImage()
 QImage createSvgImageWithCustomColor(const QString &fileName, const QColor &customColor, QSize *originalSize = nullptr, const QSize &requestedSize = {});
+QImage renderSvgImageWithCustomColor(const QString &fileName, const QColor &customColor, QSize *originalSize = nullptr, const QSize &requestedSize = {});
 QPixmap createSvgPixmapWithCustomColorCached(const QString &fileName, const QColor &customColor, QSize *originalSize = nullptr, const QSize &requestedSize = {});
 QImage drawSvgWithCustomFillColor(const QString &sourceSvgPath, const QColor &fillColor, QSize *originalSize = nullptr, const QSize &requestedSize = {});
 }
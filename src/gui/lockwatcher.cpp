@@ -22,25 +22,37 @@ using namespace OCC;
 
 Q_LOGGING_CATEGORY(lcLockWatcher, "nextcloud.gui.lockwatcher", QtInfoMsg)
 
-static const int check_frequency = 20 * 1000; // ms
+using namespace std::chrono_literals;
+
+namespace {
+constexpr auto initialCheckInterval = 1s;
+constexpr auto maximumCheckInterval = 20s;
+}
 
 LockWatcher::LockWatcher(QObject *parent)
     : QObject(parent)
+    , _initialInterval(initialCheckInterval)
 {
+    _timer.setSingleShot(true);
     connect(&_timer, &QTimer::timeout,
         this, &LockWatcher::checkFiles);
-    _timer.start(check_frequency);
 }
 
 void LockWatcher::addFile(const QString &path)
 {
     qCInfo(lcLockWatcher) << "Watching for lock of" << path << "being released";
-    _watchedPaths.insert(path);
+    _watchedPaths.insert(path, { _initialInterval, std::chrono::steady_clock::now() + _initialInterval });
+    scheduleNextCheck();
 }
 
 void LockWatcher::setCheckInterval(std::chrono::milliseconds interval)
 {
-    _timer.start(interval.count());
+    _initialInterval = interval;
+    const auto nextCheck = std::chrono::steady_clock::now() + interval;
+    for (auto &watchedFile : _watchedPaths) {
+        watchedFile = { interval, nextCheck };
+    }
+    scheduleNextCheck();
 }
 
 bool LockWatcher::contains(const QString &path)
@@ -50,18 +62,52 @@ bool LockWatcher::contains(const QString &path)
 
 void LockWatcher::checkFiles()
 {
-    QSet<QString> unlocked;
+    const auto now = std::chrono::steady_clock::now();
+    QStringList duePaths;
+    for (auto it = _watchedPaths.cbegin(); it != _watchedPaths.cend(); ++it) {
+        if (it->nextCheck <= now) {
+            duePaths.append(it.key());
+        }
+    }
 
-    foreach (const QString &path, _watchedPaths) {
-        if (!FileSystem::isFileLocked(path)) {
-            qCInfo(lcLockWatcher) << "Lock of" << path << "was released";
-            emit fileUnlocked(path);
-            unlocked.insert(path);
+    // Looking the paths up again ensures that calling back into
+    // addFile from connected slots isn't a problem.
+    for (const auto &path : qAsConst(duePaths)) {
+        if (checkUnlocked(path)) {
+            continue;
+        }
+        const auto it = _watchedPaths.find(path);
+        if (it != _watchedPaths.end()) {
+            it->interval = std::min(it->interval * 2, std::max(_initialInterval, std::chrono::milliseconds(maximumCheckInterval)));
+            it->nextCheck = now + it->interval;
         }
     }
 
-    // Doing it this way instead of with a QMutableSetIterator
-    // ensures that calling back into addFile from connected
-    // slots isn't a problem.
-    _watchedPaths.subtract(unlocked);
+    scheduleNextCheck();
+}
+
+bool LockWatcher::checkUnlocked(const QString &path)
+{
+    if (FileSystem::isFileLocked(path)) {
+        return false;
+    }
+    qCInfo(lcLockWatcher) << "Lock of" << path << "was released";
+    _watchedPaths.remove(path);
+    emit fileUnlocked(path);
+    return true;
+}
+
+void LockWatcher::scheduleNextCheck()
+{
+    if (_watchedPaths.isEmpty()) {
+        _timer.stop();
+        return;
+    }
+
+    auto nextCheck = std::chrono::steady_clock::time_point::max();
+    for (const auto &watchedFile : qAsConst(_watchedPaths)) {
+        nextCheck = std::min(nextCheck, watchedFile.nextCheck);
+    }
+    const auto delay = std::chrono::duration_cast<std::chrono::milliseconds>(nextCheck - std::chrono::steady_clock::now());
+    _timer.start(std::max(delay, 0ms));
 }
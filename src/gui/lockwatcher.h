@@ -16,10 +16,9 @@
 
 #include "config.h"
 
-#include <QList>
+#include <QHash>
 #include <QObject>
 #include <QString>
-#include <QSet>
 #include <QTimer>
 
 #include <chrono>
@@ -35,7 +34,8 @@ namespace OCC {
  *
  * In this situation we do want to start a sync run as soon as the file
  * becomes available again. To do that, we need to regularly check whether
- * the file is still being locked.
+ * the file is still being locked. Each file is checked again after an
+ * interval that doubles with every check that still finds it locked.
  *
  * @ingroup gui
  */
@@ -53,7 +53,7 @@ public:
      */
     void addFile(const QString &path);
 
-    /** Adjusts the default interval for checking whether the lock is still present */
+    /** Adjusts the initial interval for checking whether the lock is still present */
     void setCheckInterval(std::chrono::milliseconds interval);
 
     /** Whether the path is being watched for lock-changes */
@@ -68,7 +68,18 @@ private slots:
     void checkFiles();
 
 private:
-    QSet<QString> _watchedPaths;
+    struct WatchedFile
+    {
+        std::chrono::milliseconds interval;
+        std::chrono::steady_clock::time_point nextCheck;
+    };
+
+    /** Emits fileUnlocked and stops watching if the lock is gone; returns whether it was */
+    bool checkUnlocked(const QString &path);
+    void scheduleNextCheck();
+
+    QHash<QString, WatchedFile> _watchedPaths;
+    std::chrono::milliseconds _initialInterval;
     QTimer _timer;
 };
 }
@@ -205,7 +205,8 @@ void NetworkSettings::saveBWLimitSettings()
         cfgFile.setUseDownloadLimit(1);
     } else if (_ui->noDownloadLimitRadioButton->isChecked()) {
         cfgFile.setUseDownloadLimit(0);
-    } else if (_ui->autoDownloadLimitRadioButton->isChecked()) {
+    } else if (_ui->autoDownloadLimitRadioButton->isChecked() && cfgFile.useDownloadLimit() >= 0) {
+        // keeps the adaptive mode, which can only be chosen in the config file
         cfgFile.setUseDownloadLimit(-1);
     }
     cfgFile.setDownloadLimit(_ui->downloadSpinBox->value());
@@ -214,7 +215,8 @@ void NetworkSettings::saveBWLimitSettings()
         cfgFile.setUseUploadLimit(1);
     } else if (_ui->noUploadLimitRadioButton->isChecked()) {
         cfgFile.setUseUploadLimit(0);
-    } else if (_ui->autoUploadLimitRadioButton->isChecked()) {
+    } else if (_ui->autoUploadLimitRadioButton->isChecked() && cfgFile.useUploadLimit() >= 0) {
+        // keeps the adaptive mode, which can only be chosen in the config file
         cfgFile.setUseUploadLimit(-1);
     }
     cfgFile.setUploadLimit(_ui->uploadSpinBox->value());
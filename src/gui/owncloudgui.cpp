@@ -102,6 +102,8 @@ ownCloudGui::ownCloudGui(Application *parent)
     ProgressDispatcher *pd = ProgressDispatcher::instance();
     connect(pd, &ProgressDispatcher::progressInfo, this,
         &ownCloudGui::slotUpdateProgress);
+    connect(pd, &ProgressDispatcher::itemCompleted, this,
+        &ownCloudGui::slotItemCompleted);
 
     FolderMan *folderMan = FolderMan::instance();
     connect(folderMan, &FolderMan::folderSyncStateChange,
@@ -504,26 +506,27 @@ void ownCloudGui::slotUpdateProgress(const QString &folder, const ProgressInfo &
         //_actionStatus->setText(msg);
     }
 
-    if (!progress._lastCompletedItem.isEmpty()) {
-
-        QString kindStr = Progress::asResultString(progress._lastCompletedItem);
-        QString timeStr = QTime::currentTime().toString("hh:mm");
-        QString actionText = tr("%1 (%2, %3)").arg(progress._lastCompletedItem._file, kindStr, timeStr);
-        auto *action = new QAction(actionText, this);
-        Folder *f = FolderMan::instance()->folder(folder);
-        if (f) {
-            QString fullPath = f->path() + '/' + progress._lastCompletedItem._file;
-            if (QFile(fullPath).exists()) {
-                connect(action, &QAction::triggered, this, [this, fullPath] { this->slotOpenPath(fullPath); });
-            } else {
-                action->setEnabled(false);
-            }
-        }
-        if (_recentItemsActions.length() > 5) {
-            _recentItemsActions.takeFirst()->deleteLater();
+}
+
+void ownCloudGui::slotItemCompleted(const QString &folder, const SyncFileItemPtr &item)
+{
+    QString kindStr = Progress::asResultString(*item);
+    QString timeStr = QTime::currentTime().toString("hh:mm");
+    QString actionText = tr("%1 (%2, %3)").arg(item->_file, kindStr, timeStr);
+    auto *action = new QAction(actionText, this);
+    Folder *f = FolderMan::instance()->folder(folder);
+    if (f) {
+        QString fullPath = f->path() + '/' + item->_file;
+        if (QFile(fullPath).exists()) {
+            connect(action, &QAction::triggered, this, [this, fullPath] { this->slotOpenPath(fullPath); });
+        } else {
+            action->setEnabled(false);
         }
-        _recentItemsActions.append(action);
     }
+    if (_recentItemsActions.length() > 5) {
+        _recentItemsActions.takeFirst()->deleteLater();
+    }
+    _recentItemsActions.append(action);
 }
 
 void ownCloudGui::slotLogin()
@@ -110,6 +110,7 @@ public slots:
 private slots:
     void slotLogin();
     void slotLogout();
+    void slotItemCompleted(const QString &folder, const OCC::SyncFileItemPtr &item);
 
 private:
     QPointer<Systray> _tray;
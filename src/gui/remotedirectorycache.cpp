@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) by Nextcloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "remotedirectorycache.h"
+
+#include "account.h"
+#include "capabilities.h"
+#include "common/utility.h"
+
+#include <QLoggingCategory>
+
+namespace {
+constexpr auto fetchTimeoutMsecs = 60 * 1000;
+}
+
+namespace OCC {
+
+Q_LOGGING_CATEGORY(lcRemoteDirectoryCache, "nextcloud.gui.remotedirectorycache", QtInfoMsg)
+
+std::chrono::milliseconds RemoteDirectoryCache::uncheckedListingLifetime = std::chrono::minutes(1);
+int RemoteDirectoryCache::maximumCachedEntries = 20000;
+
+RemoteDirectoryCache::RemoteDirectoryCache(Account *account)
+    : QObject(account)
+    , _account(account)
+    , _listings(maximumCachedEntries)
+{
+}
+
+RemoteDirectoryCache *RemoteDirectoryCache::forAccount(const AccountPtr &account)
+{
+    auto cache = account->findChild<RemoteDirectoryCache *>(QString(), Qt::FindDirectChildrenOnly);
+    if (!cache) {
+        cache = new RemoteDirectoryCache(account.data());
+    }
+    return cache;
+}
+
+QString RemoteDirectoryCache::normalizedPath(const QString &path)
+{
+    auto result = path;
+    while (result.startsWith(QLatin1Char('/'))) {
+        result.remove(0, 1);
+    }
+    while (result.endsWith(QLatin1Char('/'))) {
+        result.chop(1);
+    }
+    return result;
+}
+
+const RemoteDirectoryCache::Listing *RemoteDirectoryCache::listing(const QString &path, const QByteArray &journalEtag) const
+{
+    // Also marks the listing as recently used
+    const auto cached = _listings.object(normalizedPath(path));
+    if (!cached) {
+        return nullptr;
+    }
+    const auto isCurrent = journalEtag.isEmpty() ? !cached->age.hasExpired(uncheckedListingLifetime.count()) : cached->etag == journalEtag;
+    return isCurrent ? cached : nullptr;
+}
+
+void RemoteDirectoryCache::fetch(const QString &path)
+{
+    const auto key = normalizedPath(path);
+    if (_pending.contains(key)) {
+        return;
+    }
+    _pending.insert(key, {});
+
+    auto job = new LsColJob(_account->sharedFromThis(), key, this);
+    auto props = QList<QByteArray>() << "resourcetype"
+                                     << "getetag"
+                                     << "http://owncloud.org/ns:size"
+                                     << "http://owncloud.org/ns:permissions"
+                                     << "http://owncloud.org/ns:fileid";
+    if (_account->capabilities().clientSideEncryptionAvailable()) {
+        props << "http://nextcloud.org/ns:is-encrypted";
+    }
+    job->setProperties(props);
+    job->setTimeout(fetchTimeoutMsecs);
+
+    // The listed directory comes first
+    connect(job, &LsColJob::directoryListingIterated, this, [this, key, isListedDirectory = true](const QString &href, const QMap<QString, QString> &properties) mutable {
+        auto &listing = _pending[key];
+        if (isListedDirectory) {
+            listing.etag = Utility::normalizeEtag(properties.value(QStringLiteral("getetag")).toUtf8());
+            isListedDirectory = false;
+        }
+        const auto permissions = properties.find(QStringLiteral("permissions"));
+        if (permissions != properties.cend()) {
+            listing.permissions.insert(href, *permissions);
+        }
+        if (properties.value(QStringLiteral("is-encrypted")) == QLatin1String("1")) {
+            listing.encrypted.insert(href);
+        }
+    });
+    connect(job, &LsColJob::directoryListingSubfolders, this, [this, job, key](const QStringList &subfolders) {
+        auto listing = _pending.take(key);
+        listing.subfolders = subfolders;
+        listing.folderInfos = job->_folderInfos;
+        listing.age.start();
+        // Costs one per file and directory in it. A listing larger than the
+        // whole cache is kept alone, the views waiting for it need it.
+        const auto cost = qMin(1 + listing.folderInfos.size(), _listings.maxCost());
+        _listings.insert(key, new Listing(std::move(listing)), cost);
+        emit fetched(key);
+    });
+    connect(job, &LsColJob::finishedWithError, this, [this, key](QNetworkReply *reply) {
+        qCInfo(lcRemoteDirectoryCache) << "Could not list" << key << reply->errorString();
+        _pending.remove(key);
+        emit fetchFailed(key, reply);
+    });
+    job->start();
+}
+
+bool RemoteDirectoryCache::isFetching(const QString &path) const
+{
+    return _pending.contains(normalizedPath(path));
+}
+
+void RemoteDirectoryCache::invalidate(const QString &path)
+{
+    _listings.remove(normalizedPath(path));
+}
+
+}
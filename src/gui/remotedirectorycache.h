@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) by Nextcloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#pragma once
+
+#include "accountfwd.h"
+#include "networkjobs.h"
+
+#include <QCache>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QStringList>
+
+#include <chrono>
+
+class QNetworkReply;
+
+namespace OCC {
+
+/**
+ * @brief Remote directory listings shared by the views that browse the server
+ *
+ * FolderStatusModel and SelectiveSyncWidget both show the folder tree of the
+ * server and list one directory at a time as it is expanded. They ask this
+ * cache first and only fetch listings that are unknown or stale; a fetch
+ * that is already running is shared.
+ *
+ * Whether a listing is stale is decided with the etag of the directory the
+ * journal has from the last sync: as long as the sync engine saw the same
+ * etag the listing is current. Directories without a journal record, like
+ * the excluded ones, are only reused for a short while.
+ *
+ * The least recently used listings are dropped once the listings hold more
+ * than maximumCachedEntries entries in total.
+ *
+ * There is one cache per account, see forAccount().
+ *
+ * @ingroup gui
+ */
+class RemoteDirectoryCache : public QObject
+{
+    Q_OBJECT
+public:
+    struct Listing
+    {
+        QByteArray etag; // of the listed directory, normalized
+        QStringList subfolders; // hrefs like LsColJob::directoryListingSubfolders(), the listed directory first
+        QHash<QString, ExtraFolderInfo> folderInfos; // by href, of files too
+        QHash<QString, QString> permissions; // by href without trailing slash
+        QSet<QString> encrypted; // hrefs without trailing slash
+        QElapsedTimer age;
+    };
+
+    static RemoteDirectoryCache *forAccount(const AccountPtr &account);
+
+    /// How long listings that can't be checked against the journal are reused
+    static std::chrono::milliseconds uncheckedListingLifetime;
+
+    /// How many files and directories a cache keeps listings of, read when it is created
+    static int maximumCachedEntries;
+
+    /// The path as used for the keys and signals: no leading or trailing slashes
+    [[nodiscard]] static QString normalizedPath(const QString &path);
+
+    /**
+     * The listing of @a path if it is current, otherwise nullptr.
+     *
+     * With a @a journalEtag the listing is current if it was fetched at
+     * that etag, without one if it is recent.
+     */
+    [[nodiscard]] const Listing *listing(const QString &path, const QByteArray &journalEtag = {}) const;
+
+    /// Fetches the listing of @a path, unless that is already being done
+    void fetch(const QString &path);
+
+    [[nodiscard]] bool isFetching(const QString &path) const;
+
+    /// Forgets the listing of @a path, so the next one is fetched
+    void invalidate(const QString &path);
+
+signals:
+    void fetched(const QString &path);
+    void fetchFailed(const QString &path, QNetworkReply *reply);
+
+private:
+    explicit RemoteDirectoryCache(Account *account);
+
+    Account *_account;
+    QCache<QString, Listing> _listings;
+    QHash<QString, Listing> _pending;
+};
+
+}
@@ -85,6 +85,12 @@ SelectiveSyncWidget::SelectiveSyncWidget(AccountPtr account, QWidget *parent)
         this, &SelectiveSyncWidget::slotItemExpanded);
     connect(_folderTree, &QTreeWidget::itemChanged,
         this, &SelectiveSyncWidget::slotItemChanged);
+
+    const auto cache = RemoteDirectoryCache::forAccount(_account);
+    connect(cache, &RemoteDirectoryCache::fetched,
+        this, &SelectiveSyncWidget::slotListingFetched);
+    connect(cache, &RemoteDirectoryCache::fetchFailed,
+        this, &SelectiveSyncWidget::slotListingFetchFailed);
     _folderTree->setSortingEnabled(true);
     _folderTree->sortByColumn(0, Qt::AscendingOrder);
     _folderTree->setColumnCount(2);
@@ -106,26 +112,58 @@ QSize SelectiveSyncWidget::sizeHint() const
 void SelectiveSyncWidget::refreshFolders()
 {
     _encryptedPaths.clear();
+    _pendingListings.clear();
 
-    auto *job = new LsColJob(_account, _folderPath, this);
-    auto props = QList<QByteArray>() << "resourcetype"
-                                     << "http://owncloud.org/ns:size";
-    if (_account->capabilities().clientSideEncryptionAvailable()) {
-        props << "http://nextcloud.org/ns:is-encrypted";
-    }
-    job->setProperties(props);
-    connect(job, &LsColJob::directoryListingSubfolders,
-        this, &SelectiveSyncWidget::slotUpdateDirectories);
-    connect(job, &LsColJob::directoryListingSubfolders,
-        this, &SelectiveSyncWidget::slotUpdateRootFolderFilesSize);
-    connect(job, &LsColJob::finishedWithError,
-        this, &SelectiveSyncWidget::slotLscolFinishedWithError);
-    connect(job, &LsColJob::directoryListingIterated,
-        this, &SelectiveSyncWidget::slotGatherEncryptedPaths);
-    job->start();
     _folderTree->clear();
     _loading->show();
     _loading->move(10, _folderTree->header()->height() + 10);
+    requestListing(_folderPath);
+}
+
+void SelectiveSyncWidget::requestListing(const QString &path)
+{
+    const auto cache = RemoteDirectoryCache::forAccount(_account);
+    if (const auto listing = cache->listing(path)) {
+        applyListing(path, *listing);
+        return;
+    }
+    _pendingListings.insert(RemoteDirectoryCache::normalizedPath(path));
+    cache->fetch(path);
+}
+
+void SelectiveSyncWidget::slotListingFetched(const QString &path)
+{
+    if (!_pendingListings.remove(path)) {
+        return;
+    }
+    if (const auto listing = RemoteDirectoryCache::forAccount(_account)->listing(path)) {
+        applyListing(path, *listing);
+    }
+}
+
+void SelectiveSyncWidget::applyListing(const QString &path, const RemoteDirectoryCache::Listing &listing)
+{
+    // Don't allow to select subfolders of encrypted subfolders
+    const auto webdavFolder = QUrl(_account->davUrl()).path();
+    for (const auto &encryptedPath : listing.encrypted) {
+        Q_ASSERT(encryptedPath.startsWith(webdavFolder));
+        // This dialog use the postfix / convention for folder paths
+        const auto relativePath = encryptedPath.mid(webdavFolder.size()) + '/';
+        if (!_encryptedPaths.contains(relativePath)) {
+            _encryptedPaths << relativePath;
+        }
+    }
+
+    if (RemoteDirectoryCache::normalizedPath(path) == RemoteDirectoryCache::normalizedPath(_folderPath)) {
+        _rootFilesSize = 0;
+        for (auto it = std::cbegin(listing.folderInfos); it != std::cend(listing.folderInfos); ++it) {
+            if (!listing.subfolders.contains(it.key())) {
+                _rootFilesSize += it.value().size;
+            }
+        }
+    }
+
+    updateDirectories(listing.subfolders, listing);
 }
 
 void SelectiveSyncWidget::setFolderInfo(const QString &folderPath, const QString &rootName, const QStringList &oldBlackList)
@@ -194,9 +232,8 @@ void SelectiveSyncWidget::recursiveInsert(QTreeWidgetItem *parent, QStringList p
     }
 }
 
-void SelectiveSyncWidget::slotUpdateDirectories(QStringList list)
+void SelectiveSyncWidget::updateDirectories(QStringList list, const RemoteDirectoryCache::Listing &listing)
 {
-    auto job = qobject_cast<LsColJob *>(sender());
     QScopedValueRollback<bool> isInserting(_inserting);
     _inserting = true;
 
@@ -246,7 +283,7 @@ void SelectiveSyncWidget::slotUpdateDirectories(QStringList list)
         root->setIcon(0, Theme::instance()->applicationIcon());
         root->setData(0, Qt::UserRole, QString());
         root->setCheckState(0, Qt::Checked);
-        qint64 size = job ? job->_folderInfos[pathToRemove].size : -1;
+        qint64 size = listing.folderInfos.value(pathToRemove).size;
         if (size >= 0) {
             root->setText(1, Utility::octetsToString(size));
             root->setData(1, Qt::UserRole, size);
@@ -255,7 +292,7 @@ void SelectiveSyncWidget::slotUpdateDirectories(QStringList list)
 
     Utility::sortFilenames(list);
     foreach (QString path, list) {
-        auto size = job ? job->_folderInfos[path].size : 0;
+        auto size = listing.folderInfos.value(path).size;
         path.remove(pathToRemove);
 
         // Don't allow to select subfolders of encrypted subfolders
@@ -289,26 +326,11 @@ void SelectiveSyncWidget::slotUpdateDirectories(QStringList list)
     root->setExpanded(true);
 }
 
-void SelectiveSyncWidget::slotUpdateRootFolderFilesSize(const QStringList &subfolders)
+void SelectiveSyncWidget::slotListingFetchFailed(const QString &path, QNetworkReply *r)
 {
-    const auto job = qobject_cast<LsColJob *>(sender());
-    
-    if (!job) {
-        qWarning() << "slotUpdateRootFolderFilesSize must have a valid sender";
+    if (!_pendingListings.remove(path) || path != RemoteDirectoryCache::normalizedPath(_folderPath)) {
         return;
     }
-
-    _rootFilesSize = 0;
-
-    for (auto it = std::cbegin(job->_folderInfos); it != std::cend(job->_folderInfos); ++it) {
-        if (!subfolders.contains(it.key())) {
-            _rootFilesSize += it.value().size;
-        }
-    }
-}
-
-void SelectiveSyncWidget::slotLscolFinishedWithError(QNetworkReply *r)
-{
     if (r->error() == QNetworkReply::ContentNotFoundError) {
         _loading->setText(tr("No subfolders currently on the server."));
     } else {
@@ -317,19 +339,6 @@ void SelectiveSyncWidget::slotLscolFinishedWithError(QNetworkReply *r)
     _loading->resize(_loading->sizeHint()); // because it's not in a layout
 }
 
-void SelectiveSyncWidget::slotGatherEncryptedPaths(const QString &path, const QMap<QString, QString> &properties)
-{
-    const auto it = properties.find("is-encrypted");
-    if (it == properties.cend() || *it != QStringLiteral("1")) {
-        return;
-    }
-
-    const auto webdavFolder = QUrl(_account->davUrl()).path();
-    Q_ASSERT(path.startsWith(webdavFolder));
-    // This dialog use the postfix / convention for folder paths
-    _encryptedPaths << path.mid(webdavFolder.size()) + '/';
-}
-
 void SelectiveSyncWidget::slotItemExpanded(QTreeWidgetItem *item)
 {
     QString dir = item->data(0, Qt::UserRole).toString();
@@ -339,12 +348,7 @@ void SelectiveSyncWidget::slotItemExpanded(QTreeWidgetItem *item)
     if (!_folderPath.isEmpty()) {
         prefix = _folderPath + QLatin1Char('/');
     }
-    auto *job = new LsColJob(_account, prefix + dir, this);
-    job->setProperties(QList<QByteArray>() << "resourcetype"
-                                           << "http://owncloud.org/ns:size");
-    connect(job, &LsColJob::directoryListingSubfolders,
-        this, &SelectiveSyncWidget::slotUpdateDirectories);
-    job->start();
+    requestListing(prefix + dir);
 }
 
 void SelectiveSyncWidget::slotItemChanged(QTreeWidgetItem *item, int col)
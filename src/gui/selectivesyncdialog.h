@@ -16,6 +16,7 @@
 #include <QDialog>
 #include <QTreeWidget>
 #include "accountfwd.h"
+#include "remotedirectorycache.h"
 
 #include "csync_exclude.h"
 
@@ -55,15 +56,16 @@ public:
     [[nodiscard]] QSize sizeHint() const override;
 
 private slots:
-    void slotUpdateDirectories(QStringList);
-    void slotUpdateRootFolderFilesSize(const QStringList &subfolders);
+    void slotListingFetched(const QString &path);
+    void slotListingFetchFailed(const QString &path, QNetworkReply *reply);
     void slotItemExpanded(QTreeWidgetItem *);
     void slotItemChanged(QTreeWidgetItem *, int);
-    void slotLscolFinishedWithError(QNetworkReply *);
-    void slotGatherEncryptedPaths(const QString &, const QMap<QString, QString> &);
 
 private:
     void refreshFolders();
+    void requestListing(const QString &path);
+    void applyListing(const QString &path, const RemoteDirectoryCache::Listing &listing);
+    void updateDirectories(QStringList list, const RemoteDirectoryCache::Listing &listing);
     void recursiveInsert(QTreeWidgetItem *parent, QStringList pathTrail, QString path, qint64 size);
 
     AccountPtr _account;
@@ -83,6 +85,9 @@ private:
 
     QStringList _encryptedPaths;
 
+    // Listings requested from the RemoteDirectoryCache, by normalized path
+    QSet<QString> _pendingListings;
+
     qint64 _rootFilesSize = 0;
 };
 
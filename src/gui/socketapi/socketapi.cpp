@@ -966,7 +966,7 @@ void SocketApi::command_MAKE_AVAILABLE_LOCALLY(const QString &filesArg, SocketLi
         }
 
         // Trigger sync
-        data.folder->schedulePathForLocalDiscovery(data.folderRelativePath);
+        data.folder->schedulePathForUserTriggeredSync(data.folderRelativePath);
         data.folder->scheduleThisFolderSoon();
     }
 }
@@ -38,6 +38,18 @@ namespace OCC {
 
 Q_LOGGING_CATEGORY(lcActivity, "nextcloud.gui.activity", QtInfoMsg)
 
+namespace {
+constexpr auto syncFileItemSummaryObjectType = "sync_file_item_summary";
+
+// Activities of successfully synced files, the ones that are summarized once there are too many
+bool isSyncedFileActivity(const Activity &activity)
+{
+    return activity._type == Activity::SyncFileItemType
+        && activity._objectType != QLatin1String(syncFileItemSummaryObjectType)
+        && (activity._syncFileItemStatus == SyncFileItem::Success || activity._syncFileItemStatus == SyncFileItem::NoStatus);
+}
+}
+
 ActivityListModel::ActivityListModel(QObject *parent)
     : QAbstractListModel(parent)
 {
@@ -603,9 +615,79 @@ void ActivityListModel::addNotificationToActivityList(const Activity &activity)
 
 void ActivityListModel::addSyncFileItemToActivityList(const Activity &activity)
 {
-    qCDebug(lcActivity) << "Successfully added to the activity list: " << activity._subject;
-    addEntriesToActivityList({activity});
-    _syncFileItemLists.prepend(activity);
+    addSyncFileItemsToActivityList({activity});
+}
+
+void ActivityListModel::addSyncFileItemsToActivityList(const ActivityList &activities)
+{
+    qCDebug(lcActivity) << "Adding" << activities.size() << "synced files to the activity list";
+
+    QSet<QString> summarizedFolders;
+    auto newActivities = activities;
+    // Only the newest ones would be kept anyway
+    if (newActivities.size() > MaxSyncFileItemActivities) {
+        const auto excess = newActivities.size() - MaxSyncFileItemActivities;
+        for (auto it = newActivities.cbegin(); it != newActivities.cbegin() + excess; ++it) {
+            _summarizedSyncFileItems[it->_folder]++;
+            summarizedFolders.insert(it->_folder);
+        }
+        newActivities.erase(newActivities.begin(), newActivities.begin() + excess);
+    }
+    addEntriesToActivityList(newActivities);
+
+    // Drop the oldest rows, removing contiguous rows at once
+    auto excess = std::count_if(_finalList.cbegin(), _finalList.cend(), isSyncedFileActivity) - MaxSyncFileItemActivities;
+    for (int row = 0; excess > 0 && row < _finalList.size();) {
+        if (!isSyncedFileActivity(_finalList.at(row))) {
+            ++row;
+            continue;
+        }
+        auto endRow = row;
+        while (excess > 0 && endRow < _finalList.size() && isSyncedFileActivity(_finalList.at(endRow))) {
+            const auto &folder = _finalList.at(endRow)._folder;
+            _summarizedSyncFileItems[folder]++;
+            summarizedFolders.insert(folder);
+            ++endRow;
+            --excess;
+        }
+        beginRemoveRows({}, row, endRow - 1);
+        _finalList.erase(_finalList.begin() + row, _finalList.begin() + endRow);
+        endRemoveRows();
+    }
+
+    for (const auto &folder : qAsConst(summarizedFolders)) {
+        updateSyncFileItemSummary(folder);
+    }
+}
+
+void ActivityListModel::updateSyncFileItemSummary(const QString &folder)
+{
+    const auto count = _summarizedSyncFileItems.value(folder);
+    const auto subject = tr("%n more file(s) synced", "", count);
+    const auto it = std::find_if(_finalList.begin(), _finalList.end(), [&folder](const Activity &activity) {
+        return activity._objectType == QLatin1String(syncFileItemSummaryObjectType) && activity._folder == folder;
+    });
+    if (it != _finalList.end()) {
+        it->_subject = subject;
+        it->_dateTime = QDateTime::currentDateTime();
+        const auto summaryIndex = index(static_cast<int>(std::distance(_finalList.begin(), it)));
+        emit dataChanged(summaryIndex, summaryIndex);
+        return;
+    }
+
+    Activity summary;
+    summary._type = Activity::SyncFileItemType;
+    summary._objectType = QLatin1String(syncFileItemSummaryObjectType);
+    summary._syncFileItemStatus = SyncFileItem::Success;
+    summary._dateTime = QDateTime::currentDateTime();
+    summary._subject = subject;
+    summary._message = folder;
+    summary._folder = folder;
+    if (_accountState) {
+        summary._accName = _accountState->account()->displayName();
+        summary._link = _accountState->account()->url();
+    }
+    addEntriesToActivityList({summary});
 }
 
 void ActivityListModel::removeActivityFromActivityList(int row)
@@ -894,6 +976,7 @@ void ActivityListModel::slotRemoveAccount()
     _finalList.clear();
     _activityLists.clear();
     _presentedActivities.clear();
+    _summarizedSyncFileItems.clear();
     setAndRefreshCurrentlyFetching(false);
     _doneFetching = false;
     _currentItem = 0;
@@ -119,6 +119,11 @@ public:
 
     [[nodiscard]] OCC::ActivityList allConflicts() const;
 
+    static constexpr int maxSyncFileItemActivities()
+    {
+        return MaxSyncFileItemActivities;
+    }
+
 public slots:
     void slotRefreshActivity();
     void slotRefreshActivityInitial();
@@ -131,6 +136,12 @@ public slots:
     void addErrorToActivityList(const OCC::Activity &activity, const ErrorType type);
     void addIgnoredFileToList(const OCC::Activity &newActivity);
     void addSyncFileItemToActivityList(const OCC::Activity &activity);
+    /** Adds the activities of synced files with a single model update.
+     *
+     * Only the newest maxSyncFileItemActivities() ones are kept, the older ones
+     * are counted in one summary entry per folder.
+     */
+    void addSyncFileItemsToActivityList(const OCC::ActivityList &activities);
     void removeActivityFromActivityList(int row);
     void removeActivityFromActivityList(const OCC::Activity &activity);
 
@@ -178,12 +189,12 @@ private:
 
     void displaySingleConflictDialog(const Activity &activity);
     void setHasSyncConflicts(bool conflictsFound);
+    void updateSyncFileItemSummary(const QString &folder);
 
     Activity _notificationIgnoredFiles;
     Activity _dummyFetchingActivities;
 
     ActivityList _activityLists;
-    ActivityList _syncFileItemLists;
     ActivityList _notificationLists;
     ActivityList _listOfIgnoredFiles;
     ActivityList _notificationErrorsLists;
@@ -191,6 +202,9 @@ private:
 
     QSet<qint64> _presentedActivities;
 
+    // Number of synced file activities per folder that are only shown in the folder's summary
+    QHash<QString, int> _summarizedSyncFileItems;
+
     bool _displayActions = true;
 
     int _currentItem = 0;
@@ -210,6 +224,7 @@ private:
     bool _hasSyncConflicts = false;
 
     static constexpr quint32 MaxActionButtons = 3;
+    static constexpr int MaxSyncFileItemActivities = 100;
 };
 }
 
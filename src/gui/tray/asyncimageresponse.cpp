@@ -17,6 +17,7 @@
 #include <QSvgRenderer>
 
 #include "asyncimageresponse.h"
+#include "iconutils.h"
 #include "usermodel.h"
 
 AsyncImageResponse::AsyncImageResponse(const QString &id, const QSize &requestedSize)
@@ -83,6 +84,13 @@ void AsyncImageResponse::processNextImage()
         }
     }
 
+    // Icons rendered from SVGs before don't need to be fetched and rendered again
+    const auto cachedImage = OCC::Ui::IconUtils::findCachedImage(imagePath, _svgRecolor, _requestedImageSize);
+    if (!cachedImage.isNull()) {
+        setImageAndEmitFinished(cachedImage);
+        return;
+    }
+
     if (accountInRequestedServer) {
         const QUrl iconUrl(_imagePaths.at(_index));
         if (iconUrl.isValid() && !iconUrl.scheme().isEmpty()) {
@@ -119,8 +127,11 @@ void AsyncImageResponse::slotProcessNetworkReply()
                 scaledSvg.fill("transparent");
                 QPainter painterForSvg(&scaledSvg);
                 svgRenderer.render(&painterForSvg);
+                painterForSvg.end();
 
+                const auto imagePath = _imagePaths.at(_index - 1);
                 if(!_svgRecolor.isValid()) {
+                    OCC::Ui::IconUtils::insertCachedImage(imagePath, _svgRecolor, _requestedImageSize, scaledSvg);
                     setImageAndEmitFinished(scaledSvg);
                     return;
                 }
@@ -130,6 +141,8 @@ void AsyncImageResponse::slotProcessNetworkReply()
                 QPainter imagePainter(&image);
                 imagePainter.setCompositionMode(QPainter::CompositionMode_DestinationIn);
                 imagePainter.drawImage(0, 0, scaledSvg);
+                imagePainter.end();
+                OCC::Ui::IconUtils::insertCachedImage(imagePath, _svgRecolor, _requestedImageSize, image);
                 setImageAndEmitFinished(image);
                 return;
             } else {
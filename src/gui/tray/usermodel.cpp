@@ -72,6 +72,11 @@ User::User(AccountStatePtr &account, const bool &isCurrent, QObject *parent)
     connect(&_expiredActivitiesCheckTimer, &QTimer::timeout,
         this, &User::slotCheckExpiredActivities);
 
+    _syncFileItemActivitiesTimer.setSingleShot(true);
+    _syncFileItemActivitiesTimer.setInterval(std::chrono::milliseconds(100));
+    connect(&_syncFileItemActivitiesTimer, &QTimer::timeout,
+        this, &User::slotFlushSyncFileItemActivities);
+
     connect(_account.data(), &AccountState::stateChanged,
             [=]() { if (isConnected()) {slotRefreshImmediately();} });
     connect(_account.data(), &AccountState::stateChanged, this, &User::accountStateChanged);
@@ -797,7 +802,10 @@ void User::processCompletedSyncItem(const Folder *folder, const SyncFileItemPtr
             }
         }
 
-        _activityModel->addSyncFileItemToActivityList(activity);
+        _pendingSyncFileItemActivities.append(activity);
+        if (!_syncFileItemActivitiesTimer.isActive()) {
+            _syncFileItemActivitiesTimer.start();
+        }
     } else {
         qCWarning(lcActivity) << "Item " << item->_file << " retrieved resulted in error " << item->_errorString;
 
@@ -824,6 +832,13 @@ void User::processCompletedSyncItem(const Folder *folder, const SyncFileItemPtr
     }
 }
 
+void User::slotFlushSyncFileItemActivities()
+{
+    // A big sync completes thousands of items per second, update the model once for all of them
+    _activityModel->addSyncFileItemsToActivityList(_pendingSyncFileItemActivities);
+    _pendingSyncFileItemActivities.clear();
+}
+
 const QVariantList &User::groupFolders() const
 {
     return _trayFolderInfos;
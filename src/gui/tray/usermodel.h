@@ -144,6 +144,7 @@ private slots:
     void slotReceivedPushNotification(OCC::Account *account);
     void slotReceivedPushActivity(OCC::Account *account);
     void slotCheckExpiredActivities();
+    void slotFlushSyncFileItemActivities();
     void slotGroupFoldersFetched(QNetworkReply *reply);
     void checkNotifiedNotifications();
     void showDesktopNotification(const QString &title, const QString &message, const long notificationId);
@@ -175,6 +176,10 @@ private:
     QTimer _notificationCheckTimer;
     QHash<AccountState *, QElapsedTimer> _timeSinceLastCheck;
 
+    // Activities of synced files are added to the model in batches, see slotFlushSyncFileItemActivities()
+    ActivityList _pendingSyncFileItemActivities;
+    QTimer _syncFileItemActivitiesTimer;
+
     QElapsedTimer _guiLogTimer;
     QSet<long> _notifiedNotifications;
     QMimeDatabase _mimeDb;
@@ -16,6 +16,8 @@
 #include "propagatedownload.h"
 #include "propagateupload.h"
 #include "propagatorjobs.h"
+#include "account.h"
+#include "networkjobs.h"
 #include "common/utility.h"
 
 #ifdef Q_OS_WIN
@@ -24,391 +26,447 @@
 #endif
 
 #include <QLoggingCategory>
+#include <QNetworkReply>
 #include <QTimer>
 #include <QObject>
+#include <QtMath>
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
 
 namespace OCC {
 
 Q_LOGGING_CATEGORY(lcBandwidthManager, "nextcloud.sync.bandwidthmanager", QtInfoMsg)
 
+namespace {
+
+// A burst may use the quota of a quarter second, but at least this much
+constexpr qint64 minimumBurstBytes = 16 * 1024;
+
+// Handing out less than this at once costs more in overhead than it gains in accuracy
+constexpr qint64 minimumGrantBytes = 4 * 1024;
+
+// Qt opens at most this many HTTP/1.1 connections per host. Once transfers
+// use all of them, a probe waits for a free connection instead of measuring
+// the round trip.
+constexpr std::size_t http1ConnectionsPerHost = 6;
+
+// The lowest latency seen stands for the idle path; forget it now and then
+// in case the route changed
+constexpr auto baseLatencyLifetime = std::chrono::minutes(10);
+
+// Latency above the base by more than this means the transfers are queuing up
+constexpr qint64 congestionDelayMsecs = 100;
+
+// The adaptive rate never drops below this, and grows by at least this much
+constexpr qint64 adaptiveMinimumRate = 16 * 1000;
+
+const char uploadWakeMethod[] = "readyRead";
+const char downloadWakeMethod[] = "slotReadyRead";
+
+qint64 relativeRate(qint64 limit, qint64 measuredRate)
+{
+    // The unlimited measuring windows count towards the average as well,
+    // so the rate in between has to be a bit lower than the percentage.
+    const auto percent = qBound(qint64(BandwidthSchedule::MinimumRelativeLimit), -limit, qint64(BandwidthSchedule::MaximumRelativeLimit)) / 100.0;
+    const double measuring = std::chrono::duration<double>(BandwidthManager::relativeLimitMeasuringInterval).count();
+    const double limiting = std::chrono::duration<double>(BandwidthManager::relativeLimitLimitingInterval).count();
+    const auto factor = qMax(0.01, (percent * (measuring + limiting) - measuring) / limiting);
+    return qMax(qint64(1), static_cast<qint64>(measuredRate * factor));
+}
+
+}
+
+TokenBucket::TokenBucket()
+    : TokenBucket([] {
+        return static_cast<qint64>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+    })
+{
+}
+
+TokenBucket::TokenBucket(Clock clock)
+    : _clock(std::move(clock))
+{
+}
+
+void TokenBucket::setRate(qint64 bytesPerSecond)
+{
+    refill();
+    const auto wasUnlimited = _rate <= 0;
+    _rate = qMax(qint64(0), bytesPerSecond);
+    _capacity = _rate > 0 ? qMax(_rate / 4, minimumBurstBytes) : 0;
+    // A fresh limit starts with a full bucket to allow for the initial burst
+    _tokens = wasUnlimited ? _capacity : qMin(_tokens, double(_capacity));
+}
+
+void TokenBucket::refill()
+{
+    const auto now = _clock();
+    if (_lastRefillNsecs < 0) {
+        _lastRefillNsecs = now;
+        return;
+    }
+    const auto elapsedNsecs = qMax(qint64(0), now - _lastRefillNsecs);
+    _lastRefillNsecs = now;
+    _tokens = qMin(double(_capacity), _tokens + _rate * (elapsedNsecs / 1e9));
+}
+
+qint64 TokenBucket::take(qint64 wanted, qint64 minimum)
+{
+    if (_rate <= 0) {
+        return wanted;
+    }
+    const auto granted = qMin(wanted, available());
+    if (granted <= 0 || granted < qMin(wanted, minimum)) {
+        return 0;
+    }
+    _tokens -= granted;
+    return granted;
+}
+
+qint64 TokenBucket::available()
+{
+    if (_rate <= 0) {
+        return std::numeric_limits<qint64>::max();
+    }
+    refill();
+    return static_cast<qint64>(_tokens);
+}
+
+qint64 TokenBucket::msecsUntilAvailable(qint64 amount)
+{
+    if (_rate <= 0) {
+        return 0;
+    }
+    const auto missing = qMin(amount, _capacity) - available();
+    return missing <= 0 ? 0 : qCeil(missing * 1000.0 / _rate);
+}
+
 // Because of the many layers of buffering inside Qt (and probably the OS and the network)
 // we cannot lower this value much more. If we do, the estimated bw will be very high
 // because the buffers fill fast while the actual network algorithms are not relevant yet.
-static qint64 relativeLimitMeasuringTimerIntervalMsec = 1000 * 2;
 // See also WritingState in http://code.woboq.org/qt5/qtbase/src/network/access/qhttpprotocolhandler.cpp.html#_ZN20QHttpProtocolHandler11sendRequestEv
+std::chrono::milliseconds BandwidthManager::relativeLimitMeasuringInterval = std::chrono::seconds(2);
+
+std::chrono::milliseconds BandwidthManager::relativeLimitLimitingInterval = std::chrono::seconds(20);
 
-// FIXME At some point:
-//  * Register device only after the QNR received its metaDataChanged() signal
-//  * Incorporate Qt buffer fill state (it's a negative absolute delta).
-//  * Incorporate SSL overhead (percentage)
-//  * For relative limiting, do less measuring and more delaying+giving quota
-//  * For relative limiting, smoothen measurements
+std::chrono::milliseconds BandwidthManager::latencyProbeInterval = std::chrono::seconds(2);
+
+std::chrono::milliseconds BandwidthManager::latencyProbeTimeout = std::chrono::seconds(10);
 
 BandwidthManager::BandwidthManager(OwncloudPropagator *p)
     : QObject()
     , _propagator(p)
 {
-    _currentUploadLimit = _propagator->_uploadLimit;
-    _currentDownloadLimit = _propagator->_downloadLimit;
-
     QObject::connect(&_switchingTimer, &QTimer::timeout, this, &BandwidthManager::switchingTimerExpired);
     _switchingTimer.setInterval(10 * 1000);
     _switchingTimer.start();
     QMetaObject::invokeMethod(this, "switchingTimerExpired", Qt::QueuedConnection);
 
-    // absolute uploads/downloads
-    QObject::connect(&_absoluteLimitTimer, &QTimer::timeout, this, &BandwidthManager::absoluteLimitTimerExpired);
-    _absoluteLimitTimer.setInterval(1000);
-    _absoluteLimitTimer.start();
-
-    // Relative uploads
-    QObject::connect(&_relativeUploadMeasuringTimer, &QTimer::timeout,
-        this, &BandwidthManager::relativeUploadMeasuringTimerExpired);
-    _relativeUploadMeasuringTimer.setInterval(relativeLimitMeasuringTimerIntervalMsec);
-    _relativeUploadMeasuringTimer.start();
-    _relativeUploadMeasuringTimer.setSingleShot(true); // will be restarted from the delay timer
-    QObject::connect(&_relativeUploadDelayTimer, &QTimer::timeout,
-        this, &BandwidthManager::relativeUploadDelayTimerExpired);
-    _relativeUploadDelayTimer.setSingleShot(true); // will be restarted from the measuring timer
-
-    // Relative downloads
-    QObject::connect(&_relativeDownloadMeasuringTimer, &QTimer::timeout,
-        this, &BandwidthManager::relativeDownloadMeasuringTimerExpired);
-    _relativeDownloadMeasuringTimer.setInterval(relativeLimitMeasuringTimerIntervalMsec);
-    _relativeDownloadMeasuringTimer.start();
-    _relativeDownloadMeasuringTimer.setSingleShot(true); // will be restarted from the delay timer
-    QObject::connect(&_relativeDownloadDelayTimer, &QTimer::timeout,
-        this, &BandwidthManager::relativeDownloadDelayTimerExpired);
-    _relativeDownloadDelayTimer.setSingleShot(true); // will be restarted from the measuring timer
+    _refillTimer.setSingleShot(true);
+    QObject::connect(&_refillTimer, &QTimer::timeout, this, &BandwidthManager::refillTimerExpired);
+
+    _relativeLimitTimer.setSingleShot(true);
+    QObject::connect(&_relativeLimitTimer, &QTimer::timeout, this, &BandwidthManager::relativeLimitTimerExpired);
+
+    _latencyProbeTimer.setInterval(latencyProbeInterval);
+    QObject::connect(&_latencyProbeTimer, &QTimer::timeout, this, &BandwidthManager::latencyProbeTimerExpired);
 }
 
 BandwidthManager::~BandwidthManager() = default;
 
 void BandwidthManager::registerUploadDevice(UploadDevice *p)
 {
-    _absoluteUploadDeviceList.push_back(p);
-    _relativeUploadDeviceList.push_back(p);
+    _upload.transfers.push_back(p);
     QObject::connect(p, &QObject::destroyed, this, &BandwidthManager::unregisterUploadDevice);
-
-    if (usingAbsoluteUploadLimit()) {
-        p->setBandwidthLimited(true);
-        p->setChoked(false);
-    } else if (usingRelativeUploadLimit()) {
-        p->setBandwidthLimited(true);
-        p->setChoked(true);
-    } else {
-        p->setBandwidthLimited(false);
-        p->setChoked(false);
-    }
 }
 
 void BandwidthManager::unregisterUploadDevice(QObject *o)
 {
-    auto p = reinterpret_cast<UploadDevice *>(o); // note, we might already be in the ~QObject
-    _absoluteUploadDeviceList.remove(p);
-    _relativeUploadDeviceList.remove(p);
-    if (p == _relativeLimitCurrentMeasuredDevice) {
-        _relativeLimitCurrentMeasuredDevice = nullptr;
-        _relativeUploadLimitProgressAtMeasuringRestart = 0;
-    }
+    unregisterTransfer(_upload, o); // note, we might already be in the ~QObject
 }
 
 void BandwidthManager::registerDownloadJob(GETFileJob *j)
 {
-    _downloadJobList.push_back(j);
+    _download.transfers.push_back(j);
     QObject::connect(j, &QObject::destroyed, this, &BandwidthManager::unregisterDownloadJob);
-
-    if (usingAbsoluteDownloadLimit()) {
-        j->setBandwidthLimited(true);
-        j->setChoked(false);
-    } else if (usingRelativeDownloadLimit()) {
-        j->setBandwidthLimited(true);
-        j->setChoked(true);
-    } else {
-        j->setBandwidthLimited(false);
-        j->setChoked(false);
-    }
 }
 
 void BandwidthManager::unregisterDownloadJob(QObject *o)
 {
-    auto *j = reinterpret_cast<GETFileJob *>(o); // note, we might already be in the ~QObject
-    _downloadJobList.remove(j);
-    if (_relativeLimitCurrentMeasuredJob == j) {
-        _relativeLimitCurrentMeasuredJob = nullptr;
-        _relativeDownloadLimitProgressAtMeasuringRestart = 0;
-    }
+    unregisterTransfer(_download, o); // note, we might already be in the ~QObject
 }
 
-void BandwidthManager::relativeUploadMeasuringTimerExpired()
+void BandwidthManager::unregisterTransfer(Shaper &shaper, QObject *transfer)
 {
-    if (!usingRelativeUploadLimit() || _relativeUploadDeviceList.empty()) {
-        // Not in this limiting mode, just wait 1 sec to continue the cycle
-        _relativeUploadDelayTimer.setInterval(1000);
-        _relativeUploadDelayTimer.start();
-        return;
-    }
-
-    if (!_relativeLimitCurrentMeasuredDevice) {
-        qCDebug(lcBandwidthManager) << "No device set, just waiting 1 sec";
-        _relativeUploadDelayTimer.setInterval(1000);
-        _relativeUploadDelayTimer.start();
-        return;
-    }
-
-    qCDebug(lcBandwidthManager) << _relativeUploadDeviceList.size() << "Starting Delay";
-
-    const auto currentReadWithProgress = _relativeLimitCurrentMeasuredDevice->_readWithProgress;
-    const auto currentRead = _relativeLimitCurrentMeasuredDevice->_read;
-    const auto relativeLimitProgressMeasured = (currentReadWithProgress + currentRead) / 2;
-    const auto relativeLimitProgressDifference = relativeLimitProgressMeasured - _relativeUploadLimitProgressAtMeasuringRestart;
-
-    qCDebug(lcBandwidthManager) << _relativeUploadLimitProgressAtMeasuringRestart
-                                << relativeLimitProgressMeasured
-                                << relativeLimitProgressDifference;
-
-    const auto speedkBPerSec = (relativeLimitProgressDifference / relativeLimitMeasuringTimerIntervalMsec * 1000) / 1024;
-
-    qCDebug(lcBandwidthManager) << relativeLimitProgressDifference / 1024 << "kB =>" << speedkBPerSec << "kB/sec on full speed ("
-                                << currentReadWithProgress << currentRead
-                                << qAbs(currentReadWithProgress - currentRead)
-                                << ")";
-
-    const auto uploadLimitPercent = qMax( qMin(-_currentUploadLimit, qint64(90)), qint64(10) ); // Clamp value
-    const auto wholeTimeMsec = (100.0 / uploadLimitPercent) * relativeLimitMeasuringTimerIntervalMsec;
-    const auto waitTimeMsec = wholeTimeMsec - relativeLimitMeasuringTimerIntervalMsec;
-    const auto realWaitTimeMsec = waitTimeMsec + wholeTimeMsec;
+    shaper.transfers.remove(transfer);
+    shaper.waiting.remove(transfer);
+}
 
-    qCDebug(lcBandwidthManager) << waitTimeMsec << " - " << realWaitTimeMsec << " msec for " << uploadLimitPercent << "%";
+qint64 BandwidthManager::takeUploadQuota(UploadDevice *device, qint64 wanted)
+{
+    return takeQuota(_upload, device, wanted);
+}
 
-    // We want to wait twice as long since we want to give all
-    // devices the same quota we used now since we don't want
-    // any upload to timeout
-    _relativeUploadDelayTimer.setInterval(realWaitTimeMsec);
-    _relativeUploadDelayTimer.start();
+qint64 BandwidthManager::takeDownloadQuota(GETFileJob *job, qint64 wanted)
+{
+    // The job reads what already arrived, so the grant is what was transferred
+    const auto granted = takeQuota(_download, job, wanted);
+    _download.transferredBytes += granted;
+    return granted;
+}
 
-    const auto deviceCount = _relativeUploadDeviceList.size();
-    const auto  quotaPerDevice = relativeLimitProgressDifference * (uploadLimitPercent / 100.0) / deviceCount + 1.0;
+void BandwidthManager::uploadProgressed(qint64 bytes)
+{
+    _upload.transferredBytes += bytes;
+}
 
-    for (const auto uploadDevice : _relativeUploadDeviceList) {
-        uploadDevice->setBandwidthLimited(true);
-        uploadDevice->setChoked(false);
-        uploadDevice->giveBandwidthQuota(quotaPerDevice);
-        qCDebug(lcBandwidthManager) << "Gave" << quotaPerDevice / 1024.0 << "kB to" << uploadDevice;
+qint64 BandwidthManager::takeQuota(Shaper &shaper, QObject *transfer, qint64 wanted)
+{
+    auto &bucket = shaper.bucket;
+    if (bucket.rate() > 0) {
+        // Nobody gets more than their share of a burst, so parallel transfers take turns
+        const auto transferCount = qMax(qint64(1), static_cast<qint64>(shaper.transfers.size()));
+        wanted = qMin(wanted, qMax(minimumGrantBytes, bucket.capacity() / transferCount));
     }
 
-    _relativeLimitCurrentMeasuredDevice = nullptr;
+    const auto granted = bucket.take(wanted, minimumGrantBytes);
+    if (granted == 0 && std::find(shaper.waiting.cbegin(), shaper.waiting.cend(), transfer) == shaper.waiting.cend()) {
+        shaper.waiting.push_back(transfer);
+        scheduleRefill();
+    }
+    return granted;
 }
 
-void BandwidthManager::relativeUploadDelayTimerExpired()
+void BandwidthManager::scheduleRefill()
 {
-    // Switch to measuring state
-    _relativeUploadMeasuringTimer.start(); // always start to continue the cycle
-
-    if (!usingRelativeUploadLimit()) {
-        return; // oh, not actually needed
+    auto delay = std::numeric_limits<qint64>::max();
+    for (auto shaper : {&_upload, &_download}) {
+        if (!shaper->waiting.empty()) {
+            delay = qMin(delay, shaper->bucket.msecsUntilAvailable(minimumGrantBytes));
+        }
     }
-
-    if (_relativeUploadDeviceList.empty()) {
+    if (delay == std::numeric_limits<qint64>::max()) {
         return;
     }
+    // Wake up no more often than every millisecond
+    delay = qMax(qint64(1), delay);
+    if (!_refillTimer.isActive() || _refillTimer.remainingTime() > delay) {
+        _refillTimer.start(static_cast<int>(delay));
+    }
+}
 
-    qCDebug(lcBandwidthManager) << _relativeUploadDeviceList.size() << "Starting measuring";
+void BandwidthManager::refillTimerExpired()
+{
+    wakeWaiting(_upload, uploadWakeMethod);
+    wakeWaiting(_download, downloadWakeMethod);
+    scheduleRefill();
+}
 
-    // Take first device and then append it again (= we round robin all devices)
-    _relativeLimitCurrentMeasuredDevice = _relativeUploadDeviceList.front();
-    _relativeUploadDeviceList.pop_front();
-    _relativeUploadDeviceList.push_back(_relativeLimitCurrentMeasuredDevice);
+void BandwidthManager::wakeWaiting(Shaper &shaper, const char *wakeMethod)
+{
+    // Wake as many transfers as the refilled tokens can serve, in the
+    // order they started waiting. The others keep waiting for the next round.
+    auto tokens = shaper.bucket.available();
+    const auto transferCount = qMax(qint64(1), static_cast<qint64>(shaper.transfers.size()));
+    const auto share = qMax(minimumGrantBytes, shaper.bucket.capacity() / transferCount);
+    while (!shaper.waiting.empty() && tokens >= minimumGrantBytes) {
+        auto transfer = shaper.waiting.front();
+        shaper.waiting.pop_front();
+        tokens -= qMin(tokens, share);
+        QMetaObject::invokeMethod(transfer, wakeMethod, Qt::QueuedConnection);
+    }
+}
 
-    const auto currentReadWithProgress = _relativeLimitCurrentMeasuredDevice->_readWithProgress;
-    const auto currentRead =  _relativeLimitCurrentMeasuredDevice->_read;
-    _relativeUploadLimitProgressAtMeasuringRestart = (currentReadWithProgress + currentRead) / 2;
+void BandwidthManager::applyLimit(Shaper &shaper, qint64 limit)
+{
+    shaper.limit = limit;
+    if (limit > 0) {
+        shaper.bucket.setRate(limit);
+    } else if (limit == BandwidthSchedule::AdaptiveLimit) {
+        shaper.bucket.setRate(shaper.adaptiveRate);
+    } else if (limit < 0 && !_relativeLimitMeasuring && shaper.measuredRate > 0) {
+        shaper.bucket.setRate(relativeRate(limit, shaper.measuredRate));
+    } else {
+        shaper.bucket.setRate(0);
+    }
+    qCDebug(lcBandwidthManager) << "Limiting to" << shaper.bucket.rate() << "bytes per second for" << shaper.transfers.size() << "transfers";
+}
 
-    _relativeLimitCurrentMeasuredDevice->setBandwidthLimited(false);
-    _relativeLimitCurrentMeasuredDevice->setChoked(false);
+void BandwidthManager::relativeLimitTimerExpired()
+{
+    if (!usingRelativeUploadLimit() && !usingRelativeDownloadLimit()) {
+        _relativeLimitMeasuring = false;
+        return;
+    }
 
-    // choke all other UploadDevices
-    for (const auto uploadDevice : _relativeUploadDeviceList) {
-        if (uploadDevice == _relativeLimitCurrentMeasuredDevice) {
-            continue;
+    if (_relativeLimitMeasuring) {
+        const auto measuringMsecs = qMax(qint64(1), static_cast<qint64>(relativeLimitMeasuringInterval.count()));
+        for (auto shaper : {&_upload, &_download}) {
+            // Without any transfer the previous measurement is still the best guess
+            if (shaper->limit < 0 && shaper->limit != BandwidthSchedule::AdaptiveLimit && shaper->transferredBytes > 0) {
+                shaper->measuredRate = shaper->transferredBytes * 1000 / measuringMsecs;
+                qCDebug(lcBandwidthManager) << shaper->measuredRate / 1024 << "kB/sec on full speed";
+            }
         }
-
-        uploadDevice->setBandwidthLimited(true);
-        uploadDevice->setChoked(true);
+        _relativeLimitMeasuring = false;
+        _relativeLimitTimer.start(relativeLimitLimitingInterval);
+    } else {
+        if (usingRelativeUploadLimit()) {
+            _upload.transferredBytes = 0;
+        }
+        if (usingRelativeDownloadLimit()) {
+            _download.transferredBytes = 0;
+        }
+        _relativeLimitMeasuring = true;
+        _relativeLimitTimer.start(relativeLimitMeasuringInterval);
     }
 
-    // now we're in measuring state
+    if (usingRelativeUploadLimit()) {
+        applyLimit(_upload, _upload.limit);
+        wakeWaiting(_upload, uploadWakeMethod);
+    }
+    if (usingRelativeDownloadLimit()) {
+        applyLimit(_download, _download.limit);
+        wakeWaiting(_download, downloadWakeMethod);
+    }
+    scheduleRefill();
 }
 
-// for downloads:
-void BandwidthManager::relativeDownloadMeasuringTimerExpired()
+void BandwidthManager::latencyProbeTimerExpired()
 {
-    if (!usingRelativeDownloadLimit() || _downloadJobList.empty()) {
-        // Not in this limiting mode, just wait 1 sec to continue the cycle
-        _relativeDownloadDelayTimer.setInterval(1000);
-        _relativeDownloadDelayTimer.start();
+    if (_latencyProbeRunning) {
         return;
     }
-    if (!_relativeLimitCurrentMeasuredJob) {
-        qCDebug(lcBandwidthManager) << "No job set, just waiting 1 sec";
-        _relativeDownloadDelayTimer.setInterval(1000);
-        _relativeDownloadDelayTimer.start();
+    const auto uploading = usingAdaptiveUploadLimit() && !_upload.transfers.empty();
+    const auto downloading = usingAdaptiveDownloadLimit() && !_download.transfers.empty();
+    if (!uploading && !downloading) {
+        // Idle time says nothing about the transfers; start a fresh window once they run
+        if (usingAdaptiveUploadLimit()) {
+            _upload.transferredBytes = 0;
+        }
+        if (usingAdaptiveDownloadLimit()) {
+            _download.transferredBytes = 0;
+        }
+        _latencyWindow.start();
         return;
     }
 
-    qCDebug(lcBandwidthManager) << _downloadJobList.size() << "Starting Delay";
-
-    const auto relativeLimitProgressMeasured = _relativeLimitCurrentMeasuredJob->currentDownloadPosition();
-    const auto relativeLimitProgressDifference = relativeLimitProgressMeasured - _relativeDownloadLimitProgressAtMeasuringRestart;
-
-    qCDebug(lcBandwidthManager) << _relativeDownloadLimitProgressAtMeasuringRestart
-                                << relativeLimitProgressMeasured << relativeLimitProgressDifference;
-
-    const auto speedkBPerSec = (relativeLimitProgressDifference / relativeLimitMeasuringTimerIntervalMsec * 1000) / 1024;
-
-    qCDebug(lcBandwidthManager) << relativeLimitProgressDifference / 1024 << "kB =>" << speedkBPerSec << "kB/sec on full speed ("
-                                << _relativeLimitCurrentMeasuredJob->currentDownloadPosition();
-
-    const auto downloadLimitPercent = qMax( qMin(-_currentDownloadLimit, qint64(90)), qint64(10));
-    const auto wholeTimeMsec = (100.0 / downloadLimitPercent) * relativeLimitMeasuringTimerIntervalMsec;
-    const auto waitTimeMsec = wholeTimeMsec - relativeLimitMeasuringTimerIntervalMsec;
-    const auto realWaitTimeMsec = waitTimeMsec + wholeTimeMsec;
-
-    qCDebug(lcBandwidthManager) << waitTimeMsec << " - " << realWaitTimeMsec << " msec for " << downloadLimitPercent << "%";
-
-    // We want to wait twice as long since we want to give all
-    // devices the same quota we used now since we don't want
-    // any download to timeout
-    _relativeDownloadDelayTimer.setInterval(realWaitTimeMsec);
-    _relativeDownloadDelayTimer.start();
-
-    const auto jobCount = _downloadJobList.size();
-    auto quota = relativeLimitProgressDifference * (downloadLimitPercent / 100.0);
-
-    if (quota > 20 * 1024) {
-        qCDebug(lcBandwidthManager) << "ADJUSTING QUOTA FROM " << quota << " TO " << quota - 20 * 1024;
-        quota -= 20 * 1024;
+    // The probe shares the connections of the transfers. Unless they are
+    // multiplexed over HTTP/2, it would only measure how long it waited for one.
+    const auto transferCount = _upload.transfers.size() + _download.transfers.size();
+    if (!_latencyProbeUsedHttp2 && transferCount >= http1ConnectionsPerHost) {
+        qCDebug(lcBandwidthManager) << "Not probing the latency, all connections may be busy with" << transferCount << "transfers";
+        return;
     }
 
-    const auto quotaPerJob = quota / jobCount + 1;
-    for (const auto getFileJob : _downloadJobList) {
-        getFileJob->setBandwidthLimited(true);
-        getFileJob->setChoked(false);
-        getFileJob->giveBandwidthQuota(quotaPerJob);
-
-        qCDebug(lcBandwidthManager) << "Gave" << quotaPerJob / 1024.0 << "kB to" << getFileJob;
-    }
-    _relativeLimitCurrentMeasuredDevice = nullptr;
+    const auto account = _propagator->account();
+    auto job = new SimpleNetworkJob(account, this);
+    job->setTimeout(latencyProbeTimeout.count());
+    QNetworkRequest req;
+    req.setPriority(QNetworkRequest::HighPriority);
+    QElapsedTimer latency;
+    latency.start();
+    _latencyProbeRunning = true;
+    connect(job, &SimpleNetworkJob::finishedSignal, this, [this, job, latency](QNetworkReply *reply) {
+        _latencyProbeRunning = false;
+        // A timeout doesn't tell whether the probe waited for the link or for a connection
+        if (reply->error() != QNetworkReply::NoError) {
+            qCDebug(lcBandwidthManager) << "Latency probe failed" << (job->timedOut() ? QStringLiteral("with a timeout") : reply->errorString());
+            return;
+        }
+        _latencyProbeUsedHttp2 = reply->attribute(QNetworkRequest::Http2WasUsedAttribute).toBool();
+        latencyMeasured(latency.elapsed(), _latencyWindow.restart());
+    });
+    job->startRequest("GET", Utility::concatUrlPath(account->url(), QStringLiteral("status.php")), req);
 }
 
-void BandwidthManager::relativeDownloadDelayTimerExpired()
+void BandwidthManager::latencyMeasured(qint64 latencyMsecs, qint64 windowMsecs)
 {
-    // Switch to measuring state
-    _relativeDownloadMeasuringTimer.start(); // always start to continue the cycle
-
-    if (!usingRelativeDownloadLimit()) {
-        return; // oh, not actually needed
+    if (_baseLatency < 0 || latencyMsecs < _baseLatency || _baseLatencyAge.hasExpired(std::chrono::milliseconds(baseLatencyLifetime).count())) {
+        _baseLatency = latencyMsecs;
+        _baseLatencyAge.start();
     }
+    const auto congested = latencyMsecs - _baseLatency > congestionDelayMsecs;
+    qCDebug(lcBandwidthManager) << "Latency" << latencyMsecs << "ms, base" << _baseLatency << "ms, congested:" << congested;
 
-    if (_downloadJobList.empty()) {
-        qCDebug(lcBandwidthManager) << _downloadJobList.size() << "No jobs?";
-        return;
+    if (usingAdaptiveUploadLimit()) {
+        adaptRate(_upload, congested, windowMsecs, uploadWakeMethod);
     }
+    if (usingAdaptiveDownloadLimit()) {
+        adaptRate(_download, congested, windowMsecs, downloadWakeMethod);
+    }
+    scheduleRefill();
+}
 
-    qCDebug(lcBandwidthManager) << _downloadJobList.size() << "Starting measuring";
-
-    // Take first device and then append it again (= we round robin all devices)
-    _relativeLimitCurrentMeasuredJob = _downloadJobList.front();
-    _downloadJobList.pop_front();
-    _downloadJobList.push_back(_relativeLimitCurrentMeasuredJob);
-
-    _relativeDownloadLimitProgressAtMeasuringRestart = _relativeLimitCurrentMeasuredJob->currentDownloadPosition();
-    _relativeLimitCurrentMeasuredJob->setBandwidthLimited(false);
-    _relativeLimitCurrentMeasuredJob->setChoked(false);
+void BandwidthManager::adaptRate(Shaper &shaper, bool congested, qint64 windowMsecs, const char *wakeMethod)
+{
+    const auto throughput = shaper.transferredBytes * 1000 / qMax(qint64(1), windowMsecs);
+    shaper.transferredBytes = 0;
 
-    // choke all other download jobs
-    for (const auto getFileJob : _downloadJobList) {
-        if (getFileJob == _relativeLimitCurrentMeasuredJob) {
-            continue;
+    if (congested) {
+        // Without our own traffic somebody else is to blame
+        if (throughput == 0) {
+            return;
         }
-
-        getFileJob->setBandwidthLimited(true);
-        getFileJob->setChoked(true);
+        const auto current = shaper.adaptiveRate > 0 ? shaper.adaptiveRate : throughput;
+        shaper.adaptiveRate = qMax(adaptiveMinimumRate, current * 7 / 10);
+    } else if (shaper.adaptiveRate > 0) {
+        shaper.adaptiveRate += qMax(shaper.adaptiveRate / 8, adaptiveMinimumRate);
+        // Once the transfers don't come close to the rate it doesn't limit anything
+        if (throughput > 0 && shaper.adaptiveRate > 4 * throughput) {
+            shaper.adaptiveRate = 0;
+        }
+    } else {
+        return;
     }
 
-    // now we're in measuring state
+    applyLimit(shaper, shaper.limit);
+    wakeWaiting(shaper, wakeMethod);
 }
 
-// end downloads
-
 void BandwidthManager::switchingTimerExpired()
 {
-    const auto newUploadLimit = _propagator->_uploadLimit;
-    if (newUploadLimit != _currentUploadLimit) {
-        qCInfo(lcBandwidthManager) << "Upload Bandwidth limit changed" << _currentUploadLimit << newUploadLimit;
-        _currentUploadLimit = newUploadLimit;
-
-        for (const auto uploadDevice : _relativeUploadDeviceList) {
-            Q_ASSERT(uploadDevice);
-
-            if (usingAbsoluteUploadLimit()) {
-                uploadDevice->setBandwidthLimited(true);
-                uploadDevice->setChoked(false);
-            } else if (usingRelativeUploadLimit()) {
-                uploadDevice->setBandwidthLimited(true);
-                uploadDevice->setChoked(true);
-            } else {
-                uploadDevice->setBandwidthLimited(false);
-                uploadDevice->setChoked(false);
-            }
-        }
+    // A schedule entry covering the current time overrides the configured limit
+    const auto now = QTime::currentTime();
+
+    const qint64 newUploadLimit = _propagator->_uploadLimitSchedule.effectiveLimit(now, _propagator->_uploadLimit);
+    if (newUploadLimit != _upload.limit) {
+        qCInfo(lcBandwidthManager) << "Upload Bandwidth limit changed" << _upload.limit << newUploadLimit;
+        _upload.adaptiveRate = 0;
+        applyLimit(_upload, newUploadLimit);
+        wakeWaiting(_upload, uploadWakeMethod);
     }
 
-    const auto newDownloadLimit = _propagator->_downloadLimit;
-    if (newDownloadLimit != _currentDownloadLimit) {
-        qCInfo(lcBandwidthManager) << "Download Bandwidth limit changed" << _currentDownloadLimit << newDownloadLimit;
-        _currentDownloadLimit = newDownloadLimit;
-
-        for (const auto getJob : _downloadJobList) {
-            Q_ASSERT(getJob);
-
-            if (usingAbsoluteDownloadLimit()) {
-                getJob->setBandwidthLimited(true);
-                getJob->setChoked(false);
-            } else if (usingRelativeDownloadLimit()) {
-                getJob->setBandwidthLimited(true);
-                getJob->setChoked(true);
-            } else {
-                getJob->setBandwidthLimited(false);
-                getJob->setChoked(false);
-            }
-        }
+    const qint64 newDownloadLimit = _propagator->_downloadLimitSchedule.effectiveLimit(now, _propagator->_downloadLimit);
+    if (newDownloadLimit != _download.limit) {
+        qCInfo(lcBandwidthManager) << "Download Bandwidth limit changed" << _download.limit << newDownloadLimit;
+        _download.adaptiveRate = 0;
+        applyLimit(_download, newDownloadLimit);
+        wakeWaiting(_download, downloadWakeMethod);
     }
-}
-
-void BandwidthManager::absoluteLimitTimerExpired()
-{
-    if (usingAbsoluteUploadLimit() && !_absoluteUploadDeviceList.empty()) {
-        const auto quotaPerDevice = _currentUploadLimit / qMax((std::list<UploadDevice *>::size_type)1, _absoluteUploadDeviceList.size());
-
-        qCDebug(lcBandwidthManager) << quotaPerDevice << _absoluteUploadDeviceList.size() << _currentUploadLimit;
 
-        for (const auto device : _absoluteUploadDeviceList) {
-            device->giveBandwidthQuota(quotaPerDevice);
-            qCDebug(lcBandwidthManager) << "Gave " << quotaPerDevice / 1024.0 << " kB to" << device;
+    if (usingRelativeUploadLimit() || usingRelativeDownloadLimit()) {
+        if (!_relativeLimitTimer.isActive()) {
+            // start with measuring the unlimited rate
+            _relativeLimitMeasuring = false;
+            relativeLimitTimerExpired();
         }
+    } else {
+        _relativeLimitTimer.stop();
+        _relativeLimitMeasuring = false;
     }
 
-    if (usingAbsoluteDownloadLimit() && !_downloadJobList.empty()) {
-        const auto quotaPerJob = _currentDownloadLimit / qMax((std::list<GETFileJob *>::size_type)1, _downloadJobList.size());
-
-        qCDebug(lcBandwidthManager) << quotaPerJob << _downloadJobList.size() << _currentDownloadLimit;
-
-        for (const auto job : _downloadJobList) {
-            job->giveBandwidthQuota(quotaPerJob);
-            qCDebug(lcBandwidthManager) << "Gave " << quotaPerJob / 1024.0 << " kB to" << job;
+    if (usingAdaptiveUploadLimit() || usingAdaptiveDownloadLimit()) {
+        if (!_latencyProbeTimer.isActive()) {
+            _latencyWindow.start();
+            _latencyProbeTimer.start();
         }
+    } else {
+        _latencyProbeTimer.stop();
     }
+    scheduleRefill();
 }
 
 } // namespace OCC
@@ -17,31 +17,136 @@
 
 #include <QObject>
 #include <QTimer>
+#include <QElapsedTimer>
 #include <QIODevice>
+
+#include <chrono>
+#include <functional>
 #include <list>
 
+#include "owncloudlib.h"
+#include "bandwidthschedule.h"
+
 namespace OCC {
 
 class UploadDevice;
 class GETFileJob;
 class OwncloudPropagator;
 
+/**
+ * @brief Rate limiter that hands out bytes at a fixed rate
+ *
+ * Tokens are refilled continuously from the elapsed time, up to the
+ * burst capacity. A rate of 0 means unlimited.
+ *
+ * @ingroup libsync
+ */
+class OWNCLOUDSYNC_EXPORT TokenBucket
+{
+public:
+    /// Returns a monotonic time in nanoseconds
+    using Clock = std::function<qint64()>;
+
+    TokenBucket();
+    /// Uses @a clock instead of the steady clock, for tests
+    explicit TokenBucket(Clock clock);
+
+    /// Sets the rate in bytes per second; the burst capacity follows from it
+    void setRate(qint64 bytesPerSecond);
+    [[nodiscard]] qint64 rate() const { return _rate; }
+    [[nodiscard]] qint64 capacity() const { return _capacity; }
+
+    /**
+     * Takes up to @a wanted bytes if at least @a minimum of them are
+     * available. Returns how many bytes may be transferred now.
+     */
+    qint64 take(qint64 wanted, qint64 minimum = 1);
+
+    /// Bytes that may be taken right now
+    qint64 available();
+
+    /// Milliseconds until @a amount bytes are available
+    qint64 msecsUntilAvailable(qint64 amount);
+
+private:
+    void refill();
+
+    qint64 _rate = 0;
+    qint64 _capacity = 0;
+    double _tokens = 0;
+    Clock _clock;
+    qint64 _lastRefillNsecs = -1;
+};
+
 /**
  * @brief The BandwidthManager class
+ *
+ * All upload devices share one token bucket and all download jobs share
+ * another, so a limit holds no matter how many transfers run in parallel.
+ * A transfer that runs out of tokens waits in line and gets woken up once
+ * its fair share has been refilled.
+ *
+ * Relative limits (negative values, in percent) are applied by measuring
+ * the unlimited throughput for a short window now and then and limiting
+ * the rate in between. Uploads are measured from the upload progress,
+ * as the bytes read from the devices mostly end up in Qt's buffers.
+ *
+ * The adaptive limit probes the latency to the server while transfers run.
+ * When it rises above the lowest latency seen, the transfers are what
+ * fills the queues on the way, so the rate backs off; otherwise it grows
+ * again until the limit isn't needed anymore. While the transfers may take
+ * up every HTTP/1.1 connection to the server, there is no probe, it would
+ * only measure the wait for a connection.
+ *
+ * The limits of the propagator, and the schedules overriding them, are
+ * reevaluated periodically, so they change without restarting the sync.
+ *
  * @ingroup libsync
  */
-class BandwidthManager : public QObject
+class OWNCLOUDSYNC_EXPORT BandwidthManager : public QObject
 {
     Q_OBJECT
 public:
     BandwidthManager(OwncloudPropagator *p);
     ~BandwidthManager() override;
 
-    bool usingAbsoluteUploadLimit() { return _currentUploadLimit > 0; }
-    bool usingRelativeUploadLimit() { return _currentUploadLimit < 0; }
-    bool usingAbsoluteDownloadLimit() { return _currentDownloadLimit > 0; }
-    bool usingRelativeDownloadLimit() { return _currentDownloadLimit < 0; }
-
+    /// How long relative limits measure the unlimited throughput
+    static std::chrono::milliseconds relativeLimitMeasuringInterval;
+    /// How long the rate derived from a measurement is applied
+    static std::chrono::milliseconds relativeLimitLimitingInterval;
+    /// How often the latency to the server is probed for adaptive limits
+    static std::chrono::milliseconds latencyProbeInterval;
+    /// How long a latency probe may take, a slower one gives no sample
+    static std::chrono::milliseconds latencyProbeTimeout;
+
+    bool usingAbsoluteUploadLimit() { return _upload.limit > 0; }
+    bool usingRelativeUploadLimit() { return _upload.limit < 0 && !usingAdaptiveUploadLimit(); }
+    bool usingAdaptiveUploadLimit() { return _upload.limit == BandwidthSchedule::AdaptiveLimit; }
+    bool usingAbsoluteDownloadLimit() { return _download.limit > 0; }
+    bool usingRelativeDownloadLimit() { return _download.limit < 0 && !usingAdaptiveDownloadLimit(); }
+    bool usingAdaptiveDownloadLimit() { return _download.limit == BandwidthSchedule::AdaptiveLimit; }
+
+    /**
+     * Takes up to @a wanted bytes of upload quota for @a device.
+     *
+     * Returns 0 if the bucket is empty; the device then emits readyRead()
+     * once it may continue.
+     */
+    qint64 takeUploadQuota(OCC::UploadDevice *device, qint64 wanted);
+
+    /**
+     * Takes up to @a wanted bytes of download quota for @a job.
+     *
+     * Returns 0 if the bucket is empty; the job's reply is read again
+     * once it may continue.
+     */
+    qint64 takeDownloadQuota(OCC::GETFileJob *job, qint64 wanted);
+
+    /// @a bytes more of an upload were sent to the server
+    void uploadProgressed(qint64 bytes);
+
+    [[nodiscard]] qint64 uploadRate() const { return _upload.bucket.rate(); } // for the test
+    [[nodiscard]] qint64 downloadRate() const { return _download.bucket.rate(); } // for the test
 
 public slots:
     void registerUploadDevice(OCC::UploadDevice *);
@@ -50,16 +155,43 @@ public slots:
     void registerDownloadJob(OCC::GETFileJob *);
     void unregisterDownloadJob(QObject *);
 
-    void absoluteLimitTimerExpired();
     void switchingTimerExpired();
 
-    void relativeUploadMeasuringTimerExpired();
-    void relativeUploadDelayTimerExpired();
-
-    void relativeDownloadMeasuringTimerExpired();
-    void relativeDownloadDelayTimerExpired();
+private slots:
+    void refillTimerExpired();
+    void relativeLimitTimerExpired();
+    void latencyProbeTimerExpired();
 
 private:
+    // One direction: its bucket, the transfers sharing it and those waiting for tokens
+    struct Shaper
+    {
+        TokenBucket bucket;
+        qint64 limit = 0; // > 0: bytes per second, < 0: percent of the measured rate or adaptive
+        std::list<QObject *> transfers;
+        std::list<QObject *> waiting;
+
+        // bytes transferred since the last relative measurement or latency probe
+        qint64 transferredBytes = 0;
+
+        // relative limiting
+        qint64 measuredRate = 0;
+
+        // adaptive limiting, 0 while unlimited
+        qint64 adaptiveRate = 0;
+    };
+
+    qint64 takeQuota(Shaper &shaper, QObject *transfer, qint64 wanted);
+    void applyLimit(Shaper &shaper, qint64 limit);
+    void wakeWaiting(Shaper &shaper, const char *wakeMethod);
+    void unregisterTransfer(Shaper &shaper, QObject *transfer);
+    void scheduleRefill();
+    void latencyMeasured(qint64 latencyMsecs, qint64 windowMsecs);
+    void adaptRate(Shaper &shaper, bool congested, qint64 windowMsecs, const char *wakeMethod);
+
+    Shaper _upload;
+    Shaper _download;
+
     // for switching between absolute and relative bw limiting
     QTimer _switchingTimer;
 
@@ -67,38 +199,21 @@ private:
     // by the propagator emitting the changed limit values to us as signal
     OwncloudPropagator *_propagator;
 
-    // for absolute up/down bw limiting
-    QTimer _absoluteLimitTimer;
-
-    // FIXME merge these two lists
-    std::list<UploadDevice *> _absoluteUploadDeviceList;
-    std::list<UploadDevice *> _relativeUploadDeviceList;
-
-    QTimer _relativeUploadMeasuringTimer;
-
-    // for relative bw limiting, we need to wait this amount before measuring again
-    QTimer _relativeUploadDelayTimer;
-
-    // the device measured
-    UploadDevice *_relativeLimitCurrentMeasuredDevice = nullptr;
-
-    // for measuring how much progress we made at start
-    qint64 _relativeUploadLimitProgressAtMeasuringRestart = 0;
-    qint64 _currentUploadLimit = 0;
-
-    std::list<GETFileJob *> _downloadJobList;
-    QTimer _relativeDownloadMeasuringTimer;
-
-    // for relative bw limiting, we need to wait this amount before measuring again
-    QTimer _relativeDownloadDelayTimer;
-
-    // the device measured
-    GETFileJob *_relativeLimitCurrentMeasuredJob = nullptr;
-
-    // for measuring how much progress we made at start
-    qint64 _relativeDownloadLimitProgressAtMeasuringRestart = 0LL;
-
-    qint64 _currentDownloadLimit = 0;
+    // wakes waiting transfers once the buckets have been refilled
+    QTimer _refillTimer;
+
+    // alternates between measuring and limiting for relative limits
+    QTimer _relativeLimitTimer;
+    bool _relativeLimitMeasuring = false;
+
+    // for adaptive limits
+    QTimer _latencyProbeTimer;
+    QElapsedTimer _latencyWindow;
+    bool _latencyProbeRunning = false;
+    // whether the last probe shared a multiplexed connection with the transfers
+    bool _latencyProbeUsedHttp2 = false;
+    qint64 _baseLatency = -1;
+    QElapsedTimer _baseLatencyAge;
 };
 
 } // namespace OCC
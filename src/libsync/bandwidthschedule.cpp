@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) by Nextcloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "bandwidthschedule.h"
+
+#include <QLoggingCategory>
+#include <QStringList>
+
+#include <limits>
+
+namespace OCC {
+
+Q_LOGGING_CATEGORY(lcBandwidthSchedule, "nextcloud.sync.bandwidthschedule", QtInfoMsg)
+
+namespace {
+
+const auto timeFormat = QStringLiteral("HH:mm");
+const auto adaptiveValue = QStringLiteral("adaptive");
+
+std::optional<int> parseLimit(const QString &value)
+{
+    if (value == adaptiveValue) {
+        return BandwidthSchedule::AdaptiveLimit;
+    }
+    auto ok = false;
+    if (value.endsWith(QLatin1Char('%'))) {
+        const auto percent = value.chopped(1).toInt(&ok);
+        if (!ok || percent < BandwidthSchedule::MinimumRelativeLimit || percent > BandwidthSchedule::MaximumRelativeLimit) {
+            return {};
+        }
+        return -percent;
+    }
+    const auto kbytes = value.toLongLong(&ok);
+    if (!ok || kbytes < 0 || kbytes > std::numeric_limits<int>::max() / 1000) {
+        return {};
+    }
+    return static_cast<int>(kbytes * 1000);
+}
+
+QString limitToString(int limit)
+{
+    if (limit == BandwidthSchedule::AdaptiveLimit) {
+        return adaptiveValue;
+    }
+    if (limit < 0) {
+        return QString::number(-limit) + QLatin1Char('%');
+    }
+    return QString::number(limit / 1000);
+}
+
+}
+
+BandwidthSchedule BandwidthSchedule::fromString(const QString &schedule)
+{
+    BandwidthSchedule result;
+    const auto entries = schedule.split(QLatin1Char(','), Qt::SkipEmptyParts);
+    for (const auto &entryString : entries) {
+        const auto rangeAndLimit = entryString.trimmed().split(QLatin1Char('='));
+        const auto range = rangeAndLimit.first().split(QLatin1Char('-'));
+        if (rangeAndLimit.size() != 2 || range.size() != 2) {
+            qCWarning(lcBandwidthSchedule) << "Ignoring malformed schedule entry" << entryString;
+            continue;
+        }
+
+        Entry entry;
+        entry.start = QTime::fromString(range.at(0).trimmed(), timeFormat);
+        entry.end = QTime::fromString(range.at(1).trimmed(), timeFormat);
+        const auto limit = parseLimit(rangeAndLimit.at(1).trimmed().toLower());
+        if (!entry.start.isValid() || !entry.end.isValid() || !limit) {
+            qCWarning(lcBandwidthSchedule) << "Ignoring malformed schedule entry" << entryString;
+            continue;
+        }
+        entry.limit = *limit;
+        result._entries.append(entry);
+    }
+    return result;
+}
+
+QString BandwidthSchedule::toString() const
+{
+    QStringList entries;
+    for (const auto &entry : _entries) {
+        entries.append(entry.start.toString(timeFormat) + QLatin1Char('-') + entry.end.toString(timeFormat)
+            + QLatin1Char('=') + limitToString(entry.limit));
+    }
+    return entries.join(QLatin1Char(','));
+}
+
+std::optional<int> BandwidthSchedule::limitAt(const QTime &time) const
+{
+    for (const auto &entry : _entries) {
+        const auto covered = entry.start < entry.end
+            ? time >= entry.start && time < entry.end
+            : time >= entry.start || time < entry.end; // wraps around midnight
+        if (covered) {
+            return entry.limit;
+        }
+    }
+    return {};
+}
+
+int BandwidthSchedule::effectiveLimit(const QTime &time, int staticLimit) const
+{
+    return limitAt(time).value_or(staticLimit);
+}
+
+}
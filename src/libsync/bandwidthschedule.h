@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) by Nextcloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#pragma once
+
+#include <QString>
+#include <QTime>
+#include <QVector>
+
+#include <optional>
+
+#include "owncloudlib.h"
+
+namespace OCC {
+
+/**
+ * @brief Bandwidth limits that depend on the time of day
+ *
+ * A schedule is written as comma separated entries of the form
+ * "09:00-17:00=10000". The value after the equals sign is one of:
+ *  - a limit in kB/s, where 0 means unlimited
+ *  - a percentage like "75%", for the measured relative limit; the
+ *    relative limiting supports 10% to 90% only, other percentages
+ *    are rejected
+ *  - "adaptive", to back off when the latency to the server rises
+ *
+ * An entry whose end is not after its start wraps around midnight. The
+ * first matching entry wins; outside of all entries the static limit
+ * applies.
+ *
+ * Limits use the units of SyncEngine::setNetworkLimits(): bytes per
+ * second when positive, percent when negative, and
+ * BandwidthSchedule::AdaptiveLimit for the adaptive mode.
+ *
+ * @ingroup libsync
+ */
+class OWNCLOUDSYNC_EXPORT BandwidthSchedule
+{
+public:
+    /// Limit value that follows the server's latency instead of a fixed rate
+    static constexpr int AdaptiveLimit = -1000;
+
+    /// Range of percentages that relative limits can hold the throughput to
+    static constexpr int MinimumRelativeLimit = 10;
+    static constexpr int MaximumRelativeLimit = 90;
+
+    struct Entry
+    {
+        QTime start;
+        QTime end;
+        int limit = 0;
+    };
+
+    /// Parses @a schedule; entries that can't be parsed are skipped with a warning
+    static BandwidthSchedule fromString(const QString &schedule);
+    [[nodiscard]] QString toString() const;
+
+    [[nodiscard]] bool isEmpty() const { return _entries.isEmpty(); }
+    [[nodiscard]] const QVector<Entry> &entries() const { return _entries; }
+
+    /// The limit of the first entry covering @a time, if there is one
+    [[nodiscard]] std::optional<int> limitAt(const QTime &time) const;
+
+    /// The scheduled limit at @a time, or @a staticLimit outside of all entries
+    [[nodiscard]] int effectiveLimit(const QTime &time, int staticLimit) const;
+
+private:
+    QVector<Entry> _entries;
+};
+
+}
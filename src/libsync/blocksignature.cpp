@@ -0,0 +1,191 @@
+/*
+ * Copyright (C) by Nextcloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "blocksignature.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QFile>
+#include <QHash>
+#include <QLoggingCategory>
+
+#include <array>
+
+namespace OCC {
+
+Q_LOGGING_CATEGORY(lcBlockSignature, "nextcloud.sync.blocksignature", QtInfoMsg)
+
+namespace {
+    constexpr quint8 serializationVersion = 2;
+    constexpr auto hashAlgorithm = QCryptographicHash::Sha256;
+    constexpr int hashLength = 32;
+
+    // The gear table must never change: it defines the cut points of the
+    // signatures stored in the journal.
+    constexpr std::array<quint64, 256> makeGearTable()
+    {
+        std::array<quint64, 256> table = {};
+        quint64 state = 0x6e657874636c6f75; // splitmix64
+        for (auto &entry : table) {
+            state += 0x9e3779b97f4a7c15;
+            auto z = state;
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+            entry = z ^ (z >> 31);
+        }
+        return table;
+    }
+
+    constexpr auto gearTable = makeGearTable();
+
+    // Keeps maxBlockSize << shift and the cut mask far from overflowing
+    constexpr int maxBlockSizeShift = 20;
+}
+
+int BlockSignature::blockSizeShiftForSize(qint64 fileSize)
+{
+    // All blocks but the last one are at least as big as the minimum block size
+    int shift = 0;
+    while (shift < maxBlockSizeShift && (minBlockSize << shift) * maxBlockCount <= fileSize) {
+        ++shift;
+    }
+    return shift;
+}
+
+BlockSignature BlockSignature::compute(QIODevice *device, int blockSizeShift)
+{
+    Q_ASSERT(blockSizeShift >= 0 && blockSizeShift <= maxBlockSizeShift);
+    const auto scaledMinBlockSize = minBlockSize << blockSizeShift;
+    const auto scaledMaxBlockSize = maxBlockSize << blockSizeShift;
+    const auto cutMask = (quint64(1) << (cutBits + blockSizeShift)) - 1;
+
+    BlockSignature result;
+    result._blockSizeShift = blockSizeShift;
+    QCryptographicHash hash(hashAlgorithm);
+    QByteArray buffer(1024 * 1024, Qt::Uninitialized);
+
+    qint64 offset = 0;
+    qint64 blockStart = 0;
+    quint64 gear = 0;
+    while (true) {
+        const auto read = device->read(buffer.data(), buffer.size());
+        if (read < 0) {
+            qCWarning(lcBlockSignature) << "Could not read" << device << device->errorString();
+            return {};
+        }
+        if (read == 0) {
+            break;
+        }
+
+        const auto data = reinterpret_cast<const uchar *>(buffer.constData());
+        qint64 segmentStart = 0;
+        for (qint64 i = 0; i < read; ++i) {
+            gear = (gear << 1) + gearTable[data[i]];
+            const auto blockSize = offset + i + 1 - blockStart;
+            if (blockSize < scaledMinBlockSize || ((gear & cutMask) != 0 && blockSize < scaledMaxBlockSize)) {
+                continue;
+            }
+            hash.addData(buffer.constData() + segmentStart, static_cast<int>(i + 1 - segmentStart));
+            result._blocks.append({ blockStart, blockSize, hash.result() });
+            hash.reset();
+            blockStart += blockSize;
+            segmentStart = i + 1;
+            gear = 0;
+        }
+        hash.addData(buffer.constData() + segmentStart, static_cast<int>(read - segmentStart));
+        offset += read;
+    }
+    if (offset > blockStart) {
+        result._blocks.append({ blockStart, offset - blockStart, hash.result() });
+    }
+
+    result._valid = true;
+    return result;
+}
+
+BlockSignature BlockSignature::computeForFile(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qCWarning(lcBlockSignature) << "Could not open" << path << file.errorString();
+        return {};
+    }
+    return compute(&file, blockSizeShiftForSize(file.size()));
+}
+
+QByteArray BlockSignature::serialize() const
+{
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream << serializationVersion << static_cast<quint8>(_blockSizeShift) << static_cast<quint32>(_blocks.size());
+    for (const auto &block : _blocks) {
+        stream << block.size;
+        stream.writeRawData(block.hash.constData(), block.hash.size());
+    }
+    return data;
+}
+
+BlockSignature BlockSignature::deserialize(const QByteArray &data)
+{
+    QDataStream stream(data);
+    quint8 version = 0;
+    quint8 blockSizeShift = 0;
+    quint32 count = 0;
+    stream >> version >> blockSizeShift >> count;
+    if (stream.status() != QDataStream::Ok || version != serializationVersion || blockSizeShift > maxBlockSizeShift) {
+        return {};
+    }
+
+    BlockSignature result;
+    result._blockSizeShift = blockSizeShift;
+    qint64 offset = 0;
+    for (quint32 i = 0; i < count; ++i) {
+        Block block;
+        block.offset = offset;
+        stream >> block.size;
+        block.hash.resize(hashLength);
+        if (stream.readRawData(block.hash.data(), hashLength) != hashLength
+            || stream.status() != QDataStream::Ok || block.size <= 0) {
+            return {};
+        }
+        offset += block.size;
+        result._blocks.append(block);
+    }
+    result._valid = true;
+    return result;
+}
+
+qint64 BlockSignature::size() const
+{
+    return _blocks.isEmpty() ? 0 : _blocks.last().offset + _blocks.last().size;
+}
+
+QVector<int> BlockSignature::matchBlocks(const BlockSignature &previous) const
+{
+    QHash<QByteArray, int> previousBlocks;
+    previousBlocks.reserve(previous._blocks.size());
+    for (int i = previous._blocks.size() - 1; i >= 0; --i) {
+        previousBlocks.insert(previous._blocks[i].hash, i);
+    }
+
+    QVector<int> matches;
+    matches.reserve(_blocks.size());
+    for (const auto &block : _blocks) {
+        const auto it = previousBlocks.constFind(block.hash);
+        matches.append(it != previousBlocks.constEnd() && previous._blocks[*it].size == block.size ? *it : -1);
+    }
+    return matches;
+}
+
+}
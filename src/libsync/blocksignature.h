@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) by Nextcloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#pragma once
+
+#include "owncloudlib.h"
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+class QIODevice;
+
+namespace OCC {
+
+/**
+ * @brief Content-defined block boundaries and block hashes of a file
+ *
+ * The file is cut where a rolling gear hash over the last bytes matches a
+ * bit pattern, bounded by minBlockSize and maxBlockSize. Since the cut points
+ * only depend on the surrounding content, inserting or removing bytes only
+ * changes the blocks around the modification and the following blocks keep
+ * their hashes.
+ *
+ * Used by PropagateUploadFileNG to upload only the changed blocks of a large
+ * file, see Capabilities::deltaChunking().
+ *
+ * @ingroup libsync
+ */
+class OWNCLOUDSYNC_EXPORT BlockSignature
+{
+public:
+    struct Block
+    {
+        qint64 offset = 0;
+        qint64 size = 0;
+        QByteArray hash;
+    };
+
+    // Block sizes for files smaller than maxBlockCount * minBlockSize (5 GB).
+    // For larger files all of them are scaled up by 2^blockSizeShift.
+    static constexpr qint64 minBlockSize = 512 * 1024;
+    static constexpr qint64 maxBlockSize = 8 * 1024 * 1024;
+    // a cut point is found about every 2 MiB after minBlockSize
+    static constexpr int cutBits = 21;
+
+    // Every block is uploaded as one chunk, and chunking-ng accepts at most 10000 chunks
+    static constexpr qint64 maxBlockCount = 10000;
+
+    /** The smallest block size scale that cuts a file of this size into at most maxBlockCount blocks */
+    static int blockSizeShiftForSize(qint64 fileSize);
+
+    /** Reads the device from its current position to the end.
+     *
+     * Returns an invalid signature if reading failed.
+     */
+    static BlockSignature compute(QIODevice *device, int blockSizeShift = 0);
+
+    /** Opens and reads the file at path with the block sizes scaled for its size,
+     * see compute(QIODevice *, int)
+     */
+    static BlockSignature computeForFile(const QString &path);
+
+    /** Parses the output of serialize(), returns an invalid signature on corrupt data */
+    static BlockSignature deserialize(const QByteArray &data);
+
+    [[nodiscard]] QByteArray serialize() const;
+
+    [[nodiscard]] bool isValid() const { return _valid; }
+    [[nodiscard]] const QVector<Block> &blocks() const { return _blocks; }
+    [[nodiscard]] qint64 size() const;
+    [[nodiscard]] int blockSizeShift() const { return _blockSizeShift; }
+
+    /** For each block, the index of a block with the same contents in previous, or -1 */
+    [[nodiscard]] QVector<int> matchBlocks(const BlockSignature &previous) const;
+
+private:
+    QVector<Block> _blocks;
+    int _blockSizeShift = 0;
+    bool _valid = false;
+};
+
+}
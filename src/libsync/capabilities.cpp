@@ -240,6 +240,16 @@ bool Capabilities::bulkUpload() const
     return _capabilities["dav"].toMap()["bulkupload"].toByteArray() >= "1.0";
 }
 
+bool Capabilities::deltaChunking() const
+{
+    return chunkingNg() && _capabilities["dav"].toMap()["delta_chunking"].toByteArray() >= "1.0";
+}
+
+bool Capabilities::propfindDepthInfinity() const
+{
+    return _capabilities["dav"].toMap()["propfind"].toMap()["depth_infinity"].toBool();
+}
+
 bool Capabilities::filesLockAvailable() const
 {
     return _capabilities["files"].toMap()["locking"].toByteArray() >= "1.0";
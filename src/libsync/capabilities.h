@@ -65,6 +65,21 @@ public:
     [[nodiscard]] int shareDefaultPermissions() const;
     [[nodiscard]] bool chunkingNg() const;
     [[nodiscard]] bool bulkUpload() const;
+
+    /** Whether the server keeps the chunks of finished chunked uploads and
+     * accepts COPY of such chunks into a new upload, see PropagateUploadFileNG.
+     *
+     * The kept chunks take as much space as the file itself. The client keeps
+     * at most one finished upload per file in the journal and deletes it when
+     * a new version was uploaded or the file leaves the journal. The server may
+     * expire kept uploads like unfinished ones; the next upload then sends all
+     * blocks again.
+     */
+    [[nodiscard]] bool deltaChunking() const;
+    /** Whether the server answers PROPFIND requests with "Depth: infinity",
+     * see DiscoverySingleDirectoryJob::setFetchSubtree().
+     */
+    [[nodiscard]] bool propfindDepthInfinity() const;
     [[nodiscard]] bool filesLockAvailable() const;
     [[nodiscard]] bool userStatus() const;
     [[nodiscard]] bool userStatusSupportsEmoji() const;
@@ -546,8 +546,8 @@ QByteArray extractPrivateKeySalt(const QByteArray &data)
 }
 
 QByteArray decryptStringSymmetric(const QByteArray& key, const QByteArray& data) {
-    qCInfo(lcCse()) << "decryptStringSymmetric key: " << key;
-    qCInfo(lcCse()) << "decryptStringSymmetric data: " << data;
+    qCDebug(lcCse()) << "decryptStringSymmetric key: " << key;
+    qCDebug(lcCse()) << "decryptStringSymmetric data: " << data;
 
     const auto parts = splitCipherParts(data);
     if (parts.size() < 2) {
@@ -558,8 +558,8 @@ QByteArray decryptStringSymmetric(const QByteArray& key, const QByteArray& data)
     QByteArray cipherTXT64 = parts.at(0);
     QByteArray ivB64 = parts.at(1);
 
-    qCInfo(lcCse()) << "decryptStringSymmetric cipherTXT: " << cipherTXT64;
-    qCInfo(lcCse()) << "decryptStringSymmetric IV: " << ivB64;
+    qCDebug(lcCse()) << "decryptStringSymmetric cipherTXT: " << cipherTXT64;
+    qCDebug(lcCse()) << "decryptStringSymmetric IV: " << ivB64;
 
     QByteArray cipherTXT = QByteArray::fromBase64(cipherTXT64);
     QByteArray iv = QByteArray::fromBase64(ivB64);
@@ -95,6 +95,7 @@ bool StoreMetaDataApiJob::finished()
 		if (retCode != 200) {
 			qCInfo(lcCseJob()) << "error sending the metadata" << path() << errorString() << retCode;
 			emit error(_fileId, retCode);
+			return true;
 		}
 
 		qCInfo(lcCseJob()) << "Metadata submited to the server successfully";
@@ -146,6 +147,7 @@ bool UpdateMetadataApiJob::finished()
 		if (retCode != 200) {
 			qCInfo(lcCseJob()) << "error updating the metadata" << path() << errorString() << retCode;
 			emit error(_fileId, retCode);
+			return true;
 		}
 
 		qCInfo(lcCseJob()) << "Metadata submited to the server successfully";
@@ -36,6 +36,7 @@
 #include <QFile>
 #include <QFileInfo>
 #include <QLoggingCategory>
+#include <QMutex>
 #include <QSettings>
 #include <QNetworkProxy>
 #include <QStandardPaths>
@@ -96,6 +97,8 @@ static constexpr char useUploadLimitC[] = "BWLimit/useUploadLimit";
 static constexpr char useDownloadLimitC[] = "BWLimit/useDownloadLimit";
 static constexpr char uploadLimitC[] = "BWLimit/uploadLimit";
 static constexpr char downloadLimitC[] = "BWLimit/downloadLimit";
+static constexpr char uploadLimitScheduleC[] = "BWLimit/uploadLimitSchedule";
+static constexpr char downloadLimitScheduleC[] = "BWLimit/downloadLimitSchedule";
 
 static constexpr char newBigFolderSizeLimitC[] = "newBigFolderSizeLimit";
 static constexpr char useNewBigFolderSizeLimitC[] = "useNewBigFolderSizeLimit";
@@ -119,12 +122,58 @@ Q_LOGGING_CATEGORY(lcConfigFile, "nextcloud.sync.configfile", QtInfoMsg)
 QString ConfigFile::_confDir = {};
 QString ConfigFile::_discoveredLegacyConfigPath = {};
 
-static chrono::milliseconds millisecondsValue(const QSettings &setting, const char *key,
-    chrono::milliseconds defaultValue)
+static QString groupKey(const QString &group, const QString &key)
 {
-    return chrono::milliseconds(setting.value(QLatin1String(key), qlonglong(defaultValue.count())).toLongLong());
+    return group.isEmpty() ? key : group + QLatin1Char('/') + key;
 }
 
+/** The parsed contents of the config file, shared by all ConfigFile instances.
+ *
+ * The file is only parsed again after the contents were dropped: by ConfigFile
+ * writes, by QSettings from settingsWithGroup() going away, when the config
+ * directory changes and by ConfigFile::reloadSettings().
+ */
+struct ConfigFileCache
+{
+    QMutex mutex;
+    // Empty while the contents need to be loaded
+    QString fileName;
+    QHash<QString, QVariant> values;
+
+    // The system-wide settings are never written by the client, they are read once
+    bool systemValuesLoaded = false;
+    QHash<QString, QVariant> systemValues;
+
+    void invalidate() { fileName.clear(); }
+};
+Q_GLOBAL_STATIC(ConfigFileCache, g_configFileCache)
+
+static void loadSettings(const QSettings &settings, QHash<QString, QVariant> &values)
+{
+    values.clear();
+    const auto keys = settings.allKeys();
+    for (const auto &key : keys) {
+        values.insert(key, settings.value(key));
+    }
+}
+
+/** A QSettings for the config file that drops the cached contents once its own writes are on disk
+ */
+class ConfigFileSettings : public QSettings
+{
+public:
+    ConfigFileSettings(const QString &fileName, QObject *parent)
+        : QSettings(fileName, QSettings::IniFormat, parent)
+    {
+    }
+
+    ~ConfigFileSettings() override
+    {
+        sync();
+        ConfigFile::reloadSettings();
+    }
+};
+
 bool copy_dir_recursive(QString from_dir, QString to_dir)
 {
     QDir dir;
@@ -164,12 +213,6 @@ ConfigFile::ConfigFile()
     qApp->setApplicationName(Theme::instance()->appNameGUI());
 
     QSettings::setDefaultFormat(QSettings::IniFormat);
-
-    const QString config = configFile();
-
-
-    QSettings settings(config, QSettings::IniFormat);
-    settings.beginGroup(defaultConnection());
 }
 
 bool ConfigFile::setConfDir(const QString &value)
@@ -187,6 +230,7 @@ bool ConfigFile::setConfDir(const QString &value)
         dirPath = fi.absoluteFilePath();
         qCInfo(lcConfigFile) << "Using custom config dir " << dirPath;
         _confDir = dirPath;
+        reloadSettings();
         return true;
     }
     return false;
@@ -194,21 +238,17 @@ bool ConfigFile::setConfDir(const QString &value)
 
 bool ConfigFile::optionalServerNotifications() const
 {
-    QSettings settings(configFile(), QSettings::IniFormat);
-    return settings.value(QLatin1String(optionalServerNotificationsC), true).toBool();
+    return cachedValue(QLatin1String(optionalServerNotificationsC), true).toBool();
 }
 
 bool ConfigFile::showCallNotifications() const
 {
-    const QSettings settings(configFile(), QSettings::IniFormat);
-    return settings.value(QLatin1String(showCallNotificationsC), true).toBool() && optionalServerNotifications();
+    return cachedValue(QLatin1String(showCallNotificationsC), true).toBool() && optionalServerNotifications();
 }
 
 void ConfigFile::setShowCallNotifications(bool show)
 {
-    QSettings settings(configFile(), QSettings::IniFormat);
-    settings.setValue(QLatin1String(showCallNotificationsC), show);
-    settings.sync();
+    storeValue(QLatin1String(showCallNotificationsC), show);
 }
 
 bool ConfigFile::showInExplorerNavigationPane() const
@@ -224,62 +264,49 @@ bool ConfigFile::showInExplorerNavigationPane() const
         false
 #endif
         ;
-    QSettings settings(configFile(), QSettings::IniFormat);
-    return settings.value(QLatin1String(showInExplorerNavigationPaneC), defaultValue).toBool();
+    return cachedValue(QLatin1String(showInExplorerNavigationPaneC), defaultValue).toBool();
 }
 
 void ConfigFile::setShowInExplorerNavigationPane(bool show)
 {
-    QSettings settings(configFile(), QSettings::IniFormat);
-    settings.setValue(QLatin1String(showInExplorerNavigationPaneC), show);
-    settings.sync();
+    storeValue(QLatin1String(showInExplorerNavigationPaneC), show);
 }
 
 int ConfigFile::timeout() const
 {
-    QSettings settings(configFile(), QSettings::IniFormat);
-    return settings.value(QLatin1String(timeoutC), 300).toInt(); // default to 5 min
+    return cachedValue(QLatin1String(timeoutC), 300).toInt(); // default to 5 min
 }
 
 qint64 ConfigFile::chunkSize() const
 {
-    QSettings settings(configFile(), QSettings::IniFormat);
-    return settings.value(QLatin1String(chunkSizeC), 10 * 1000 * 1000).toLongLong(); // default to 10 MB
+    return cachedValue(QLatin1String(chunkSizeC), 10 * 1000 * 1000).toLongLong(); // default to 10 MB
 }
 
 qint64 ConfigFile::maxChunkSize() const
 {
-    QSettings settings(configFile(), QSettings::IniFormat);
-    return settings.value(QLatin1String(maxChunkSizeC), 1000 * 1000 * 1000).toLongLong(); // default to 1000 MB
+    return cachedValue(QLatin1String(maxChunkSizeC), 1000 * 1000 * 1000).toLongLong(); // default to 1000 MB
 }
 
 qint64 ConfigFile::minChunkSize() const
 {
-    QSettings settings(configFile(), QSettings::IniFormat);
-    return settings.value(QLatin1String(minChunkSizeC), 1000 * 1000).toLongLong(); // default to 1 MB
+    return cachedValue(QLatin1String(minChunkSizeC), 1000 * 1000).toLongLong(); // default to 1 MB
 }
 
 chrono::milliseconds ConfigFile::targetChunkUploadDuration() const
 {
-    QSettings settings(configFile(), QSettings::IniFormat);
-    return millisecondsValue(settings, targetChunkUploadDurationC, chrono::minutes(1));
+    return millisecondsValue(QLatin1String(targetChunkUploadDurationC), chrono::minutes(1));
 }
 
 void ConfigFile::setOptionalServerNotifications(bool show)
 {
-    QSettings settings(configFile(), QSettings::IniFormat);
-    settings.setValue(QLatin1String(optionalServerNotificationsC), show);
-    settings.sync();
+    storeValue(QLatin1String(optionalServerNotificationsC), show);
 }
 
 void ConfigFile::saveGeometry(QWidget *w)
 {
 #ifndef TOKEN_AUTH_ONLY
     ASSERT(!w->objectName().isNull());
-    QSettings settings(configFile(), QSettings::IniFormat);
-    settings.beginGroup(w->objectName());
-    settings.setValue(QLatin1String(geometryC), w->saveGeometry());
-    settings.sync();
+    storeValue(groupKey(w->objectName(), QLatin1String(geometryC)), w->saveGeometry());
 #endif
 }
 
@@ -297,10 +324,7 @@ void ConfigFile::saveGeometryHeader(QHeaderView *header)
         return;
     ASSERT(!header->objectName().isEmpty());
 
-    QSettings settings(configFile(), QSettings::IniFormat);
-    settings.beginGroup(header->objectName());
-    settings.setValue(QLatin1String(geometryC), header->saveState());
-    settings.sync();
+    storeValue(groupKey(header->objectName(), QLatin1String(geometryC)), header->saveState());
 #endif
 }
 
@@ -311,9 +335,7 @@ void ConfigFile::restoreGeometryHeader(QHeaderView *header)
         return;
     ASSERT(!header->objectName().isNull());
 
-    QSettings settings(configFile(), QSettings::IniFormat);
-    settings.beginGroup(header->objectName());
-    header->restoreState(settings.value(geometryC).toByteArray());
+    header->restoreState(cachedValue(groupKey(header->objectName(), QLatin1String(geometryC))).toByteArray());
 #endif
 }
 
@@ -486,38 +508,25 @@ QString ConfigFile::defaultConnection() const
 void ConfigFile::storeData(const QString &group, const QString &key, const QVariant &value)
 {
     const QString con(group.isEmpty() ? defaultConnection() : group);
-    QSettings settings(configFile(), QSettings::IniFormat);
-
-    settings.beginGroup(con);
-    settings.setValue(key, value);
-    settings.sync();
+    storeValue(groupKey(con, key), value);
 }
 
 QVariant ConfigFile::retrieveData(const QString &group, const QString &key) const
 {
     const QString con(group.isEmpty() ? defaultConnection() : group);
-    QSettings settings(configFile(), QSettings::IniFormat);
-
-    settings.beginGroup(con);
-    return settings.value(key);
+    return cachedValue(groupKey(con, key));
 }
 
 void ConfigFile::removeData(const QString &group, const QString &key)
 {
     const QString con(group.isEmpty() ? defaultConnection() : group);
-    QSettings settings(configFile(), QSettings::IniFormat);
-
-    settings.beginGroup(con);
-    settings.remove(key);
+    removeValue(groupKey(con, key));
 }
 
 bool ConfigFile::dataExists(const QString &group, const QString &key) const
 {
     const QString con(group.isEmpty() ? defaultConnection() : group);
-    QSettings settings(configFile(), QSettings::IniFormat);
-
-    settings.beginGroup(con);
-    return settings.contains(key);
+    return cachedValue(groupKey(con, key)).isValid();
 }
 
 chrono::milliseconds ConfigFile::remotePollInterval(const QString &connection) const
@@ -526,11 +535,8 @@ chrono::milliseconds ConfigFile::remotePollInterval(const QString &connection) c
     if (connection.isEmpty())
         con = defaultConnection();
 
-    QSettings settings(configFile(), QSettings::IniFormat);
-    settings.beginGroup(con);
-
     auto defaultPollInterval = chrono::milliseconds(DEFAULT_REMOTE_POLL_INTERVAL);
-    auto remoteInterval = millisecondsValue(settings, remotePollIntervalC, defaultPollInterval);
+    auto remoteInterval = millisecondsValue(groupKey(con, QLatin1String(remotePollIntervalC)), defaultPollInterval);
     if (remoteInterval < chrono::seconds(5)) {
         qCWarning(lcConfigFile) << "Remote Interval is less than 5 seconds, reverting to" << DEFAULT_REMOTE_POLL_INTERVAL;
         remoteInterval = defaultPollInterval;
@@ -548,10 +554,7 @@ void ConfigFile::setRemotePollInterval(chrono::milliseconds interval, const QStr
         qCWarning(lcConfigFile) << "Remote Poll interval of " << interval.count() << " is below five seconds.";
         return;
     }
-    QSettings settings(configFile(), QSettings::IniFormat);
-    settings.beginGroup(con);
-    settings.setValue(QLatin1String(remotePollIntervalC), qlonglong(interval.count()));
-    settings.sync();
+    storeValue(groupKey(con, QLatin1String(remotePollIntervalC)), qlonglong(interval.count()));
 }
 
 chrono::milliseconds ConfigFile::forceSyncInterval(const QString &connection) const
@@ -561,11 +564,9 @@ chrono::milliseconds ConfigFile::forceSyncInterval(const QString &connection) co
     QString con(connection);
     if (connection.isEmpty())
         con = defaultConnection();
-    QSettings settings(configFile(), QSettings::IniFormat);
-    settings.beginGroup(con);
 
     auto defaultInterval = chrono::hours(2);
-    auto interval = millisecondsValue(settings, forceSyncIntervalC, defaultInterval);
+    auto interval = millisecondsValue(groupKey(con, QLatin1String(forceSyncIntervalC)), defaultInterval);
     if (interval < pollInterval) {
         qCWarning(lcConfigFile) << "Force sync interval is less than the remote poll inteval, reverting to" << pollInterval.count();
         interval = pollInterval;
@@ -575,9 +576,7 @@ chrono::milliseconds ConfigFile::forceSyncInterval(const QString &connection) co
 
 chrono::milliseconds OCC::ConfigFile::fullLocalDiscoveryInterval() const
 {
-    QSettings settings(configFile(), QSettings::IniFormat);
-    settings.beginGroup(defaultConnection());
-    return millisecondsValue(settings, fullLocalDiscoveryIntervalC, chrono::hours(1));
+    return millisecondsValue(groupKey(defaultConnection(), QLatin1String(fullLocalDiscoveryIntervalC)), chrono::hours(1));
 }
 
 chrono::milliseconds ConfigFile::notificationRefreshInterval(const QString &connection) const
@@ -585,11 +584,9 @@ chrono::milliseconds ConfigFile::notificationRefreshInterval(const QString &conn
     QString con(connection);
     if (connection.isEmpty())
         con = defaultConnection();
-    QSettings settings(configFile(), QSettings::IniFormat);
-    settings.beginGroup(con);
 
     const auto defaultInterval = chrono::minutes(1);
-    auto interval = millisecondsValue(settings, notificationRefreshIntervalC, defaultInterval);
+    auto interval = millisecondsValue(groupKey(con, QLatin1String(notificationRefreshIntervalC)), defaultInterval);
     if (interval < chrono::minutes(1)) {
         qCWarning(lcConfigFile) << "Notification refresh interval smaller than one minute, setting to one minute";
         interval = chrono::minutes(1);
@@ -602,11 +599,9 @@ chrono::milliseconds ConfigFile::updateCheckInterval(const QString &connection)
     QString con(connection);
     if (connection.isEmpty())
         con = defaultConnection();
-    QSettings settings(configFile(), QSettings::IniFormat);
-    settings.beginGroup(con);
 
     auto defaultInterval = chrono::hours(10);
-    auto interval = millisecondsValue(settings, updateCheckIntervalC, defaultInterval);
+    auto interval = millisecondsValue(groupKey(con, QLatin1String(updateCheckIntervalC)), defaultInterval);
 
     auto minInterval = chrono::minutes(5);
     if (interval < minInterval) {
@@ -635,11 +630,7 @@ void ConfigFile::setSkipUpdateCheck(bool skip, const QString &connection)
     if (connection.isEmpty())
         con = defaultConnection();
 
-    QSettings settings(configFile(), QSettings::IniFormat);
-    settings.beginGroup(con);
-
-    settings.setValue(QLatin1String(skipUpdateCheckC), QVariant(skip));
-    settings.sync();
+    storeValue(groupKey(con, QLatin1String(skipUpdateCheckC)), QVariant(skip));
 }
 
 bool ConfigFile::autoUpdateCheck(const QString &connection) const
@@ -661,23 +652,18 @@ void ConfigFile::setAutoUpdateCheck(bool autoCheck, const QString &connection)
     if (connection.isEmpty())
         con = defaultConnection();
 
-    QSettings settings(configFile(), QSettings::IniFormat);
-    settings.beginGroup(con);
-
-    settings.setValue(QLatin1String(autoUpdateCheckC), QVariant(autoCheck));
-    settings.sync();
+    storeValue(groupKey(con, QLatin1String(autoUpdateCheckC)), QVariant(autoCheck));
 }
 
 int ConfigFile::updateSegment() const
 {
-    QSettings settings(configFile(), QSettings::IniFormat);
-    int segment = settings.value(QLatin1String(updateSegmentC), -1).toInt();
+    int segment = cachedValue(QLatin1String(updateSegmentC), -1).toInt();
 
     // Invalid? (Unset at the very first launch)
     if(segment < 0 || segment > 99) {
         // Save valid segment value, normally has to be done only once.
         segment = Utility::rand() % 99;
-        settings.setValue(QLatin1String(updateSegmentC), segment);
+        storeValue(QLatin1String(updateSegmentC), segment);
     }
 
     return segment;
@@ -695,8 +681,7 @@ QString ConfigFile::updateChannel() const
         defaultUpdateChannel = QStringLiteral("beta");
     }
 
-    QSettings settings(configFile(), QSettings::IniFormat);
-    const auto channel = settings.value(QLatin1String(updateChannelC), defaultUpdateChannel).toString();
+    const auto channel = cachedValue(QLatin1String(updateChannelC), defaultUpdateChannel).toString();
     if (!validUpdateChannels.contains(channel)) {
         qCWarning(lcConfigFile()) << "Received invalid update channel from confog:"
                                   << channel
@@ -717,44 +702,37 @@ void ConfigFile::setUpdateChannel(const QString &channel)
         return;
     }
 
-    QSettings settings(configFile(), QSettings::IniFormat);
-    settings.setValue(QLatin1String(updateChannelC), channel);
+    storeValue(QLatin1String(updateChannelC), channel);
 }
 
 [[nodiscard]] QString ConfigFile::overrideServerUrl() const
 {
-    QSettings settings(configFile(), QSettings::IniFormat);
-    return settings.value(QLatin1String(overrideServerUrlC), {}).toString();
+    return cachedValue(QLatin1String(overrideServerUrlC), {}).toString();
 }
 
 void ConfigFile::setOverrideServerUrl(const QString &url)
 {
-    QSettings settings(configFile(), QSettings::IniFormat);
-    settings.setValue(QLatin1String(overrideServerUrlC), url);
+    storeValue(QLatin1String(overrideServerUrlC), url);
 }
 
 [[nodiscard]] QString ConfigFile::overrideLocalDir() const
 {
-    QSettings settings(configFile(), QSettings::IniFormat);
-    return settings.value(QLatin1String(overrideLocalDirC), {}).toString();
+    return cachedValue(QLatin1String(overrideLocalDirC), {}).toString();
 }
 
 void ConfigFile::setOverrideLocalDir(const QString &localDir)
 {
-    QSettings settings(configFile(), QSettings::IniFormat);
-    settings.setValue(QLatin1String(overrideLocalDirC), localDir);
+    storeValue(QLatin1String(overrideLocalDirC), localDir);
 }
 
 bool ConfigFile::isVfsEnabled() const
 {
-    QSettings settings(configFile(), QSettings::IniFormat);
-    return settings.value({isVfsEnabledC}, {}).toBool();
+    return cachedValue({isVfsEnabledC}, {}).toBool();
 }
 
 void ConfigFile::setVfsEnabled(bool enabled)
 {
-    QSettings settings(configFile(), QSettings::IniFormat);
-    settings.setValue({isVfsEnabledC}, enabled);
+    storeValue({isVfsEnabledC}, enabled);
 }
 
 void ConfigFile::setProxyType(int proxyType,
@@ -790,46 +768,89 @@ void ConfigFile::setProxyType(int proxyType,
         }
     }
     settings.sync();
+
+    QMutexLocker locker(&g_configFileCache()->mutex);
+    g_configFileCache()->invalidate();
 }
 
 QVariant ConfigFile::getValue(const QString &param, const QString &group,
     const QVariant &defaultValue) const
 {
+    const auto key = groupKey(group, param);
     QVariant systemSetting;
-    if (Utility::isMac()) {
-        QSettings systemSettings(QLatin1String("/Library/Preferences/" APPLICATION_REV_DOMAIN ".plist"), QSettings::NativeFormat);
-        if (!group.isEmpty()) {
-            systemSettings.beginGroup(group);
-        }
-        systemSetting = systemSettings.value(param, defaultValue);
-    } else if (Utility::isUnix()) {
-        QSettings systemSettings(QString(SYSCONFDIR "/%1/%1.conf").arg(Theme::instance()->appName()), QSettings::NativeFormat);
-        if (!group.isEmpty()) {
-            systemSettings.beginGroup(group);
-        }
-        systemSetting = systemSettings.value(param, defaultValue);
-    } else { // Windows
-        QSettings systemSettings(QString::fromLatin1(R"(HKEY_LOCAL_MACHINE\Software\%1\%2)")
-                                     .arg(APPLICATION_VENDOR, Theme::instance()->appNameGUI()),
-            QSettings::NativeFormat);
-        if (!group.isEmpty()) {
-            systemSettings.beginGroup(group);
+    {
+        auto cache = g_configFileCache();
+        QMutexLocker locker(&cache->mutex);
+        if (!cache->systemValuesLoaded) {
+            if (Utility::isMac()) {
+                const QSettings systemSettings(QLatin1String("/Library/Preferences/" APPLICATION_REV_DOMAIN ".plist"), QSettings::NativeFormat);
+                loadSettings(systemSettings, cache->systemValues);
+            } else if (Utility::isUnix()) {
+                const QSettings systemSettings(QString(SYSCONFDIR "/%1/%1.conf").arg(Theme::instance()->appName()), QSettings::NativeFormat);
+                loadSettings(systemSettings, cache->systemValues);
+            } else { // Windows
+                const QSettings systemSettings(QString::fromLatin1(R"(HKEY_LOCAL_MACHINE\Software\%1\%2)")
+                                                   .arg(APPLICATION_VENDOR, Theme::instance()->appNameGUI()),
+                    QSettings::NativeFormat);
+                loadSettings(systemSettings, cache->systemValues);
+            }
+            cache->systemValuesLoaded = true;
         }
-        systemSetting = systemSettings.value(param, defaultValue);
+        systemSetting = cache->systemValues.value(key, defaultValue);
     }
 
-    QSettings settings(configFile(), QSettings::IniFormat);
-    if (!group.isEmpty())
-        settings.beginGroup(group);
-
-    return settings.value(param, systemSetting);
+    return cachedValue(key, systemSetting);
 }
 
 void ConfigFile::setValue(const QString &key, const QVariant &value)
 {
-    QSettings settings(configFile(), QSettings::IniFormat);
+    storeValue(key, value);
+}
+
+QVariant ConfigFile::cachedValue(const QString &key, const QVariant &defaultValue) const
+{
+    auto cache = g_configFileCache();
+    QMutexLocker locker(&cache->mutex);
+    if (cache->fileName.isEmpty()) {
+        cache->fileName = configFile();
+        loadSettings(QSettings(cache->fileName, QSettings::IniFormat), cache->values);
+    }
+    return cache->values.value(key, defaultValue);
+}
 
+void ConfigFile::reloadSettings()
+{
+    if (g_configFileCache.isDestroyed()) {
+        return;
+    }
+    auto cache = g_configFileCache();
+    QMutexLocker locker(&cache->mutex);
+    cache->invalidate();
+}
+
+void ConfigFile::storeValue(const QString &key, const QVariant &value) const
+{
+    auto cache = g_configFileCache();
+    QMutexLocker locker(&cache->mutex);
+    QSettings settings(configFile(), QSettings::IniFormat);
     settings.setValue(key, value);
+    settings.sync();
+    cache->invalidate();
+}
+
+void ConfigFile::removeValue(const QString &key) const
+{
+    auto cache = g_configFileCache();
+    QMutexLocker locker(&cache->mutex);
+    QSettings settings(configFile(), QSettings::IniFormat);
+    settings.remove(key);
+    settings.sync();
+    cache->invalidate();
+}
+
+chrono::milliseconds ConfigFile::millisecondsValue(const QString &key, chrono::milliseconds defaultValue) const
+{
+    return chrono::milliseconds(cachedValue(key, qlonglong(defaultValue.count())).toLongLong());
 }
 
 int ConfigFile::proxyType() const
@@ -872,8 +893,7 @@ QString ConfigFile::proxyPassword() const
         // Security: Migrate password from config file to keychain
         auto job = new KeychainChunk::WriteJob(key, pass.toUtf8());
         if (job->exec()) {
-            QSettings settings(configFile(), QSettings::IniFormat);
-            settings.remove(QLatin1String(proxyPassC));
+            removeValue(QLatin1String(proxyPassC));
             qCInfo(lcConfigFile()) << "Migrated proxy password to keychain";
         }
     } else {
@@ -932,6 +952,26 @@ void ConfigFile::setDownloadLimit(int kbytes)
     setValue(downloadLimitC, kbytes);
 }
 
+QString ConfigFile::uploadLimitSchedule() const
+{
+    return getValue(uploadLimitScheduleC).toString();
+}
+
+QString ConfigFile::downloadLimitSchedule() const
+{
+    return getValue(downloadLimitScheduleC).toString();
+}
+
+void ConfigFile::setUploadLimitSchedule(const QString &schedule)
+{
+    setValue(uploadLimitScheduleC, schedule);
+}
+
+void ConfigFile::setDownloadLimitSchedule(const QString &schedule)
+{
+    setValue(downloadLimitScheduleC, schedule);
+}
+
 QPair<bool, qint64> ConfigFile::newBigFolderSizeLimit() const
 {
     auto defaultValue = Theme::instance()->newBigFolderSizeLimit();
@@ -980,111 +1020,94 @@ bool ConfigFile::showMainDialogAsNormalWindow() const {
 
 bool ConfigFile::promptDeleteFiles() const
 {
-    QSettings settings(configFile(), QSettings::IniFormat);
-    return settings.value(QLatin1String(promptDeleteC), false).toBool();
+    return cachedValue(QLatin1String(promptDeleteC), false).toBool();
 }
 
 void ConfigFile::setPromptDeleteFiles(bool promptDeleteFiles)
 {
-    QSettings settings(configFile(), QSettings::IniFormat);
-    settings.setValue(QLatin1String(promptDeleteC), promptDeleteFiles);
+    storeValue(QLatin1String(promptDeleteC), promptDeleteFiles);
 }
 
 bool ConfigFile::monoIcons() const
 {
-    QSettings settings(configFile(), QSettings::IniFormat);
     bool monoDefault = false; // On Mac we want bw by default
 #ifdef Q_OS_MAC
     // OEM themes are not obliged to ship mono icons
     monoDefault = QByteArrayLiteral("Nextcloud") == QByteArrayLiteral(APPLICATION_NAME);
 #endif
-    return settings.value(QLatin1String(monoIconsC), monoDefault).toBool();
+    return cachedValue(QLatin1String(monoIconsC), monoDefault).toBool();
 }
 
 void ConfigFile::setMonoIcons(bool useMonoIcons)
 {
-    QSettings settings(configFile(), QSettings::IniFormat);
-    settings.setValue(QLatin1String(monoIconsC), useMonoIcons);
+    storeValue(QLatin1String(monoIconsC), useMonoIcons);
 }
 
 bool ConfigFile::crashReporter() const
 {
-    QSettings settings(configFile(), QSettings::IniFormat);
-    const auto fallback = settings.value(QLatin1String(crashReporterC), true);
+    const auto fallback = cachedValue(QLatin1String(crashReporterC), true);
     return getPolicySetting(QLatin1String(crashReporterC), fallback).toBool();
 }
 
 void ConfigFile::setCrashReporter(bool enabled)
 {
-    QSettings settings(configFile(), QSettings::IniFormat);
-    settings.setValue(QLatin1String(crashReporterC), enabled);
+    storeValue(QLatin1String(crashReporterC), enabled);
 }
 
 bool ConfigFile::automaticLogDir() const
 {
-    QSettings settings(configFile(), QSettings::IniFormat);
-    return settings.value(QLatin1String(automaticLogDirC), false).toBool();
+    return cachedValue(QLatin1String(automaticLogDirC), false).toBool();
 }
 
 void ConfigFile::setAutomaticLogDir(bool enabled)
 {
-    QSettings settings(configFile(), QSettings::IniFormat);
-    settings.setValue(QLatin1String(automaticLogDirC), enabled);
+    storeValue(QLatin1String(automaticLogDirC), enabled);
 }
 
 QString ConfigFile::logDir() const
 {
     const auto defaultLogDir = QString(configPath() + QStringLiteral("/logs"));
-    QSettings settings(configFile(), QSettings::IniFormat);
-    return settings.value(QLatin1String(logDirC), defaultLogDir).toString();
+    return cachedValue(QLatin1String(logDirC), defaultLogDir).toString();
 }
 
 void ConfigFile::setLogDir(const QString &dir)
 {
-    QSettings settings(configFile(), QSettings::IniFormat);
-    settings.setValue(QLatin1String(logDirC), dir);
+    storeValue(QLatin1String(logDirC), dir);
 }
 
 bool ConfigFile::logDebug() const
 {
-    QSettings settings(configFile(), QSettings::IniFormat);
-    return settings.value(QLatin1String(logDebugC), false).toBool();
+    return cachedValue(QLatin1String(logDebugC), false).toBool();
 }
 
 void ConfigFile::setLogDebug(bool enabled)
 {
-    QSettings settings(configFile(), QSettings::IniFormat);
-    settings.setValue(QLatin1String(logDebugC), enabled);
+    storeValue(QLatin1String(logDebugC), enabled);
 }
 
 int ConfigFile::logExpire() const
 {
-    QSettings settings(configFile(), QSettings::IniFormat);
-    return settings.value(QLatin1String(logExpireC), 24).toInt();
+    return cachedValue(QLatin1String(logExpireC), 24).toInt();
 }
 
 void ConfigFile::setLogExpire(int hours)
 {
-    QSettings settings(configFile(), QSettings::IniFormat);
-    settings.setValue(QLatin1String(logExpireC), hours);
+    storeValue(QLatin1String(logExpireC), hours);
 }
 
 bool ConfigFile::logFlush() const
 {
-    QSettings settings(configFile(), QSettings::IniFormat);
-    return settings.value(QLatin1String(logFlushC), false).toBool();
+    return cachedValue(QLatin1String(logFlushC), false).toBool();
 }
 
 void ConfigFile::setLogFlush(bool enabled)
 {
-    QSettings settings(configFile(), QSettings::IniFormat);
-    settings.setValue(QLatin1String(logFlushC), enabled);
+    storeValue(QLatin1String(logFlushC), enabled);
 }
 
 bool ConfigFile::showExperimentalOptions() const
 {
-    QSettings settings(configFile(), QSettings::IniFormat);
-    return settings.value(QLatin1String(showExperimentalOptionsC), false).toBool();
+    return cachedValue(QLatin1String(showExperimentalOptionsC), false).toBool();
 }
 
 QString ConfigFile::certificatePath() const
@@ -1094,9 +1117,7 @@ QString ConfigFile::certificatePath() const
 
 void ConfigFile::setCertificatePath(const QString &cPath)
 {
-    QSettings settings(configFile(), QSettings::IniFormat);
-    settings.setValue(QLatin1String(certPath), cPath);
-    settings.sync();
+    storeValue(QLatin1String(certPath), cPath);
 }
 
 QString ConfigFile::certificatePasswd() const
@@ -1106,21 +1127,17 @@ QString ConfigFile::certificatePasswd() const
 
 void ConfigFile::setCertificatePasswd(const QString &cPasswd)
 {
-    QSettings settings(configFile(), QSettings::IniFormat);
-    settings.setValue(QLatin1String(certPasswd), cPasswd);
-    settings.sync();
+    storeValue(QLatin1String(certPasswd), cPasswd);
 }
 
 QString ConfigFile::clientVersionString() const
 {
-    QSettings settings(configFile(), QSettings::IniFormat);
-    return settings.value(QLatin1String(clientVersionC), QString()).toString();
+    return cachedValue(QLatin1String(clientVersionC), QString()).toString();
 }
 
 void ConfigFile::setClientVersionString(const QString &version)
 {
-    QSettings settings(configFile(), QSettings::IniFormat);
-    settings.setValue(QLatin1String(clientVersionC), version);
+    storeValue(QLatin1String(clientVersionC), version);
 }
 
 Q_GLOBAL_STATIC(QString, g_configFileName)
@@ -1132,7 +1149,7 @@ std::unique_ptr<QSettings> ConfigFile::settingsWithGroup(const QString &group, Q
         ConfigFile cfg;
         *g_configFileName() = cfg.configFile();
     }
-    std::unique_ptr<QSettings> settings(new QSettings(*g_configFileName(), QSettings::IniFormat, parent));
+    std::unique_ptr<QSettings> settings(new ConfigFileSettings(*g_configFileName(), parent));
     settings->beginGroup(group);
     return settings;
 }
@@ -1175,14 +1192,12 @@ void ConfigFile::setDiscoveredLegacyConfigPath(const QString &discoveredLegacyCo
 
 bool ConfigFile::macFileProviderModuleEnabled() const
 {
-    QSettings settings(configFile(), QSettings::IniFormat);
-    return settings.value(macFileProviderModuleEnabledC, false).toBool();
+    return cachedValue(macFileProviderModuleEnabledC, false).toBool();
 }
 
 void ConfigFile::setMacFileProviderModuleEnabled(const bool moduleEnabled)
 {
-    QSettings settings(configFile(), QSettings::IniFormat);
-    settings.setValue(QLatin1String(macFileProviderModuleEnabledC), moduleEnabled);
+    storeValue(QLatin1String(macFileProviderModuleEnabledC), moduleEnabled);
 }
 
 }
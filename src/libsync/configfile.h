@@ -128,7 +128,7 @@ public:
     [[nodiscard]] QString proxyUser() const;
     [[nodiscard]] QString proxyPassword() const;
 
-    /** 0: no limit, 1: manual, >0: automatic */
+    /** 0: no limit, 1: manual, -1: automatic, -2: adaptive to the server's latency */
     [[nodiscard]] int useUploadLimit() const;
     [[nodiscard]] int useDownloadLimit() const;
     void setUseUploadLimit(int);
@@ -138,6 +138,11 @@ public:
     [[nodiscard]] int downloadLimit() const;
     void setUploadLimit(int kbytes);
     void setDownloadLimit(int kbytes);
+    /** time of day dependent limits overriding the ones above, see BandwidthSchedule */
+    [[nodiscard]] QString uploadLimitSchedule() const;
+    [[nodiscard]] QString downloadLimitSchedule() const;
+    void setUploadLimitSchedule(const QString &schedule);
+    void setDownloadLimitSchedule(const QString &schedule);
     /** [checked, size in MB] **/
     [[nodiscard]] QPair<bool, qint64> newBigFolderSizeLimit() const;
     void setNewBigFolderSizeLimit(bool isChecked, qint64 mbytes);
@@ -153,6 +158,13 @@ public:
 
     static bool setConfDir(const QString &value);
 
+    /** Drops the cached contents of the config file, so the next read parses it again.
+     *
+     * Needed after the file was changed by other processes or by other means
+     * than ConfigFile and settingsWithGroup().
+     */
+    static void reloadSettings();
+
     [[nodiscard]] bool optionalServerNotifications() const;
     void setOptionalServerNotifications(bool show);
 
@@ -238,6 +250,17 @@ private:
         const QVariant &defaultValue = QVariant()) const;
     void setValue(const QString &key, const QVariant &value);
 
+    /** Reads a value of the config file, key is "group/param" for grouped settings.
+     *
+     * The parsed file is cached for the whole process and only read again
+     * after reloadSettings() or a write through ConfigFile.
+     */
+    [[nodiscard]] QVariant cachedValue(const QString &key, const QVariant &defaultValue = QVariant()) const;
+    // Write to the file right away and drop the cache
+    void storeValue(const QString &key, const QVariant &value) const;
+    void removeValue(const QString &key) const;
+    [[nodiscard]] std::chrono::milliseconds millisecondsValue(const QString &key, std::chrono::milliseconds defaultValue) const;
+
     [[nodiscard]] QString keychainProxyPasswordKey() const;
 
     using SharedCreds = QSharedPointer<AbstractCredentials>;
@@ -76,6 +76,18 @@ void ProcessDirectoryJob::start()
 {
     qCInfo(lcDisco) << "STARTING" << _currentFolder._server << _queryServer << _currentFolder._local << _queryLocal;
 
+    // With a targeted remote discovery only the listed folders are queried,
+    // their parents are traversed with the db entries
+    if (!_discoveryData->_remoteDiscoveryPaths.empty()) {
+        if (_queryServer == NormalQuery && !_discoveryData->isInRemoteDiscoveryPaths(_currentFolder._original)) {
+            _queryServer = ParentNotChanged;
+            qCDebug(lcDisco) << "adjusted remote discovery policy" << _currentFolder._server << _queryServer;
+        } else if (_queryServer == ParentNotChanged && _discoveryData->_remoteDiscoveryPaths.count(_currentFolder._original)) {
+            _queryServer = NormalQuery;
+            qCDebug(lcDisco) << "adjusted remote discovery policy" << _currentFolder._server << _queryServer;
+        }
+    }
+
     if (_queryServer == NormalQuery) {
         _serverJob = startAsyncServerQuery();
     } else {
@@ -876,7 +888,7 @@ void ProcessDirectoryJob::processFileAnalyzeRemoteInfo(
 
         auto postProcessRename = [this, item, base, originalPath](PathTuple &path) {
             auto adjustedOriginalPath = _discoveryData->adjustRenamedPath(originalPath, SyncFileItem::Up);
-            _discoveryData->_renamedItemsRemote.insert(originalPath, path._target);
+            _discoveryData->addRenamedItem(originalPath, path._target, SyncFileItem::Down);
             item->_modtime = base._modtime;
             item->_inode = base._inode;
             item->_instruction = CSYNC_INSTRUCTION_RENAME;
@@ -972,7 +984,10 @@ void ProcessDirectoryJob::processFileAnalyzeLocalInfo(
         // conflict we don't need to recurse into it. (local c1.owncloud, c1/ ; remote: c1)
         if (item->_instruction == CSYNC_INSTRUCTION_CONFLICT && !item->isDirectory())
             recurse = false;
-        if (_queryLocal != NormalQuery && _queryServer != NormalQuery)
+        // A targeted remote discovery still needs to reach the listed folders
+        const auto leadsToRemoteDiscoveryPath = _queryServer == ParentNotChanged && recurseQueryServer == ParentNotChanged
+            && !_discoveryData->_remoteDiscoveryPaths.empty() && _discoveryData->leadsToRemoteDiscoveryPath(path._original);
+        if (_queryLocal != NormalQuery && _queryServer != NormalQuery && !leadsToRemoteDiscoveryPath)
             recurse = false;
 
         if ((item->_direction == SyncFileItem::Down || item->_instruction == CSYNC_INSTRUCTION_CONFLICT || item->_instruction == CSYNC_INSTRUCTION_NEW || item->_instruction == CSYNC_INSTRUCTION_SYNC) &&
@@ -1341,6 +1356,7 @@ void ProcessDirectoryJob::processFileAnalyzeLocalInfo(
             item->_e2eEncryptionStatus = EncryptionStatusEnums::fromDbEncryptionStatus(base._e2eEncryptionStatus);
         }
         postProcessLocalNew();
+        findRemoteCopyCandidates(item);
         finalize();
         return;
     }
@@ -1378,7 +1394,7 @@ void ProcessDirectoryJob::processFileAnalyzeLocalInfo(
         } else {
             // Signal to future checkPermissions() to forbid the REMOVE and set to restore instead
             qCInfo(lcDisco) << "Preventing future remove on source" << originalPath;
-            _discoveryData->_forbiddenDeletes[originalPath + '/'] = true;
+            _discoveryData->addForbiddenDelete(originalPath);
         }
         return;
     }
@@ -1387,7 +1403,7 @@ void ProcessDirectoryJob::processFileAnalyzeLocalInfo(
 
     auto processRename = [item, originalPath, base, this](PathTuple &path) {
         auto adjustedOriginalPath = _discoveryData->adjustRenamedPath(originalPath, SyncFileItem::Down);
-        _discoveryData->_renamedItemsLocal.insert(originalPath, path._target);
+        _discoveryData->addRenamedItem(originalPath, path._target, SyncFileItem::Up);
         item->_renameTarget = path._target;
         path._server = adjustedOriginalPath;
         item->_file = path._server;
@@ -1450,6 +1466,29 @@ void ProcessDirectoryJob::processFileAnalyzeLocalInfo(
     finalize();
 }
 
+void ProcessDirectoryJob::findRemoteCopyCandidates(const SyncFileItemPtr &item)
+{
+    const auto minSize = _discoveryData->_syncOptions._minRemoteCopySize;
+    if (minSize < 0 || item->_size < minSize || item->_type != ItemTypeFile
+        || item->_instruction != CSYNC_INSTRUCTION_NEW || item->isEncrypted() || isInsideEncryptedTree()) {
+        return;
+    }
+
+    // The checksums are compared by the propagator: hashing a big file here would
+    // block the discovery. A few candidates are enough to find duplicates.
+    constexpr int maxCandidates = 10;
+    const auto ok = _discoveryData->_statedb->getFileRecordsBySize(item->_size, [&](const SyncJournalFileRecord &rec) {
+        if (item->_remoteCopyCandidates.size() < maxCandidates
+            && (rec._type == ItemTypeFile || rec._type == ItemTypeVirtualFile) && !rec.isE2eEncrypted()
+            && !rec._checksumHeader.isEmpty() && !_discoveryData->isRenamed(rec.path())) {
+            item->_remoteCopyCandidates.append(rec.path());
+        }
+    });
+    if (!ok) {
+        dbError();
+    }
+}
+
 void ProcessDirectoryJob::processFileConflict(const SyncFileItemPtr &item, ProcessDirectoryJob::PathTuple path, const LocalInfo &localEntry, const RemoteInfo &serverEntry, const SyncJournalFileRecord &dbEntry)
 {
     item->_previousSize = localEntry.size;
@@ -1609,7 +1648,7 @@ void ProcessDirectoryJob::processFileFinalize(
         if (removed
             // For the purpose of rename deletion, restored deleted placeholder is as if it was deleted
             || (item->_type == ItemTypeVirtualFile && item->_instruction == CSYNC_INSTRUCTION_NEW)) {
-            _discoveryData->_deletedItem[path._original] = item;
+            _discoveryData->addDeletedItem(path._original, item);
         }
         emit _discoveryData->itemDiscovered(item);
     }
@@ -1697,12 +1736,7 @@ bool ProcessDirectoryJob::checkPermissions(const OCC::SyncFileItemPtr &item)
         break;
     }
     case CSYNC_INSTRUCTION_REMOVE: {
-        QString fileSlash = item->_file + '/';
-        auto forbiddenIt = _discoveryData->_forbiddenDeletes.upperBound(fileSlash);
-        if (forbiddenIt != _discoveryData->_forbiddenDeletes.begin())
-            forbiddenIt -= 1;
-        if (forbiddenIt != _discoveryData->_forbiddenDeletes.end()
-            && fileSlash.startsWith(forbiddenIt.key())) {
+        if (_discoveryData->isForbiddenDelete(item->_file)) {
             item->_instruction = CSYNC_INSTRUCTION_NEW;
             item->_direction = SyncFileItem::Down;
             item->_isRestoration = true;
@@ -1804,8 +1838,18 @@ void ProcessDirectoryJob::subJobFinished()
     _childIgnored |= job->_childIgnored;
     _childModified |= job->_childModified;
 
-    if (job->_dirItem)
+    if (job->_fetchesSubtree) {
+        // Subdirectories that were excluded or not recursed into never used their listing
+        _discoveryData->dropPrefetchedListingsBelow(_discoveryData->_remoteFolder + job->_currentFolder._server);
+    }
+
+    if (job->_dirItem) {
         emit _discoveryData->itemDiscovered(job->_dirItem);
+        if (!_dirItem) {
+            // Only the root job has no directory item: a top-level subtree is complete
+            emit _discoveryData->subtreeDiscovered(job->_dirItem->destination());
+        }
+    }
 
     int count = _runningJobs.removeAll(job);
     ASSERT(count == 1);
@@ -1890,6 +1934,14 @@ DiscoverySingleDirectoryJob *ProcessDirectoryJob::startAsyncServerQuery()
         _discoveryData->_remoteFolder + _currentFolder._server, this);
     if (!_dirItem)
         serverJob->setIsRootPath(); // query the fingerprint on the root
+    serverJob->setDiscoveryPhase(_discoveryData);
+    // Nothing below a folder that is new on the server is known yet, list all of it at once
+    if (_dirItem && _dirItem->_instruction == CSYNC_INSTRUCTION_NEW && _dirItem->_direction == SyncFileItem::Down
+        && !_dirItem->isEncrypted() && !isInsideEncryptedTree()
+        && _discoveryData->_account->capabilities().propfindDepthInfinity()) {
+        serverJob->setFetchSubtree();
+        _fetchesSubtree = true;
+    }
     connect(serverJob, &DiscoverySingleDirectoryJob::etag, this, &ProcessDirectoryJob::etag);
     _discoveryData->_currentlyActiveJobs++;
     _pendingAsyncJobs++;
@@ -1911,7 +1963,13 @@ DiscoverySingleDirectoryJob *ProcessDirectoryJob::startAsyncServerQuery()
         } else {
             auto code = results.error().code;
             qCWarning(lcDisco) << "Server error in directory" << _currentFolder._server << code;
-            if (_dirItem && code >= 403) {
+            if (_dirItem && code == 404 && _discoveryData->_remoteDiscoveryPaths.count(_currentFolder._original)) {
+                // A folder listed for a targeted remote discovery is gone: only
+                // the listing of its parent, which wasn't queried, can tell why
+                qCInfo(lcDisco) << "Listed folder not on the server anymore, waiting for a full remote discovery" << _currentFolder._original;
+                _discoveryData->_anotherSyncNeeded = true;
+                emit this->finished();
+            } else if (_dirItem && code >= 403) {
                 // In case of an HTTP error, we ignore that directory
                 // 403 Forbidden can be sent by the server if the file firewall is active.
                 // A file or directory should be ignored and sync must continue. See #3490
@@ -168,6 +168,11 @@ private:
     /// processFile helper for reconciling local changes
     void processFileAnalyzeLocalInfo(const SyncFileItemPtr &item, PathTuple, const LocalInfo &, const RemoteInfo &, const SyncJournalFileRecord &, QueryMode recurseQueryServer);
 
+    /** processFile helper for new local files: remember the known files with the
+     * same size, one of them may be copied on the server instead of uploading
+     */
+    void findRemoteCopyCandidates(const SyncFileItemPtr &item);
+
     /// processFile helper for local/remote conflicts
     void processFileConflict(const SyncFileItemPtr &item, PathTuple, const LocalInfo &, const RemoteInfo &, const SyncJournalFileRecord &);
 
@@ -290,6 +295,7 @@ private:
     bool _childIgnored = false; // The directory contains ignored item that would prevent deletion
     PinState _pinState = PinState::Unspecified; // The directory's pin-state, see computePinState()
     bool _isInsideEncryptedTree = false; // this directory is encrypted or is within the tree of directories with root directory encrypted
+    bool _fetchesSubtree = false; // the server listing of this directory also prefetches its subdirectories
 
 signals:
     void finished();
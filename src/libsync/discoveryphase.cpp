@@ -18,19 +18,24 @@
 #include "progressdispatcher.h"
 
 #include "account.h"
+#include "clientsideencryption.h"
 #include "clientsideencryptionjobs.h"
 
 #include "common/asserts.h"
 #include "common/checksums.h"
+#include "common/syncjournaldb.h"
 
 #include <csync_exclude.h>
 #include "vio/csync_vio_local.h"
 
+#include <QJsonObject>
 #include <QLoggingCategory>
+#include <QMessageAuthenticationCode>
 #include <QUrl>
 #include <QFile>
 #include <QFileInfo>
 #include <QTextCodec>
+#include <QTimer>
 #include <cstring>
 #include <QDateTime>
 
@@ -39,6 +44,13 @@ namespace OCC {
 
 Q_LOGGING_CATEGORY(lcDiscovery, "nextcloud.sync.discovery", QtInfoMsg)
 
+static QString prefetchedListingKey(QString serverPath)
+{
+    while (serverPath.endsWith(QLatin1Char('/')))
+        serverPath.chop(1);
+    return serverPath;
+}
+
 /* Given a sorted list of paths ending with '/', return whether or not the given path is within one of the paths of the list*/
 static bool findPathInList(const QStringList &list, const QString &path)
 {
@@ -82,6 +94,37 @@ bool DiscoveryPhase::isInSelectiveSyncBlackList(const QString &path) const
     return false;
 }
 
+bool DiscoveryPhase::isInRemoteDiscoveryPaths(const QString &path) const
+{
+    if (_remoteDiscoveryPaths.empty()) {
+        return true;
+    }
+
+    auto parent = path;
+    forever {
+        if (_remoteDiscoveryPaths.count(parent)) {
+            return true;
+        }
+        if (parent.isEmpty()) {
+            return false;
+        }
+        const auto slash = parent.lastIndexOf(QLatin1Char('/'));
+        parent = slash < 0 ? QString() : parent.left(slash);
+    }
+}
+
+bool DiscoveryPhase::leadsToRemoteDiscoveryPath(const QString &path) const
+{
+    if (_remoteDiscoveryPaths.count(path)) {
+        return true;
+    }
+
+    // The paths below path are sorted right after "path/"
+    const auto prefix = path.isEmpty() ? path : path + QLatin1Char('/');
+    const auto it = _remoteDiscoveryPaths.lower_bound(prefix);
+    return it != _remoteDiscoveryPaths.end() && it->startsWith(prefix);
+}
+
 void DiscoveryPhase::checkSelectiveSyncNewFolder(const QString &path, RemotePermissions remotePerm,
     std::function<void(bool)> callback)
 {
@@ -143,7 +186,67 @@ void DiscoveryPhase::checkSelectiveSyncNewFolder(const QString &path, RemotePerm
 /* Given a path on the remote, give the path as it is when the rename is done */
 QString DiscoveryPhase::adjustRenamedPath(const QString &original, SyncFileItem::Direction d) const
 {
-    return OCC::adjustRenamedPath(d == SyncFileItem::Down ? _renamedItemsRemote : _renamedItemsLocal, original);
+    const auto &renamedItems = d == SyncFileItem::Down ? _renamedItemsRemote : _renamedItemsLocal;
+    if (renamedItems.isEmpty()) {
+        return original;
+    }
+
+    // The deepest renamed parent wins, like in OCC::adjustRenamedPath()
+    auto renamedParent = renamedItems.constEnd();
+    int prefixLength = 0;
+    _paths.forEachAncestor(original, [&](SyncPathTable::PathId id, int length) {
+        const auto it = renamedItems.constFind(id);
+        if (it != renamedItems.constEnd()) {
+            renamedParent = it;
+            prefixLength = length;
+        }
+    });
+    if (renamedParent == renamedItems.constEnd()) {
+        return original;
+    }
+    return *renamedParent + original.mid(prefixLength);
+}
+
+bool DiscoveryPhase::isRenamed(const QString &p) const
+{
+    if (_renamedItemsLocal.isEmpty() && _renamedItemsRemote.isEmpty()) {
+        return false;
+    }
+    const auto id = _paths.find(p);
+    return id != SyncPathTable::invalidId && (_renamedItemsLocal.contains(id) || _renamedItemsRemote.contains(id));
+}
+
+void DiscoveryPhase::addRenamedItem(const QString &originalPath, const QString &target, SyncFileItem::Direction direction)
+{
+    auto &renamedItems = direction == SyncFileItem::Down ? _renamedItemsRemote : _renamedItemsLocal;
+    renamedItems.insert(_paths.intern(originalPath), target);
+}
+
+void DiscoveryPhase::addForbiddenDelete(const QString &originalPath)
+{
+    _forbiddenDeletes.insert(_paths.intern(originalPath));
+}
+
+bool DiscoveryPhase::isForbiddenDelete(const QString &path) const
+{
+    if (_forbiddenDeletes.isEmpty()) {
+        return false;
+    }
+    // Only interned paths can be forbidden, so the walk can stop at the first unknown component
+    bool forbidden = false;
+    _paths.forEachAncestor(path, [&](SyncPathTable::PathId id, int) {
+        forbidden = forbidden || _forbiddenDeletes.contains(id);
+    });
+    if (forbidden) {
+        return true;
+    }
+    const auto id = _paths.find(path);
+    return id != SyncPathTable::invalidId && _forbiddenDeletes.contains(id);
+}
+
+void DiscoveryPhase::addDeletedItem(const QString &originalPath, const SyncFileItemPtr &item)
+{
+    _deletedItem[_paths.intern(originalPath)] = item;
 }
 
 QString adjustRenamedPath(const QMap<QString, QString> &renamedItems, const QString &original)
@@ -162,7 +265,8 @@ QPair<bool, QByteArray> DiscoveryPhase::findAndCancelDeletedJob(const QString &o
 {
     bool result = false;
     QByteArray oldEtag;
-    auto it = _deletedItem.find(originalPath);
+    const auto pathId = _deletedItem.isEmpty() ? SyncPathTable::invalidId : _paths.find(originalPath);
+    auto it = pathId == SyncPathTable::invalidId ? _deletedItem.end() : _deletedItem.find(pathId);
     if (it != _deletedItem.end()) {
         const SyncInstructions instruction = (*it)->_instruction;
         if (instruction == CSYNC_INSTRUCTION_IGNORE && (*it)->_type == ItemTypeVirtualFile) {
@@ -218,6 +322,21 @@ void DiscoveryPhase::enqueueDirectoryToDelete(const QString &path, ProcessDirect
     }
 }
 
+void DiscoveryPhase::dropPrefetchedListingsBelow(const QString &serverPath)
+{
+    if (_prefetchedListings.isEmpty()) {
+        return;
+    }
+    const auto prefix = prefetchedListingKey(serverPath) + QLatin1Char('/');
+    for (auto it = _prefetchedListings.begin(); it != _prefetchedListings.end();) {
+        if (it.key().startsWith(prefix)) {
+            it = _prefetchedListings.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
 void DiscoveryPhase::startJob(ProcessDirectoryJob *job)
 {
     ENFORCE(!_currentRootJob);
@@ -241,6 +360,17 @@ void DiscoveryPhase::startJob(ProcessDirectoryJob *job)
     job->start();
 }
 
+bool DiscoveryPhase::hasQueuedDeletedDirectoriesBelow(const QString &path) const
+{
+    if (_queuedDeletedDirectories.contains(path)) {
+        return true;
+    }
+    // "path" < "path-a" < "path/a" so the children don't directly follow path
+    const auto pathSlash = path + QLatin1Char('/');
+    const auto it = _queuedDeletedDirectories.lowerBound(pathSlash);
+    return it != _queuedDeletedDirectories.constEnd() && it.key().startsWith(pathSlash);
+}
+
 void DiscoveryPhase::setSelectiveSyncBlackList(const QStringList &list)
 {
     _selectiveSyncBlackList = list;
@@ -352,7 +482,28 @@ DiscoverySingleDirectoryJob::DiscoverySingleDirectoryJob(const AccountPtr &accou
 {
 }
 
+// The whole response of a "Depth: infinity" PROPFIND is held in memory before it
+// is parsed. Bigger subtrees are listed directory by directory instead.
+static constexpr qint64 maxSubtreeListingSize = 20 * 1000 * 1000; // about 20000 entries
+
 void DiscoverySingleDirectoryJob::start()
+{
+    if (_discoveryPhase) {
+        const auto it = _discoveryPhase->_prefetchedListings.find(prefetchedListingKey(_subPath));
+        if (it != _discoveryPhase->_prefetchedListings.end()) {
+            // A parent already listed this directory, keep the results asynchronous like a real PROPFIND
+            QTimer::singleShot(0, this, [this, listing = std::move(*it)] {
+                processPrefetchedListing(listing);
+            });
+            _discoveryPhase->_prefetchedListings.erase(it);
+            return;
+        }
+    }
+
+    startLsColJob(_fetchSubtree && _discoveryPhase && !_discoveryPhase->_depthInfinityFailed);
+}
+
+void DiscoverySingleDirectoryJob::startLsColJob(bool fetchSubtree)
 {
     // Start the actual HTTP job
     auto *lsColJob = new LsColJob(_account, _subPath, this);
@@ -391,12 +542,30 @@ void DiscoverySingleDirectoryJob::start()
 
     lsColJob->setProperties(props);
 
-    QObject::connect(lsColJob, &LsColJob::directoryListingIterated,
-        this, &DiscoverySingleDirectoryJob::directoryListingIteratedSlot);
-    QObject::connect(lsColJob, &LsColJob::finishedWithError, this, &DiscoverySingleDirectoryJob::lsJobFinishedWithErrorSlot);
-    QObject::connect(lsColJob, &LsColJob::finishedWithoutError, this, &DiscoverySingleDirectoryJob::lsJobFinishedWithoutErrorSlot);
+    if (fetchSubtree) {
+        qCInfo(lcDiscovery) << "Listing the subtree of" << _subPath << "with a single PROPFIND";
+        lsColJob->setDepth(QByteArrayLiteral("infinity"));
+        QObject::connect(lsColJob, &LsColJob::directoryListingIterated,
+            this, &DiscoverySingleDirectoryJob::subtreeListingIteratedSlot);
+        QObject::connect(lsColJob, &LsColJob::finishedWithError, this, &DiscoverySingleDirectoryJob::subtreeJobFinishedWithErrorSlot);
+        QObject::connect(lsColJob, &LsColJob::finishedWithoutError, this, &DiscoverySingleDirectoryJob::subtreeJobFinishedWithoutErrorSlot);
+    } else {
+        QObject::connect(lsColJob, &LsColJob::directoryListingIterated,
+            this, &DiscoverySingleDirectoryJob::directoryListingIteratedSlot);
+        QObject::connect(lsColJob, &LsColJob::finishedWithError, this, &DiscoverySingleDirectoryJob::lsJobFinishedWithErrorSlot);
+        QObject::connect(lsColJob, &LsColJob::finishedWithoutError, this, &DiscoverySingleDirectoryJob::lsJobFinishedWithoutErrorSlot);
+    }
     lsColJob->start();
 
+    if (fetchSubtree) {
+        connect(lsColJob->reply(), &QNetworkReply::downloadProgress, this, [this](qint64 bytesReceived, qint64) {
+            if (bytesReceived > maxSubtreeListingSize && _lsColJob && !_subtreeListingTooLarge) {
+                _subtreeListingTooLarge = true;
+                _lsColJob->reply()->abort();
+            }
+        });
+    }
+
     _lsColJob = lsColJob;
 }
 
@@ -513,6 +682,18 @@ static void propertyMapToRemoteInfo(const QMap<QString, QString> &map, RemoteInf
     }
 }
 
+static RemoteInfo remoteInfoFromListing(const QString &file, const QMap<QString, QString> &map)
+{
+    RemoteInfo result;
+    int slash = file.lastIndexOf('/');
+    result.name = file.mid(slash + 1);
+    result.size = -1;
+    propertyMapToRemoteInfo(map, result);
+    if (result.isDirectory)
+        result.size = 0;
+    return result;
+}
+
 void DiscoverySingleDirectoryJob::directoryListingIteratedSlot(const QString &file, const QMap<QString, QString> &map)
 {
     if (!_ignoredFirst) {
@@ -544,23 +725,7 @@ void DiscoverySingleDirectoryJob::directoryListingIteratedSlot(const QString &fi
             _size = map.value("size").toInt();
         }
     } else {
-
-        RemoteInfo result;
-        int slash = file.lastIndexOf('/');
-        result.name = file.mid(slash + 1);
-        result.size = -1;
-        propertyMapToRemoteInfo(map, result);
-        if (result.isDirectory)
-            result.size = 0;
-
-        if (_isExternalStorage && result.remotePerm.hasPermission(RemotePermissions::IsMounted)) {
-            /* All the entries in a external storage have 'M' in their permission. However, for all
-               purposes in the desktop client, we only need to know about the mount points.
-               So replace the 'M' by a 'm' for every sub entries in an external storage */
-            result.remotePerm.unsetPermission(RemotePermissions::IsMounted);
-            result.remotePerm.setPermission(RemotePermissions::IsMountedSub);
-        }
-        _results.push_back(std::move(result));
+        addResult(remoteInfoFromListing(file, map));
     }
 
     //This works in concerto with the RequestEtagJob and the Folder object to check if the remote folder changed.
@@ -571,8 +736,89 @@ void DiscoverySingleDirectoryJob::directoryListingIteratedSlot(const QString &fi
     }
 }
 
+void DiscoverySingleDirectoryJob::addResult(RemoteInfo &&result)
+{
+    if (_isExternalStorage && result.remotePerm.hasPermission(RemotePermissions::IsMounted)) {
+        /* All the entries in a external storage have 'M' in their permission. However, for all
+           purposes in the desktop client, we only need to know about the mount points.
+           So replace the 'M' by a 'm' for every sub entries in an external storage */
+        result.remotePerm.unsetPermission(RemotePermissions::IsMounted);
+        result.remotePerm.setPermission(RemotePermissions::IsMountedSub);
+    }
+    _results.push_back(std::move(result));
+}
+
+void DiscoverySingleDirectoryJob::subtreeListingIteratedSlot(const QString &file, const QMap<QString, QString> &map)
+{
+    const auto ownKey = prefetchedListingKey(_subPath);
+    if (_subtreeRootHref.isNull()) {
+        // The first entry is the directory itself. The other hrefs are compared with
+        // its href rather than with the request URL: they are decoded the same way.
+        _subtreeRootHref = file;
+        _subtreeListings[ownKey].properties = map;
+        return;
+    }
+    if (!file.startsWith(_subtreeRootHref + QLatin1Char('/'))) {
+        qCWarning(lcDiscovery) << "Ignoring" << file << "outside of the listed subtree" << _subtreeRootHref;
+        return;
+    }
+
+    const auto key = ownKey + file.mid(_subtreeRootHref.size());
+    const auto parentKey = key.left(key.lastIndexOf(QLatin1Char('/')));
+    auto result = remoteInfoFromListing(file, map);
+    if (result.isDirectory) {
+        // Also directories without any entries need a listing
+        _subtreeListings[key].properties = map;
+    }
+    _subtreeListings[parentKey].entries.push_back(std::move(result));
+}
+
+void DiscoverySingleDirectoryJob::subtreeJobFinishedWithoutErrorSlot()
+{
+    const auto responseTimestamp = _lsColJob->responseTimestamp();
+    auto ownListing = _subtreeListings.take(prefetchedListingKey(_subPath));
+    for (auto it = _subtreeListings.begin(); it != _subtreeListings.end(); ++it) {
+        it->responseTimestamp = responseTimestamp;
+        _discoveryPhase->_prefetchedListings.insert(it.key(), std::move(*it));
+    }
+    _subtreeListings.clear();
+
+    ownListing.responseTimestamp = responseTimestamp;
+    processPrefetchedListing(ownListing);
+}
+
+void DiscoverySingleDirectoryJob::subtreeJobFinishedWithErrorSlot(QNetworkReply *r)
+{
+    const auto httpCode = r->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    qCInfo(lcDiscovery) << "Could not list the subtree of" << _subPath << r->errorString() << httpCode
+                        << (_subtreeListingTooLarge ? "(too large)" : "") << ", listing it by directory";
+    _subtreeListings.clear();
+    _subtreeRootHref.clear();
+
+    // Only a refusal of the request means that the server won't answer any of them,
+    // network errors or a too large subtree only concern this directory
+    if (!_subtreeListingTooLarge && ((httpCode >= 400 && httpCode < 500) || httpCode == 501)) {
+        _discoveryPhase->_depthInfinityFailed = true;
+    }
+    startLsColJob(false);
+}
+
+void DiscoverySingleDirectoryJob::processPrefetchedListing(const PrefetchedDirectoryListing &listing)
+{
+    directoryListingIteratedSlot(_subPath, listing.properties); // the directory itself
+    for (auto entry : listing.entries) {
+        addResult(std::move(entry));
+    }
+    _responseTimestamp = listing.responseTimestamp;
+    lsJobFinishedWithoutErrorSlot();
+}
+
 void DiscoverySingleDirectoryJob::lsJobFinishedWithoutErrorSlot()
 {
+    if (_lsColJob && _responseTimestamp.isEmpty()) {
+        _responseTimestamp = _lsColJob->responseTimestamp();
+    }
+
     if (!_ignoredFirst) {
         // This is a sanity check, if we haven't _ignoredFirst then it means we never received any directoryListingIteratedSlot
         // which means somehow the server XML was bogus
@@ -584,11 +830,16 @@ void DiscoverySingleDirectoryJob::lsJobFinishedWithoutErrorSlot()
         deleteLater();
         return;
     } else if (isE2eEncrypted()) {
-        emit etag(_firstEtag, QDateTime::fromString(QString::fromUtf8(_lsColJob->responseTimestamp()), Qt::RFC2822Date));
+        emit etag(_firstEtag, QDateTime::fromString(QString::fromUtf8(_responseTimestamp), Qt::RFC2822Date));
+        if (applyCachedE2eMetadata()) {
+            emit finished(_results);
+            deleteLater();
+            return;
+        }
         fetchE2eMetadata();
         return;
     }
-    emit etag(_firstEtag, QDateTime::fromString(QString::fromUtf8(_lsColJob->responseTimestamp()), Qt::RFC2822Date));
+    emit etag(_firstEtag, QDateTime::fromString(QString::fromUtf8(_responseTimestamp), Qt::RFC2822Date));
     emit finished(_results);
     deleteLater();
 }
@@ -635,32 +886,98 @@ void DiscoverySingleDirectoryJob::metadataReceived(const QJsonDocument &json, in
     _isFileDropDetected = metadata.isFileDropPresent();
     _encryptedMetadataNeedUpdate = metadata.encryptedMetadataNeedUpdate();
 
+    QHash<QString, QString> originalFilenames;
     const auto encryptedFiles = metadata.files();
+    for (const auto &encryptedFile : encryptedFiles) {
+        originalFilenames.insert(encryptedFile.encryptedFilename, encryptedFile.originalFilename);
+    }
+    applyE2eFilenames(originalFilenames);
 
-    const auto findEncryptedFile = [=](const QString &name) {
-        const auto it = std::find_if(std::cbegin(encryptedFiles), std::cend(encryptedFiles), [=](const EncryptedFile &file) {
-            return file.encryptedFilename == name;
-        });
-        if (it == std::cend(encryptedFiles)) {
-            return Optional<EncryptedFile>();
-        } else {
-            return Optional<EncryptedFile>(*it);
-        }
-    };
+    // Metadata that is going to be rewritten by this sync must be fetched again next time
+    if (metadata.isMetadataSetup() && !_isFileDropDetected && !_encryptedMetadataNeedUpdate) {
+        storeE2eMetadataCache(originalFilenames);
+    } else if (_discoveryPhase && _discoveryPhase->_statedb) {
+        _discoveryPhase->_statedb->deleteE2EeFolderMetadataCache(_localFileId);
+    }
+
+    emit finished(_results);
+    deleteLater();
+}
 
-    std::transform(std::cbegin(_results), std::cend(_results), std::begin(_results), [=](const RemoteInfo &info) {
-        auto result = info;
-        const auto encryptedFileInfo = findEncryptedFile(result.name);
-        if (encryptedFileInfo) {
+void DiscoverySingleDirectoryJob::applyE2eFilenames(const QHash<QString, QString> &originalFilenames)
+{
+    for (auto &result : _results) {
+        const auto it = originalFilenames.constFind(result.name);
+        if (it != originalFilenames.cend()) {
             result._isE2eEncrypted = true;
             result.e2eMangledName = _subPath.mid(1) + QLatin1Char('/') + result.name;
-            result.name = encryptedFileInfo->originalFilename;
+            result.name = *it;
         }
-        return result;
-    });
+    }
+}
 
-    emit finished(_results);
-    deleteLater();
+QByteArray DiscoverySingleDirectoryJob::e2eMetadataCacheKey() const
+{
+    // Derived from the private key, so the cache is only readable while the
+    // keys are unlocked, just like the metadata on the server
+    const auto &privateKey = _account->e2e()->_privateKey;
+    if (privateKey.isEmpty()) {
+        return {};
+    }
+    return QMessageAuthenticationCode::hash(QByteArrayLiteral("e2ee folder metadata cache"), privateKey, QCryptographicHash::Sha256)
+        .left(16); // AES-128, like encryptStringSymmetric() expects
+}
+
+bool DiscoverySingleDirectoryJob::applyCachedE2eMetadata()
+{
+    if (!_discoveryPhase || !_discoveryPhase->_statedb || _localFileId.isEmpty() || _firstEtag.isEmpty()) {
+        return false;
+    }
+    const auto key = e2eMetadataCacheKey();
+    if (key.isEmpty()) {
+        return false;
+    }
+    const auto cached = _discoveryPhase->_statedb->e2EeFolderMetadataCache(_localFileId, _firstEtag);
+    if (cached.isEmpty()) {
+        return false;
+    }
+
+    const auto json = QJsonDocument::fromJson(EncryptionHelper::decryptStringSymmetric(key, cached));
+    if (!json.isObject()) {
+        qCWarning(lcDiscovery) << "Discarding unreadable metadata cache of" << _subPath;
+        _discoveryPhase->_statedb->deleteE2EeFolderMetadataCache(_localFileId);
+        return false;
+    }
+
+    QHash<QString, QString> originalFilenames;
+    const auto files = json.object().value(QStringLiteral("files")).toObject();
+    for (auto it = files.constBegin(); it != files.constEnd(); ++it) {
+        originalFilenames.insert(it.key(), it.value().toString());
+    }
+    qCDebug(lcDiscovery) << "Using the cached metadata of" << _subPath << "for etag" << _firstEtag;
+    applyE2eFilenames(originalFilenames);
+    return true;
+}
+
+void DiscoverySingleDirectoryJob::storeE2eMetadataCache(const QHash<QString, QString> &originalFilenames)
+{
+    if (!_discoveryPhase || !_discoveryPhase->_statedb || _localFileId.isEmpty() || _firstEtag.isEmpty()) {
+        return;
+    }
+    const auto key = e2eMetadataCacheKey();
+    if (key.isEmpty()) {
+        return;
+    }
+
+    QJsonObject files;
+    for (auto it = originalFilenames.cbegin(); it != originalFilenames.cend(); ++it) {
+        files.insert(it.key(), it.value());
+    }
+    const QJsonObject cache{{QStringLiteral("files"), files}};
+    const auto encrypted = EncryptionHelper::encryptStringSymmetric(key, QJsonDocument(cache).toJson(QJsonDocument::Compact));
+    if (!encrypted.isEmpty()) {
+        _discoveryPhase->_statedb->setE2EeFolderMetadataCache(_localFileId, _firstEtag, encrypted);
+    }
 }
 
 void DiscoverySingleDirectoryJob::metadataError(const QByteArray &fileId, int httpReturnCode)
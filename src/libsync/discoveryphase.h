@@ -25,8 +25,10 @@
 #include <QWaitCondition>
 #include <QRunnable>
 #include <deque>
+#include <set>
 #include "syncoptions.h"
 #include "syncfileitem.h"
+#include "syncpathtable.h"
 
 class ExcludedFiles;
 
@@ -131,6 +133,18 @@ private:
 public:
 };
 
+/**
+ * A directory listing that arrived as part of a "Depth: infinity" PROPFIND of one
+ * of its parents, see DiscoverySingleDirectoryJob::setFetchSubtree()
+ */
+struct PrefetchedDirectoryListing
+{
+    QMap<QString, QString> properties; // of the directory itself
+    QVector<RemoteInfo> entries;
+    QByteArray responseTimestamp;
+};
+
+class DiscoveryPhase;
 
 /**
  * @brief Run a PROPFIND on a directory and process the results for Discovery
@@ -144,6 +158,17 @@ public:
     explicit DiscoverySingleDirectoryJob(const AccountPtr &account, const QString &path, QObject *parent = nullptr);
     // Specify that this is the root and we need to check the data-fingerprint
     void setIsRootPath() { _isRootPath = true; }
+    /** Listings of this directory prefetched by a parent are used instead of a PROPFIND,
+     * and setFetchSubtree() stores the listings of the subdirectories there.
+     */
+    void setDiscoveryPhase(DiscoveryPhase *discoveryPhase) { _discoveryPhase = discoveryPhase; }
+    /** List the whole subtree with a single "Depth: infinity" PROPFIND.
+     *
+     * Only the results for this directory are reported, the listings of the
+     * subdirectories are kept in the DiscoveryPhase for their own jobs.
+     * Falls back to a normal PROPFIND if the server refuses.
+     */
+    void setFetchSubtree() { _fetchSubtree = true; }
     void start();
     void abort();
     [[nodiscard]] bool isFileDropDetected() const;
@@ -159,11 +184,27 @@ private slots:
     void directoryListingIteratedSlot(const QString &, const QMap<QString, QString> &);
     void lsJobFinishedWithoutErrorSlot();
     void lsJobFinishedWithErrorSlot(QNetworkReply *);
+    void subtreeListingIteratedSlot(const QString &, const QMap<QString, QString> &);
+    void subtreeJobFinishedWithoutErrorSlot();
+    void subtreeJobFinishedWithErrorSlot(QNetworkReply *);
     void fetchE2eMetadata();
     void metadataReceived(const QJsonDocument &json, int statusCode);
     void metadataError(const QByteArray& fileId, int httpReturnCode);
 
 private:
+    void startLsColJob(bool fetchSubtree);
+    void addResult(RemoteInfo &&result);
+    void processPrefetchedListing(const PrefetchedDirectoryListing &listing);
+
+    /** Encrypted folders keep their decrypted file names in the journal, keyed by
+     * the folder's etag, so unchanged folders need neither a metadata request
+     * nor a decryption. The names are stored encrypted with a key derived from
+     * the private key.
+     */
+    [[nodiscard]] QByteArray e2eMetadataCacheKey() const;
+    bool applyCachedE2eMetadata();
+    void storeE2eMetadataCache(const QHash<QString, QString> &originalFilenames);
+    void applyE2eFilenames(const QHash<QString, QString> &originalFilenames);
 
     [[nodiscard]] bool isE2eEncrypted() const { return _isE2eEncrypted != SyncFileItem::EncryptionStatus::NotEncrypted; }
 
@@ -188,6 +229,13 @@ private:
     int64_t _size = 0;
     QString _error;
     QPointer<LsColJob> _lsColJob;
+    QByteArray _responseTimestamp;
+    DiscoveryPhase *_discoveryPhase = nullptr;
+    bool _fetchSubtree = false;
+    // The listings of the subtree, keyed by server path, while the subtree PROPFIND runs
+    QHash<QString, PrefetchedDirectoryListing> _subtreeListings;
+    QString _subtreeRootHref; // the href of this directory in the subtree PROPFIND
+    bool _subtreeListingTooLarge = false;
 
 public:
     QByteArray _dataFingerprint;
@@ -201,13 +249,20 @@ class DiscoveryPhase : public QObject
 
     QPointer<ProcessDirectoryJob> _currentRootJob;
 
+    /** Interned db-paths of this discovery run.
+     *
+     * The rename, deletion and forbidden-delete bookkeeping below is keyed on
+     * the ids of this table instead of full path strings.
+     */
+    SyncPathTable _paths;
+
     /** Maps the db-path of a deleted item to its SyncFileItem.
      *
      * If it turns out the item was renamed after all, the instruction
      * can be changed. See findAndCancelDeletedJob(). Note that
      * itemDiscovered() will already have been emitted for the item.
      */
-    QMap<QString, SyncFileItemPtr> _deletedItem;
+    QHash<SyncPathTable::PathId, SyncFileItemPtr> _deletedItem;
 
     QVector<QString> _directoryNamesToRestoreOnPropagation;
 
@@ -224,25 +279,30 @@ class DiscoveryPhase : public QObject
     QMap<QString, ProcessDirectoryJob *> _queuedDeletedDirectories;
 
     // map source (original path) -> destinations (current server or local path)
-    QMap<QString, QString> _renamedItemsRemote;
-    QMap<QString, QString> _renamedItemsLocal;
+    QHash<SyncPathTable::PathId, QString> _renamedItemsRemote;
+    QHash<SyncPathTable::PathId, QString> _renamedItemsLocal;
 
     // set of paths that should not be removed even though they are removed locally:
     // there was a move to an invalid destination and now the source should be restored
     //
-    // This applies recursively to subdirectories.
-    // All entries should have a trailing slash (even files), so lookup with
-    // lowerBound() is reliable.
-    //
-    // The value of this map doesn't matter.
-    QMap<QString, bool> _forbiddenDeletes;
+    // This applies recursively to subdirectories, see isForbiddenDelete().
+    QSet<SyncPathTable::PathId> _forbiddenDeletes;
 
     /** Returns whether the db-path has been renamed locally or on the remote.
      *
      * Useful for avoiding processing of items that have already been claimed in
      * a rename (would otherwise be discovered as deletions).
      */
-    [[nodiscard]] bool isRenamed(const QString &p) const { return _renamedItemsLocal.contains(p) || _renamedItemsRemote.contains(p); }
+    [[nodiscard]] bool isRenamed(const QString &p) const;
+
+    void addRenamedItem(const QString &originalPath, const QString &target, SyncFileItem::Direction direction);
+
+    void addForbiddenDelete(const QString &originalPath);
+
+    /** Whether the db-path or one of its parents was added with addForbiddenDelete() */
+    [[nodiscard]] bool isForbiddenDelete(const QString &path) const;
+
+    void addDeletedItem(const QString &originalPath, const SyncFileItemPtr &item);
 
     int _currentlyActiveJobs = 0;
 
@@ -254,6 +314,15 @@ class DiscoveryPhase : public QObject
 
     [[nodiscard]] bool isInSelectiveSyncBlackList(const QString &path) const;
 
+    /** Whether the db-path is one of _remoteDiscoveryPaths or inside one of them.
+     *
+     * Always true when the remote discovery isn't targeted.
+     */
+    [[nodiscard]] bool isInRemoteDiscoveryPaths(const QString &path) const;
+
+    /** Whether the db-path is one of _remoteDiscoveryPaths or one of their parent folders */
+    [[nodiscard]] bool leadsToRemoteDiscoveryPath(const QString &path) const;
+
     // Check if the new folder should be deselected or not.
     // May be async. "Return" via the callback, true if the item is blacklisted
     void checkSelectiveSyncNewFolder(const QString &path, RemotePermissions rp,
@@ -294,9 +363,29 @@ public:
     QStringList _leadingAndTrailingSpacesFilesAllowed;
     bool _ignoreHiddenFiles = false;
     std::function<bool(const QString &)> _shouldDiscoverLocaly;
+    std::set<QString> _remoteDiscoveryPaths; // see SyncEngine::setRemoteDiscoveryPaths(), empty for a full remote discovery
+
+    /** Directory listings fetched by a "Depth: infinity" PROPFIND of a parent, keyed by server path.
+     *
+     * An entry is removed once the DiscoverySingleDirectoryJob of that directory used it,
+     * or when the subtree is discovered without that directory being listed.
+     */
+    QHash<QString, PrefetchedDirectoryListing> _prefetchedListings;
+    // Set once the server refused a "Depth: infinity" PROPFIND, to not ask again in this sync
+    bool _depthInfinityFailed = false;
+
+    /// Removes the unused prefetched listings of the subdirectories of serverPath
+    void dropPrefetchedListingsBelow(const QString &serverPath);
 
     void startJob(ProcessDirectoryJob *);
 
+    /** Whether deleted directories below the db-path are still waiting to be discovered.
+     *
+     * Their contents are only discovered once the rest of the tree is done,
+     * see _queuedDeletedDirectories.
+     */
+    [[nodiscard]] bool hasQueuedDeletedDirectoriesBelow(const QString &path) const;
+
     void setSelectiveSyncBlackList(const QStringList &list);
     void setSelectiveSyncWhiteList(const QStringList &list);
 
@@ -313,6 +402,13 @@ signals:
     void itemDiscovered(const OCC::SyncFileItemPtr &item);
     void finished();
 
+    /** A top-level directory and everything below it has been discovered.
+     *
+     * itemDiscovered() has been emitted for all of its items, including the
+     * directory itself. The path is relative to the sync folder.
+     */
+    void subtreeDiscovered(const QString &path);
+
     // A new folder was discovered and was not synced because of the confirmation feature
     void newBigFolder(const QString &folder, bool isExternal);
 
@@ -325,6 +421,9 @@ signals:
     void addErrorToGui(const SyncFileItem::Status status, const QString &errorMessage, const QString &subject, const OCC::ErrorCategory category);
 };
 
-/// Implementation of DiscoveryPhase::adjustRenamedPath
+/** Returns original with its deepest parent folder in renamedItems replaced by its new path.
+ *
+ * Used by OwncloudPropagator::adjustRenamedPath().
+ */
 QString adjustRenamedPath(const QMap<QString, QString> &renamedItems, const QString &original);
 }
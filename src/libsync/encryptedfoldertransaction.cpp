@@ -0,0 +1,311 @@
+/*
+ * Copyright (C) by Nextcloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "encryptedfoldertransaction.h"
+#include "account.h"
+#include "clientsideencryptionjobs.h"
+#include "deletejob.h"
+#include "networkjobs.h"
+#include "owncloudpropagator.h"
+#include "common/syncjournaldb.h"
+
+#include <QJsonDocument>
+#include <QLoggingCategory>
+#include <QNetworkReply>
+
+#include <utility>
+
+namespace OCC {
+
+Q_LOGGING_CATEGORY(lcEncryptedFolderTransaction, "nextcloud.sync.propagator.encryptedfoldertransaction", QtInfoMsg)
+
+EncryptedFolderTransaction::EncryptedFolderTransaction(OwncloudPropagator *propagator,
+    const QString &localPath,
+    const QString &remotePath,
+    FolderMetadata::RequiredMetadataVersion requiredMetadataVersion,
+    QObject *parent)
+    : QObject(parent)
+    , _propagator(propagator)
+    , _localPath(localPath)
+    , _remotePath(remotePath)
+    , _requiredMetadataVersion(requiredMetadataVersion)
+{
+}
+
+EncryptedFolderTransaction::~EncryptedFolderTransaction() = default;
+
+void EncryptedFolderTransaction::start()
+{
+    switch (_state) {
+    case State::Ready:
+        emit ready();
+        return;
+    case State::Locking:
+        return;
+    case State::Committing:
+    case State::Committed:
+        qCWarning(lcEncryptedFolderTransaction) << "Transaction for" << _localPath << "was already committed";
+        emit failed();
+        return;
+    case State::Idle:
+    case State::Failed:
+        break;
+    }
+
+    _state = State::Locking;
+    qCDebug(lcEncryptedFolderTransaction) << "Locking encrypted folder" << _localPath;
+    auto job = new LsColJob(_propagator->account(), _propagator->fullRemotePath(_remotePath), this);
+    job->setProperties({"resourcetype", "http://owncloud.org/ns:fileid"});
+    connect(job, &LsColJob::directoryListingSubfolders, this, &EncryptedFolderTransaction::slotFolderIdReceived);
+    connect(job, &LsColJob::finishedWithError, this, &EncryptedFolderTransaction::slotFolderIdError);
+    job->start();
+}
+
+void EncryptedFolderTransaction::slotFolderIdReceived(const QStringList &list)
+{
+    auto job = qobject_cast<LsColJob *>(sender());
+    Q_ASSERT(job);
+    if (!job || list.isEmpty()) {
+        fail();
+        return;
+    }
+    const auto folderId = job->_folderInfos.value(list.first()).fileId;
+
+    auto lockJob = new LockEncryptFolderApiJob(_propagator->account(), folderId, _propagator->_journal, _propagator->account()->e2e()->_publicKey, this);
+    connect(lockJob, &LockEncryptFolderApiJob::success, this, &EncryptedFolderTransaction::slotFolderLocked);
+    connect(lockJob, &LockEncryptFolderApiJob::error, this, &EncryptedFolderTransaction::slotFolderLockError);
+    lockJob->start();
+}
+
+void EncryptedFolderTransaction::slotFolderIdError(QNetworkReply *reply)
+{
+    qCWarning(lcEncryptedFolderTransaction) << "Error retrieving the id of encrypted folder" << _localPath
+                                            << (reply ? reply->errorString() : QString());
+    fail();
+}
+
+void EncryptedFolderTransaction::slotFolderLocked(const QByteArray &folderId, const QByteArray &token)
+{
+    qCDebug(lcEncryptedFolderTransaction) << "Folder" << _localPath << folderId << "locked, fetching metadata";
+    _folderId = folderId;
+    _folderToken = token;
+
+    auto job = new GetMetadataApiJob(_propagator->account(), _folderId);
+    connect(job, &GetMetadataApiJob::jsonReceived, this, &EncryptedFolderTransaction::slotMetadataReceived);
+    connect(job, &GetMetadataApiJob::error, this, &EncryptedFolderTransaction::slotMetadataError);
+    job->start();
+}
+
+void EncryptedFolderTransaction::slotFolderLockError(const QByteArray &folderId, int httpErrorCode)
+{
+    qCWarning(lcEncryptedFolderTransaction) << "Folder" << _localPath << folderId << "couldn't be locked:" << httpErrorCode;
+    fail();
+}
+
+void EncryptedFolderTransaction::slotMetadataError(const QByteArray &folderId, int httpReturnCode)
+{
+    Q_UNUSED(folderId);
+    qCDebug(lcEncryptedFolderTransaction) << "Error getting the encrypted metadata, pretend we got empty metadata." << httpReturnCode;
+    const FolderMetadata emptyMetadata(_propagator->account());
+    slotMetadataReceived(QJsonDocument::fromJson(emptyMetadata.encryptedMetadata()), httpReturnCode);
+}
+
+void EncryptedFolderTransaction::slotMetadataReceived(const QJsonDocument &json, int statusCode)
+{
+    _metadata.reset(new FolderMetadata(_propagator->account(), _requiredMetadataVersion, json.toJson(QJsonDocument::Compact), statusCode));
+    if (!_metadata->isMetadataSetup()) {
+        qCWarning(lcEncryptedFolderTransaction) << "Metadata of" << _localPath << "couldn't be read";
+        _metadata.reset();
+        unlockFolder();
+        fail();
+        return;
+    }
+
+    _metadataExistsOnServer = statusCode != 404;
+    _state = State::Ready;
+    emit ready();
+}
+
+void EncryptedFolderTransaction::fileUploaded(const EncryptedFile &file,
+    const QString &localFile,
+    const QString &remoteFile,
+    QObject *context,
+    const std::function<void(bool)> &done)
+{
+    // While committing, the folder is still locked until the last write is done
+    if (_folderToken.isEmpty() || (_state != State::Ready && _state != State::Committing)) {
+        qCWarning(lcEncryptedFolderTransaction) << "Folder" << _localPath << "isn't locked, can't add" << localFile;
+        done(false);
+        return;
+    }
+
+    _metadata->addEncryptedFile(file);
+    _metadataChanged = true;
+    _queuedFiles.append({file, localFile, remoteFile, context, done});
+    if (!_writingMetadata) {
+        writeMetadata();
+    }
+}
+
+void EncryptedFolderTransaction::fileDeleted()
+{
+    Q_ASSERT(_state == State::Ready);
+    _metadataChanged = true;
+}
+
+void EncryptedFolderTransaction::commit()
+{
+    if (_state == State::Locking) {
+        // Only happens when the propagation is aborted while we wait for the server
+        connect(this, &EncryptedFolderTransaction::ready, this, &EncryptedFolderTransaction::commit);
+        connect(this, &EncryptedFolderTransaction::failed, this, [this] { emit committed(true); });
+        return;
+    }
+    if (_state != State::Ready) {
+        emit committed(true);
+        return;
+    }
+
+    _state = State::Committing;
+    continueCommit();
+}
+
+void EncryptedFolderTransaction::writeMetadata()
+{
+    // Everything changed so far goes into this write
+    _writingMetadata = true;
+    _writingFiles = std::exchange(_queuedFiles, {});
+    _metadataChanged = false;
+
+    qCInfo(lcEncryptedFolderTransaction) << "Writing metadata of" << _localPath << "for" << _writingFiles.size() << "uploaded files";
+    if (_metadataExistsOnServer) {
+        auto job = new UpdateMetadataApiJob(_propagator->account(), _folderId, _metadata->encryptedMetadata(), _folderToken);
+        connect(job, &UpdateMetadataApiJob::success, this, &EncryptedFolderTransaction::slotMetadataWritten);
+        connect(job, &UpdateMetadataApiJob::error, this, &EncryptedFolderTransaction::slotMetadataWriteError);
+        job->start();
+    } else {
+        auto job = new StoreMetaDataApiJob(_propagator->account(), _folderId, _metadata->encryptedMetadata());
+        connect(job, &StoreMetaDataApiJob::success, this, &EncryptedFolderTransaction::slotMetadataWritten);
+        connect(job, &StoreMetaDataApiJob::error, this, &EncryptedFolderTransaction::slotMetadataWriteError);
+        job->start();
+    }
+}
+
+void EncryptedFolderTransaction::slotMetadataWritten()
+{
+    _writingMetadata = false;
+    _metadataExistsOnServer = true;
+    const auto files = std::exchange(_writingFiles, {});
+    continueWriting();
+    // Last, finishing the jobs may commit the transaction right away
+    notify(files, true);
+}
+
+void EncryptedFolderTransaction::slotMetadataWriteError(const QByteArray &folderId, int httpReturnCode)
+{
+    qCWarning(lcEncryptedFolderTransaction) << "Writing the metadata of" << _localPath << folderId << "failed:" << httpReturnCode;
+    _writingMetadata = false;
+    _metadataWriteFailed = true;
+    // The deletions in the failed write are still missing on the server
+    _metadataChanged = true;
+
+    const auto files = std::exchange(_writingFiles, {});
+    removeUploadedFiles(files);
+    continueWriting();
+    notify(files, false);
+}
+
+void EncryptedFolderTransaction::continueWriting()
+{
+    if (!_queuedFiles.isEmpty()) {
+        writeMetadata();
+        return;
+    }
+    continueCommit();
+}
+
+void EncryptedFolderTransaction::notify(const QVector<UploadedFile> &files, bool success)
+{
+    for (const auto &file : files) {
+        if (file.context) {
+            file.done(success);
+        }
+    }
+}
+
+void EncryptedFolderTransaction::continueCommit()
+{
+    if (_state != State::Committing || _writingMetadata || _pendingDeletes > 0 || _folderToken.isEmpty()) {
+        return;
+    }
+    // A write failed before, don't try again for the deletions alone
+    if (_metadataChanged && !_metadataWriteFailed) {
+        writeMetadata();
+        return;
+    }
+    unlockFolder();
+}
+
+void EncryptedFolderTransaction::removeUploadedFiles(const QVector<UploadedFile> &files)
+{
+    // The server has the files, but not the keys to decrypt them
+    for (const auto &file : files) {
+        _metadata->removeEncryptedFile(file.file);
+        _propagator->_journal->deleteFileRecord(file.localFile, true);
+
+        auto job = new DeleteJob(_propagator->account(), _propagator->fullRemotePath(file.remoteFile), this);
+        job->setFolderToken(_folderToken);
+        connect(job, &DeleteJob::finishedSignal, this, [this, job, file] {
+            const auto error = job->reply()->error();
+            if (error != QNetworkReply::NoError && error != QNetworkReply::ContentNotFoundError) {
+                qCWarning(lcEncryptedFolderTransaction) << "Couldn't remove undecryptable file" << file.remoteFile << job->errorString();
+            }
+            --_pendingDeletes;
+            continueCommit();
+        });
+        ++_pendingDeletes;
+        job->start();
+    }
+    _propagator->_anotherSyncNeeded = true;
+}
+
+void EncryptedFolderTransaction::unlockFolder()
+{
+    const auto finish = [this] {
+        if (_state == State::Committing) {
+            _state = State::Committed;
+            emit committed(!_metadataWriteFailed);
+        }
+    };
+
+    qCDebug(lcEncryptedFolderTransaction) << "Unlocking folder" << _localPath << _folderId;
+    auto unlockJob = new UnlockEncryptFolderApiJob(_propagator->account(), _folderId, _folderToken, _propagator->_journal, this);
+    _folderId.clear();
+    _folderToken.clear();
+    connect(unlockJob, &UnlockEncryptFolderApiJob::success, this, finish);
+    connect(unlockJob, &UnlockEncryptFolderApiJob::error, this, [this, finish](const QByteArray &folderId, int httpStatus) {
+        // The token stays in the journal, the next sync unlocks the folder
+        qCWarning(lcEncryptedFolderTransaction) << "Unlocking folder" << _localPath << folderId << "failed:" << httpStatus;
+        finish();
+    });
+    unlockJob->start();
+}
+
+void EncryptedFolderTransaction::fail()
+{
+    _state = State::Failed;
+    emit failed();
+}
+
+}
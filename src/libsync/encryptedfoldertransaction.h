@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) by Nextcloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#pragma once
+
+#include <QObject>
+#include <QPointer>
+#include <QScopedPointer>
+#include <QString>
+#include <QVector>
+
+#include "owncloudlib.h"
+#include "clientsideencryption.h"
+
+#include <functional>
+
+class QNetworkReply;
+
+namespace OCC {
+
+class OwncloudPropagator;
+
+/**
+ * @brief One lock for all changes in an encrypted folder
+ *
+ * Uploads, new directories and deletions in an encrypted folder share the
+ * transaction of that folder: the first job locks the folder and fetches its
+ * metadata, the following jobs reuse both and send their requests with the
+ * same token. Once the directory's propagation is done, commit() unlocks the
+ * folder.
+ *
+ * An upload is only reported as successful once the metadata listing it was
+ * written, see fileUploaded(). Uploads finishing while the metadata is being
+ * written share the next write. Deletions only change metadata() in memory,
+ * it is written with the next upload or by commit().
+ *
+ * See OwncloudPropagator::encryptedFolderTransaction().
+ *
+ * @ingroup libsync
+ */
+class OWNCLOUDSYNC_EXPORT EncryptedFolderTransaction : public QObject
+{
+    Q_OBJECT
+public:
+    enum class State {
+        Idle,
+        Locking,
+        Ready,
+        Failed,
+        Committing,
+        Committed,
+    };
+    Q_ENUM(State)
+
+    EncryptedFolderTransaction(OwncloudPropagator *propagator,
+        const QString &localPath,
+        const QString &remotePath,
+        FolderMetadata::RequiredMetadataVersion requiredMetadataVersion,
+        QObject *parent = nullptr);
+    ~EncryptedFolderTransaction() override;
+
+    /// The folder, relative to the sync folder
+    [[nodiscard]] QString localPath() const { return _localPath; }
+    [[nodiscard]] State state() const { return _state; }
+
+    /**
+     * Locks the folder and fetches its metadata, unless that already happened.
+     *
+     * Emits ready() or failed(). A failed transaction may be started again.
+     */
+    void start();
+
+    /// The metadata of the folder, valid while the transaction is ready
+    [[nodiscard]] FolderMetadata *metadata() const { return _metadata.data(); }
+    [[nodiscard]] QByteArray folderId() const { return _folderId; }
+    [[nodiscard]] QByteArray folderToken() const { return _folderToken; }
+
+    /**
+     * The file or directory @a localFile was uploaded to @a remoteFile: adds
+     * @a file to metadata() and writes the metadata.
+     *
+     * Calls @a done in the context of @a context once the metadata was
+     * written. If that failed, @a done gets false and the file is removed
+     * from the metadata and from the server again, as nobody could decrypt
+     * it. Its journal record is dropped so the next sync uploads it again.
+     */
+    void fileUploaded(const EncryptedFile &file,
+        const QString &localFile,
+        const QString &remoteFile,
+        QObject *context,
+        const std::function<void(bool)> &done);
+
+    /// An entry was removed from metadata() for a deleted file
+    void fileDeleted();
+
+    /**
+     * Waits for the metadata writes, writes metadata() if it still changed
+     * and unlocks the folder.
+     *
+     * Emits committed() when done; it tells whether all metadata was written.
+     */
+    void commit();
+
+signals:
+    void ready();
+    void failed();
+    void committed(bool success);
+
+private:
+    void slotFolderIdReceived(const QStringList &list);
+    void slotFolderIdError(QNetworkReply *reply);
+    void slotFolderLocked(const QByteArray &folderId, const QByteArray &token);
+    void slotFolderLockError(const QByteArray &folderId, int httpErrorCode);
+    void slotMetadataReceived(const QJsonDocument &json, int statusCode);
+    void slotMetadataError(const QByteArray &folderId, int httpReturnCode);
+    void writeMetadata();
+    void slotMetadataWritten();
+    void slotMetadataWriteError(const QByteArray &folderId, int httpReturnCode);
+    void continueWriting();
+    void continueCommit();
+    void unlockFolder();
+    void fail();
+
+    struct UploadedFile
+    {
+        EncryptedFile file;
+        QString localFile;
+        QString remoteFile;
+        QPointer<QObject> context;
+        std::function<void(bool)> done;
+    };
+
+    void removeUploadedFiles(const QVector<UploadedFile> &files);
+    static void notify(const QVector<UploadedFile> &files, bool success);
+
+    OwncloudPropagator *_propagator;
+    QString _localPath;
+    QString _remotePath;
+    FolderMetadata::RequiredMetadataVersion _requiredMetadataVersion;
+    State _state = State::Idle;
+
+    QByteArray _folderId;
+    QByteArray _folderToken;
+    QScopedPointer<FolderMetadata> _metadata;
+    bool _metadataExistsOnServer = true;
+    bool _metadataChanged = false;
+    bool _metadataWriteFailed = false;
+    bool _writingMetadata = false;
+    int _pendingDeletes = 0;
+    /// Uploaded files waiting for the next write of the metadata
+    QVector<UploadedFile> _queuedFiles;
+    /// Uploaded files in the write that is running
+    QVector<UploadedFile> _writingFiles;
+};
+
+}
@@ -25,6 +25,12 @@
 #include "vio/csync_vio_local.h"
 #include "std/c_time.h"
 
+#ifdef Q_OS_LINUX
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#endif
+
 namespace OCC {
 
 bool FileSystem::fileEquals(const QString &fn1, const QString &fn2)
@@ -189,5 +195,24 @@ bool FileSystem::getInode(const QString &filename, quint64 *inode)
     return false;
 }
 
+bool FileSystem::preallocate(QFile &file, qint64 size)
+{
+#ifdef Q_OS_LINUX
+    if (size <= 0 || file.handle() == -1) {
+        return false;
+    }
+    // FALLOC_FL_KEEP_SIZE: the size of the file is what resuming a download relies on
+    if (fallocate(file.handle(), FALLOC_FL_KEEP_SIZE, 0, size) != 0) {
+        // Not supported by all file systems, nothing to worry about
+        qCDebug(lcFileSystem) << "Could not preallocate" << size << "bytes for" << file.fileName() << strerror(errno);
+        return false;
+    }
+    return true;
+#else
+    Q_UNUSED(file);
+    Q_UNUSED(size);
+    return false;
+#endif
+}
 
 } // namespace OCC
@@ -21,6 +21,8 @@
 #include <functional>
 
 #include <owncloudlib.h>
+
+class QFile;
 // Chain in the base include and extend the namespace
 #include "common/filesystembase.h"
 
@@ -96,6 +98,13 @@ namespace FileSystem {
     bool OWNCLOUDSYNC_EXPORT removeRecursively(const QString &path,
         const std::function<void(const QString &path, bool isDir)> &onDeleted = nullptr,
         QStringList *errors = nullptr);
+
+    /**
+     * Reserves disk space for @a size bytes of the open @a file without
+     * changing its size, so a download doesn't fragment the file or run
+     * out of space half way. Only does something where the OS supports it.
+     */
+    bool OWNCLOUDSYNC_EXPORT preallocate(QFile &file, qint64 size);
 }
 
 /** @} */
@@ -0,0 +1,205 @@
+/*
+ * Copyright (C) by Klaas Freitag <freitag@owncloud.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "inotifywatcher.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QLoggingCategory>
+#include <QSocketNotifier>
+#include <QStringList>
+#include <QVarLengthArray>
+
+#include <cerrno>
+#include <cstring>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+namespace OCC {
+
+Q_LOGGING_CATEGORY(lcInotifyWatcher, "nextcloud.sync.inotifywatcher", QtInfoMsg)
+
+InotifyWatcher::InotifyWatcher(QObject *parent)
+    : QObject(parent)
+{
+    _fd = inotify_init();
+    if (_fd != -1) {
+        _socket.reset(new QSocketNotifier(_fd, QSocketNotifier::Read));
+        connect(_socket.data(), &QSocketNotifier::activated, this, &InotifyWatcher::slotReceivedNotification);
+    } else {
+        qCWarning(lcInotifyWatcher) << "inotify_init() failed:" << strerror(errno);
+    }
+}
+
+InotifyWatcher::~InotifyWatcher()
+{
+    _socket.reset();
+    if (_fd != -1) {
+        close(_fd);
+    }
+}
+
+bool InotifyWatcher::findFoldersBelow(const QDir &dir, QStringList &fullList)
+{
+    if (!(dir.exists() && dir.isReadable())) {
+        qCDebug(lcInotifyWatcher) << "Non existing path coming in:" << dir.absolutePath();
+        return false;
+    }
+
+    bool ok = true;
+    const auto filter = QDir::Dirs | QDir::NoDotAndDotDot | QDir::NoSymLinks | QDir::Hidden;
+    const auto subDirs = dir.entryList(filter);
+    for (const auto &subDir : subDirs) {
+        const QString fullPath = dir.path() + QLatin1Char('/') + subDir;
+        fullList.append(fullPath);
+        ok = findFoldersBelow(QDir(fullPath), fullList) && ok;
+    }
+    return ok;
+}
+
+void InotifyWatcher::registerPath(const QString &path)
+{
+    if (path.isEmpty())
+        return;
+
+    const int wd = inotify_add_watch(_fd, path.toUtf8().constData(),
+        IN_CLOSE_WRITE | IN_ATTRIB | IN_MOVE | IN_CREATE | IN_DELETE | IN_DELETE_SELF | IN_MOVE_SELF | IN_UNMOUNT | IN_ONLYDIR);
+    if (wd > -1) {
+        _watchToPath.insert(wd, path);
+        _pathToWatch.insert(path, wd);
+    } else if (errno == ENOMEM || errno == ENOSPC) {
+        qCWarning(lcInotifyWatcher) << "Running out of inotify watches, could not watch" << path;
+        emit watchesExhausted();
+    }
+}
+
+void InotifyWatcher::addFolderRecursive(const QString &path)
+{
+    if (_fd == -1 || _pathToWatch.contains(path))
+        return;
+
+    int subdirs = 0;
+    qCDebug(lcInotifyWatcher) << "(+) Watcher:" << path;
+
+    registerPath(QDir(path).absolutePath());
+
+    QStringList allSubfolders;
+    if (!findFoldersBelow(QDir(path), allSubfolders)) {
+        qCWarning(lcInotifyWatcher) << "Could not traverse all sub folders of" << path;
+    }
+    for (const auto &subfolder : qAsConst(allSubfolders)) {
+        const QDir folder(subfolder);
+        if (folder.exists() && !_pathToWatch.contains(folder.absolutePath())) {
+            subdirs++;
+            if (_isIgnored && _isIgnored(subfolder)) {
+                qCDebug(lcInotifyWatcher) << "* Not adding" << folder.path();
+                continue;
+            }
+            registerPath(folder.absolutePath());
+        } else {
+            qCDebug(lcInotifyWatcher) << "    `-> discarded:" << folder.path();
+        }
+    }
+
+    if (subdirs > 0) {
+        qCDebug(lcInotifyWatcher) << "    `-> and" << subdirs << "subdirectories";
+    }
+}
+
+void InotifyWatcher::slotReceivedNotification(int fd)
+{
+    QVarLengthArray<char, 2048> buffer(2048);
+    auto len = read(fd, buffer.data(), buffer.size());
+    /**
+      * From inotify documentation:
+      *
+      * The behavior when the buffer given to read(2) is too
+      * small to return information about the next event
+      * depends on the kernel version: in kernels  before 2.6.21,
+      * read(2) returns 0; since kernel 2.6.21, read(2) fails with
+      * the error EINVAL.
+      */
+    while (len < 0 && errno == EINVAL) {
+        // double the buffer size and try again
+        buffer.resize(buffer.size() * 2);
+        len = read(fd, buffer.data(), buffer.size());
+    }
+    if (len <= 0) {
+        return;
+    }
+
+    // iterate events in buffer
+    const auto ulen = static_cast<size_t>(len);
+    const inotify_event *event = nullptr;
+    for (size_t i = 0; i + sizeof(inotify_event) <= ulen; i += sizeof(inotify_event) + event->len) {
+        event = reinterpret_cast<const inotify_event *>(buffer.constData() + i);
+
+        if (event->mask & IN_Q_OVERFLOW) {
+            qCWarning(lcInotifyWatcher) << "inotify event queue overflowed, changes were lost";
+            emit eventsLost();
+            continue;
+        }
+
+        // Fire event for the path that was changed.
+        if (event->len == 0 || event->wd <= -1)
+            continue;
+        const auto fileName = QString::fromUtf8(event->name);
+        // Filter out journal changes, they happen during every sync
+        if (fileName.startsWith(QLatin1String("._sync_"))
+            || fileName.startsWith(QLatin1String(".csync_journal.db"))
+            || fileName.startsWith(QLatin1String(".sync_"))) {
+            continue;
+        }
+        const QString p = _watchToPath.value(event->wd) + QLatin1Char('/') + fileName;
+        emit pathChanged(p);
+
+        if ((event->mask & (IN_MOVED_TO | IN_CREATE))
+            && QFileInfo(p).isDir()
+            && !(_isIgnored && _isIgnored(p))) {
+            addFolderRecursive(p);
+        }
+        if (event->mask & (IN_MOVED_FROM | IN_DELETE)) {
+            removeFoldersBelow(p);
+        }
+    }
+}
+
+void InotifyWatcher::removeFoldersBelow(const QString &path)
+{
+    auto it = _pathToWatch.find(path);
+    if (it == _pathToWatch.end())
+        return;
+
+    const QString pathSlash = path + QLatin1Char('/');
+
+    // Remove the entry and all subentries
+    while (it != _pathToWatch.end()) {
+        const auto itPath = it.key();
+        if (!itPath.startsWith(path))
+            break;
+        if (itPath != path && !itPath.startsWith(pathSlash)) {
+            // order is 'foo', 'foo bar', 'foo/bar'
+            ++it;
+            continue;
+        }
+
+        const auto wid = it.value();
+        inotify_rm_watch(_fd, wid);
+        _watchToPath.remove(wid);
+        it = _pathToWatch.erase(it);
+        qCDebug(lcInotifyWatcher) << "Removed watch for" << itPath;
+    }
+}
+
+}
@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) by Klaas Freitag <freitag@owncloud.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#pragma once
+
+#include "owncloudlib.h"
+
+#include <QObject>
+#include <QString>
+#include <QHash>
+#include <QMap>
+#include <QScopedPointer>
+
+#include <functional>
+
+class QDir;
+class QSocketNotifier;
+
+namespace OCC {
+
+/**
+ * @brief Recursively watches a directory tree with inotify
+ *
+ * One watch is registered per directory. Directories that appear are
+ * watched as well, watches of removed directories are dropped. Changes
+ * of the sync journal are not reported.
+ *
+ * Used by the client's FolderWatcher and by the daemon mode of nextcloudcmd.
+ *
+ * @ingroup libsync
+ */
+class OWNCLOUDSYNC_EXPORT InotifyWatcher : public QObject
+{
+    Q_OBJECT
+public:
+    explicit InotifyWatcher(QObject *parent = nullptr);
+    ~InotifyWatcher() override;
+
+    /// False if inotify could not be initialized
+    [[nodiscard]] bool isValid() const { return _fd != -1; }
+
+    /// Subdirectories the callback returns true for are not watched
+    void setPathIgnoredCallback(const std::function<bool(const QString &)> &isIgnored) { _isIgnored = isIgnored; }
+
+    /// Watches the directory and all directories below it
+    void addFolderRecursive(const QString &path);
+
+    [[nodiscard]] int watchCount() const { return _pathToWatch.size(); }
+
+signals:
+    /// A file or directory was modified, created, moved or removed
+    void pathChanged(const QString &path);
+
+    /// A directory could not be watched because the inotify watches are exhausted
+    void watchesExhausted();
+
+    /// The kernel's event queue overflowed, changes were lost
+    void eventsLost();
+
+protected:
+    // attention: result list passed by reference!
+    bool findFoldersBelow(const QDir &dir, QStringList &fullList);
+    void removeFoldersBelow(const QString &path);
+
+private slots:
+    void slotReceivedNotification(int fd);
+
+private:
+    void registerPath(const QString &path);
+
+    int _fd = -1;
+    QScopedPointer<QSocketNotifier> _socket;
+    QHash<int, QString> _watchToPath;
+    QMap<QString, int> _pathToWatch;
+    std::function<bool(const QString &)> _isIgnored;
+};
+
+}
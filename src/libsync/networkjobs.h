@@ -149,6 +149,13 @@ public:
     void setProperties(QList<QByteArray> properties);
     [[nodiscard]] QList<QByteArray> properties() const;
 
+    /**
+     * The "Depth" header of the request, "1" by default.
+     *
+     * With "infinity" directoryListingIterated() is emitted for the whole subtree.
+     */
+    void setDepth(const QByteArray &depth) { _depth = depth; }
+
 signals:
     void directoryListingSubfolders(const QStringList &items);
     void directoryListingIterated(const QString &name, const QMap<QString, QString> &properties);
@@ -161,6 +168,7 @@ private slots:
 private:
     QList<QByteArray> _properties;
     QUrl _url; // Used instead of path() if the url is specified in the constructor
+    QByteArray _depth = QByteArrayLiteral("1");
 };
 
 /**
@@ -21,7 +21,9 @@
 #include "propagateremotedelete.h"
 #include "propagateremotemove.h"
 #include "propagateremotemkdir.h"
+#include "propagateremotecopy.h"
 #include "bulkpropagatorjob.h"
+#include "encryptedfoldertransaction.h"
 #include "updatefiledropmetadata.h"
 #include "propagatorjobs.h"
 #include "filesystem.h"
@@ -84,12 +86,11 @@ OwncloudPropagator::~OwncloudPropagator() = default;
 
 int OwncloudPropagator::maximumActiveTransferJob()
 {
-    if (_downloadLimit != 0
-        || _uploadLimit != 0
-        || !_syncOptions._parallelNetworkJobs) {
-        // disable parallelism when there is a network limit.
+    if (!_syncOptions._parallelNetworkJobs) {
         return 1;
     }
+    // Network limits don't need to disable parallelism: the bandwidth manager
+    // shares one token bucket between all transfers.
     return qMin(3, qCeil(_syncOptions._parallelNetworkJobs / 2.));
 }
 
@@ -368,6 +369,9 @@ PropagateItemJob *OwncloudPropagator::createJob(const SyncFileItemPtr &item)
             job->setDeleteExistingFolder(deleteExisting);
             return job;
         } else {
+            if (!item->_remoteCopyCandidates.isEmpty() && !deleteExisting) {
+                return new PropagateRemoteCopy(this, item);
+            }
             if (deleteExisting || !isDelayedUploadItem(item)) {
                 auto job = createUploadJob(item, deleteExisting);
                 return job.release();
@@ -479,7 +483,7 @@ void OwncloudPropagator::adjustDeletedFoldersWithNewChildren(SyncFileItemVector
     }
 }
 
-qint64 OwncloudPropagator::smallFileSize()
+qint64 OwncloudPropagator::smallFileSize() const
 {
     const qint64 smallFileSize = 100 * 1024; //default to 1 MB. Not dynamic right now.
     return smallFileSize;
@@ -489,12 +493,23 @@ void OwncloudPropagator::start(SyncFileItemVector &&items)
 {
     Q_ASSERT(std::is_sorted(items.begin(), items.end()));
 
-    _abortRequested = false;
+    if (_rootJob && _discoveryBarrier) {
+        // The propagation was started by appendDiscoveredItems(), these are the remaining items
+        adjustDeletedFoldersWithNewChildren(items);
 
-    /* This builds all the jobs needed for the propagation.
-     * Each directory is a PropagateDirectory job, which contains the files in it.
-     * In order to do that we loop over the items. (which are sorted by destination)
-     * When we enter a directory, we can create the directory job and push it on the stack. */
+        QVector<PropagatorJob *> directoriesToRemove;
+        appendJobsForItems(items, directoriesToRemove);
+        foreach (PropagatorJob *it, directoriesToRemove) {
+            _rootJob->appendDirDeletionJob(it);
+        }
+
+        _discoveryBarrier->release();
+        _discoveryBarrier.clear();
+        scheduleNextJob();
+        return;
+    }
+
+    _abortRequested = false;
 
     const auto regex = syncOptions().fileRegex();
     if (regex.isValid()) {
@@ -527,9 +542,54 @@ void OwncloudPropagator::start(SyncFileItemVector &&items)
 
     resetDelayedUploadTasks();
     _rootJob.reset(new PropagateRootDirectory(this));
+    QVector<PropagatorJob *> directoriesToRemove;
+    appendJobsForItems(items, directoriesToRemove);
+
+    foreach (PropagatorJob *it, directoriesToRemove) {
+        _rootJob->appendDirDeletionJob(it);
+    }
+
+    connect(_rootJob.data(), &PropagatorJob::finished, this, &OwncloudPropagator::emitFinished);
+
+    _jobScheduled = false;
+    scheduleNextJob();
+}
+
+void OwncloudPropagator::appendDiscoveredItems(SyncFileItemVector &&items)
+{
+    Q_ASSERT(std::is_sorted(items.begin(), items.end()));
+
+    if (!_rootJob) {
+        _abortRequested = false;
+        resetDelayedUploadTasks();
+        _rootJob.reset(new PropagateRootDirectory(this));
+
+        // Keeps the root job from finishing before start() hands over the rest of the discovery
+        _discoveryBarrier = new PropagateDiscoveryBarrier(this);
+        _rootJob->appendJob(_discoveryBarrier);
+
+        connect(_rootJob.data(), &PropagatorJob::finished, this, &OwncloudPropagator::emitFinished);
+        _jobScheduled = false;
+    }
+    ENFORCE(_discoveryBarrier, "Discovered items appended after the discovery finished");
+
+    QVector<PropagatorJob *> directoriesToRemove;
+    appendJobsForItems(items, directoriesToRemove);
+    // Deletions must wait for the end of the discovery, see SyncEngine::slotSubtreeDiscovered()
+    ENFORCE(directoriesToRemove.isEmpty());
+
+    scheduleNextJob();
+}
+
+void OwncloudPropagator::appendJobsForItems(const SyncFileItemVector &items, QVector<PropagatorJob *> &directoriesToRemove)
+{
+    /* This builds all the jobs needed for the propagation.
+     * Each directory is a PropagateDirectory job, which contains the files in it.
+     * In order to do that we loop over the items. (which are sorted by destination)
+     * When we enter a directory, we can create the directory job and push it on the stack. */
+
     QStack<QPair<QString /* directory name */, PropagateDirectory * /* job */>> directories;
     directories.push(qMakePair(QString(), _rootJob.data()));
-    QVector<PropagatorJob *> directoriesToRemove;
     QString removedDirectory;
     QString maybeConflictDirectory;
     foreach (const SyncFileItemPtr &item, items) {
@@ -594,15 +654,6 @@ void OwncloudPropagator::start(SyncFileItemVector &&items)
                                  maybeConflictDirectory);
         }
     }
-
-    foreach (PropagatorJob *it, directoriesToRemove) {
-        _rootJob->appendDirDeletionJob(it);
-    }
-
-    connect(_rootJob.data(), &PropagatorJob::finished, this, &OwncloudPropagator::emitFinished);
-
-    _jobScheduled = false;
-    scheduleNextJob();
 }
 
 void OwncloudPropagator::startDirectoryPropagation(const SyncFileItemPtr &item,
@@ -813,7 +864,7 @@ void OwncloudPropagator::scheduleNextJobImpl()
     _jobScheduled = false;
 
     if (_activeJobList.count() < maximumActiveTransferJob()) {
-        if (_rootJob->scheduleSelfOrChild()) {
+        if (scheduleByPriority(PropagatorJob::BulkPriority)) {
             scheduleNextJob();
         }
     } else if (_activeJobList.count() < hardMaximumActiveJob()) {
@@ -829,11 +880,109 @@ void OwncloudPropagator::scheduleNextJobImpl()
         }
         if (_activeJobList.count() < maximumActiveTransferJob() + likelyFinishedQuicklyCount) {
             qCDebug(lcPropagator) << "Can pump in another request! activeJobs =" << _activeJobList.count();
-            if (_rootJob->scheduleSelfOrChild()) {
+            if (scheduleByPriority(PropagatorJob::BulkPriority)) {
                 scheduleNextJob();
             }
+        } else if (scheduleByPriority(PropagatorJob::UserTriggeredPriority)) {
+            // What the user is waiting for doesn't queue up behind long transfers
+            qCDebug(lcPropagator) << "Started a user triggered job, activeJobs =" << _activeJobList.count();
+            scheduleNextJob();
+        }
+    }
+}
+
+bool OwncloudPropagator::scheduleByPriority(PropagatorJob::Priority leastUrgent)
+{
+    // A single walk over the job tree: queued jobs and user triggered tasks are started
+    // as soon as they are found, the other tasks once the most urgent one is known
+    _schedulingPriority = leastUrgent;
+    _schedulingCandidate.clear();
+    auto started = _rootJob->scheduleSelfOrChild();
+    if (!started && _schedulingCandidate) {
+        started = _schedulingCandidate->startNextTask();
+    }
+    _schedulingCandidate.clear();
+    _schedulingPriority = PropagatorJob::BulkPriority;
+    return started;
+}
+
+bool OwncloudPropagator::mayStartJob(const PropagatorJob &job) const
+{
+    if (_schedulingPriority > PropagatorJob::UserTriggeredPriority) {
+        return true;
+    }
+
+    SyncFileItemPtr item;
+    if (const auto directoryJob = qobject_cast<const PropagateDirectory *>(&job)) {
+        item = directoryJob->_item;
+    } else if (const auto itemJob = qobject_cast<const PropagateItemJob *>(&job)) {
+        item = itemJob->_item;
+    }
+    if (!item) {
+        return false;
+    }
+    if (priorityForItem(*item) == PropagatorJob::UserTriggeredPriority) {
+        return true;
+    }
+    const auto prefix = item->destination() + QLatin1Char('/');
+    return std::any_of(_userTriggeredPaths.cbegin(), _userTriggeredPaths.cend(), [&prefix](const QString &path) {
+        return path.startsWith(prefix);
+    });
+}
+
+bool OwncloudPropagator::offerTask(PropagatorCompositeJob *composite, PropagatorJob::Priority priority, std::chrono::steady_clock::time_point queuedAt)
+{
+    if (priority == PropagatorJob::UserTriggeredPriority) {
+        return true;
+    }
+    if (!_schedulingCandidate || priority < _candidatePriority
+        || (priority == _candidatePriority && queuedAt < _candidateQueuedAt)) {
+        _schedulingCandidate = composite;
+        _candidatePriority = priority;
+        _candidateQueuedAt = queuedAt;
+    }
+    return false;
+}
+
+PropagatorJob::Priority OwncloudPropagator::priorityForItem(const SyncFileItem &item) const
+{
+    if (!_userTriggeredPaths.empty()) {
+        auto path = item.destination();
+        while (!path.isEmpty()) {
+            if (_userTriggeredPaths.find(path) != _userTriggeredPaths.end()) {
+                return PropagatorJob::UserTriggeredPriority;
+            }
+            path.truncate(qMax(path.lastIndexOf(QLatin1Char('/')), 0));
         }
     }
+
+    const auto transfersContents = !item.isDirectory()
+        && item._type != ItemTypeVirtualFile
+        && (item._instruction == CSYNC_INSTRUCTION_NEW
+            || item._instruction == CSYNC_INSTRUCTION_SYNC
+            || item._instruction == CSYNC_INSTRUCTION_CONFLICT
+            || item._instruction == CSYNC_INSTRUCTION_TYPE_CHANGE);
+    if (!transfersContents) {
+        return PropagatorJob::MetadataPriority;
+    }
+
+    return item._size < smallFileSize() ? PropagatorJob::SmallFilePriority : PropagatorJob::BulkPriority;
+}
+
+std::chrono::milliseconds OwncloudPropagator::priorityDeadline(PropagatorJob::Priority priority)
+{
+    using namespace std::chrono_literals;
+    switch (priority) {
+    case PropagatorJob::UserTriggeredPriority:
+    case PropagatorJob::MetadataPriority:
+        return 0ms;
+    case PropagatorJob::SmallFilePriority:
+        return 10s;
+    case PropagatorJob::BulkPriority:
+    case PropagatorJob::PriorityCount:
+        break;
+    }
+    return 60s;
 }
 
 void OwncloudPropagator::reportProgress(const SyncFileItem &item, qint64 bytes)
@@ -1059,6 +1208,54 @@ void OwncloudPropagator::clearDelayedTasks()
     _delayedTasks.clear();
 }
 
+EncryptedFolderTransaction *OwncloudPropagator::encryptedFolderTransaction(const QString &localPath,
+    const QString &remotePath,
+    SyncFileItem::EncryptionStatus encryptionStatus)
+{
+    auto &transaction = _encryptedFolderTransactions[localPath];
+    if (!transaction) {
+        const auto requiredMetadataVersion = encryptionStatus == SyncFileItem::EncryptionStatus::EncryptedMigratedV1_2
+            ? FolderMetadata::RequiredMetadataVersion::Version1_2
+            : FolderMetadata::RequiredMetadataVersion::Version1;
+        transaction = new EncryptedFolderTransaction(this, localPath, remotePath, requiredMetadataVersion, this);
+    }
+    return transaction;
+}
+
+bool OwncloudPropagator::commitEncryptedFolderTransactions(const QString &localPath, QObject *context, const std::function<void(bool)> &done)
+{
+    QVector<EncryptedFolderTransaction *> transactions;
+    for (auto it = _encryptedFolderTransactions.begin(); it != _encryptedFolderTransactions.end();) {
+        if (localPath.isEmpty() || it.key() == localPath || it.key().startsWith(localPath + QLatin1Char('/'))) {
+            transactions.append(it.value());
+            it = _encryptedFolderTransactions.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    if (transactions.isEmpty()) {
+        return false;
+    }
+
+    struct CommitStatus {
+        int pending = 0;
+        bool success = true;
+    };
+    const auto status = QSharedPointer<CommitStatus>::create();
+    status->pending = transactions.size();
+    for (const auto transaction : qAsConst(transactions)) {
+        connect(transaction, &EncryptedFolderTransaction::committed, context, [transaction, status, done](bool success) {
+            transaction->deleteLater();
+            status->success &= success;
+            if (--status->pending == 0) {
+                done(status->success);
+            }
+        });
+        transaction->commit();
+    }
+    return true;
+}
+
 void OwncloudPropagator::addToBulkUploadBlackList(const QString &file)
 {
     qCDebug(lcPropagator) << "black list for bulk upload" << file;
@@ -1168,6 +1365,71 @@ void PropagatorCompositeJob::appendJob(PropagatorJob *job)
     _jobsToDo.append(job);
 }
 
+void PropagatorCompositeJob::appendTask(const SyncFileItemPtr &item)
+{
+    _tasksToDo[propagator()->priorityForItem(*item)].push_back({ item, std::chrono::steady_clock::now() });
+}
+
+bool PropagatorCompositeJob::hasTasksToDo() const
+{
+    return std::any_of(_tasksToDo.cbegin(), _tasksToDo.cend(), [](const std::deque<QueuedTask> &tasks) {
+        return !tasks.empty();
+    });
+}
+
+int PropagatorCompositeJob::nextTaskClass(Priority *priority) const
+{
+    const auto now = std::chrono::steady_clock::now();
+    auto taskClass = static_cast<int>(PriorityCount);
+    *priority = PriorityCount;
+    for (int i = 0; i < PriorityCount; ++i) {
+        const auto &tasks = _tasksToDo[i];
+        if (tasks.empty()) {
+            continue;
+        }
+
+        // Each class is in queue order, so only the first task can have waited too long
+        auto classPriority = static_cast<Priority>(i);
+        if (classPriority > MetadataPriority
+            && now - tasks.front().queuedAt >= OwncloudPropagator::priorityDeadline(classPriority)) {
+            classPriority = MetadataPriority;
+        }
+        if (classPriority < *priority
+            || (classPriority == *priority && tasks.front().queuedAt < _tasksToDo[taskClass].front().queuedAt)) {
+            taskClass = i;
+            *priority = classPriority;
+        }
+    }
+    return taskClass;
+}
+
+SyncFileItemPtr PropagatorCompositeJob::takeNextTask()
+{
+    auto priority = PriorityCount;
+    const auto taskClass = nextTaskClass(&priority);
+    if (taskClass == PriorityCount || priority > propagator()->schedulingPriority()) {
+        return {};
+    }
+    auto &tasks = _tasksToDo[taskClass];
+    const auto item = tasks.front().item;
+    tasks.pop_front();
+    return item;
+}
+
+bool PropagatorCompositeJob::startNextTask()
+{
+    while (const auto nextTask = takeNextTask()) {
+        PropagatorJob *job = propagator()->createJob(nextTask);
+        if (!job) {
+            qCWarning(lcDirectory) << "Useless task found for file" << nextTask->destination() << "instruction" << nextTask->_instruction;
+            continue;
+        }
+        job->setAssociatedComposite(this);
+        return startJob(job);
+    }
+    return false;
+}
+
 bool PropagatorCompositeJob::scheduleSelfOrChild()
 {
     if (_state == Finished) {
@@ -1196,29 +1458,29 @@ bool PropagatorCompositeJob::scheduleSelfOrChild()
     }
 
     // Now it's our turn, check if we have something left to do.
-    // First, convert a task to a job if necessary
-    while (_jobsToDo.isEmpty() && !_tasksToDo.isEmpty()) {
-        SyncFileItemPtr nextTask = _tasksToDo.first();
-        _tasksToDo.remove(0);
-        PropagatorJob *job = propagator()->createJob(nextTask);
-        if (!job) {
-            qCWarning(lcDirectory) << "Useless task found for file" << nextTask->destination() << "instruction" << nextTask->_instruction;
-            continue;
+    // Queued jobs, like the ones of sub directories, go before the tasks
+    for (int i = 0; i < _jobsToDo.size(); ++i) {
+        PropagatorJob *nextJob = _jobsToDo.at(i);
+        if (propagator()->mayStartJob(*nextJob)) {
+            _jobsToDo.remove(i);
+            return startJob(nextJob);
+        }
+        if (nextJob->parallelism() != FullParallelism) {
+            break;
         }
-        appendJob(job);
-        break;
     }
-    // Then run the next job
-    if (!_jobsToDo.isEmpty()) {
-        PropagatorJob *nextJob = _jobsToDo.first();
-        _jobsToDo.remove(0);
-        _runningJobs.append(nextJob);
-        return possiblyRunNextJob(nextJob);
+
+    // Then offer our most urgent task, it may have to wait until the whole tree was visited
+    auto priority = PriorityCount;
+    const auto taskClass = nextTaskClass(&priority);
+    if (taskClass != PriorityCount && priority <= propagator()->schedulingPriority()
+        && propagator()->offerTask(this, priority, _tasksToDo[taskClass].front().queuedAt)) {
+        return startNextTask();
     }
 
     // If neither us or our children had stuff left to do we could hang. Make sure
     // we mark this job as finished so that the propagator can schedule a new one.
-    if (_jobsToDo.isEmpty() && _tasksToDo.isEmpty() && _runningJobs.isEmpty()) {
+    if (_jobsToDo.isEmpty() && !hasTasksToDo() && _runningJobs.isEmpty()) {
         // Our parent jobs are already iterating over their running jobs, post to the event loop
         // to avoid removing ourself from that list while they iterate.
         QMetaObject::invokeMethod(this, "finalize", Qt::QueuedConnection);
@@ -1247,7 +1509,7 @@ void PropagatorCompositeJob::slotSubJobFinished(SyncFileItem::Status status)
         _hasError = status;
     }
 
-    if (_jobsToDo.isEmpty() && _tasksToDo.isEmpty() && _runningJobs.isEmpty()) {
+    if (_jobsToDo.isEmpty() && !hasTasksToDo() && _runningJobs.isEmpty()) {
         finalize();
     } else {
         propagator()->scheduleNextJob();
@@ -1346,6 +1608,10 @@ void PropagateDirectory::slotFirstJobFinished(SyncFileItem::Status status)
 
 void PropagateDirectory::slotSubJobsFinished(SyncFileItem::Status status)
 {
+    if (commitEncryptedFolderTransactions(status)) {
+        return;
+    }
+
     if (!_item->isEmpty() && status == SyncFileItem::Success) {
         // If a directory is renamed, recursively delete any stale items
         // that may still exist below the old path.
@@ -1397,6 +1663,20 @@ void PropagateDirectory::slotSubJobsFinished(SyncFileItem::Status status)
     emit finished(status);
 }
 
+bool PropagateDirectory::commitEncryptedFolderTransactions(SyncFileItem::Status status)
+{
+    // Once all jobs below this directory are done, the encrypted folders they
+    // changed are unlocked, see EncryptedFolderTransaction
+    return propagator()->commitEncryptedFolderTransactions(_item->destination(), this, [this, status](bool success) {
+        auto result = status;
+        if (!success && status == SyncFileItem::Success) {
+            result = _item->_status = SyncFileItem::NormalError;
+            _item->_errorString = tr("Failed to update the metadata of an encrypted folder");
+        }
+        slotSubJobsFinished(result);
+    });
+}
+
 PropagateRootDirectory::PropagateRootDirectory(OwncloudPropagator *propagator)
     : PropagateDirectory(propagator, SyncFileItemPtr(new SyncFileItem))
     , _dirDeletionJobs(propagator)
@@ -1482,6 +1762,10 @@ void PropagateRootDirectory::slotSubJobsFinished(SyncFileItem::Status status)
         return;
     }
 
+    if (commitEncryptedFolderTransactions(status)) {
+        return;
+    }
+
     if (status != SyncFileItem::Success
         && status != SyncFileItem::Restoration
         && status != SyncFileItem::BlacklistedError
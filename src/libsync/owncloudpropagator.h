@@ -29,11 +29,16 @@
 #include "syncfileitem.h"
 #include "common/syncjournaldb.h"
 #include "bandwidthmanager.h"
+#include "bandwidthschedule.h"
 #include "accountfwd.h"
 #include "syncoptions.h"
 #include "progressdispatcher.h"
 
+#include <array>
+#include <chrono>
 #include <deque>
+#include <functional>
+#include <set>
 
 namespace OCC {
 
@@ -100,6 +105,25 @@ public:
 
     Q_ENUM(JobParallelism)
 
+    /** Scheduling classes of the items of a composite job, most urgent first.
+     *
+     * See OwncloudPropagator::priorityForItem().
+     */
+    enum Priority {
+        /** Paths the user just touched or explicitly asked to sync */
+        UserTriggeredPriority,
+        /** Operations that don't transfer file contents */
+        MetadataPriority,
+        /** Transfers below OwncloudPropagator::smallFileSize() */
+        SmallFilePriority,
+        /** Everything else */
+        BulkPriority,
+
+        PriorityCount
+    };
+
+    Q_ENUM(Priority)
+
     [[nodiscard]] virtual JobParallelism parallelism() const { return FullParallelism; }
 
     /**
@@ -235,8 +259,15 @@ class PropagatorCompositeJob : public PropagatorJob
 {
     Q_OBJECT
 public:
+    struct QueuedTask
+    {
+        SyncFileItemPtr item;
+        std::chrono::steady_clock::time_point queuedAt;
+    };
+
     QVector<PropagatorJob *> _jobsToDo;
-    SyncFileItemVector _tasksToDo;
+    // Items that still need a job, grouped by their Priority, oldest first
+    std::array<std::deque<QueuedTask>, PriorityCount> _tasksToDo;
     QVector<PropagatorJob *> _runningJobs;
     SyncFileItem::Status _hasError = SyncFileItem::NoStatus; // NoStatus,  or NormalError / SoftError if there was an error
     quint64 _abortsCount = 0;
@@ -252,14 +283,17 @@ public:
     ~PropagatorCompositeJob() override = default;
 
     void appendJob(PropagatorJob *job);
-    void appendTask(const SyncFileItemPtr &item)
-    {
-        _tasksToDo.append(item);
-    }
+    void appendTask(const SyncFileItemPtr &item);
+    [[nodiscard]] bool hasTasksToDo() const;
 
     bool scheduleSelfOrChild() override;
     [[nodiscard]] JobParallelism parallelism() const override;
 
+    /** Creates and starts a job for the most urgent task, see OwncloudPropagator::offerTask().
+     * returns true if a job was started.
+     */
+    bool startNextTask();
+
     /*
      * Abort synchronously or asynchronously - some jobs
      * require to be finished without immediete abort (abort on job might
@@ -295,6 +329,25 @@ private slots:
 
     void slotSubJobFinished(OCC::SyncFileItem::Status status);
     void finalize();
+
+private:
+    bool startJob(PropagatorJob *job)
+    {
+        _runningJobs.append(job);
+        return possiblyRunNextJob(job);
+    }
+
+    /** The class of the most urgent task, or PriorityCount if there are no tasks.
+     *
+     * Tasks that waited longer than the deadline of their class count as
+     * MetadataPriority, the effective priority is returned in priority.
+     */
+    [[nodiscard]] int nextTaskClass(Priority *priority) const;
+
+    /** Takes the most urgent task, unless it is less urgent than the propagator
+     * currently schedules, see OwncloudPropagator::schedulingPriority().
+     */
+    SyncFileItemPtr takeNextTask();
 };
 
 /**
@@ -354,6 +407,9 @@ private slots:
     void slotFirstJobFinished(OCC::SyncFileItem::Status status);
     virtual void slotSubJobsFinished(OCC::SyncFileItem::Status status);
 
+protected:
+    /// Returns true if encrypted folder transactions are committed; slotSubJobsFinished() is called again afterwards
+    bool commitEncryptedFolderTransactions(SyncFileItem::Status status);
 };
 
 /**
@@ -406,7 +462,66 @@ public:
     void start() override;
 };
 
+/**
+ * @brief Placeholder job that keeps its composite from finishing while discovery runs
+ * @ingroup libsync
+ *
+ * Used for pipelined propagation: subtrees are appended to the root job as
+ * they get discovered and release() is called once the last items were
+ * appended, see OwncloudPropagator::appendDiscoveredItems().
+ */
+class PropagateDiscoveryBarrier : public PropagatorJob
+{
+    Q_OBJECT
+public:
+    explicit PropagateDiscoveryBarrier(OwncloudPropagator *propagator)
+        : PropagatorJob(propagator)
+    {
+    }
+
+    bool scheduleSelfOrChild() override
+    {
+        if (_state != NotYetStarted) {
+            return false;
+        }
+        // There is nothing to run, but returning true lets the jobs queued behind us get scheduled
+        _state = Running;
+        if (_released) {
+            QMetaObject::invokeMethod(this, [this] { finish(); }, Qt::QueuedConnection);
+        }
+        return true;
+    }
+
+    void abort(PropagatorJob::AbortType abortType) override
+    {
+        // No more items will arrive, don't block the root job any longer
+        release();
+        PropagatorJob::abort(abortType);
+    }
+
+    void release()
+    {
+        _released = true;
+        if (_state == Running) {
+            finish();
+        }
+    }
+
+private:
+    void finish()
+    {
+        if (_state == Finished) {
+            return;
+        }
+        _state = Finished;
+        emit finished(SyncFileItem::Success);
+    }
+
+    bool _released = false;
+};
+
 class PropagateUploadFileCommon;
+class EncryptedFolderTransaction;
 
 class OWNCLOUDSYNC_EXPORT OwncloudPropagator : public QObject
 {
@@ -432,8 +547,21 @@ public:
 
     ~OwncloudPropagator() override;
 
+    /** Propagates the items of a sync.
+     *
+     * If appendDiscoveredItems() was used before, these are the items that
+     * were left when the discovery finished.
+     */
     void start(SyncFileItemVector &&_syncedItems);
 
+    /** Starts propagating a fully discovered subtree while the discovery is still running.
+     *
+     * The items must be sorted and must not contain deletions, renames or
+     * type changes. The propagation doesn't finish before start() was called
+     * with the remaining items.
+     */
+    void appendDiscoveredItems(SyncFileItemVector &&items);
+
     void startDirectoryPropagation(const SyncFileItemPtr &item,
                                    QStack<QPair<QString, PropagateDirectory*>> &directories,
                                    QVector<PropagatorJob *> &directoriesToRemove,
@@ -451,6 +579,8 @@ public:
 
     int _downloadLimit = 0;
     int _uploadLimit = 0;
+    BandwidthSchedule _downloadLimitSchedule;
+    BandwidthSchedule _uploadLimitSchedule;
     BandwidthManager _bandwidthManager;
 
     bool _abortRequested = false;
@@ -489,7 +619,7 @@ public:
      * chunk-upload duration set.
      */
     qint64 _chunkSize;
-    qint64 smallFileSize();
+    [[nodiscard]] qint64 smallFileSize() const;
 
     /* The maximum number of active jobs in parallel  */
     int hardMaximumActiveJob();
@@ -524,15 +654,51 @@ public:
      */
     PropagateItemJob *createJob(const SyncFileItemPtr &item);
 
+    std::unique_ptr<PropagateUploadFileCommon> createUploadJob(SyncFileItemPtr item,
+                                                               bool deleteExisting);
+
     void scheduleNextJob();
     void reportProgress(const SyncFileItem &, qint64 bytes);
 
+    /** Paths the user explicitly asked to sync, see SyncEngine::setUserTriggeredPaths().
+     *
+     * Items at or below these paths are scheduled before everything else.
+     */
+    void setUserTriggeredPaths(const std::set<QString> &paths) { _userTriggeredPaths = paths; }
+
+    /** The scheduling class of an item, see PropagatorJob::Priority */
+    [[nodiscard]] PropagatorJob::Priority priorityForItem(const SyncFileItem &item) const;
+
+    /** The least urgent class that may be started in the current scheduling pass */
+    [[nodiscard]] PropagatorJob::Priority schedulingPriority() const { return _schedulingPriority; }
+
+    /** Whether a queued job, like the one of a sub directory, may be started in the current scheduling pass.
+     *
+     * Beyond the transfer limit only jobs for user triggered paths and their parent directories are started.
+     */
+    [[nodiscard]] bool mayStartJob(const PropagatorJob &job) const;
+
+    /** Called by the composite jobs during a scheduling pass with their most urgent task.
+     *
+     * Returns true if no other task can be more urgent and the task should be started
+     * right away. Otherwise the most urgent task offered is started once the whole job
+     * tree was visited.
+     */
+    bool offerTask(PropagatorCompositeJob *composite, PropagatorJob::Priority priority, std::chrono::steady_clock::time_point queuedAt);
+
+    /** How long items of a class may wait before they are promoted to MetadataPriority */
+    static std::chrono::milliseconds priorityDeadline(PropagatorJob::Priority priority);
+
     void abort()
     {
         if (_abortRequested)
             return;
 
         _abortRequested = true;
+
+        // Write the metadata of the files already uploaded into encrypted folders
+        commitEncryptedFolderTransactions({}, this, [](bool) {});
+
         if (_rootJob) {
             // Connect to abortFinished  which signals that abort has been asynchronously finished
             connect(_rootJob.data(), &PropagateDirectory::abortFinished, this, &OwncloudPropagator::emitFinished);
@@ -622,6 +788,25 @@ public:
 
     [[nodiscard]] bool isInBulkUploadBlackList(const QString &file) const;
 
+    /** The transaction shared by the jobs changing the encrypted folder @a localPath
+     *
+     * It is created on first use. @a remotePath is the folder's path on the server,
+     * relative to the sync folder, and @a encryptionStatus tells which metadata
+     * version it needs.
+     */
+    EncryptedFolderTransaction *encryptedFolderTransaction(const QString &localPath,
+        const QString &remotePath,
+        SyncFileItem::EncryptionStatus encryptionStatus);
+
+    /** Commits the encrypted folder transactions at or below @a localPath
+     *
+     * An empty @a localPath commits all of them. Calls @a done in the context
+     * of @a context once they are committed, with whether all metadata could
+     * be written. Returns false, without calling @a done, if there was nothing
+     * to commit.
+     */
+    bool commitEncryptedFolderTransactions(const QString &localPath, QObject *context, const std::function<void(bool)> &done);
+
 private slots:
 
     void abortTimeout()
@@ -642,6 +827,11 @@ private slots:
 
     void scheduleNextJobImpl();
 
+    /** Asks the root job to start something no less urgent than leastUrgent,
+     * the most urgent task of the job tree goes first.
+     */
+    bool scheduleByPriority(PropagatorJob::Priority leastUrgent);
+
 signals:
     void newItem(const OCC::SyncFileItemPtr &);
     void itemCompleted(const SyncFileItemPtr &item, OCC::ErrorCategory category);
@@ -662,17 +852,29 @@ signals:
     void insufficientRemoteStorage();
 
 private:
-    std::unique_ptr<PropagateUploadFileCommon> createUploadJob(SyncFileItemPtr item,
-                                                               bool deleteExisting);
-
     void pushDelayedUploadTask(SyncFileItemPtr item);
 
     void resetDelayedUploadTasks();
 
     static void adjustDeletedFoldersWithNewChildren(SyncFileItemVector &items);
 
+    /** Builds the jobs for the sorted items below the root job.
+     *
+     * Jobs for directory deletions are returned in directoriesToRemove,
+     * since they have to run at the very end.
+     */
+    void appendJobsForItems(const SyncFileItemVector &items, QVector<PropagatorJob *> &directoriesToRemove);
+
     AccountPtr _account;
     QScopedPointer<PropagateRootDirectory> _rootJob;
+    // Set while the root job waits for more items of a running discovery
+    QPointer<PropagateDiscoveryBarrier> _discoveryBarrier;
+    std::set<QString> _userTriggeredPaths;
+    PropagatorJob::Priority _schedulingPriority = PropagatorJob::BulkPriority;
+    // The most urgent task offered in the current scheduling pass, see offerTask()
+    QPointer<PropagatorCompositeJob> _schedulingCandidate;
+    PropagatorJob::Priority _candidatePriority = PropagatorJob::BulkPriority;
+    std::chrono::steady_clock::time_point _candidateQueuedAt;
     SyncOptions _syncOptions;
     bool _jobScheduled = false;
 
@@ -684,6 +886,9 @@ private:
 
     QSet<QString> &_bulkUploadBlackList;
 
+    // Open encrypted folder transactions by local folder path
+    QHash<QString, EncryptedFolderTransaction *> _encryptedFolderTransactions;
+
     static bool _allowDelayedUpload;
 };
 
@@ -32,6 +32,7 @@
 #include <QNetworkAccessManager>
 #include <QFileInfo>
 #include <QDir>
+#include <algorithm>
 #include <cmath>
 
 #ifdef Q_OS_UNIX
@@ -43,6 +44,18 @@ namespace OCC {
 Q_LOGGING_CATEGORY(lcGetJob, "nextcloud.sync.networkjob.get", QtInfoMsg)
 Q_LOGGING_CATEGORY(lcPropagateDownload, "nextcloud.sync.propagator.download", QtInfoMsg)
 
+namespace {
+
+// Keep the buffer of the reply low while the bandwidth is limited, so it
+// doesn't read far ahead of the limit. Otherwise let it read in larger slabs.
+constexpr qint64 limitedReplyReadBufferSize = 16 * 1024;
+constexpr qint64 unlimitedReplyReadBufferSize = 256 * 1024;
+
+// The data is moved from the reply to the file in pieces of this size at most
+constexpr qint64 writeSlabSize = 64 * 1024;
+
+}
+
 // Always coming in with forward slashes.
 // In csync_excluded_no_ctx we ignore all files with longer than 254 chars
 // This function also adds a dot at the beginning of the filename to hide the file on OS X and Linux
@@ -79,9 +92,6 @@ GETFileJob::GETFileJob(AccountPtr account, const QString &path, QIODevice *devic
     , _expectedContentLength(-1)
     , _resumeStart(resumeStart)
     , _errorStatus(SyncFileItem::NoStatus)
-    , _bandwidthLimited(false)
-    , _bandwidthChoked(false)
-    , _bandwidthQuota(0)
     , _bandwidthManager(nullptr)
     , _hasEmittedFinishedSignal(false)
     , _lastModified()
@@ -100,9 +110,6 @@ GETFileJob::GETFileJob(AccountPtr account, const QUrl &url, QIODevice *device,
     , _resumeStart(resumeStart)
     , _errorStatus(SyncFileItem::NoStatus)
     , _directDownloadUrl(url)
-    , _bandwidthLimited(false)
-    , _bandwidthChoked(false)
-    , _bandwidthQuota(0)
     , _bandwidthManager(nullptr)
     , _hasEmittedFinishedSignal(false)
     , _lastModified()
@@ -133,7 +140,7 @@ void GETFileJob::start()
         sendRequest("GET", _directDownloadUrl, req);
     }
 
-    qCDebug(lcGetJob) << _bandwidthManager << _bandwidthChoked << _bandwidthLimited;
+    qCDebug(lcGetJob) << _bandwidthManager;
     if (_bandwidthManager) {
         _bandwidthManager->registerDownloadJob(this);
     }
@@ -143,9 +150,17 @@ void GETFileJob::start()
     AbstractNetworkJob::start();
 }
 
+qint64 GETFileJob::replyReadBufferSize() const
+{
+    if (_bandwidthManager && (_bandwidthManager->usingAbsoluteDownloadLimit() || _bandwidthManager->usingRelativeDownloadLimit() || _bandwidthManager->usingAdaptiveDownloadLimit())) {
+        return limitedReplyReadBufferSize;
+    }
+    return unlimitedReplyReadBufferSize;
+}
+
 void GETFileJob::newReplyHook(QNetworkReply *reply)
 {
-    reply->setReadBufferSize(16 * 1024); // keep low so we can easier limit the bandwidth
+    reply->setReadBufferSize(replyReadBufferSize());
 
     connect(reply, &QNetworkReply::metaDataChanged, this, &GETFileJob::slotMetaDataChanged);
     connect(reply, &QIODevice::readyRead, this, &GETFileJob::slotReadyRead);
@@ -157,7 +172,7 @@ void GETFileJob::slotMetaDataChanged()
 {
     // For some reason setting the read buffer in GETFileJob::start doesn't seem to go
     // through the HTTP layer thread(?)
-    reply()->setReadBufferSize(16 * 1024);
+    reply()->setReadBufferSize(replyReadBufferSize());
 
     int httpStatus = reply()->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
 
@@ -250,69 +265,90 @@ void GETFileJob::slotMetaDataChanged()
         _lastModified = Utility::qDateTimeToTime_t(lastModified.toDateTime());
     }
 
-    _saveBodyToFile = true;
-}
+    if (auto file = qobject_cast<QFile *>(_device); file && _contentLength > 0) {
+        FileSystem::preallocate(*file, _resumeStart + _contentLength);
+    }
+    startInlineChecksums();
 
-void GETFileJob::setBandwidthManager(BandwidthManager *bwm)
-{
-    _bandwidthManager = bwm;
+    _saveBodyToFile = true;
 }
 
-void GETFileJob::setChoked(bool c)
+QByteArray GETFileJob::transmissionChecksumHeader() const
 {
-    _bandwidthChoked = c;
-    QMetaObject::invokeMethod(this, "slotReadyRead", Qt::QueuedConnection);
+    auto checksumHeader = findBestChecksum(reply()->rawHeader(checkSumHeaderC));
+    const auto contentMd5Header = reply()->rawHeader(contentMd5HeaderC);
+    if (checksumHeader.isEmpty() && !contentMd5Header.isEmpty()) {
+        checksumHeader = "MD5:" + contentMd5Header;
+    }
+    return checksumHeader;
 }
 
-void GETFileJob::setBandwidthLimited(bool b)
+void GETFileJob::startInlineChecksums()
 {
-    _bandwidthLimited = b;
-    QMetaObject::invokeMethod(this, "slotReadyRead", Qt::QueuedConnection);
+    _inlineChecksums.clear();
+    // The part downloaded before wasn't seen, so reading the file again is needed anyway
+    if (_resumeStart > 0) {
+        return;
+    }
+    for (const auto &checksumType : {parseChecksumHeaderType(transmissionChecksumHeader()), _contentChecksumType}) {
+        const auto alreadyComputed = std::any_of(_inlineChecksums.cbegin(), _inlineChecksums.cend(), [&checksumType](const ChecksumCalculator &calculator) {
+            return calculator.checksumType() == checksumType;
+        });
+        if (checksumType.isEmpty() || alreadyComputed) {
+            continue;
+        }
+        ChecksumCalculator calculator(checksumType);
+        if (calculator.isValid()) {
+            _inlineChecksums.push_back(std::move(calculator));
+        }
+    }
 }
 
-void GETFileJob::giveBandwidthQuota(qint64 q)
+QByteArray GETFileJob::inlineChecksum(const QByteArray &checksumType) const
 {
-    _bandwidthQuota = q;
-    qCDebug(lcGetJob) << "Got" << q << "bytes";
-    QMetaObject::invokeMethod(this, "slotReadyRead", Qt::QueuedConnection);
+    for (const auto &calculator : _inlineChecksums) {
+        if (calculator.checksumType() == checksumType) {
+            return calculator.result();
+        }
+    }
+    return QByteArray();
 }
 
-qint64 GETFileJob::currentDownloadPosition()
+void GETFileJob::setBandwidthManager(BandwidthManager *bwm)
 {
-    if (_device && _device->pos() > 0 && _device->pos() > qint64(_resumeStart)) {
-        return _device->pos();
-    }
-    return _resumeStart;
+    _bandwidthManager = bwm;
 }
 
 qint64 GETFileJob::writeToDevice(const QByteArray &data)
 {
-    return _device->write(data);
+    const auto writtenBytes = _device->write(data);
+    if (writtenBytes > 0) {
+        for (auto &calculator : _inlineChecksums) {
+            calculator.addData(data.constData(), writtenBytes);
+        }
+    }
+    return writtenBytes;
 }
 
 void GETFileJob::slotReadyRead()
 {
     if (!reply())
         return;
-    int bufferSize = qMin(1024 * 8ll, reply()->bytesAvailable());
-    QByteArray buffer(bufferSize, Qt::Uninitialized);
+    if (_saveBodyToFile && _readBuffer.isEmpty() && reply()->bytesAvailable() > 0) {
+        _readBuffer.resize(writeSlabSize);
+    }
 
     while (reply()->bytesAvailable() > 0 && _saveBodyToFile) {
-        if (_bandwidthChoked) {
-            qCWarning(lcGetJob) << "Download choked";
-            break;
-        }
-        qint64 toRead = bufferSize;
-        if (_bandwidthLimited) {
-            toRead = qMin(qint64(bufferSize), _bandwidthQuota);
+        qint64 toRead = qMin(qint64(_readBuffer.size()), reply()->bytesAvailable());
+        if (_bandwidthManager) {
+            toRead = _bandwidthManager->takeDownloadQuota(this, toRead);
             if (toRead == 0) {
                 qCDebug(lcGetJob) << "Out of quota";
                 break;
             }
-            _bandwidthQuota -= toRead;
         }
 
-        const qint64 readBytes = reply()->read(buffer.data(), toRead);
+        const qint64 readBytes = reply()->read(_readBuffer.data(), toRead);
         if (readBytes < 0) {
             _errorString = networkReplyErrorString(*reply());
             _errorStatus = SyncFileItem::NormalError;
@@ -321,7 +357,7 @@ void GETFileJob::slotReadyRead()
             return;
         }
 
-        const qint64 writtenBytes = writeToDevice(QByteArray::fromRawData(buffer.constData(), readBytes));
+        const qint64 writtenBytes = writeToDevice(QByteArray::fromRawData(_readBuffer.constData(), readBytes));
         if (writtenBytes != readBytes) {
             _errorString = _device->errorString();
             _errorStatus = SyncFileItem::NormalError;
@@ -734,6 +770,7 @@ void PropagateDownloadFile::startDownload()
             &_tmpFile, headers, expectedEtagForResume, _resumeStart, this);
     }
     _job->setBandwidthManager(&propagator()->_bandwidthManager);
+    _job->setContentChecksumType(propagator()->account()->capabilities().preferredUploadChecksumType());
     connect(_job.data(), &GETFileJob::finishedSignal, this, &PropagateDownloadFile::slotGetFinished);
     connect(_job.data(), &GETFileJob::downloadProgress, this, &PropagateDownloadFile::slotDownloadProgress);
     propagator()->_activeJobList.append(this);
@@ -928,11 +965,17 @@ void PropagateDownloadFile::slotGetFinished()
         this, &PropagateDownloadFile::transmissionChecksumValidated);
     connect(validator, &ValidateChecksumHeader::validationFailed,
         this, &PropagateDownloadFile::slotChecksumFail);
-    auto checksumHeader = findBestChecksum(job->reply()->rawHeader(checkSumHeaderC));
-    auto contentMd5Header = job->reply()->rawHeader(contentMd5HeaderC);
-    if (checksumHeader.isEmpty() && !contentMd5Header.isEmpty())
-        checksumHeader = "MD5:" + contentMd5Header;
-    validator->start(_tmpFile.fileName(), checksumHeader);
+    const auto checksumHeader = job->transmissionChecksumHeader();
+    _inlineContentChecksum = job->inlineChecksum(propagator()->account()->capabilities().preferredUploadChecksumType());
+
+    // The job may have computed the checksum while writing the file; then there's no need to read it again
+    const auto checksumType = parseChecksumHeaderType(checksumHeader);
+    const auto inlineChecksum = job->inlineChecksum(checksumType);
+    if (!inlineChecksum.isEmpty()) {
+        validator->validate(checksumHeader, checksumType, inlineChecksum);
+    } else {
+        validator->start(_tmpFile.fileName(), checksumHeader);
+    }
 }
 
 void PropagateDownloadFile::slotChecksumFail(const QString &errMsg,
@@ -1096,6 +1139,9 @@ void PropagateDownloadFile::transmissionChecksumValidated(const QByteArray &chec
     if (theContentChecksumType == checksumType || theContentChecksumType.isEmpty()) {
         return contentChecksumComputed(checksumType, checksum);
     }
+    if (!_inlineContentChecksum.isEmpty()) {
+        return contentChecksumComputed(theContentChecksumType, _inlineContentChecksum);
+    }
 
     // Compute the content checksum.
     auto computeChecksum = new ComputeChecksum(this);
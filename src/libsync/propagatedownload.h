@@ -22,6 +22,8 @@
 #include <QBuffer>
 #include <QFile>
 
+#include <vector>
+
 namespace OCC {
 class PropagateDownloadEncrypted;
 
@@ -41,9 +43,6 @@ class OWNCLOUDSYNC_EXPORT GETFileJob : public AbstractNetworkJob
     SyncFileItem::Status _errorStatus;
     QUrl _directDownloadUrl;
     QByteArray _etag;
-    bool _bandwidthLimited; // if _bandwidthQuota will be used
-    bool _bandwidthChoked; // if download is paused (won't read on readyRead())
-    qint64 _bandwidthQuota;
     QPointer<BandwidthManager> _bandwidthManager;
     bool _hasEmittedFinishedSignal;
     time_t _lastModified;
@@ -51,6 +50,13 @@ class OWNCLOUDSYNC_EXPORT GETFileJob : public AbstractNetworkJob
     /// Will be set to true once we've seen a 2xx response header
     bool _saveBodyToFile = false;
 
+    /// Reused for all reads from the reply
+    QByteArray _readBuffer;
+
+    /// Checksums computed while the body is written, only when downloading from the start
+    QByteArray _contentChecksumType;
+    std::vector<ChecksumCalculator> _inlineChecksums;
+
 protected:
     qint64 _contentLength;
 
@@ -92,10 +98,6 @@ public:
     void newReplyHook(QNetworkReply *reply) override;
 
     void setBandwidthManager(BandwidthManager *bwm);
-    void setChoked(bool c);
-    void setBandwidthLimited(bool b);
-    void giveBandwidthQuota(qint64 q);
-    qint64 currentDownloadPosition();
 
     [[nodiscard]] QString errorString() const override;
     void setErrorString(const QString &s) { _errorString = s; }
@@ -113,9 +115,25 @@ public:
     [[nodiscard]] qint64 expectedContentLength() const { return _expectedContentLength; }
     void setExpectedContentLength(qint64 size) { _expectedContentLength = size; }
 
+    /// Also compute a checksum of this type while downloading, next to the transmission checksum
+    void setContentChecksumType(const QByteArray &checksumType) { _contentChecksumType = checksumType; }
+
+    /// The best checksum header the server sent along, like "SHA1:abc", or empty
+    [[nodiscard]] QByteArray transmissionChecksumHeader() const;
+
+    /**
+     * The checksum of the written data if it was computed while downloading,
+     * or empty if the file has to be read again to get it, e.g. after resuming.
+     */
+    [[nodiscard]] QByteArray inlineChecksum(const QByteArray &checksumType) const;
+
 protected:
     virtual qint64 writeToDevice(const QByteArray &data);
 
+private:
+    void startInlineChecksums();
+    [[nodiscard]] qint64 replyReadBufferSize() const;
+
 signals:
     void finishedSignal();
     void downloadProgress(qint64, qint64);
@@ -171,6 +189,8 @@ private:
     +-> startDownload() <--------------------------+
           |                                        |
           +-> run a GETFileJob                     | checksum identical?
+                (computes checksums on the way     |
+                 unless it resumes)                |
                                                    |
       done?-> slotGetFinished()                    |
                 |                                  |
@@ -179,6 +199,7 @@ private:
       done?-> transmissionChecksumValidated()      |
                 |                                  |
                 +-> compute the content checksum   |
+                    if not known yet               |
                                                    |
       done?-> contentChecksumComputed()            |
                 |                                  |
@@ -256,6 +277,9 @@ private:
     EncryptedFile _encryptedInfo;
     ConflictRecord _conflictRecord;
 
+    /// Content checksum the GETFileJob computed while downloading, if any
+    QByteArray _inlineContentChecksum;
+
     QElapsedTimer _stopwatch;
 
     PropagateDownloadEncrypted *_downloadEncryptedHelper = nullptr;
@@ -0,0 +1,243 @@
+/*
+ * Copyright (C) by Nextcloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "propagateremotecopy.h"
+#include "propagateremotemove.h"
+#include "propagateupload.h"
+#include "owncloudpropagator_p.h"
+#include "account.h"
+#include "common/syncjournaldb.h"
+#include "common/utility.h"
+#include "common/asserts.h"
+#include "common/checksums.h"
+
+#include <QDir>
+
+namespace OCC {
+
+Q_LOGGING_CATEGORY(lcPropagateRemoteCopy, "nextcloud.sync.propagator.remotecopy", QtInfoMsg)
+
+PropagateRemoteCopy::PropagateRemoteCopy(OwncloudPropagator *propagator, const SyncFileItemPtr &item)
+    : PropagateItemJob(propagator, item)
+{
+}
+
+PropagateRemoteCopy::~PropagateRemoteCopy() = default;
+
+void PropagateRemoteCopy::start()
+{
+    if (propagator()->_abortRequested)
+        return;
+
+    // One hash of the file can only be compared with checksums of the same type
+    QByteArray checksumType;
+    for (const auto &path : qAsConst(_item->_remoteCopyCandidates)) {
+        SyncJournalFileRecord record;
+        if (!propagator()->_journal->getFileRecord(path, &record) || !record.isValid()
+            || record.isE2eEncrypted() || record._checksumHeader.isEmpty()) {
+            continue;
+        }
+        const auto type = parseChecksumHeaderType(record._checksumHeader);
+        if (checksumType.isEmpty()) {
+            checksumType = type;
+        }
+        if (type == checksumType) {
+            _candidates.append(record);
+        }
+    }
+    if (_candidates.isEmpty()) {
+        startUpload();
+        return;
+    }
+
+    auto computeChecksum = new ComputeChecksum(this);
+    computeChecksum->setChecksumType(checksumType);
+    connect(computeChecksum, &ComputeChecksum::done,
+        this, &PropagateRemoteCopy::slotChecksumComputed);
+    connect(computeChecksum, &ComputeChecksum::done,
+        computeChecksum, &QObject::deleteLater);
+    propagator()->_activeJobList.append(this);
+    computeChecksum->start(propagator()->fullLocalPath(_item->_file));
+}
+
+void PropagateRemoteCopy::slotChecksumComputed(const QByteArray &checksumType, const QByteArray &checksum)
+{
+    propagator()->_activeJobList.removeOne(this);
+
+    if (propagator()->_abortRequested)
+        return;
+
+    if (!checksum.isEmpty()) {
+        // Also saves the upload from computing it again
+        _item->_checksumHeader = makeChecksumHeader(checksumType, checksum);
+        for (const auto &candidate : qAsConst(_candidates)) {
+            if (candidate._checksumHeader == _item->_checksumHeader) {
+                qCInfo(lcPropagateRemoteCopy) << "New file" << _item->_file << "has the same contents as" << candidate.path() << ", copying it on the server";
+                _source = candidate;
+                startCopy();
+                return;
+            }
+        }
+    }
+
+    startUpload();
+}
+
+void PropagateRemoteCopy::startCopy()
+{
+    // The parent of the source may have been renamed earlier in this sync
+    const auto source = propagator()->adjustRenamedPath(_source.path());
+    qCInfo(lcPropagateRemoteCopy) << source << _item->_file;
+
+    QMap<QByteArray, QByteArray> headers;
+    headers[QByteArrayLiteral("Overwrite")] = "F";
+    if (!_source._etag.isEmpty()) {
+        // Only copy the contents the journal knows about
+        headers[QByteArrayLiteral("If-Match")] = '"' + _source._etag + '"';
+    }
+
+    const auto davUrl = propagator()->account()->davUrl();
+    const auto destination = QDir::cleanPath(davUrl.path() + propagator()->fullRemotePath(_item->_file));
+    auto job = new CopyJob(propagator()->account(), Utility::concatUrlPath(davUrl, propagator()->fullRemotePath(source)),
+        destination, headers, this);
+    connect(job, &CopyJob::finishedSignal, this, &PropagateRemoteCopy::slotCopyJobFinished);
+    _job = job;
+    propagator()->_activeJobList.append(this);
+    job->start();
+}
+
+void PropagateRemoteCopy::abort(PropagatorJob::AbortType abortType)
+{
+    if (_uploadJob) {
+        if (abortType == AbortType::Asynchronous) {
+            connect(_uploadJob.get(), &PropagatorJob::abortFinished, this, &PropagatorJob::abortFinished);
+        }
+        _uploadJob->abort(abortType);
+        return;
+    }
+
+    if (_job && _job->reply())
+        _job->reply()->abort();
+
+    if (abortType == AbortType::Asynchronous) {
+        emit abortFinished();
+    }
+}
+
+void PropagateRemoteCopy::slotCopyJobFinished()
+{
+    propagator()->_activeJobList.removeOne(this);
+
+    ASSERT(_job);
+
+    QNetworkReply::NetworkError err = _job->reply()->error();
+    _item->_httpErrorCode = _job->reply()->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    _item->_responseTimeStamp = _job->responseTimestamp();
+    _item->_requestId = _job->requestId();
+
+    if (propagator()->_abortRequested) {
+        done(SyncFileItem::SoftError, _job->errorString(), errorCategoryFromNetworkError(err));
+        return;
+    }
+
+    if (err != QNetworkReply::NoError || (_item->_httpErrorCode != 201 && _item->_httpErrorCode != 204)) {
+        // E.g. 404 when the source was deleted earlier in this sync
+        qCInfo(lcPropagateRemoteCopy) << "Could not copy" << _source.path() << "to" << _item->_file
+                                      << _item->_httpErrorCode << _job->errorString() << ", uploading instead";
+        startUpload();
+        return;
+    }
+
+    // The copy has the modification time of the source, X-OC-Mtime is ignored on COPY
+    auto proppatchJob = new ProppatchJob(propagator()->account(), propagator()->fullRemotePath(_item->_file), this);
+    proppatchJob->setProperties({ { QByteArrayLiteral("DAV::lastmodified"), QByteArray::number(qint64(_item->_modtime)) } });
+    connect(proppatchJob, &ProppatchJob::success, this, &PropagateRemoteCopy::slotProppatchFinished);
+    connect(proppatchJob, &ProppatchJob::finishedWithError, this, [this] {
+        propagator()->_activeJobList.removeOne(this);
+        if (propagator()->_abortRequested)
+            return;
+        // The upload replaces the copy and sets the modification time with it
+        qCInfo(lcPropagateRemoteCopy) << "Could not set the modification time of" << _item->_file << ", uploading instead";
+        startUpload();
+    });
+    _job = proppatchJob;
+    propagator()->_activeJobList.append(this);
+    proppatchJob->start();
+}
+
+void PropagateRemoteCopy::slotProppatchFinished()
+{
+    propagator()->_activeJobList.removeOne(this);
+
+    if (propagator()->_abortRequested)
+        return;
+
+    // The COPY reply doesn't tell the etag and file id of the new file
+    auto propfindJob = new PropfindJob(propagator()->account(), propagator()->fullRemotePath(_item->_file), this);
+    propfindJob->setProperties({ QByteArrayLiteral("getetag"),
+        QByteArrayLiteral("http://owncloud.org/ns:fileid"),
+        QByteArrayLiteral("http://owncloud.org/ns:permissions") });
+    connect(propfindJob, &PropfindJob::result, this, &PropagateRemoteCopy::slotPropfindFinished);
+    connect(propfindJob, &PropfindJob::finishedWithError, this, [this](QNetworkReply *reply) {
+        propagator()->_activeJobList.removeOne(this);
+        const auto err = reply ? reply->error() : QNetworkReply::NetworkError::UnknownNetworkError;
+        done(SyncFileItem::NormalError, tr("Could not read the metadata of the copied file"), errorCategoryFromNetworkError(err));
+    });
+    _job = propfindJob;
+    propagator()->_activeJobList.append(this);
+    propfindJob->start();
+}
+
+void PropagateRemoteCopy::slotPropfindFinished(const QVariantMap &result)
+{
+    propagator()->_activeJobList.removeOne(this);
+
+    _item->_etag = Utility::normalizeEtag(result.value(QStringLiteral("getetag")).toByteArray());
+    _item->_fileId = result.value(QStringLiteral("fileid")).toByteArray();
+    _item->_remotePerm = RemotePermissions::fromServerString(result.value(QStringLiteral("permissions")).toString());
+    if (_item->_etag.isEmpty() || _item->_fileId.isEmpty()) {
+        done(SyncFileItem::NormalError, tr("Missing ETag or File ID from server"), ErrorCategory::GenericError);
+        return;
+    }
+
+    const auto updateResult = propagator()->updateMetadata(*_item);
+    if (!updateResult) {
+        done(SyncFileItem::FatalError, tr("Error updating metadata: %1").arg(updateResult.error()), ErrorCategory::GenericError);
+        return;
+    } else if (*updateResult == Vfs::ConvertToPlaceholderResult::Locked) {
+        done(SyncFileItem::SoftError, tr("The file %1 is currently in use").arg(_item->_file), ErrorCategory::GenericError);
+        return;
+    }
+
+    propagator()->_journal->commit("Remote Copy");
+    done(SyncFileItem::Success, {}, ErrorCategory::NoError);
+}
+
+void PropagateRemoteCopy::startUpload()
+{
+    _item->_remoteCopyCandidates.clear();
+
+    // The upload job reports the item as completed, this job only forwards its result
+    _uploadJob = propagator()->createUploadJob(_item, false);
+    connect(_uploadJob.get(), &PropagatorJob::finished, this, &PropagateRemoteCopy::slotUploadJobFinished);
+    _uploadJob->scheduleSelfOrChild();
+}
+
+void PropagateRemoteCopy::slotUploadJobFinished(SyncFileItem::Status status)
+{
+    _state = Finished;
+    emit finished(status);
+}
+
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) by Nextcloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+#pragma once
+
+#include "owncloudpropagator.h"
+#include "networkjobs.h"
+#include "common/syncjournalfilerecord.h"
+
+#include <memory>
+
+namespace OCC {
+
+class PropagateUploadFileCommon;
+
+/**
+ * @brief Creates a new file by copying a file with the same contents on the server
+ *
+ * Used for items with SyncFileItem::_remoteCopyCandidates. The checksum of the
+ * local file is computed and compared with the ones of the candidates in the
+ * journal. The COPY is conditional on the etag of the source in the journal, so
+ * a source that changed on the server in the meantime is never copied. The
+ * server keeps the modification time of the source on COPY, it is set with a
+ * PROPPATCH afterwards.
+ *
+ * If there is no match or the COPY fails for any reason, the file is uploaded
+ * normally instead.
+ *
+ * @ingroup libsync
+ */
+class PropagateRemoteCopy : public PropagateItemJob
+{
+    Q_OBJECT
+    QPointer<AbstractNetworkJob> _job;
+    std::unique_ptr<PropagateUploadFileCommon> _uploadJob;
+    QVector<SyncJournalFileRecord> _candidates;
+    SyncJournalFileRecord _source;
+
+public:
+    PropagateRemoteCopy(OwncloudPropagator *propagator, const SyncFileItemPtr &item);
+    ~PropagateRemoteCopy() override;
+
+    void start() override;
+    void abort(PropagatorJob::AbortType abortType) override;
+
+private slots:
+    void slotChecksumComputed(const QByteArray &checksumType, const QByteArray &checksum);
+    void slotCopyJobFinished();
+    void slotProppatchFinished();
+    void slotPropfindFinished(const QVariantMap &result);
+    void slotUploadJobFinished(SyncFileItem::Status status);
+
+private:
+    void startCopy();
+    void startUpload();
+};
+}
@@ -16,6 +16,7 @@
 #include "clientsideencryptionjobs.h"
 #include "owncloudpropagator.h"
 #include "encryptfolderjob.h"
+#include "encryptedfoldertransaction.h"
 #include <QLoggingCategory>
 #include <QFileInfo>
 
@@ -34,7 +35,45 @@ void PropagateRemoteDeleteEncrypted::start()
     Q_ASSERT(!_item->_encryptedFileName.isEmpty());
 
     const QFileInfo info(_item->_encryptedFileName);
-    startLsColJob(info.path());
+    if (_item->isDirectory()) {
+        // Directories are removed after all other jobs, lock their parent on our own
+        startLsColJob(info.path());
+        return;
+    }
+
+    // Files share the lock and the metadata of their folder with the other jobs in it
+    const auto slashPosition = _item->_file.lastIndexOf(QLatin1Char('/'));
+    const auto localParentPath = slashPosition >= 0 ? _item->_file.left(slashPosition) : QString();
+    _transaction = _propagator->encryptedFolderTransaction(localParentPath, info.path(), _item->_e2eEncryptionStatus);
+    connect(_transaction, &EncryptedFolderTransaction::ready, this, &PropagateRemoteDeleteEncrypted::slotTransactionReady);
+    connect(_transaction, &EncryptedFolderTransaction::failed, this, [this] {
+        disconnect(_transaction, nullptr, this, nullptr);
+        taskFailed();
+    });
+    _transaction->start();
+}
+
+void PropagateRemoteDeleteEncrypted::slotTransactionReady()
+{
+    disconnect(_transaction, nullptr, this, nullptr);
+    qCDebug(PROPAGATE_REMOVE_ENCRYPTED) << "Metadata Received, preparing it for removal of the file";
+
+    const QFileInfo info(_propagator->fullLocalPath(_item->_file));
+    const QString fileName = info.fileName();
+
+    const auto metadata = _transaction->metadata();
+    const QVector<EncryptedFile> files = metadata->files();
+    for (const EncryptedFile &file : files) {
+        if (file.originalFilename == fileName) {
+            metadata->removeEncryptedFile(file);
+            _transaction->fileDeleted();
+            break;
+        }
+    }
+
+    // The folder stays locked, the transaction unlocks it after writing the metadata
+    _folderToken = _transaction->folderToken();
+    deleteRemoteItem(_item->_encryptedFileName);
 }
 
 void PropagateRemoteDeleteEncrypted::slotFolderUnLockedSuccessfully(const QByteArray &folderId)
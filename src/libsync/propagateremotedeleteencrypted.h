@@ -14,10 +14,14 @@
 
 #pragma once
 
+#include <QPointer>
+
 #include "abstractpropagateremotedeleteencrypted.h"
 
 namespace OCC {
 
+class EncryptedFolderTransaction;
+
 class PropagateRemoteDeleteEncrypted : public AbstractPropagateRemoteDeleteEncrypted
 {
     Q_OBJECT
@@ -29,6 +33,9 @@ public:
 private:
     void slotFolderUnLockedSuccessfully(const QByteArray &folderId) override;
     void slotFolderEncryptedMetadataReceived(const QJsonDocument &json, int statusCode) override;
+    void slotTransactionReady();
+
+    QPointer<EncryptedFolderTransaction> _transaction;
 };
 
 }
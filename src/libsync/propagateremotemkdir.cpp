@@ -228,15 +228,21 @@ void PropagateRemoteMkdir::slotMkcolJobFinished()
 
     const auto jobPath = _job->path();
 
-    if (_uploadEncryptedHelper && _uploadEncryptedHelper->isFolderLocked() && !_uploadEncryptedHelper->isUnlockRunning()) {
-        // since we are done, we need to unlock a folder in case it was locked
-        connect(_uploadEncryptedHelper, &PropagateUploadEncrypted::folderUnlocked, this, [this, err, jobHttpReasonPhraseString, jobPath]() {
+    if (_uploadEncryptedHelper && err == QNetworkReply::NoError) {
+        // Only record the directory once the parent's metadata lists it
+        propagator()->_activeJobList.append(this);
+        connect(_uploadEncryptedHelper, &PropagateUploadEncrypted::metadataWritten, this, [this, err, jobHttpReasonPhraseString, jobPath](bool success) {
+            propagator()->_activeJobList.removeOne(this);
+            if (!success) {
+                done(SyncFileItem::NormalError, tr("Failed to update the metadata of the encrypted folder"), ErrorCategory::GenericError);
+                return;
+            }
             finalizeMkColJob(err, jobHttpReasonPhraseString, jobPath);
         });
-        _uploadEncryptedHelper->unlockFolder();
-    } else {
-        finalizeMkColJob(err, jobHttpReasonPhraseString, jobPath);
+        _uploadEncryptedHelper->fileUploaded();
+        return;
     }
+    finalizeMkColJob(err, jobHttpReasonPhraseString, jobPath);
 }
 
 void PropagateRemoteMkdir::slotEncryptFolderFinished()
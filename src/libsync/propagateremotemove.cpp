@@ -27,6 +27,7 @@
 namespace OCC {
 
 Q_LOGGING_CATEGORY(lcMoveJob, "nextcloud.sync.networkjob.move", QtInfoMsg)
+Q_LOGGING_CATEGORY(lcCopyJob, "nextcloud.sync.networkjob.copy", QtInfoMsg)
 Q_LOGGING_CATEGORY(lcPropagateRemoteMove, "nextcloud.sync.propagator.remotemove", QtInfoMsg)
 
 MoveJob::MoveJob(AccountPtr account, const QString &path,
@@ -74,6 +75,39 @@ bool MoveJob::finished()
     return true;
 }
 
+CopyJob::CopyJob(AccountPtr account, const QUrl &url, const QString &destination,
+    QMap<QByteArray, QByteArray> extraHeaders, QObject *parent)
+    : AbstractNetworkJob(account, QString(), parent)
+    , _url(url)
+    , _destination(destination)
+    , _extraHeaders(extraHeaders)
+{
+}
+
+void CopyJob::start()
+{
+    QNetworkRequest req;
+    req.setRawHeader("Destination", QUrl::toPercentEncoding(_destination, "/"));
+    for (auto it = _extraHeaders.constBegin(); it != _extraHeaders.constEnd(); ++it) {
+        req.setRawHeader(it.key(), it.value());
+    }
+    sendRequest("COPY", _url, req);
+
+    if (reply()->error() != QNetworkReply::NoError) {
+        qCWarning(lcCopyJob) << " Network error: " << reply()->errorString();
+    }
+    AbstractNetworkJob::start();
+}
+
+bool CopyJob::finished()
+{
+    qCInfo(lcCopyJob) << "COPY of" << reply()->request().url() << "FINISHED WITH STATUS"
+                      << replyStatusString();
+
+    emit finishedSignal();
+    return true;
+}
+
 void PropagateRemoteMove::start()
 {
     if (propagator()->_abortRequested)
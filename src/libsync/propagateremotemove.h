@@ -41,6 +41,30 @@ signals:
     void finishedSignal();
 };
 
+/**
+ * @brief Server-side COPY of a resource
+ *
+ * Used to reuse data that already exists on the server instead of uploading it.
+ * @ingroup libsync
+ */
+class OWNCLOUDSYNC_EXPORT CopyJob : public AbstractNetworkJob
+{
+    Q_OBJECT
+    const QUrl _url;
+    const QString _destination;
+    QMap<QByteArray, QByteArray> _extraHeaders;
+
+public:
+    explicit CopyJob(AccountPtr account, const QUrl &url, const QString &destination,
+        QMap<QByteArray, QByteArray> extraHeaders, QObject *parent = nullptr);
+
+    void start() override;
+    bool finished() override;
+
+signals:
+    void finishedSignal();
+};
+
 /**
  * @brief The PropagateRemoteMove class
  * @ingroup libsync
@@ -38,8 +38,10 @@
 #include <QJsonObject>
 #include <QFileInfo>
 
+#include <algorithm>
 #include <cmath>
 #include <cstring>
+#include <utility>
 
 namespace OCC {
 
@@ -328,6 +330,13 @@ void PropagateUploadFileCommon::slotComputeContentChecksum()
         return;
     }
 
+    // Rather than reading the whole file once more, hash the data while it is sent
+    if (computesChecksumsWhileUploading()) {
+        _uploadChecksums = std::make_shared<UploadChecksums>(QList<QByteArray>{checksumType, transmissionChecksumType(checksumType)});
+        slotStartUpload(QByteArray(), QByteArray());
+        return;
+    }
+
     // Compute the content checksum.
     auto computeChecksum = new ComputeChecksum(this);
     computeChecksum->setChecksumType(checksumType);
@@ -344,20 +353,15 @@ void PropagateUploadFileCommon::slotComputeTransmissionChecksum(const QByteArray
     _item->_checksumHeader = makeChecksumHeader(contentChecksumType, contentChecksum);
 
     // Reuse the content checksum as the transmission checksum if possible
-    const auto supportedTransmissionChecksums =
-        propagator()->account()->capabilities().supportedChecksumTypes();
-    if (supportedTransmissionChecksums.contains(contentChecksumType)) {
+    const auto checksumType = transmissionChecksumType(contentChecksumType);
+    if (checksumType == contentChecksumType) {
         slotStartUpload(contentChecksumType, contentChecksum);
         return;
     }
 
     // Compute the transmission checksum.
     auto computeChecksum = new ComputeChecksum(this);
-    if (uploadChecksumEnabled()) {
-        computeChecksum->setChecksumType(propagator()->account()->capabilities().uploadChecksumType());
-    } else {
-        computeChecksum->setChecksumType(QByteArray());
-    }
+    computeChecksum->setChecksumType(checksumType);
 
     connect(computeChecksum, &ComputeChecksum::done,
         this, &PropagateUploadFileCommon::slotStartUpload);
@@ -366,18 +370,85 @@ void PropagateUploadFileCommon::slotComputeTransmissionChecksum(const QByteArray
     computeChecksum->start(_fileToUpload._path);
 }
 
-void PropagateUploadFileCommon::slotStartUpload(const QByteArray &transmissionChecksumType, const QByteArray &transmissionChecksum)
+QByteArray PropagateUploadFileCommon::transmissionChecksumType(const QByteArray &contentChecksumType) const
 {
-    // Remove ourselfs from the list of active job, before any posible call to done()
-    // When we start chunks, we will add it again, once for every chunks.
-    propagator()->_activeJobList.removeOne(this);
+    const auto &capabilities = propagator()->account()->capabilities();
+    if (capabilities.supportedChecksumTypes().contains(contentChecksumType)) {
+        return contentChecksumType;
+    }
+    return uploadChecksumEnabled() ? capabilities.uploadChecksumType() : QByteArray();
+}
 
-    _transmissionChecksumHeader = makeChecksumHeader(transmissionChecksumType, transmissionChecksum);
+void PropagateUploadFileCommon::setChecksumHeaders(const QByteArray &contentChecksumHeader, const QByteArray &transmissionChecksumHeader)
+{
+    _item->_checksumHeader = contentChecksumHeader;
+    _transmissionChecksumHeader = transmissionChecksumHeader;
 
     // If no checksum header was not set, reuse the transmission checksum as the content checksum.
     if (_item->_checksumHeader.isEmpty()) {
         _item->_checksumHeader = _transmissionChecksumHeader;
     }
+}
+
+bool PropagateUploadFileCommon::takeUploadChecksums()
+{
+    const auto checksums = std::exchange(_uploadChecksums, nullptr);
+    ENFORCE(checksums);
+    const auto contentChecksumType = propagator()->account()->capabilities().preferredUploadChecksumType();
+    const auto checksumType = transmissionChecksumType(contentChecksumType);
+    if (checksums->coversFile(_fileToUpload._size)) {
+        setChecksumHeaders(makeChecksumHeader(contentChecksumType, checksums->checksum(contentChecksumType)),
+            makeChecksumHeader(checksumType, checksums->checksum(checksumType)));
+        return true;
+    }
+
+    // Some data was sent by an earlier sync or copied on the server
+    qCInfo(lcPropagateUpload) << "Not all data of" << _item->_file << "was sent, computing the checksums from the file";
+    propagator()->_activeJobList.append(this);
+    const auto finish = [this](const QByteArray &contentChecksumHeader, const QByteArray &transmissionChecksumHeader) {
+        propagator()->_activeJobList.removeOne(this);
+        if (propagator()->_abortRequested) {
+            return;
+        }
+        setChecksumHeaders(contentChecksumHeader, transmissionChecksumHeader);
+        checksumsComputedAfterUpload();
+    };
+
+    auto computeChecksum = new ComputeChecksum(this);
+    computeChecksum->setChecksumType(contentChecksumType);
+    connect(computeChecksum, &ComputeChecksum::done, this, [this, checksumType, finish](const QByteArray &contentType, const QByteArray &contentChecksum) {
+        const auto contentChecksumHeader = makeChecksumHeader(contentType, contentChecksum);
+        if (checksumType == contentType) {
+            finish(contentChecksumHeader, contentChecksumHeader);
+            return;
+        }
+        auto computeTransmissionChecksum = new ComputeChecksum(this);
+        computeTransmissionChecksum->setChecksumType(checksumType);
+        connect(computeTransmissionChecksum, &ComputeChecksum::done, this, [finish, contentChecksumHeader](const QByteArray &type, const QByteArray &checksum) {
+            finish(contentChecksumHeader, makeChecksumHeader(type, checksum));
+        });
+        connect(computeTransmissionChecksum, &ComputeChecksum::done,
+            computeTransmissionChecksum, &QObject::deleteLater);
+        computeTransmissionChecksum->start(_fileToUpload._path);
+    });
+    connect(computeChecksum, &ComputeChecksum::done,
+        computeChecksum, &QObject::deleteLater);
+    computeChecksum->start(_fileToUpload._path);
+    return false;
+}
+
+void PropagateUploadFileCommon::slotStartUpload(const QByteArray &transmissionChecksumType, const QByteArray &transmissionChecksum)
+{
+    // Remove ourselfs from the list of active job, before any posible call to done()
+    // When we start chunks, we will add it again, once for every chunks.
+    propagator()->_activeJobList.removeOne(this);
+
+    if (_uploadChecksums) {
+        // The checksums are only known once everything was sent
+        _transmissionChecksumHeader.clear();
+    } else {
+        setChecksumHeaders(_item->_checksumHeader, makeChecksumHeader(transmissionChecksumType, transmissionChecksum));
+    }
 
     const QString fullFilePath = _fileToUpload._path;
     const QString originalFilePath = propagator()->fullLocalPath(_item->_file);
@@ -426,25 +497,48 @@ void PropagateUploadFileCommon::slotStartUpload(const QByteArray &transmissionCh
     doStartUpload();
 }
 
-void PropagateUploadFileCommon::slotFolderUnlocked(const QByteArray &folderId, int httpReturnCode)
+void PropagateUploadFileCommon::slotOnErrorStartFolderUnlock(SyncFileItem::Status status, const QString &errorString)
 {
-    qDebug() << "Failed to unlock encrypted folder" << folderId;
-    if (_uploadStatus.status == SyncFileItem::NoStatus && httpReturnCode != 200) {
-        done(SyncFileItem::FatalError, tr("Failed to unlock encrypted folder."));
-    } else {
-        done(_uploadStatus.status, _uploadStatus.message);
+    // The folder's EncryptedFolderTransaction unlocks it once the directory is done
+    done(status, errorString);
+}
+
+UploadChecksums::UploadChecksums(const QList<QByteArray> &checksumTypes)
+{
+    for (const auto &checksumType : checksumTypes) {
+        const auto known = std::any_of(_calculators.cbegin(), _calculators.cend(), [&checksumType](const ChecksumCalculator &calculator) {
+            return calculator.checksumType() == checksumType;
+        });
+        ChecksumCalculator calculator(checksumType);
+        if (!known && calculator.isValid()) {
+            _calculators.push_back(std::move(calculator));
+        }
     }
 }
 
-void PropagateUploadFileCommon::slotOnErrorStartFolderUnlock(SyncFileItem::Status status, const QString &errorString)
+void UploadChecksums::addData(qint64 offset, const char *data, qint64 length)
 {
-    if (_uploadingEncrypted) {
-        _uploadStatus = { status, errorString };
-        connect(_uploadEncryptedHelper, &PropagateUploadEncrypted::folderUnlocked, this, &PropagateUploadFileCommon::slotFolderUnlocked);
-        _uploadEncryptedHelper->unlockFolder();
-    } else {
-        done(status, errorString);
+    if (offset > _position) {
+        _hasGap = true;
     }
+    if (_hasGap || offset + length <= _position) {
+        return;
+    }
+    const auto seen = _position - offset;
+    for (auto &calculator : _calculators) {
+        calculator.addData(data + seen, length - seen);
+    }
+    _position = offset + length;
+}
+
+QByteArray UploadChecksums::checksum(const QByteArray &checksumType) const
+{
+    for (const auto &calculator : _calculators) {
+        if (calculator.checksumType() == checksumType) {
+            return calculator.result();
+        }
+    }
+    return QByteArray();
 }
 
 UploadDevice::UploadDevice(const QString &fileName, qint64 start, qint64 size, BandwidthManager *bwm)
@@ -510,15 +604,11 @@ qint64 UploadDevice::readData(char *data, qint64 maxlen)
     if (maxlen <= 0) {
         return 0;
     }
-    if (isChoked()) {
-        return 0;
-    }
-    if (isBandwidthLimited()) {
-        maxlen = qMin(maxlen, _bandwidthQuota);
-        if (maxlen <= 0) { // no quota
+    if (isBandwidthLimited() && _bandwidthManager) {
+        maxlen = _bandwidthManager->takeUploadQuota(this, maxlen);
+        if (maxlen <= 0) { // no quota, the manager emits readyRead() once there is
             return 0;
         }
-        _bandwidthQuota -= maxlen;
     }
 
     auto c = _file.read(data, maxlen);
@@ -526,6 +616,9 @@ qint64 UploadDevice::readData(char *data, qint64 maxlen)
         setErrorString(_file.errorString());
         return -1;
     }
+    if (_checksums) {
+        _checksums->addData(_start + _read, data, c);
+    }
     _read += c;
     return c;
 }
@@ -535,7 +628,12 @@ void UploadDevice::slotJobUploadProgress(qint64 sent, qint64 t)
     if (sent == 0 || t == 0) {
         return;
     }
+    // A request that is sent again reports its progress from the start
+    const auto progressed = sent >= _readWithProgress ? sent - _readWithProgress : sent;
     _readWithProgress = sent;
+    if (_bandwidthManager) {
+        _bandwidthManager->uploadProgressed(progressed);
+    }
 }
 
 bool UploadDevice::atEnd() const
@@ -572,28 +670,12 @@ bool UploadDevice::seek(qint64 pos)
     return true;
 }
 
-void UploadDevice::giveBandwidthQuota(qint64 bwq)
-{
-    if (!atEnd()) {
-        _bandwidthQuota = bwq;
-        QMetaObject::invokeMethod(this, "readyRead", Qt::QueuedConnection); // tell QNAM that we have quota
-    }
-}
-
 void UploadDevice::setBandwidthLimited(bool b)
 {
     _bandwidthLimited = b;
     QMetaObject::invokeMethod(this, "readyRead", Qt::QueuedConnection);
 }
 
-void UploadDevice::setChoked(bool b)
-{
-    _choked = b;
-    if (!_choked) {
-        QMetaObject::invokeMethod(this, "readyRead", Qt::QueuedConnection);
-    }
-}
-
 void PropagateUploadFileCommon::startPollJob(const QString &path)
 {
     auto *job = new PollJob(propagator()->account(), path, _item,
@@ -786,6 +868,25 @@ QMap<QByteArray, QByteArray> PropagateUploadFileCommon::headers()
 }
 
 void PropagateUploadFileCommon::finalize()
+{
+    if (_uploadingEncrypted) {
+        // Nobody could decrypt the file before the folder's metadata lists it
+        propagator()->_activeJobList.append(this);
+        connect(_uploadEncryptedHelper, &PropagateUploadEncrypted::metadataWritten, this, [this](bool success) {
+            propagator()->_activeJobList.removeOne(this);
+            if (!success) {
+                done(SyncFileItem::NormalError, tr("Failed to update the metadata of the encrypted folder"));
+                return;
+            }
+            finalizeUpload();
+        });
+        _uploadEncryptedHelper->fileUploaded();
+        return;
+    }
+    finalizeUpload();
+}
+
+void PropagateUploadFileCommon::finalizeUpload()
 {
     // Update the quota, if known
     auto quotaIt = propagator()->_folderQuota.find(QFileInfo(_item->_file).path());
@@ -819,13 +920,7 @@ void PropagateUploadFileCommon::finalize()
     propagator()->_journal->setUploadInfo(_item->_file, SyncJournalDb::UploadInfo());
     propagator()->_journal->commit("upload file start");
 
-    if (_uploadingEncrypted) {
-        _uploadStatus = { SyncFileItem::Success, QString() };
-        connect(_uploadEncryptedHelper, &PropagateUploadEncrypted::folderUnlocked, this, &PropagateUploadFileCommon::slotFolderUnlocked);
-        _uploadEncryptedHelper->unlockFolder();
-    } else {
-        done(SyncFileItem::Success);
-    }
+    done(SyncFileItem::Success);
 }
 
 void PropagateUploadFileCommon::abortNetworkJobs(
@@ -15,10 +15,16 @@
 
 #include "owncloudpropagator.h"
 #include "networkjobs.h"
+#include "blocksignature.h"
+#include "common/checksums.h"
 
 #include <QBuffer>
 #include <QFile>
 #include <QElapsedTimer>
+#include <QFutureWatcher>
+
+#include <memory>
+#include <vector>
 
 
 namespace OCC {
@@ -30,6 +36,34 @@ Q_DECLARE_LOGGING_CATEGORY(lcPropagateUploadNG)
 
 class BandwidthManager;
 
+/**
+ * @brief Checksums of a file, computed from the data its upload reads
+ *
+ * The data has to arrive in file order. Data that was seen before, e.g.
+ * when a request is sent again, is skipped. A gap, like the part of a
+ * resumed upload that was sent by an earlier sync, leaves the checksums
+ * incomplete.
+ *
+ * @ingroup libsync
+ */
+class UploadChecksums
+{
+public:
+    explicit UploadChecksums(const QList<QByteArray> &checksumTypes);
+
+    void addData(qint64 offset, const char *data, qint64 length);
+
+    /// Whether all data of a file of @a size bytes was seen, in order
+    [[nodiscard]] bool coversFile(qint64 size) const { return !_hasGap && _position == size; }
+
+    [[nodiscard]] QByteArray checksum(const QByteArray &checksumType) const;
+
+private:
+    std::vector<ChecksumCalculator> _calculators;
+    qint64 _position = 0;
+    bool _hasGap = false;
+};
+
 /**
  * @brief The UploadDevice class
  * @ingroup libsync
@@ -54,9 +88,9 @@ public:
 
     void setBandwidthLimited(bool);
     bool isBandwidthLimited() { return _bandwidthLimited; }
-    void setChoked(bool);
-    bool isChoked() { return _choked; }
-    void giveBandwidthQuota(qint64 bwq);
+
+    /// Feeds the data that is read into @a checksums
+    void setChecksums(const std::shared_ptr<UploadChecksums> &checksums) { _checksums = checksums; }
 
 signals:
 
@@ -73,13 +107,12 @@ private:
 
     // Bandwidth manager related
     QPointer<BandwidthManager> _bandwidthManager;
-    qint64 _bandwidthQuota = 0;
     qint64 _readWithProgress = 0;
-    bool _bandwidthLimited = false; // if _bandwidthQuota will be used
-    bool _choked = false; // if upload is paused (readData() will return 0)
-    friend class BandwidthManager;
+    bool _bandwidthLimited = true; // if the bandwidth manager's limits apply
 public slots:
     void slotJobUploadProgress(qint64 sent, qint64 t);
+
+    std::shared_ptr<UploadChecksums> _checksums;
 };
 
 /**
@@ -193,7 +226,8 @@ class PropagateUploadEncrypted;
  *                   |
  *                   v
  *    slotComputeTransmissionChecksum()
- *         |
+ *         |     (skipped when the upload computes the checksums from
+ *         |      the data it sends, see computesChecksumsWhileUploading())
  *         v
  *    slotStartUpload()  -> doStartUpload()
  *                                  .
@@ -205,11 +239,6 @@ class PropagateUploadFileCommon : public PropagateItemJob
 {
     Q_OBJECT
 
-    struct UploadStatus {
-        SyncFileItem::Status status = SyncFileItem::NoStatus;
-        QString message;
-    };
-
 protected:
     QVector<AbstractNetworkJob *> _jobs; /// network jobs that are currently in transit
     bool _finished BITFIELD(1); /// Tells that all the jobs have been finished
@@ -253,7 +282,6 @@ public:
     void setupEncryptedFile(const QString& path, const QString& filename, quint64 size);
     void setupUnencryptedFile();
     void startUploadFile();
-    void callUnlockFolder();
     bool isLikelyFinishedQuickly() override { return _item->_size < propagator()->smallFileSize(); }
 
 private slots:
@@ -262,9 +290,7 @@ private slots:
     void slotComputeTransmissionChecksum(const QByteArray &contentChecksumType, const QByteArray &contentChecksum);
     // transmission checksum computed, prepare the upload
     void slotStartUpload(const QByteArray &transmissionChecksumType, const QByteArray &transmissionChecksum);
-    // invoked when encrypted folder lock has been released
-    void slotFolderUnlocked(const QByteArray &folderId, int httpReturnCode);
-    // invoked on internal error to unlock a folder and faile
+    // invoked on internal error
     void slotOnErrorStartFolderUnlock(SyncFileItem::Status status, const QString &errorString);
 
 public:
@@ -316,10 +342,39 @@ protected:
 
     /** Bases headers that need to be sent on the PUT, or in the MOVE for chunking-ng */
     QMap<QByteArray, QByteArray> headers();
+
+    /** Whether _fileToUpload is an encrypted copy of the local file */
+    [[nodiscard]] bool uploadingEncrypted() const { return _uploadingEncrypted; }
+
+    /**
+     * Whether the checksums may be computed from the data the upload sends
+     * instead of reading the file beforehand. Only possible when they are
+     * sent in a request after the data, like the MOVE of chunking-ng.
+     */
+    [[nodiscard]] virtual bool computesChecksumsWhileUploading() const { return false; }
+
+    /**
+     * Takes the checksums from _uploadChecksums, which is reset.
+     *
+     * Returns false if they are incomplete; they are then computed from the
+     * file and checksumsComputedAfterUpload() is called once they are known.
+     */
+    bool takeUploadChecksums();
+
+    /** Called when takeUploadChecksums() had to compute the checksums from the file */
+    virtual void checksumsComputedAfterUpload() {}
+
+    /** Set while the checksums are computed from the data the upload sends */
+    std::shared_ptr<UploadChecksums> _uploadChecksums;
+
 private:
+    [[nodiscard]] QByteArray transmissionChecksumType(const QByteArray &contentChecksumType) const;
+    void setChecksumHeaders(const QByteArray &contentChecksumHeader, const QByteArray &transmissionChecksumHeader);
+    /** Records the uploaded file in the journal, once an encrypted file is listed in the metadata */
+    void finalizeUpload();
+
   PropagateUploadEncrypted *_uploadEncryptedHelper = nullptr;
   bool _uploadingEncrypted = false;
-  UploadStatus _uploadStatus;
 };
 
 /**
@@ -394,11 +449,20 @@ private:
     };
     QMap<qint64, ServerChunkInfo> _serverChunks;
 
+    // Delta upload: when valid, the chunks are the blocks of _blockSignature and
+    // the blocks listed in _blockMatches are copied from the chunks of the
+    // previous upload that were kept on the server.
+    QFutureWatcher<BlockSignature> _blockSignatureWatcher;
+    BlockSignature _blockSignature;
+    QVector<int> _blockMatches;
+    uint _previousTransferId = 0; /// transfer id of the kept chunks of the previous upload
+
     /**
      * Return the URL of a chunk.
      * If chunk == -1, returns the URL of the parent folder containing the chunks
      */
     QUrl chunkUrl(int chunk = -1);
+    QUrl chunkUrl(uint transferId, int chunk);
 
 public:
     PropagateUploadFileNG(OwncloudPropagator *propagator, const SyncFileItemPtr &item)
@@ -409,11 +473,19 @@ public:
     void doStartUpload() override;
 
 private:
+    [[nodiscard]] bool isDeltaUploadCandidate() const;
+    [[nodiscard]] bool computesChecksumsWhileUploading() const override;
+    void checksumsComputedAfterUpload() override;
+    void resumeOrStartNewUpload();
     void startNewUpload();
     void startNextChunk();
+    void chunkFinished();
+    void storeBlockSignature();
 public slots:
     void abort(OCC::PropagateUploadFileNG::AbortType abortType) override;
 private slots:
+    void slotBlockSignatureComputed();
+    void slotCopyFinished();
     void slotPropfindFinished();
     void slotPropfindFinishedWithError();
     void slotPropfindIterate(const QString &name, const QMap<QString, QString> &properties);
@@ -1,4 +1,5 @@
 #include "propagateuploadencrypted.h"
+#include "encryptedfoldertransaction.h"
 #include "clientsideencryptionjobs.h"
 #include "networkjobs.h"
 #include "clientsideencryption.h"
@@ -21,119 +22,45 @@ PropagateUploadEncrypted::PropagateUploadEncrypted(OwncloudPropagator *propagato
     , _propagator(propagator)
     , _remoteParentPath(remoteParentPath)
     , _item(item)
-    , _metadata(nullptr)
 {
 }
 
 void PropagateUploadEncrypted::start()
 {
-    const auto rootPath = [=]() {
-        const auto result = _propagator->remotePath();
-        if (result.startsWith('/')) {
-            return result.mid(1);
-        } else {
-            return result;
-        }
-    }();
-    const auto absoluteRemoteParentPath = [=]{
-        auto path = QString(rootPath + _remoteParentPath);
-        if (path.endsWith('/')) {
-            path.chop(1);
-        }
-        return path;
-    }();
-
+    const auto slashPosition = _item->_file.lastIndexOf(QLatin1Char('/'));
+    const auto localParentPath = slashPosition >= 0 ? _item->_file.left(slashPosition) : QString();
 
     /* If the file is in a encrypted folder, which we know, we wouldn't be here otherwise,
      * we need to do the long road:
-     * find the ID of the folder.
-     * lock the folder using it's id.
-     * download the metadata
-     * update the metadata
+     * lock the folder and download the metadata, unless another job in this folder already did.
      * upload the file
-     * upload the metadata
-     * unlock the folder.
+     * add the file to the metadata.
+     * The folder's transaction uploads the metadata and unlocks the folder once
+     * all jobs in the folder are done.
      */
-    qCDebug(lcPropagateUploadEncrypted) << "Folder is encrypted, let's get the Id from it.";
-    auto job = new LsColJob(_propagator->account(), absoluteRemoteParentPath, this);
-    job->setProperties({"resourcetype", "http://owncloud.org/ns:fileid"});
-    connect(job, &LsColJob::directoryListingSubfolders, this, &PropagateUploadEncrypted::slotFolderEncryptedIdReceived);
-    connect(job, &LsColJob::finishedWithError, this, &PropagateUploadEncrypted::slotFolderEncryptedIdError);
-    job->start();
+    _transaction = _propagator->encryptedFolderTransaction(localParentPath, _remoteParentPath, _item->_e2eEncryptionStatus);
+    connect(_transaction, &EncryptedFolderTransaction::ready, this, &PropagateUploadEncrypted::slotTransactionReady);
+    connect(_transaction, &EncryptedFolderTransaction::failed, this, &PropagateUploadEncrypted::slotTransactionFailed);
+    _transaction->start();
 }
 
-/* We try to lock a folder, if it's locked we try again in one second.
- * if it's still locked we try again in one second. looping untill one minute.
- *                                                                      -> fail.
- * the 'loop':                                                         /
- *    slotFolderEncryptedIdReceived -> slotTryLock -> lockError -> stillTime? -> slotTryLock
- *                                        \
- *                                         -> success.
- */
-
-void PropagateUploadEncrypted::slotFolderEncryptedIdReceived(const QStringList &list)
+void PropagateUploadEncrypted::disconnectTransaction()
 {
-  qCDebug(lcPropagateUploadEncrypted) << "Received id of folder, trying to lock it so we can prepare the metadata";
-  auto job = qobject_cast<LsColJob *>(sender());
-  const auto& folderInfo = job->_folderInfos.value(list.first());
-  _folderLockFirstTry.start();
-  slotTryLock(folderInfo.fileId);
+    // The transaction is shared, only react to the first ready() or failed()
+    disconnect(_transaction, nullptr, this, nullptr);
 }
 
-void PropagateUploadEncrypted::slotTryLock(const QByteArray& fileId)
+void PropagateUploadEncrypted::slotTransactionFailed()
 {
-  const auto lockJob = new LockEncryptFolderApiJob(_propagator->account(), fileId, _propagator->_journal, _propagator->account()->e2e()->_publicKey, this);
-  connect(lockJob, &LockEncryptFolderApiJob::success, this, &PropagateUploadEncrypted::slotFolderLockedSuccessfully);
-  connect(lockJob, &LockEncryptFolderApiJob::error, this, &PropagateUploadEncrypted::slotFolderLockedError);
-  lockJob->start();
+    disconnectTransaction();
+    qCDebug(lcPropagateUploadEncrypted) << "Couldn't lock the encrypted folder or fetch its metadata.";
+    emit error();
 }
 
-void PropagateUploadEncrypted::slotFolderLockedSuccessfully(const QByteArray& fileId, const QByteArray& token)
+void PropagateUploadEncrypted::slotTransactionReady()
 {
-  qCDebug(lcPropagateUploadEncrypted) << "Folder" << fileId << "Locked Successfully for Upload, Fetching Metadata";
-  // Should I use a mutex here?
-  _currentLockingInProgress = true;
-  _folderToken = token;
-  _folderId = fileId;
-  _isFolderLocked = true;
-
-  auto job = new GetMetadataApiJob(_propagator->account(), _folderId);
-  connect(job, &GetMetadataApiJob::jsonReceived,
-          this, &PropagateUploadEncrypted::slotFolderEncryptedMetadataReceived);
-  connect(job, &GetMetadataApiJob::error,
-          this, &PropagateUploadEncrypted::slotFolderEncryptedMetadataError);
-
-  job->start();
-}
-
-void PropagateUploadEncrypted::slotFolderEncryptedMetadataError(const QByteArray& fileId, int httpReturnCode)
-{
-    Q_UNUSED(fileId);
-    Q_UNUSED(httpReturnCode);
-    qCDebug(lcPropagateUploadEncrypted()) << "Error Getting the encrypted metadata. Pretend we got empty metadata.";
-    const FolderMetadata emptyMetadata(_propagator->account());
-    auto json = QJsonDocument::fromJson(emptyMetadata.encryptedMetadata());
-    slotFolderEncryptedMetadataReceived(json, httpReturnCode);
-}
-
-void PropagateUploadEncrypted::slotFolderEncryptedMetadataReceived(const QJsonDocument &json, int statusCode)
-{
-  qCDebug(lcPropagateUploadEncrypted) << "Metadata Received, Preparing it for the new file." << json.toVariant();
-
-  // Encrypt File!
-  _metadata.reset(new FolderMetadata(_propagator->account(),
-                                     _item->_e2eEncryptionStatus == SyncFileItem::EncryptionStatus::EncryptedMigratedV1_2 ? FolderMetadata::RequiredMetadataVersion::Version1_2 : FolderMetadata::RequiredMetadataVersion::Version1,
-                                     json.toJson(QJsonDocument::Compact), statusCode));
-
-  if (!_metadata->isMetadataSetup()) {
-      if (_isFolderLocked) {
-          connect(this, &PropagateUploadEncrypted::folderUnlocked, this, &PropagateUploadEncrypted::error);
-          unlockFolder();
-      } else {
-          emit error();
-      }
-      return;
-  }
+  disconnectTransaction();
+  qCDebug(lcPropagateUploadEncrypted) << "Metadata Received, Preparing it for the new file.";
 
   QFileInfo info(_propagator->fullLocalPath(_item->_file));
   const QString fileName = info.fileName();
@@ -141,7 +68,7 @@ void PropagateUploadEncrypted::slotFolderEncryptedMetadataReceived(const QJsonDo
   // Find existing metadata for this file
   bool found = false;
   EncryptedFile encryptedFile;
-  const QVector<EncryptedFile> files = _metadata->files();
+  const QVector<EncryptedFile> files = _transaction->metadata()->files();
 
   for(const EncryptedFile &file : files) {
     if (file.originalFilename == fileName) {
@@ -189,8 +116,7 @@ void PropagateUploadEncrypted::slotFolderEncryptedMetadataReceived(const QJsonDo
 
       if (!encryptionResult) {
         qCDebug(lcPropagateUploadEncrypted()) << "There was an error encrypting the file, aborting upload.";
-        connect(this, &PropagateUploadEncrypted::folderUnlocked, this, &PropagateUploadEncrypted::error);
-        unlockFolder();
+        emit error();
         return;
       }
 
@@ -198,113 +124,33 @@ void PropagateUploadEncrypted::slotFolderEncryptedMetadataReceived(const QJsonDo
       _completeFileName = output.fileName();
   }
 
-  qCDebug(lcPropagateUploadEncrypted) << "Creating the metadata for the encrypted file.";
-
-  _metadata->addEncryptedFile(encryptedFile);
   _encryptedFile = encryptedFile;
 
-  qCDebug(lcPropagateUploadEncrypted) << "Metadata created, sending to the server.";
-
-  if (statusCode == 404) {
-    auto job = new StoreMetaDataApiJob(_propagator->account(),
-                                       _folderId,
-                                       _metadata->encryptedMetadata());
-    connect(job, &StoreMetaDataApiJob::success, this, &PropagateUploadEncrypted::slotUpdateMetadataSuccess);
-    connect(job, &StoreMetaDataApiJob::error, this, &PropagateUploadEncrypted::slotUpdateMetadataError);
-    job->start();
-  } else {
-    auto job = new UpdateMetadataApiJob(_propagator->account(),
-                                      _folderId,
-                                      _metadata->encryptedMetadata(),
-                                      _folderToken);
-
-    connect(job, &UpdateMetadataApiJob::success, this, &PropagateUploadEncrypted::slotUpdateMetadataSuccess);
-    connect(job, &UpdateMetadataApiJob::error, this, &PropagateUploadEncrypted::slotUpdateMetadataError);
-    job->start();
-  }
-}
-
-void PropagateUploadEncrypted::slotUpdateMetadataSuccess(const QByteArray& fileId)
-{
-    Q_UNUSED(fileId);
-    qCDebug(lcPropagateUploadEncrypted) << "Uploading of the metadata success, Encrypting the file";
-    QFileInfo outputInfo(_completeFileName);
-
-    qCDebug(lcPropagateUploadEncrypted) << "Encrypted Info:" << outputInfo.path() << outputInfo.fileName() << outputInfo.size();
-    qCDebug(lcPropagateUploadEncrypted) << "Finalizing the upload part, now the actuall uploader will take over";
-    emit finalized(outputInfo.path() + QLatin1Char('/') + outputInfo.fileName(),
-                   _remoteParentPath + QLatin1Char('/') + outputInfo.fileName(),
-                   outputInfo.size());
-}
-
-void PropagateUploadEncrypted::slotUpdateMetadataError(const QByteArray& fileId, int httpErrorResponse)
-{
-  qCDebug(lcPropagateUploadEncrypted) << "Update metadata error for folder" << fileId << "with error" << httpErrorResponse;
-  qCDebug(lcPropagateUploadEncrypted()) << "Unlocking the folder.";
-  connect(this, &PropagateUploadEncrypted::folderUnlocked, this, &PropagateUploadEncrypted::error);
-  unlockFolder();
+  QFileInfo outputInfo(_completeFileName);
+  qCDebug(lcPropagateUploadEncrypted) << "Encrypted Info:" << outputInfo.path() << outputInfo.fileName() << outputInfo.size();
+  qCDebug(lcPropagateUploadEncrypted) << "Finalizing the upload part, now the actuall uploader will take over";
+  emit finalized(outputInfo.path() + QLatin1Char('/') + outputInfo.fileName(),
+                 _remoteParentPath + QLatin1Char('/') + outputInfo.fileName(),
+                 outputInfo.size());
 }
 
-void PropagateUploadEncrypted::slotFolderLockedError(const QByteArray& fileId, int httpErrorCode)
+void PropagateUploadEncrypted::fileUploaded()
 {
-    Q_UNUSED(httpErrorCode);
-    /* try to call the lock from 5 to 5 seconds
-     * and fail if it's more than 5 minutes. */
-    QTimer::singleShot(5000, this, [this, fileId]{
-        if (!_currentLockingInProgress) {
-            qCDebug(lcPropagateUploadEncrypted) << "Error locking the folder while no other update is locking it up.";
-            qCDebug(lcPropagateUploadEncrypted) << "Perhaps another client locked it.";
-            qCDebug(lcPropagateUploadEncrypted) << "Abort";
+    if (!_transaction || !_transaction->metadata()) {
+        qCWarning(lcPropagateUploadEncrypted) << "No metadata to add" << _item->_file << "to";
+        emit metadataWritten(false);
         return;
-        }
+    }
 
-        // Perhaps I should remove the elapsed timer if the lock is from this client?
-        if (_folderLockFirstTry.elapsed() > /* five minutes */ 1000 * 60 * 5 ) {
-            qCDebug(lcPropagateUploadEncrypted) << "One minute passed, ignoring more attempts to lock the folder.";
-        return;
-        }
-        slotTryLock(fileId);
+    qCDebug(lcPropagateUploadEncrypted) << "Adding" << _item->_file << "to the metadata of its folder.";
+    _transaction->fileUploaded(_encryptedFile, _item->_file, _item->_encryptedFileName, this, [this](bool success) {
+        emit metadataWritten(success);
     });
-
-    qCDebug(lcPropagateUploadEncrypted) << "Folder" << fileId << "Coundn't be locked.";
-}
-
-void PropagateUploadEncrypted::slotFolderEncryptedIdError(QNetworkReply *r)
-{
-    Q_UNUSED(r);
-    qCDebug(lcPropagateUploadEncrypted) << "Error retrieving the Id of the encrypted folder.";
 }
 
-void PropagateUploadEncrypted::unlockFolder()
+QByteArray PropagateUploadEncrypted::folderToken() const
 {
-    ASSERT(!_isUnlockRunning);
-
-    if (_isUnlockRunning) {
-        qWarning() << "Double-call to unlockFolder.";
-        return;
-    }
-
-    _isUnlockRunning = true;
-
-    qDebug() << "Calling Unlock";
-    auto *unlockJob = new UnlockEncryptFolderApiJob(_propagator->account(), _folderId, _folderToken, _propagator->_journal, this);
-
-    connect(unlockJob, &UnlockEncryptFolderApiJob::success, [this](const QByteArray &folderId) {
-        qDebug() << "Successfully Unlocked";
-        _folderToken = "";
-        _folderId = "";
-        _isFolderLocked = false;
-
-        emit folderUnlocked(folderId, 200);
-        _isUnlockRunning = false;
-    });
-    connect(unlockJob, &UnlockEncryptFolderApiJob::error, [this](const QByteArray &folderId, int httpStatus) {
-        qDebug() << "Unlock Error";
-
-        emit folderUnlocked(folderId, httpStatus);
-        _isUnlockRunning = false;
-    });
-    unlockJob->start();
+    return _transaction ? _transaction->folderToken() : QByteArray();
 }
 
 } // namespace OCC
@@ -7,7 +7,7 @@
 #include <QByteArray>
 #include <QJsonDocument>
 #include <QNetworkReply>
-#include <QScopedPointer>
+#include <QPointer>
 #include <QFile>
 #include <QTemporaryFile>
 
@@ -16,15 +16,22 @@
 
 namespace OCC {
 class FolderMetadata;
+class EncryptedFolderTransaction;
 
   /* This class is used if the server supports end to end encryption.
  * It will fire for *any* folder, encrypted or not, because when the
  * client starts the upload request we don't know if the folder is
  * encrypted on the server.
  *
+ * The folder is locked and its metadata is fetched by the
+ * EncryptedFolderTransaction shared by all jobs in that folder. Call
+ * fileUploaded() once the upload succeeded to add the file to the metadata
+ * and write it.
+ *
  * emits:
  * finalized() if the encrypted file is ready to be uploaded
  * error() if there was an error with the encryption
+ * metadataWritten() once the metadata listing the uploaded file was written
  * folderNotEncrypted() if the file is within a folder that's not encrypted.
  *
  */
@@ -38,46 +45,30 @@ public:
 
     void start();
 
-    void unlockFolder();
+    /// Adds the uploaded file to the folder's metadata and writes it, emits metadataWritten()
+    void fileUploaded();
 
-    [[nodiscard]] bool isUnlockRunning() const { return _isUnlockRunning; }
-    [[nodiscard]] bool isFolderLocked() const { return _isFolderLocked; }
-    [[nodiscard]] const QByteArray folderToken() const { return _folderToken; }
+    [[nodiscard]] QByteArray folderToken() const;
 
 private slots:
-    void slotFolderEncryptedIdReceived(const QStringList &list);
-    void slotFolderEncryptedIdError(QNetworkReply *r);
-    void slotFolderLockedSuccessfully(const QByteArray& fileId, const QByteArray& token);
-    void slotFolderLockedError(const QByteArray& fileId, int httpErrorCode);
-    void slotTryLock(const QByteArray& fileId);
-    void slotFolderEncryptedMetadataReceived(const QJsonDocument &json, int statusCode);
-    void slotFolderEncryptedMetadataError(const QByteArray& fileId, int httpReturnCode);
-    void slotUpdateMetadataSuccess(const QByteArray& fileId);
-    void slotUpdateMetadataError(const QByteArray& fileId, int httpReturnCode);
+    void slotTransactionReady();
+    void slotTransactionFailed();
 
 signals:
     // Emmited after the file is encrypted and everythign is setup.
     void finalized(const QString& path, const QString& filename, quint64 size);
     void error();
-    void folderUnlocked(const QByteArray &folderId, int httpStatus);
+    // Only report the upload as successful on success, else the file was removed from the server again
+    void metadataWritten(bool success);
 
 private:
+  void disconnectTransaction();
+
   OwncloudPropagator *_propagator;
   QString _remoteParentPath;
   SyncFileItemPtr _item;
 
-  QByteArray _folderToken;
-  QByteArray _folderId;
-
-  QElapsedTimer _folderLockFirstTry;
-  bool _currentLockingInProgress = false;
-
-  bool _isUnlockRunning = false;
-  bool _isFolderLocked = false;
-
-  QByteArray _generatedKey;
-  QByteArray _generatedIv;
-  QScopedPointer<FolderMetadata> _metadata;
+  QPointer<EncryptedFolderTransaction> _transaction;
   EncryptedFile _encryptedFile;
   QString _completeFileName;
 };
@@ -30,16 +30,22 @@
 #include <QNetworkAccessManager>
 #include <QFileInfo>
 #include <QDir>
+#include <qtconcurrentrun.h>
 #include <cmath>
 #include <cstring>
 
 namespace OCC {
 
 QUrl PropagateUploadFileNG::chunkUrl(int chunk)
+{
+    return chunkUrl(_transferId, chunk);
+}
+
+QUrl PropagateUploadFileNG::chunkUrl(uint transferId, int chunk)
 {
     QString path = QLatin1String("remote.php/dav/uploads/")
         + propagator()->account()->davUser()
-        + QLatin1Char('/') + QString::number(_transferId);
+        + QLatin1Char('/') + QString::number(transferId);
     if (chunk >= 0) {
         // We need to do add leading 0 because the server orders the chunk alphabetically
         path += QLatin1Char('/') + QString::number(chunk).rightJustified(16, '0'); // 1e16 is 10 petabyte
@@ -51,6 +57,9 @@ QUrl PropagateUploadFileNG::chunkUrl(int chunk)
   State machine:
 
      *----> doStartUpload()
+            Delta upload? Compute the block signature
+              |
+            resumeOrStartNewUpload()
             Check the db: is there an entry?
               /               \
              no                yes
@@ -69,10 +78,16 @@ QUrl PropagateUploadFileNG::chunkUrl(int chunk)
     |
     +---->  startNextChunk()  ---finished?  --+
                   ^               |          |
+                  |          PUT or COPY     |
+                  |               |          |
                   +---------------+          |
                                              |
     +----------------------------------------+
     |
+    +-> Checksums of the sent data complete?  --no-->  compute them from the file
+    |                                                        |
+    +<-------------------------------------------------------+
+    |
     +-> MOVE ------> moveJobFinished() ---> finalize()
 
 
@@ -82,6 +97,68 @@ void PropagateUploadFileNG::doStartUpload()
 {
     propagator()->_activeJobList.append(this);
 
+    if (!isDeltaUploadCandidate()) {
+        resumeOrStartNewUpload();
+        return;
+    }
+
+    // Reading a big file takes a while, don't block the event loop
+    connect(&_blockSignatureWatcher, &QFutureWatcherBase::finished,
+        this, &PropagateUploadFileNG::slotBlockSignatureComputed);
+    const auto path = _fileToUpload._path;
+    _blockSignatureWatcher.setFuture(QtConcurrent::run([path]() {
+        return BlockSignature::computeForFile(path);
+    }));
+}
+
+bool PropagateUploadFileNG::computesChecksumsWhileUploading() const
+{
+    // The checksums go into the final MOVE. Delta uploads copy blocks on the
+    // server instead of sending them and read the whole file for the block
+    // signature anyway.
+    return !isDeltaUploadCandidate();
+}
+
+void PropagateUploadFileNG::checksumsComputedAfterUpload()
+{
+    startNextChunk();
+}
+
+bool PropagateUploadFileNG::isDeltaUploadCandidate() const
+{
+    return propagator()->account()->capabilities().deltaChunking()
+        && _fileToUpload._size >= propagator()->syncOptions()._minDeltaUploadSize
+        && !uploadingEncrypted();
+}
+
+void PropagateUploadFileNG::slotBlockSignatureComputed()
+{
+    if (propagator()->_abortRequested)
+        return;
+
+    _blockSignature = _blockSignatureWatcher.result();
+    if (_blockSignature.isValid() && _blockSignature.size() != _fileToUpload._size) {
+        // The file is being modified, the upload will notice and fail
+        qCInfo(lcPropagateUploadNG) << "Size changed while computing the block signature of" << _item->_file;
+        _blockSignature = BlockSignature();
+    }
+
+    if (_blockSignature.isValid()) {
+        const auto previous = propagator()->_journal->getBlockSignature(_item->_file);
+        if (previous._valid) {
+            _previousTransferId = previous._transferid;
+            _blockMatches = _blockSignature.matchBlocks(BlockSignature::deserialize(previous._signature));
+            qCInfo(lcPropagateUploadNG) << "Delta upload of" << _item->_file << ":"
+                                        << _blockMatches.size() - _blockMatches.count(-1) << "of" << _blockMatches.size()
+                                        << "blocks are unchanged";
+        }
+    }
+
+    resumeOrStartNewUpload();
+}
+
+void PropagateUploadFileNG::resumeOrStartNewUpload()
+{
     const SyncJournalDb::UploadInfo progressInfo = propagator()->_journal->getUploadInfo(_item->_file);
     Q_ASSERT(_item->_modtime > 0);
     if (_item->_modtime <= 0) {
@@ -142,6 +219,23 @@ void PropagateUploadFileNG::slotPropfindFinished()
         ++_currentChunk;
     }
 
+    if (_blockSignature.isValid()) {
+        // The remaining chunks must continue on a block boundary
+        const auto &blocks = _blockSignature.blocks();
+        const auto chunksMatchBlocks = _currentChunk <= blocks.size()
+            && (_currentChunk < blocks.size() ? blocks[_currentChunk].offset : _fileToUpload._size) == _sent;
+        if (!chunksMatchBlocks) {
+            qCInfo(lcPropagateUploadNG) << "Chunks on the server don't match the blocks of" << _item->_file << ", restarting";
+
+            // Fire and forget. Any error will be ignored.
+            (new DeleteJob(propagator()->account(), chunkUrl(), this))->start();
+
+            propagator()->_activeJobList.append(this);
+            startNewUpload();
+            return;
+        }
+    }
+
     if (_sent > _fileToUpload._size) {
         // Normally this can't happen because the size is xor'ed with the transfer id, and it is
         // therefore impossible that there is more data on the server than on the file.
@@ -295,13 +389,31 @@ void PropagateUploadFileNG::startNextChunk()
     qint64 fileSize = _fileToUpload._size;
     ENFORCE(fileSize >= _sent, "Sent data exceeds file size");
 
-    // prevent situation that chunk size is bigger then required one to send
-    _currentChunkSize = qMin(propagator()->_chunkSize, fileSize - _sent);
+    if (_blockSignature.isValid()) {
+        // Each chunk is one block, so the next upload can reuse the unchanged ones
+        const auto &blocks = _blockSignature.blocks();
+        _currentChunkSize = _currentChunk < blocks.size() ? blocks[_currentChunk].size : 0;
+    } else {
+        // prevent situation that chunk size is bigger then required one to send
+        _currentChunkSize = qMin(propagator()->_chunkSize, fileSize - _sent);
+    }
 
     if (_currentChunkSize == 0) {
         Q_ASSERT(_jobs.isEmpty()); // There should be no running job anymore
+        if (_uploadChecksums && !takeUploadChecksums()) {
+            return; // continues in checksumsComputedAfterUpload()
+        }
         _finished = true;
 
+        // With the checksums computed while uploading, the upload info doesn't know the
+        // content checksum yet. It is needed to recognize the upload if the MOVE's reply gets lost.
+        auto uploadInfo = propagator()->_journal->getUploadInfo(_item->_file);
+        if (uploadInfo._valid && uploadInfo._contentChecksum != _item->_checksumHeader) {
+            uploadInfo._contentChecksum = _item->_checksumHeader;
+            propagator()->_journal->setUploadInfo(_item->_file, uploadInfo);
+            propagator()->_journal->commit("Upload info");
+        }
+
         // Finish with a MOVE
         // If we changed the file name, we must store the changed filename in the remote folder, not the original one.
         QString destination = QDir::cleanPath(propagator()->account()->davUrl().path()
@@ -318,6 +430,10 @@ void PropagateUploadFileNG::startNextChunk()
             headers[checkSumHeaderC] = _transmissionChecksumHeader;
         }
         headers[QByteArrayLiteral("OC-Total-Length")] = QByteArray::number(fileSize);
+        if (_blockSignature.isValid()) {
+            // Keep the chunks for the next delta upload, see storeBlockSignature()
+            headers[QByteArrayLiteral("OC-Keep-Chunks")] = "1";
+        }
 
         auto job = new MoveJob(propagator()->account(), Utility::concatUrlPath(chunkUrl(), "/.file"),
             destination, headers, this);
@@ -330,9 +446,26 @@ void PropagateUploadFileNG::startNextChunk()
         return;
     }
 
+    if (_blockMatches.value(_currentChunk, -1) >= 0) {
+        // The server still has this block from the previous upload
+        auto job = new CopyJob(propagator()->account(), chunkUrl(_previousTransferId, _blockMatches[_currentChunk]),
+            chunkUrl(_currentChunk).path(), {}, this);
+        _jobs.append(job);
+        connect(job, &CopyJob::finishedSignal, this, &PropagateUploadFileNG::slotCopyFinished);
+        connect(job, &QObject::destroyed, this, &PropagateUploadFileCommon::slotJobDestroyed);
+        _sent += _currentChunkSize;
+        _currentChunk++;
+        job->start();
+        propagator()->_activeJobList.append(this);
+        return;
+    }
+
     const QString fileName = _fileToUpload._path;
     auto device = std::make_unique<UploadDevice>(
             fileName, _sent, _currentChunkSize, &propagator()->_bandwidthManager);
+    if (_uploadChecksums) {
+        device->setChecksums(_uploadChecksums);
+    }
     if (!device->open(QIODevice::ReadOnly)) {
         qCWarning(lcPropagateUploadNG) << "Could not prepare upload device: " << device->errorString();
 
@@ -421,6 +554,39 @@ void PropagateUploadFileNG::slotPutFinished()
                                   << propagator()->_chunkSize << "bytes";
     }
 
+    chunkFinished();
+}
+
+void PropagateUploadFileNG::slotCopyFinished()
+{
+    auto *job = qobject_cast<CopyJob *>(sender());
+    ASSERT(job);
+
+    slotJobDestroyed(job); // remove it from the _jobs list
+
+    propagator()->_activeJobList.removeOne(this);
+
+    if (_finished) {
+        return;
+    }
+
+    if (job->reply()->error() != QNetworkReply::NoError) {
+        // The kept chunks may be gone, upload the remaining blocks instead
+        qCWarning(lcPropagateUploadNG) << "Could not copy block" << _blockMatches.value(_currentChunk - 1)
+                                       << "of transfer" << _previousTransferId << ":" << job->errorString();
+        _blockMatches.clear();
+        _currentChunk--;
+        _sent -= _currentChunkSize;
+        startNextChunk();
+        return;
+    }
+
+    propagator()->reportProgress(*_item, _sent);
+    chunkFinished();
+}
+
+void PropagateUploadFileNG::chunkFinished()
+{
     _finished = _sent == _item->_size;
 
     // Check if the file still exists
@@ -484,6 +650,7 @@ void PropagateUploadFileNG::slotMoveJobFinished()
             done(SyncFileItem::NormalError, tr("Poll URL missing"));
             return;
         }
+        storeBlockSignature();
         _finished = true;
         startPollJob(path);
         return;
@@ -493,6 +660,7 @@ void PropagateUploadFileNG::slotMoveJobFinished()
         abortWithError(SyncFileItem::NormalError, tr("Unexpected return code from server (%1)").arg(_item->_httpErrorCode));
         return;
     }
+    storeBlockSignature();
 
     QByteArray fid = job->reply()->rawHeader("OC-FileID");
     if (fid.isEmpty()) {
@@ -517,6 +685,30 @@ void PropagateUploadFileNG::slotMoveJobFinished()
     finalize();
 }
 
+void PropagateUploadFileNG::storeBlockSignature()
+{
+    // Also done when this upload wasn't a delta upload: at most one set of
+    // kept chunks may exist per file.
+    const auto previous = propagator()->_journal->getBlockSignature(_item->_file);
+    if (previous._valid && previous._transferid != _transferId) {
+        // The chunks kept for the previous version are not needed anymore.
+        // Fire and forget. Any error will be ignored.
+        (new DeleteJob(propagator()->account(), chunkUrl(previous._transferid, -1), propagator()))->start();
+    }
+
+    if (!previous._valid && !_blockSignature.isValid()) {
+        return;
+    }
+
+    SyncJournalDb::BlockSignatureInfo info;
+    if (_blockSignature.isValid()) {
+        info._valid = true;
+        info._transferid = _transferId;
+        info._signature = _blockSignature.serialize();
+    }
+    propagator()->_journal->setBlockSignature(_item->_file, info);
+}
+
 void PropagateUploadFileNG::slotUploadProgress(qint64 sent, qint64 total)
 {
     // Completion is signaled with sent=0, total=0; avoid accidentally
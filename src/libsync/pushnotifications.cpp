@@ -16,6 +16,9 @@
 #include "creds/abstractcredentials.h"
 #include "account.h"
 
+#include <QJsonArray>
+#include <QJsonDocument>
+
 namespace {
 static constexpr int MAX_ALLOWED_FAILED_AUTHENTICATION_ATTEMPTS = 3;
 static constexpr int PING_INTERVAL = 30 * 1000;
@@ -113,6 +116,8 @@ void PushNotifications::onWebSocketTextMessageReceived(const QString &message)
 
     if (message == "notify_file") {
         handleNotifyFile();
+    } else if (message.startsWith(QStringLiteral("notify_file_id "))) {
+        handleNotifyFileId(message);
     } else if (message == "notify_activity") {
         handleNotifyActivity();
     } else if (message == "notify_notification") {
@@ -195,6 +200,11 @@ void PushNotifications::handleAuthenticated()
     _failedAuthenticationAttemptsCount = 0;
     _isReady = true;
     startPingTimer();
+
+    // Ask for the ids of the changed files. Servers that can't tell them
+    // keep sending notify_file.
+    _webSocket->sendTextMessage(QStringLiteral("listen notify_file_id"));
+
     emit ready();
 
     // We maybe reconnected to websocket while being offline for a
@@ -211,6 +221,26 @@ void PushNotifications::handleNotifyFile()
     emitFilesChanged();
 }
 
+void PushNotifications::handleNotifyFileId(const QString &message)
+{
+    // "notify_file_id [1,2,3]"
+    const auto json = QJsonDocument::fromJson(message.mid(message.indexOf(QLatin1Char(' ')) + 1).toUtf8());
+    if (!json.isArray()) {
+        qCWarning(lcPushNotifications) << "Invalid file ids push notification, assuming any file changed";
+        emitFilesChanged();
+        return;
+    }
+
+    QVector<qint64> fileIds;
+    const auto array = json.array();
+    fileIds.reserve(array.size());
+    for (const auto &value : array) {
+        fileIds.append(value.toVariant().toLongLong());
+    }
+    qCInfo(lcPushNotifications) << "Files push notification arrived for" << fileIds.size() << "files";
+    emit fileIdsChanged(_account, fileIds);
+}
+
 void PushNotifications::handleInvalidCredentials()
 {
     qCInfo(lcPushNotifications) << "Invalid credentials submitted to websocket";
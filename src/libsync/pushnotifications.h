@@ -16,6 +16,7 @@
 
 #include <QWebSocket>
 #include <QTimer>
+#include <QVector>
 
 #include "capabilities.h"
 
@@ -74,6 +75,13 @@ signals:
      */
     void filesChanged(OCC::Account *account);
 
+    /**
+     * Will be emitted if files on the server changed and the server told which ones
+     *
+     * fileIds are the numeric file ids (oc:fileid) of the changed files.
+     */
+    void fileIdsChanged(OCC::Account *account, const QVector<qint64> &fileIds);
+
     /**
      * Will be emitted if activities have been changed on the server
      */
@@ -120,6 +128,7 @@ private:
 
     void handleAuthenticated();
     void handleNotifyFile();
+    void handleNotifyFileId(const QString &message);
     void handleInvalidCredentials();
     void handleNotifyNotification();
     void handleNotifyActivity();
@@ -211,21 +211,34 @@ static bool isFileTransferInstruction(SyncInstructions instruction)
         || instruction == CSYNC_INSTRUCTION_TYPE_CHANGE;
 }
 
-void SyncEngine::deleteStaleDownloadInfos(const SyncFileItemVector &syncItems)
+SyncEngine::KeptJournalPaths SyncEngine::collectKeptJournalPaths() const
 {
-    // Find all downloadinfo paths that we want to preserve.
-    QSet<QString> download_file_paths;
-    foreach (const SyncFileItemPtr &it, syncItems) {
-        if (it->_direction == SyncFileItem::Down
-            && it->_type == ItemTypeFile
-            && isFileTransferInstruction(it->_instruction)) {
-            download_file_paths.insert(it->_file);
+    KeptJournalPaths kept;
+    const auto collect = [&kept](const SyncFileItemVector &syncItems) {
+        for (const auto &it : syncItems) {
+            if (it->_hasBlacklistEntry) {
+                kept.blacklisted.insert(it->_file);
+            }
+            if (it->_type != ItemTypeFile || !isFileTransferInstruction(it->_instruction)) {
+                continue;
+            }
+            if (it->_direction == SyncFileItem::Down) {
+                kept.downloads.insert(it->_file);
+            } else if (it->_direction == SyncFileItem::Up) {
+                kept.uploads.insert(it->_file);
+            }
         }
-    }
+    };
+    collect(_pipelinedItems);
+    collect(_syncItems);
+    return kept;
+}
 
+void SyncEngine::deleteStaleDownloadInfos(const QSet<QString> &keep)
+{
     // Delete from journal and from filesystem.
     const QVector<SyncJournalDb::DownloadInfo> deleted_infos =
-        _journal->getAndDeleteStaleDownloadInfos(download_file_paths);
+        _journal->getAndDeleteStaleDownloadInfos(keep);
     foreach (const SyncJournalDb::DownloadInfo &deleted_info, deleted_infos) {
         const QString tmppath = _propagator->fullLocalPath(deleted_info._tmpfile);
         qCInfo(lcEngine) << "Deleting stale temporary file: " << tmppath;
@@ -233,20 +246,10 @@ void SyncEngine::deleteStaleDownloadInfos(const SyncFileItemVector &syncItems)
     }
 }
 
-void SyncEngine::deleteStaleUploadInfos(const SyncFileItemVector &syncItems)
+void SyncEngine::deleteStaleUploadInfos(const QSet<QString> &keep)
 {
-    // Find all blacklisted paths that we want to preserve.
-    QSet<QString> upload_file_paths;
-    foreach (const SyncFileItemPtr &it, syncItems) {
-        if (it->_direction == SyncFileItem::Up
-            && it->_type == ItemTypeFile
-            && isFileTransferInstruction(it->_instruction)) {
-            upload_file_paths.insert(it->_file);
-        }
-    }
-
     // Delete from journal.
-    auto ids = _journal->deleteStaleUploadInfos(upload_file_paths);
+    auto ids = _journal->deleteStaleUploadInfos(keep);
 
     // Delete the stales chunk on the server.
     if (account()->capabilities().chunkingNg()) {
@@ -259,17 +262,24 @@ void SyncEngine::deleteStaleUploadInfos(const SyncFileItemVector &syncItems)
     }
 }
 
-void SyncEngine::deleteStaleErrorBlacklistEntries(const SyncFileItemVector &syncItems)
+void SyncEngine::deleteStaleBlockSignatures()
 {
-    // Find all blacklisted paths that we want to preserve.
-    QSet<QString> blacklist_file_paths;
-    foreach (const SyncFileItemPtr &it, syncItems) {
-        if (it->_hasBlacklistEntry)
-            blacklist_file_paths.insert(it->_file);
+    const auto ids = _journal->deleteStaleBlockSignatures();
+
+    if (account()->capabilities().chunkingNg()) {
+        for (const auto transferId : ids) {
+            if (!transferId)
+                continue;
+            QUrl url = Utility::concatUrlPath(account()->url(), QLatin1String("remote.php/dav/uploads/") + account()->davUser() + QLatin1Char('/') + QString::number(transferId));
+            (new DeleteJob(account(), url, this))->start();
+        }
     }
+}
 
+void SyncEngine::deleteStaleErrorBlacklistEntries(const QSet<QString> &keep)
+{
     // Delete from journal.
-    if (!_journal->deleteStaleErrorBlacklistEntries(blacklist_file_paths)) {
+    if (!_journal->deleteStaleErrorBlacklistEntries(keep)) {
         qCWarning(lcEngine) << "Could not delete StaleErrorBlacklistEntries from DB";
     }
 }
@@ -292,16 +302,21 @@ void SyncEngine::conflictRecordMaintenance()
         }
     }
 
+    if (_seenConflictFiles.isEmpty()) {
+        return;
+    }
+
     // Did the sync see any conflict files that don't yet have records?
     // If so, add them now.
     //
     // This happens when the conflicts table is new or when conflict files
     // are downlaoded but the server doesn't send conflict headers.
+    const QSet<QByteArray> knownRecordPaths(conflictRecordPaths.cbegin(), conflictRecordPaths.cend());
     for (const auto &path : qAsConst(_seenConflictFiles)) {
         ASSERT(Utility::isConflictFile(path));
 
         auto bapath = path.toUtf8();
-        if (!conflictRecordPaths.contains(bapath)) {
+        if (!knownRecordPaths.contains(bapath)) {
             ConflictRecord record;
             record.path = bapath;
             auto basePath = Utility::conflictFileBaseNameFromPattern(bapath);
@@ -544,7 +559,11 @@ void SyncEngine::startSync()
     }
 
     _syncItems.clear();
+    _pipelinedItems.clear();
     _needsUpdate = false;
+    _pipelinedPropagation = _syncOptions._pipelinedPropagation
+        && !singleItemDiscoveryOptions().isValid()
+        && !_syncOptions.fileRegex().isValid();
 
     if (!_journal->exists()) {
         qCInfo(lcEngine) << "New sync (no sync journal exists)";
@@ -629,6 +648,12 @@ void SyncEngine::startSync()
         qCDebug(lcEngine) << "shouldDiscoverLocaly" << path << (result ? "true" : "false");
         return result;
     };
+    if (!_remoteDiscoveryPaths.empty() && !singleItemDiscoveryOptions().isValid()) {
+        qCInfo(lcEngine) << "Remote discovery limited to" << _remoteDiscoveryPaths.size() << "folders";
+        _discoveryPhase->_remoteDiscoveryPaths = _remoteDiscoveryPaths;
+        // The root folder isn't queried, so the fingerprint can't have changed
+        _discoveryPhase->_dataFingerprint = _journal->dataFingerprint();
+    }
     _discoveryPhase->setSelectiveSyncBlackList(selectiveSyncBlackList);
     _discoveryPhase->setSelectiveSyncWhiteList(_journal->getSelectiveSyncList(SyncJournalDb::SelectiveSyncWhiteList, &ok));
     if (!ok) {
@@ -658,9 +683,15 @@ void SyncEngine::startSync()
     connect(_discoveryPhase.data(), &DiscoveryPhase::newBigFolder, this, &SyncEngine::newBigFolder);
     connect(_discoveryPhase.data(), &DiscoveryPhase::fatalError, this, [this](const QString &errorString, ErrorCategory errorCategory) {
         Q_EMIT syncError(errorString, errorCategory);
-        finalize(false);
+        if (_propagator) {
+            // Pipelined jobs are running, the sync is finalized once they stopped
+            abort();
+        } else {
+            finalize(false);
+        }
     });
     connect(_discoveryPhase.data(), &DiscoveryPhase::finished, this, &SyncEngine::slotDiscoveryFinished);
+    connect(_discoveryPhase.data(), &DiscoveryPhase::subtreeDiscovered, this, &SyncEngine::slotSubtreeDiscovered);
     connect(_discoveryPhase.data(), &DiscoveryPhase::silentlyExcluded,
         _syncFileStatusTracker.data(), &SyncFileStatusTracker::slotAddSilentlyExcluded);
 
@@ -758,6 +789,7 @@ void SyncEngine::slotDiscoveryFinished()
     }
 
     qCInfo(lcEngine) << "#### Discovery end #################################################### " << _stopWatch.addLapTime(QLatin1String("Discovery Finished")) << "ms";
+    _pipelinedPropagation = false;
 
     // Sanity check
     if (!_journal->open()) {
@@ -772,8 +804,12 @@ void SyncEngine::slotDiscoveryFinished()
 
     _progressInfo->_currentDiscoveredRemoteFolder.clear();
     _progressInfo->_currentDiscoveredLocalFolder.clear();
-    _progressInfo->_status = ProgressInfo::Reconcile;
-    emit transmissionProgress(*_progressInfo);
+    // A pipelined propagation already reports its progress, it must stay in that status
+    if (_propagator.isNull()) {
+        _progressInfo->_status = ProgressInfo::Reconcile;
+        emit transmissionProgress(*_progressInfo);
+    }
+    emit discoveryFinished();
 
     //    qCInfo(lcEngine) << "Permissions of the root folder: " << _csync_ctx->remote.root_perms.toString();
     auto finish = [this]{
@@ -801,16 +837,26 @@ void SyncEngine::slotDiscoveryFinished()
         qCInfo(lcEngine) << "#### Reconcile (aboutToPropagate) #################################################### " << _stopWatch.addLapTime(QStringLiteral("Reconcile (aboutToPropagate)")) << "ms";
 
         _localDiscoveryPaths.clear();
+        _remoteDiscoveryPaths.clear();
 
-        // To announce the beginning of the sync
-        emit aboutToPropagate(_syncItems);
+        // Parts of the tree might already be propagating, see slotSubtreeDiscovered()
+        const auto propagationStarted = !_propagator.isNull();
+
+        if (propagationStarted) {
+            emit itemsAddedToPropagation(_syncItems);
+        } else {
+            // To announce the beginning of the sync
+            emit aboutToPropagate(_syncItems);
+        }
 
         qCInfo(lcEngine) << "#### Reconcile (aboutToPropagate OK) #################################################### "<< _stopWatch.addLapTime(QStringLiteral("Reconcile (aboutToPropagate OK)")) << "ms";
 
-        // it's important to do this before ProgressInfo::start(), to announce start of new sync
-        _progressInfo->_status = ProgressInfo::Propagation;
-        emit transmissionProgress(*_progressInfo);
-        _progressInfo->startEstimateUpdates();
+        if (!propagationStarted) {
+            // it's important to do this before ProgressInfo::start(), to announce start of new sync
+            _progressInfo->_status = ProgressInfo::Propagation;
+            emit transmissionProgress(*_progressInfo);
+            _progressInfo->startEstimateUpdates();
+        }
 
         // post update phase script: allow to tweak stuff by a custom script in debug mode.
         if (!qEnvironmentVariableIsEmpty("OWNCLOUD_POST_UPDATE_SCRIPT")) {
@@ -831,30 +877,19 @@ void SyncEngine::slotDiscoveryFinished()
         // do a database commit
         _journal->commit(QStringLiteral("post treewalk"));
 
-        _propagator = QSharedPointer<OwncloudPropagator>(
-            new OwncloudPropagator(_account, _localPath, _remotePath, _journal, _bulkUploadBlackList));
-        _propagator->setSyncOptions(_syncOptions);
-        connect(_propagator.data(), &OwncloudPropagator::itemCompleted,
-            this, &SyncEngine::slotItemCompleted);
-        connect(_propagator.data(), &OwncloudPropagator::progress,
-            this, &SyncEngine::slotProgress);
-        connect(_propagator.data(), &OwncloudPropagator::finished, this, &SyncEngine::slotPropagationFinished, Qt::QueuedConnection);
-        connect(_propagator.data(), &OwncloudPropagator::seenLockedFile, this, &SyncEngine::seenLockedFile);
-        connect(_propagator.data(), &OwncloudPropagator::touchedFile, this, &SyncEngine::slotAddTouchedFile);
-        connect(_propagator.data(), &OwncloudPropagator::insufficientLocalStorage, this, &SyncEngine::slotInsufficientLocalStorage);
-        connect(_propagator.data(), &OwncloudPropagator::insufficientRemoteStorage, this, &SyncEngine::slotInsufficientRemoteStorage);
-        connect(_propagator.data(), &OwncloudPropagator::newItem, this, &SyncEngine::slotNewItem);
-
-        // apply the network limits to the propagator
-        setNetworkLimits(_uploadLimit, _downloadLimit);
-
-        deleteStaleDownloadInfos(_syncItems);
-        deleteStaleUploadInfos(_syncItems);
-        deleteStaleErrorBlacklistEntries(_syncItems);
+        if (!propagationStarted) {
+            setupPropagator();
+        }
+
+        // The stale entry cleanup needs to know about all items of this sync
+        const auto kept = collectKeptJournalPaths();
+        deleteStaleDownloadInfos(kept.downloads);
+        deleteStaleUploadInfos(kept.uploads);
+        deleteStaleErrorBlacklistEntries(kept.blacklisted);
         _journal->commit(QStringLiteral("post stale entry removal"));
 
         // Emit the started signal only after the propagator has been set up.
-        if (_needsUpdate)
+        if (_needsUpdate && !propagationStarted)
             Q_EMIT started();
 
         _propagator->start(std::move(_syncItems));
@@ -894,6 +929,114 @@ void SyncEngine::slotDiscoveryFinished()
     finish();
 }
 
+void SyncEngine::slotSubtreeDiscovered(const QString &path)
+{
+    if (!_pipelinedPropagation || !_discoveryPhase) {
+        return;
+    }
+
+    // restoreOldFiles() rewrites the instructions of the whole sync
+    const auto databaseFingerprint = _journal->dataFingerprint();
+    if (!databaseFingerprint.isEmpty() && _discoveryPhase->_dataFingerprint != databaseFingerprint) {
+        qCInfo(lcEngine) << "Data fingerprint changed, not propagating before the end of the discovery";
+        _pipelinedPropagation = false;
+        return;
+    }
+
+    // Until an unchanged file was seen, the discovery might still end up asking the
+    // user to confirm the deletion of all files. That is only decided once it finished.
+    if (!_hasNoneFiles) {
+        return;
+    }
+
+    // Rename detection can still cancel deletions below this directory
+    if (_discoveryPhase->hasQueuedDeletedDirectoriesBelow(path)) {
+        return;
+    }
+
+    SyncFileItemPtr probe(new SyncFileItem);
+    probe->_file = path;
+    const auto pathSlash = path + QLatin1Char('/');
+    const auto begin = std::lower_bound(_syncItems.begin(), _syncItems.end(), probe);
+    auto end = begin;
+    while (end != _syncItems.end()
+        && ((*end)->destination() == path || (*end)->destination().startsWith(pathSlash))) {
+        if (!isStableBeforeDiscoveryFinished(**end)) {
+            return;
+        }
+        ++end;
+    }
+    if (begin == end) {
+        return;
+    }
+
+    SyncFileItemVector subtree;
+    subtree.reserve(std::distance(begin, end));
+    std::move(begin, end, std::back_inserter(subtree));
+    _syncItems.erase(begin, end);
+    _pipelinedItems.append(subtree);
+
+    qCInfo(lcEngine) << "Propagating" << subtree.size() << "items below" << path << "before the end of the discovery";
+
+    if (!_propagator) {
+        _journal->commitIfNeededAndStartNewTransaction("Pipelined propagation");
+        setupPropagator();
+
+        // To announce the beginning of the sync, once
+        emit aboutToPropagate(subtree);
+
+        _progressInfo->_status = ProgressInfo::Propagation;
+        emit transmissionProgress(*_progressInfo);
+        _progressInfo->startEstimateUpdates();
+
+        if (_needsUpdate)
+            Q_EMIT started();
+    } else {
+        emit itemsAddedToPropagation(subtree);
+    }
+
+    _propagator->appendDiscoveredItems(std::move(subtree));
+}
+
+bool SyncEngine::isStableBeforeDiscoveryFinished(const SyncFileItem &item)
+{
+    switch (item._instruction) {
+    case CSYNC_INSTRUCTION_REMOVE:
+    case CSYNC_INSTRUCTION_RENAME:
+    case CSYNC_INSTRUCTION_TYPE_CHANGE:
+        // Might still be turned into or be part of a move
+        return false;
+    default:
+        break;
+    }
+    // These can be cancelled by DiscoveryPhase::findAndCancelDeletedJob()
+    return !item._isRestoration && item._type != ItemTypeVirtualFile;
+}
+
+void SyncEngine::setupPropagator()
+{
+    _propagator = QSharedPointer<OwncloudPropagator>(
+        new OwncloudPropagator(_account, _localPath, _remotePath, _journal, _bulkUploadBlackList));
+    _propagator->setSyncOptions(_syncOptions);
+    connect(_propagator.data(), &OwncloudPropagator::itemCompleted,
+        this, &SyncEngine::slotItemCompleted);
+    connect(_propagator.data(), &OwncloudPropagator::progress,
+        this, &SyncEngine::slotProgress);
+    connect(_propagator.data(), &OwncloudPropagator::finished, this, &SyncEngine::slotPropagationFinished, Qt::QueuedConnection);
+    connect(_propagator.data(), &OwncloudPropagator::seenLockedFile, this, &SyncEngine::seenLockedFile);
+    connect(_propagator.data(), &OwncloudPropagator::touchedFile, this, &SyncEngine::slotAddTouchedFile);
+    connect(_propagator.data(), &OwncloudPropagator::insufficientLocalStorage, this, &SyncEngine::slotInsufficientLocalStorage);
+    connect(_propagator.data(), &OwncloudPropagator::insufficientRemoteStorage, this, &SyncEngine::slotInsufficientRemoteStorage);
+    connect(_propagator.data(), &OwncloudPropagator::newItem, this, &SyncEngine::slotNewItem);
+
+    // apply the network limits to the propagator
+    setNetworkLimits(_uploadLimit, _downloadLimit);
+    setNetworkLimitSchedules(_uploadLimitSchedule, _downloadLimitSchedule);
+
+    // What the user explicitly asked for goes first
+    _propagator->setUserTriggeredPaths(_userTriggeredPaths);
+}
+
 void SyncEngine::slotCleanPollsJobAborted(const QString &error, const ErrorCategory errorCategory)
 {
     syncError(error, errorCategory);
@@ -916,6 +1059,22 @@ void SyncEngine::setNetworkLimits(int upload, int download)
     }
 }
 
+void SyncEngine::setNetworkLimitSchedules(const BandwidthSchedule &upload, const BandwidthSchedule &download)
+{
+    _uploadLimitSchedule = upload;
+    _downloadLimitSchedule = download;
+
+    if (!_propagator)
+        return;
+
+    _propagator->_uploadLimitSchedule = upload;
+    _propagator->_downloadLimitSchedule = download;
+
+    if (!upload.isEmpty() || !download.isEmpty()) {
+        qCInfo(lcEngine) << "Network Limit Schedules (down/up) " << download.toString() << upload.toString();
+    }
+}
+
 void SyncEngine::slotItemCompleted(const SyncFileItemPtr &item, const ErrorCategory category)
 {
     _progressInfo->setProgressComplete(*item);
@@ -937,7 +1096,9 @@ void SyncEngine::slotPropagationFinished(bool success)
     conflictRecordMaintenance();
     caseClashConflictRecordMaintenance();
 
+    // Only scans the metadata table if records were deleted since the last cleanup
     _journal->deleteStaleFlagsEntries();
+    deleteStaleBlockSignatures();
     _journal->commit("All Finished.", false);
 
     // Send final progress information even if no
@@ -971,10 +1132,13 @@ void SyncEngine::finalize(bool success)
 
     // Delete the propagator only after emitting the signal.
     _propagator.clear();
+    _pipelinedItems.clear();
     _seenConflictFiles.clear();
     _uniqueErrors.clear();
     _localDiscoveryPaths.clear();
     _localDiscoveryStyle = LocalDiscoveryStyle::FilesystemOnly;
+    _remoteDiscoveryPaths.clear();
+    _userTriggeredPaths.clear();
 
     _clearTouchedFilesTimer.start();
     _leadingAndTrailingSpacesFilesAllowed.clear();
@@ -1107,6 +1271,32 @@ void SyncEngine::setLocalDiscoveryOptions(LocalDiscoveryStyle style, std::set<QS
     }
 }
 
+void SyncEngine::setRemoteDiscoveryPaths(std::set<QString> paths)
+{
+    // Drop the paths that are inside another one, they are discovered anyway
+    for (auto it = paths.begin(); it != paths.end();) {
+        auto parent = *it;
+        auto contained = false;
+        while (!contained && !parent.isEmpty()) {
+            const auto slash = parent.lastIndexOf(QLatin1Char('/'));
+            parent = slash < 0 ? QString() : parent.left(slash);
+            contained = paths.count(parent);
+        }
+        it = contained ? paths.erase(it) : std::next(it);
+    }
+
+    // The root folder means a full remote discovery
+    if (paths.count(QString())) {
+        paths.clear();
+    }
+    _remoteDiscoveryPaths = std::move(paths);
+}
+
+void SyncEngine::setUserTriggeredPaths(std::set<QString> paths)
+{
+    _userTriggeredPaths = std::move(paths);
+}
+
 void SyncEngine::setSingleItemDiscoveryOptions(const SingleItemDiscoveryOptions &singleItemDiscoveryOptions)
 {
     _singleItemDiscoveryOptions = singleItemDiscoveryOptions;
@@ -1211,7 +1401,12 @@ void SyncEngine::switchToVirtualFiles(const QString &localPath, SyncJournalDb &j
 void SyncEngine::abort()
 {
     if (_propagator) {
-        // If we're already in the propagation phase, aborting that is sufficient
+        // If we're already in the propagation phase, aborting that is sufficient.
+        // With pipelined propagation the discovery might still be running, it must
+        // not hand over more items.
+        if (_discoveryPhase) {
+            disconnect(_discoveryPhase.data(), nullptr, this, nullptr);
+        }
         qCInfo(lcEngine) << "Aborting sync in propagator...";
         _propagator->abort();
     } else if (_discoveryPhase) {
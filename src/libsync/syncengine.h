@@ -26,6 +26,7 @@
 #include <QSharedPointer>
 #include <set>
 
+#include "bandwidthschedule.h"
 #include "syncfileitem.h"
 #include "progressdispatcher.h"
 #include "common/utility.h"
@@ -80,6 +81,8 @@ public:
 
     [[nodiscard]] ExcludedFiles &excludedFiles() const { return *_excludedFiles; }
     [[nodiscard]] SyncFileStatusTracker &syncFileStatusTracker() const { return *_syncFileStatusTracker; }
+    /** The current progress, as last emitted with transmissionProgress() */
+    [[nodiscard]] const ProgressInfo &progressInfo() const { return *_progressInfo; }
 
     /* Returns whether another sync is needed to complete the sync */
     [[nodiscard]] AnotherSyncNeeded isAnotherSyncNeeded() const { return _anotherSyncNeeded; }
@@ -138,6 +141,8 @@ public slots:
     void abort();
 
     void setNetworkLimits(int upload, int download);
+    /** Time of day dependent limits that override the ones of setNetworkLimits() while they apply */
+    void setNetworkLimitSchedules(const OCC::BandwidthSchedule &upload, const OCC::BandwidthSchedule &download);
     void setSyncOptions(const OCC::SyncOptions &options) { _syncOptions = options; }
     void setIgnoreHiddenFiles(bool ignore) { _ignore_hidden_files = ignore; }
 
@@ -153,15 +158,45 @@ public slots:
      * sync's style.
      */
     void setLocalDiscoveryOptions(OCC::LocalDiscoveryStyle style, std::set<QString> paths = {});
+
+    /**
+     * Restricts the remote discovery of the next sync to the given folders.
+     *
+     * paths is a set of folder paths relative to the synced folder, for example
+     * the folders a push notification reported changes in. Only these folders
+     * and their changed subfolders are queried on the server. Their parent
+     * folders are traversed with the db entries and all other folders are
+     * assumed to be unchanged on the server. An empty set, or one containing the
+     * root folder, means the usual discovery that starts at the root etag.
+     *
+     * Like the local discovery options, the paths only apply to the next sync.
+     */
+    void setRemoteDiscoveryPaths(std::set<QString> paths);
+
+    /**
+     * Paths the user explicitly asked to have synced, like an opened placeholder
+     * or a folder that was made available locally.
+     *
+     * Their changes are propagated before the other ones. Like the discovery
+     * options, the paths only apply to the next sync.
+     */
+    void setUserTriggeredPaths(std::set<QString> paths);
     void addAcceptedInvalidFileName(const QString& filePath);
 
 signals:
     // During update, before reconcile
     void rootEtag(const QByteArray &, const QDateTime &);
 
+    // once the whole tree was discovered, parts of it may already be propagating
+    void discoveryFinished();
+
     // after the above signals. with the items that actually need propagating
+    // (only the first subtree with SyncOptions::_pipelinedPropagation, see itemsAddedToPropagation())
     void aboutToPropagate(OCC::SyncFileItemVector &);
 
+    // once per batch of items handed to the propagator after aboutToPropagate() was emitted
+    void itemsAddedToPropagation(OCC::SyncFileItemVector &);
+
     // after each item completed by a job (successful or not)
     void itemCompleted(const OCC::SyncFileItemPtr &item, const OCC::ErrorCategory category);
 
@@ -210,6 +245,10 @@ private slots:
 
     void slotItemCompleted(const OCC::SyncFileItemPtr &item, const OCC::ErrorCategory category);
     void slotDiscoveryFinished();
+
+    /** Hands a fully discovered subtree to the propagator if pipelined propagation is possible */
+    void slotSubtreeDiscovered(const QString &path);
+
     void slotPropagationFinished(bool success);
     void slotProgress(const OCC::SyncFileItem &item, qint64 curent);
     void slotCleanPollsJobAborted(const QString &error, const OCC::ErrorCategory category);
@@ -272,15 +311,31 @@ private:
 
     bool checkErrorBlacklisting(SyncFileItem &item);
 
+    // The journal entries that the items of this sync still need, see collectKeptJournalPaths()
+    struct KeptJournalPaths
+    {
+        QSet<QString> downloads;
+        QSet<QString> uploads;
+        QSet<QString> blacklisted;
+    };
+
+    // Collects the paths of this sync's items, including the pipelined ones, whose
+    // transfer or blacklist entries must be preserved. Only changed files become
+    // items, so this is proportional to the changes and not to the size of the tree.
+    [[nodiscard]] KeptJournalPaths collectKeptJournalPaths() const;
+
     // Cleans up unnecessary downloadinfo entries in the journal as well
     // as their temporary files.
-    void deleteStaleDownloadInfos(const SyncFileItemVector &syncItems);
+    void deleteStaleDownloadInfos(const QSet<QString> &keep);
 
     // Removes stale uploadinfos from the journal.
-    void deleteStaleUploadInfos(const SyncFileItemVector &syncItems);
+    void deleteStaleUploadInfos(const QSet<QString> &keep);
+
+    // Removes block signatures of files that are gone and their chunks kept on the server.
+    void deleteStaleBlockSignatures();
 
     // Removes stale error blacklist entries from the journal.
-    void deleteStaleErrorBlacklistEntries(const SyncFileItemVector &syncItems);
+    void deleteStaleErrorBlacklistEntries(const QSet<QString> &keep);
 
     // Removes stale and adds missing conflict records after sync
     void conflictRecordMaintenance();
@@ -291,6 +346,12 @@ private:
     // cleanup and emit the finished signal
     void finalize(bool success);
 
+    // Creates _propagator and connects it, once per sync
+    void setupPropagator();
+
+    // Whether discovering the rest of the tree could still change the instruction of the item
+    static bool isStableBeforeDiscoveryFinished(const SyncFileItem &item);
+
     void processCaseClashConflictsBeforeDiscovery();
 
     // Aggregate scheduled sync runs into interval buckets. Can be used to
@@ -316,6 +377,12 @@ private:
     // Must only be acessed during update and reconcile
     QVector<SyncFileItemPtr> _syncItems;
 
+    // Items already handed to the propagator while the discovery was running
+    SyncFileItemVector _pipelinedItems;
+
+    // Whether subtrees may still be propagated before the discovery finishes, see slotSubtreeDiscovered()
+    bool _pipelinedPropagation = false;
+
     AccountPtr _account;
     bool _needsUpdate = false;
     bool _syncRunning = false;
@@ -337,11 +404,6 @@ private:
     QScopedPointer<SyncFileStatusTracker> _syncFileStatusTracker;
     Utility::StopWatch _stopWatch;
 
-    /**
-     * check if we are allowed to propagate everything, and if we are not, adjust the instructions
-     * to recover
-     */
-    void checkForPermission(SyncFileItemVector &syncItems);
     [[nodiscard]] RemotePermissions getPermissions(const QString &file) const;
 
     /**
@@ -361,6 +423,8 @@ private:
 
     int _uploadLimit = 0;
     int _downloadLimit = 0;
+    BandwidthSchedule _uploadLimitSchedule;
+    BandwidthSchedule _downloadLimitSchedule;
     SyncOptions _syncOptions;
 
     AnotherSyncNeeded _anotherSyncNeeded = NoFollowUpSync;
@@ -380,6 +444,8 @@ private:
     LocalDiscoveryStyle _lastLocalDiscoveryStyle = LocalDiscoveryStyle::FilesystemOnly;
     LocalDiscoveryStyle _localDiscoveryStyle = LocalDiscoveryStyle::FilesystemOnly;
     std::set<QString> _localDiscoveryPaths;
+    std::set<QString> _remoteDiscoveryPaths;
+    std::set<QString> _userTriggeredPaths;
 
     QStringList _leadingAndTrailingSpacesFilesAllowed;
 
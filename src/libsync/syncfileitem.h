@@ -17,6 +17,7 @@
 
 #include <QVector>
 #include <QString>
+#include <QStringList>
 #include <QDateTime>
 #include <QMetaType>
 #include <QSharedPointer>
@@ -256,6 +257,14 @@ public:
      */
     QString _originalFile;
 
+    /** For new files: files in the journal with the same size, whose
+     * contents may already exist on the server.
+     *
+     * PropagateRemoteCopy compares their checksums with the one of the new
+     * file and creates it with a server-side COPY of a match.
+     */
+    QStringList _remoteCopyCandidates;
+
     /// Whether there's end to end encryption on this file.
     /// If the file is encrypted, the _encryptedFilename is
     /// the encrypted name on the server.
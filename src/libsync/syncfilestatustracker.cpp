@@ -115,6 +115,8 @@ SyncFileStatusTracker::SyncFileStatusTracker(SyncEngine *syncEngine)
 {
     connect(syncEngine, &SyncEngine::aboutToPropagate,
         this, &SyncFileStatusTracker::slotAboutToPropagate);
+    connect(syncEngine, &SyncEngine::itemsAddedToPropagation,
+        this, &SyncFileStatusTracker::slotItemsAddedToPropagation);
     connect(syncEngine, &SyncEngine::itemCompleted,
         this, &SyncFileStatusTracker::slotItemCompleted);
     connect(syncEngine, &SyncEngine::finished, this, &SyncFileStatusTracker::slotSyncFinished);
@@ -176,10 +178,17 @@ void SyncFileStatusTracker::slotAddSilentlyExcluded(const QString &folderPath)
 }
 
 void SyncFileStatusTracker::incSyncCountAndEmitStatusChanged(const QString &relativePath, SharedFlag sharedFlag)
+{
+    ASSERT(!relativePath.endsWith('/'));
+    incSyncCountAndEmitStatusChanged(_syncPaths.intern(relativePath), sharedFlag);
+}
+
+void SyncFileStatusTracker::incSyncCountAndEmitStatusChanged(SyncPathTable::PathId pathId, SharedFlag sharedFlag)
 {
     // Will return 0 (and increase to 1) if the path wasn't in the map yet
-    int count = _syncCount[relativePath]++;
+    int count = _syncCount[pathId]++;
     if (!count) {
+        const auto relativePath = _syncPaths.toString(pathId);
         SyncFileStatus status = sharedFlag == UnknownShared
             ? fileStatus(relativePath)
             : resolveSyncAndErrorStatus(relativePath, sharedFlag);
@@ -187,44 +196,69 @@ void SyncFileStatusTracker::incSyncCountAndEmitStatusChanged(const QString &rela
 
         // We passed from OK to SYNC, increment the parent to keep it marked as
         // SYNC while we propagate ourselves and our own children.
-        ASSERT(!relativePath.endsWith('/'));
-        int lastSlashIndex = relativePath.lastIndexOf('/');
-        if (lastSlashIndex != -1)
-            incSyncCountAndEmitStatusChanged(relativePath.left(lastSlashIndex), UnknownShared);
-        else if (!relativePath.isEmpty())
-            incSyncCountAndEmitStatusChanged(QString(), UnknownShared);
+        if (pathId != SyncPathTable::rootId)
+            incSyncCountAndEmitStatusChanged(_syncPaths.parent(pathId), UnknownShared);
     }
 }
 
 void SyncFileStatusTracker::decSyncCountAndEmitStatusChanged(const QString &relativePath, SharedFlag sharedFlag)
 {
-    int count = --_syncCount[relativePath];
+    ASSERT(!relativePath.endsWith('/'));
+    decSyncCountAndEmitStatusChanged(_syncPaths.intern(relativePath), sharedFlag);
+}
+
+void SyncFileStatusTracker::decSyncCountAndEmitStatusChanged(SyncPathTable::PathId pathId, SharedFlag sharedFlag)
+{
+    int count = --_syncCount[pathId];
     if (!count) {
         // Remove from the map, same as 0
-        _syncCount.remove(relativePath);
+        _syncCount.remove(pathId);
 
+        const auto relativePath = _syncPaths.toString(pathId);
         SyncFileStatus status = sharedFlag == UnknownShared
             ? fileStatus(relativePath)
             : resolveSyncAndErrorStatus(relativePath, sharedFlag);
         emit fileStatusChanged(getSystemDestination(relativePath), status);
 
         // We passed from SYNC to OK, decrement our parent.
-        ASSERT(!relativePath.endsWith('/'));
-        int lastSlashIndex = relativePath.lastIndexOf('/');
-        if (lastSlashIndex != -1)
-            decSyncCountAndEmitStatusChanged(relativePath.left(lastSlashIndex), UnknownShared);
-        else if (!relativePath.isEmpty())
-            decSyncCountAndEmitStatusChanged(QString(), UnknownShared);
+        if (pathId != SyncPathTable::rootId)
+            decSyncCountAndEmitStatusChanged(_syncPaths.parent(pathId), UnknownShared);
     }
 }
 
 void SyncFileStatusTracker::slotAboutToPropagate(SyncFileItemVector &items)
 {
     ASSERT(_syncCount.isEmpty());
+    _syncPaths.clear();
 
     ProblemsMap oldProblems;
     std::swap(_syncProblems, oldProblems);
 
+    slotItemsAddedToPropagation(items);
+
+    // Some metadata status won't trigger files to be synced, make sure that we
+    // push the OK status for dirty files that don't need to be propagated.
+    // Swap into a copy since fileStatus() reads _dirtyPaths to determine the status
+    QSet<QString> oldDirtyPaths;
+    std::swap(_dirtyPaths, oldDirtyPaths);
+    for (const auto &oldDirtyPath : qAsConst(oldDirtyPaths))
+        emit fileStatusChanged(getSystemDestination(oldDirtyPath), fileStatus(oldDirtyPath));
+
+    // Make sure to push any status that might have been resolved indirectly since the last sync
+    // (like an error file being deleted from disk)
+    for (const auto &syncProblem : _syncProblems)
+        oldProblems.erase(syncProblem.first);
+    for (const auto &oldProblem : oldProblems) {
+        const QString &path = oldProblem.first;
+        SyncFileStatus::SyncFileStatusTag severity = oldProblem.second;
+        if (severity == SyncFileStatus::StatusError)
+            invalidateParentPaths(path);
+        emit fileStatusChanged(getSystemDestination(path), fileStatus(path));
+    }
+}
+
+void SyncFileStatusTracker::slotItemsAddedToPropagation(SyncFileItemVector &items)
+{
     foreach (const SyncFileItemPtr &item, items) {
         qCInfo(lcStatusTracker) << "Investigating" << item->destination() << item->_status << item->_instruction << item->_direction;
         _dirtyPaths.remove(item->destination());
@@ -248,25 +282,6 @@ void SyncFileStatusTracker::slotAboutToPropagate(SyncFileItemVector &items)
         }
     }
 
-    // Some metadata status won't trigger files to be synced, make sure that we
-    // push the OK status for dirty files that don't need to be propagated.
-    // Swap into a copy since fileStatus() reads _dirtyPaths to determine the status
-    QSet<QString> oldDirtyPaths;
-    std::swap(_dirtyPaths, oldDirtyPaths);
-    for (const auto &oldDirtyPath : qAsConst(oldDirtyPaths))
-        emit fileStatusChanged(getSystemDestination(oldDirtyPath), fileStatus(oldDirtyPath));
-
-    // Make sure to push any status that might have been resolved indirectly since the last sync
-    // (like an error file being deleted from disk)
-    for (const auto &syncProblem : _syncProblems)
-        oldProblems.erase(syncProblem.first);
-    for (const auto &oldProblem : oldProblems) {
-        const QString &path = oldProblem.first;
-        SyncFileStatus::SyncFileStatusTag severity = oldProblem.second;
-        if (severity == SyncFileStatus::StatusError)
-            invalidateParentPaths(path);
-        emit fileStatusChanged(getSystemDestination(path), fileStatus(path));
-    }
 }
 
 void SyncFileStatusTracker::slotItemCompleted(const SyncFileItemPtr &item)
@@ -297,16 +312,13 @@ void SyncFileStatusTracker::slotItemCompleted(const SyncFileItemPtr &item)
 void SyncFileStatusTracker::slotSyncFinished()
 {
     // Clear the sync counts to reduce the impact of unsymetrical inc/dec calls (e.g. when directory job abort)
-    QHash<QString, int> oldSyncCount;
+    QHash<SyncPathTable::PathId, int> oldSyncCount;
     std::swap(_syncCount, oldSyncCount);
     for (auto it = oldSyncCount.begin(); it != oldSyncCount.end(); ++it) {
-        // Don't announce folders, fileStatus expect only paths without '/', otherwise it asserts
-        if (it.key().endsWith('/')) {
-            continue;
-        }
-
-        emit fileStatusChanged(getSystemDestination(it.key()), fileStatus(it.key()));
+        const auto relativePath = _syncPaths.toString(it.key());
+        emit fileStatusChanged(getSystemDestination(relativePath), fileStatus(relativePath));
     }
+    _syncPaths.clear();
 }
 
 void SyncFileStatusTracker::slotSyncEngineRunningChanged()
@@ -319,7 +331,8 @@ SyncFileStatus SyncFileStatusTracker::resolveSyncAndErrorStatus(const QString &r
     // If it's a new file and that we're not syncing it yet,
     // don't show any icon and wait for the filesystem watcher to trigger a sync.
     SyncFileStatus status(isPathKnown ? SyncFileStatus::StatusUpToDate : SyncFileStatus::StatusNone);
-    if (_syncCount.value(relativePath)) {
+    const auto pathId = _syncCount.isEmpty() ? SyncPathTable::invalidId : _syncPaths.find(relativePath);
+    if (pathId != SyncPathTable::invalidId && _syncCount.value(pathId)) {
         status.set(SyncFileStatus::StatusSync);
     } else {
         // After a sync finished, we need to show the users issues from that last sync like the activity list does.
@@ -18,6 +18,7 @@
 
 // #include "ownsql.h"
 #include "syncfileitem.h"
+#include "syncpathtable.h"
 #include "common/syncfilestatus.h"
 #include <map>
 #include <QSet>
@@ -48,6 +49,8 @@ signals:
 
 private slots:
     void slotAboutToPropagate(OCC::SyncFileItemVector &items);
+    // Marks the items that will be propagated as syncing
+    void slotItemsAddedToPropagation(OCC::SyncFileItemVector &items);
     void slotItemCompleted(const OCC::SyncFileItemPtr &item);
     void slotSyncFinished();
     void slotSyncEngineRunningChanged();
@@ -69,7 +72,9 @@ private:
     void invalidateParentPaths(const QString &path);
     QString getSystemDestination(const QString &relativePath);
     void incSyncCountAndEmitStatusChanged(const QString &relativePath, SharedFlag sharedState);
+    void incSyncCountAndEmitStatusChanged(SyncPathTable::PathId pathId, SharedFlag sharedState);
     void decSyncCountAndEmitStatusChanged(const QString &relativePath, SharedFlag sharedState);
+    void decSyncCountAndEmitStatusChanged(SyncPathTable::PathId pathId, SharedFlag sharedState);
 
     SyncEngine *_syncEngine;
 
@@ -78,7 +83,9 @@ private:
     // Counts the number direct children currently being synced (has unfinished propagation jobs).
     // We'll show a file/directory as SYNC as long as its sync count is > 0.
     // A directory that starts/ends propagation will in turn increase/decrease its own parent by 1.
-    QHash<QString, int> _syncCount;
+    // Keyed on the ids of _syncPaths, which only lives as long as a propagation.
+    QHash<SyncPathTable::PathId, int> _syncCount;
+    SyncPathTable _syncPaths;
 };
 }
 
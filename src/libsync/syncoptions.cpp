@@ -44,9 +44,21 @@ void SyncOptions::fillFromEnvironmentVariables()
     if (!targetChunkUploadDurationEnv.isEmpty())
         _targetChunkUploadDuration = std::chrono::milliseconds(targetChunkUploadDurationEnv.toUInt());
 
+    QByteArray minDeltaUploadSizeEnv = qgetenv("OWNCLOUD_MIN_DELTA_UPLOAD_SIZE");
+    if (!minDeltaUploadSizeEnv.isEmpty())
+        _minDeltaUploadSize = minDeltaUploadSizeEnv.toLongLong();
+
+    QByteArray minRemoteCopySizeEnv = qgetenv("OWNCLOUD_MIN_REMOTE_COPY_SIZE");
+    if (!minRemoteCopySizeEnv.isEmpty())
+        _minRemoteCopySize = minRemoteCopySizeEnv.toLongLong();
+
     int maxParallel = qgetenv("OWNCLOUD_MAX_PARALLEL").toInt();
     if (maxParallel > 0)
         _parallelNetworkJobs = maxParallel;
+
+    QByteArray pipelinedPropagationEnv = qgetenv("OWNCLOUD_PIPELINED_PROPAGATION");
+    if (!pipelinedPropagationEnv.isEmpty())
+        _pipelinedPropagation = pipelinedPropagationEnv.toInt() != 0;
 }
 
 void SyncOptions::verifyChunkSizes()
@@ -69,13 +69,34 @@ public:
      */
     std::chrono::milliseconds _targetChunkUploadDuration = std::chrono::minutes(1);
 
+    /** Modified files from this size on only upload their changed blocks
+     * when the server supports it, see Capabilities::deltaChunking().
+     */
+    qint64 _minDeltaUploadSize = 100 * 1000 * 1000; // 100MB
+
+    /** New files from this size on are created with a server-side copy when
+     * a file with the same size and content checksum is in the journal.
+     *
+     * Set to -1 to disable.
+     */
+    qint64 _minRemoteCopySize = 1 * 1000 * 1000; // 1MB
+
     /** The maximum number of active jobs in parallel  */
     int _parallelNetworkJobs = 6;
 
+    /** Whether fully discovered subtrees may be propagated before the discovery is done.
+     *
+     * Only top-level directories whose items can't be affected by rename or
+     * deletion detection elsewhere in the tree are released early, see
+     * SyncEngine::slotSubtreeDiscovered().
+     */
+    bool _pipelinedPropagation = false;
+
     /** Reads settings from env vars where available.
      *
      * Currently reads _initialChunkSize, _minChunkSize, _maxChunkSize,
-     * _targetChunkUploadDuration, _parallelNetworkJobs.
+     * _targetChunkUploadDuration, _minDeltaUploadSize, _minRemoteCopySize,
+     * _parallelNetworkJobs, _pipelinedPropagation.
      */
     void fillFromEnvironmentVariables();
 
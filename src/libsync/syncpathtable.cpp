@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) by Nextcloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "syncpathtable.h"
+
+#include "common/asserts.h"
+
+#include <QVarLengthArray>
+
+namespace OCC {
+
+SyncPathTable::SyncPathTable()
+{
+    clear();
+}
+
+quint64 SyncPathTable::childKey(PathId parent, QStringView name)
+{
+    return (static_cast<quint64>(parent) << 32) | qHash(name);
+}
+
+SyncPathTable::PathId SyncPathTable::find(PathId parent, QStringView name) const
+{
+    const auto key = childKey(parent, name);
+    for (auto it = _children.constFind(key); it != _children.constEnd() && it.key() == key; ++it) {
+        if (QStringView(_nodes[*it].name) == name) {
+            return *it;
+        }
+    }
+    return invalidId;
+}
+
+SyncPathTable::PathId SyncPathTable::intern(PathId parent, QStringView name)
+{
+    ASSERT(parent < _nodes.size());
+    ASSERT(!name.isEmpty() && !name.contains(QLatin1Char('/')));
+
+    const auto existing = find(parent, name);
+    if (existing != invalidId) {
+        return existing;
+    }
+
+    ENFORCE(_nodes.size() < invalidId, "Too many paths in the sync path table");
+    const auto id = static_cast<PathId>(_nodes.size());
+    _nodes.push_back({ parent, name.toString() });
+    _children.insert(childKey(parent, name), id);
+    return id;
+}
+
+SyncPathTable::PathId SyncPathTable::intern(QStringView path)
+{
+    auto id = rootId;
+    qsizetype start = 0;
+    while (start < path.size()) {
+        auto slash = path.indexOf(QLatin1Char('/'), start);
+        if (slash < 0) {
+            slash = path.size();
+        }
+        if (slash > start) {
+            id = intern(id, path.mid(start, slash - start));
+        }
+        start = slash + 1;
+    }
+    return id;
+}
+
+SyncPathTable::PathId SyncPathTable::find(QStringView path) const
+{
+    auto id = rootId;
+    qsizetype start = 0;
+    while (start < path.size() && id != invalidId) {
+        auto slash = path.indexOf(QLatin1Char('/'), start);
+        if (slash < 0) {
+            slash = path.size();
+        }
+        if (slash > start) {
+            id = find(id, path.mid(start, slash - start));
+        }
+        start = slash + 1;
+    }
+    return id;
+}
+
+QString SyncPathTable::toString(PathId id) const
+{
+    if (id == rootId || id == invalidId) {
+        return {};
+    }
+
+    QVarLengthArray<PathId, 32> chain;
+    int length = -1;
+    for (auto it = id; it != rootId; it = _nodes[it].parent) {
+        chain.append(it);
+        length += _nodes[it].name.size() + 1;
+    }
+
+    QString result;
+    result.reserve(length);
+    for (auto i = chain.size() - 1; i >= 0; --i) {
+        if (!result.isEmpty()) {
+            result += QLatin1Char('/');
+        }
+        result += _nodes[chain[i]].name;
+    }
+    return result;
+}
+
+bool SyncPathTable::isAncestorOrSelf(PathId ancestor, PathId id) const
+{
+    for (auto it = id; it != invalidId; it = _nodes[it].parent) {
+        if (it == ancestor) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void SyncPathTable::forEachAncestor(QStringView path, const std::function<void(PathId, int)> &visitor) const
+{
+    auto id = rootId;
+    qsizetype start = 0;
+    while (true) {
+        const auto slash = path.indexOf(QLatin1Char('/'), start);
+        if (slash < 0) {
+            // the last component is the path itself, not an ancestor
+            return;
+        }
+        if (slash > start) {
+            id = find(id, path.mid(start, slash - start));
+            if (id == invalidId) {
+                return;
+            }
+            visitor(id, static_cast<int>(slash));
+        }
+        start = slash + 1;
+    }
+}
+
+void SyncPathTable::clear()
+{
+    _nodes.clear();
+    _children.clear();
+    _nodes.push_back({ invalidId, QString() });
+}
+
+}
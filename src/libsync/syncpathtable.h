@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) by Nextcloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#pragma once
+
+#include "owncloudlib.h"
+
+#include <QMultiHash>
+#include <QString>
+#include <QStringView>
+
+#include <functional>
+#include <limits>
+#include <vector>
+
+namespace OCC {
+
+/**
+ * @brief Interns relative sync paths into a tree of name nodes
+ *
+ * Every node stores only its own name and a pointer to its parent, so the
+ * common directory prefixes of thousands of paths are stored once. Each node
+ * gets a stable integer id that can be used as a cheap hash key instead of
+ * the full path string. Ids stay valid until clear() is called.
+ *
+ * Paths use the same convention as SyncFileItem::_file: relative to the sync
+ * folder, separated by '/', without leading or trailing slash. The empty path
+ * is the root and always has the id rootId.
+ *
+ * Conversion back to a QString via toString() is meant for API boundaries
+ * (signals, journal access, logging).
+ *
+ * @ingroup libsync
+ */
+class OWNCLOUDSYNC_EXPORT SyncPathTable
+{
+public:
+    using PathId = quint32;
+
+    static constexpr PathId rootId = 0;
+    static constexpr PathId invalidId = std::numeric_limits<PathId>::max();
+
+    SyncPathTable();
+
+    /** Returns the id of path, creating nodes for it and its parents as needed. */
+    PathId intern(QStringView path);
+
+    /** Returns the id of the child called name below parent, creating it if needed. */
+    PathId intern(PathId parent, QStringView name);
+
+    /** Returns the id of path, or invalidId if it was never interned. */
+    [[nodiscard]] PathId find(QStringView path) const;
+
+    /** Returns the id of the child called name below parent, or invalidId. */
+    [[nodiscard]] PathId find(PathId parent, QStringView name) const;
+
+    /** Returns the parent of id. The parent of the root is invalidId. */
+    [[nodiscard]] PathId parent(PathId id) const { return _nodes[id].parent; }
+
+    /** Returns the last path component of id. */
+    [[nodiscard]] const QString &name(PathId id) const { return _nodes[id].name; }
+
+    /** Rebuilds the full relative path of id. */
+    [[nodiscard]] QString toString(PathId id) const;
+
+    /** Whether ancestor is id itself or one of its parents. */
+    [[nodiscard]] bool isAncestorOrSelf(PathId ancestor, PathId id) const;
+
+    /** Calls visitor(id, prefixLength) for every interned strict ancestor of path,
+     * from the top-most directory down, excluding the root.
+     *
+     * prefixLength is the length of the ancestor's path inside path, so
+     * path.mid(prefixLength) is the remainder including the leading slash.
+     * The walk stops at the first component that was never interned.
+     */
+    void forEachAncestor(QStringView path, const std::function<void(PathId, int)> &visitor) const;
+
+    /** Number of nodes, including the root. */
+    [[nodiscard]] int size() const { return static_cast<int>(_nodes.size()); }
+
+    /** Drops all nodes but the root, invalidating all ids. */
+    void clear();
+
+private:
+    struct Node
+    {
+        PathId parent;
+        QString name;
+    };
+
+    static quint64 childKey(PathId parent, QStringView name);
+
+    std::vector<Node> _nodes;
+    // (parent id, hash of the name) -> child id; collisions are resolved by comparing names
+    QMultiHash<quint64, PathId> _children;
+};
+
+}
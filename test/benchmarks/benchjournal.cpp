@@ -0,0 +1,128 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QRandomGenerator>
+#include <QTemporaryDir>
+#include <QDebug>
+
+#include <algorithm>
+#include <numeric>
+
+#include "common/syncjournaldb.h"
+#include "common/syncjournalfilerecord.h"
+
+using namespace OCC;
+
+constexpr int filesPerDir = 1000;
+
+QByteArray dirPath(int dirNum)
+{
+    return QByteArrayLiteral("dir") + QByteArray::number(dirNum);
+}
+
+QByteArray filePath(int fileNum)
+{
+    return dirPath(fileNum / filesPerDir) + QByteArrayLiteral("/file") + QByteArray::number(fileNum % filesPerDir);
+}
+
+void populate(const QString &dbPath, int numFiles)
+{
+    SyncJournalDb db(dbPath);
+    for (int fileNum = 0; fileNum < numFiles; ++fileNum) {
+        if (fileNum % filesPerDir == 0) {
+            SyncJournalFileRecord dir;
+            dir._path = dirPath(fileNum / filesPerDir);
+            dir._type = ItemTypeDirectory;
+            dir._etag = "etag";
+            dir._fileId = QByteArray::number(fileNum / filesPerDir) + "d";
+            dir._inode = numFiles + fileNum / filesPerDir + 1;
+            dir._remotePerm = RemotePermissions::fromDbValue("RWCKNV");
+            if (!db.setFileRecord(dir)) {
+                qFatal("Could not write %s", dir._path.constData());
+            }
+        }
+        SyncJournalFileRecord file;
+        file._path = filePath(fileNum);
+        file._type = ItemTypeFile;
+        file._etag = "etag";
+        file._fileId = QByteArray::number(fileNum);
+        file._inode = fileNum + 1;
+        file._modtime = 1600000000 + fileNum;
+        file._fileSize = fileNum;
+        file._remotePerm = RemotePermissions::fromDbValue("RWNV");
+        file._checksumHeader = "SHA1:da39a3ee5e6b4b0d3255bfef95601890afd80709";
+        if (!db.setFileRecord(file)) {
+            qFatal("Could not write %s", file._path.constData());
+        }
+        if (fileNum % 10000 == 9999) {
+            db.commit(QStringLiteral("populate"));
+        }
+    }
+    db.close();
+}
+
+void measure(const char *name, const QString &dbPath, const SyncJournalDb::PerformanceProfile &profile, int numFiles)
+{
+    SyncJournalDb db(dbPath);
+    db.setPerformanceProfile(profile);
+
+    QVector<int> order(numFiles);
+    std::iota(order.begin(), order.end(), 0);
+    std::shuffle(order.begin(), order.end(), *QRandomGenerator::global());
+
+    QElapsedTimer timer;
+    timer.start();
+    int found = 0;
+    for (const auto fileNum : order) {
+        SyncJournalFileRecord record;
+        if (db.getFileRecord(filePath(fileNum), &record) && record.isValid()) {
+            ++found;
+        }
+    }
+    const auto lookupMsecs = std::max<qint64>(timer.restart(), 1);
+
+    const auto numDirs = (numFiles + filesPerDir - 1) / filesPerDir;
+    int listed = 0;
+    for (int dirNum = 0; dirNum < numDirs; ++dirNum) {
+        if (!db.listFilesInPath(dirPath(dirNum), [&listed](const SyncJournalFileRecord &) { ++listed; })) {
+            qWarning() << "Listing failed for" << dirPath(dirNum);
+        }
+    }
+    const auto listMsecs = std::max<qint64>(timer.elapsed(), 1);
+
+    qDebug() << name << "LOOKUPS:" << found << "in" << lookupMsecs << "ms," << found * 1000 / lookupMsecs << "per second";
+    qDebug() << name << "LISTINGS:" << numDirs << "directories," << listed << "files in" << listMsecs << "ms," << listed * 1000 / listMsecs << "files per second";
+    db.close();
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    const auto numFiles = argc > 1 ? QByteArray(argv[1]).toInt() : 1000000;
+
+    QTemporaryDir tempDir;
+    const auto dbPath = tempDir.filePath(QStringLiteral("sync.db"));
+
+    QElapsedTimer timer;
+    timer.start();
+    populate(dbPath, numFiles);
+    qDebug() << "POPULATED:" << numFiles << "files in" << timer.elapsed() << "ms," << QFileInfo(dbPath).size() << "bytes";
+
+    // Run each profile twice, the first run also warms up the OS file cache
+    SyncJournalDb::PerformanceProfile sqliteDefaults;
+    sqliteDefaults.mmapSize = 0;
+    sqliteDefaults.cacheSize = 2000 * 1024;
+    const SyncJournalDb::PerformanceProfile automatic;
+    for (int run = 0; run < 2; ++run) {
+        measure("SQLITE DEFAULTS", dbPath, sqliteDefaults, numFiles);
+        measure("AUTOMATIC", dbPath, automatic, numFiles);
+    }
+    return 0;
+}
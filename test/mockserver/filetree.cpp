@@ -0,0 +1,270 @@
+/*
+ * Copyright (C) by Nextcloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "filetree.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+
+FileTree::FileTree(const QString &diskRoot)
+    : _diskRoot(diskRoot)
+{
+    insert(QString(), true).mtime = QDateTime::currentSecsSinceEpoch();
+    if (isDiskBacked()) {
+        QDir().mkpath(_diskRoot);
+        scanDisk(QString());
+    }
+}
+
+QString FileTree::normalize(const QString &path)
+{
+    auto result = QDir::cleanPath(QLatin1Char('/') + path);
+    // Nothing above the root can be reached
+    while (result == QLatin1String("/..") || result.startsWith(QLatin1String("/../"))) {
+        result.remove(0, 3);
+    }
+    while (result.startsWith(QLatin1Char('/'))) {
+        result.remove(0, 1);
+    }
+    return result;
+}
+
+QString FileTree::parentPath(const QString &path)
+{
+    const auto slashPosition = path.lastIndexOf(QLatin1Char('/'));
+    return slashPosition >= 0 ? path.left(slashPosition) : QString();
+}
+
+const FileTree::Entry *FileTree::find(const QString &path) const
+{
+    const auto it = _entries.constFind(normalize(path));
+    return it != _entries.constEnd() ? &it.value() : nullptr;
+}
+
+QStringList FileTree::children(const QString &path, bool recursive) const
+{
+    const auto normalized = normalize(path);
+    const auto prefix = normalized.isEmpty() ? QString() : normalized + QLatin1Char('/');
+
+    QStringList result;
+    for (auto it = _entries.lowerBound(prefix); it != _entries.constEnd() && it.key().startsWith(prefix); ++it) {
+        if (it.key() == normalized) {
+            continue;
+        }
+        if (!recursive && it.key().indexOf(QLatin1Char('/'), prefix.size()) >= 0) {
+            continue;
+        }
+        result.append(it.key());
+    }
+    return result;
+}
+
+const FileTree::Entry *FileTree::mkdir(const QString &path)
+{
+    const auto normalized = normalize(path);
+    const auto parent = find(parentPath(normalized));
+    if (normalized.isEmpty() || find(normalized) || !parent || !parent->isDir) {
+        return nullptr;
+    }
+    if (isDiskBacked() && !QDir().mkpath(diskPath(normalized))) {
+        return nullptr;
+    }
+
+    auto &entry = insert(normalized, true);
+    entry.mtime = QDateTime::currentSecsSinceEpoch();
+    touch(normalized);
+    return &entry;
+}
+
+const FileTree::Entry *FileTree::put(const QString &path, const QByteArray &data, qint64 mtime, const QByteArray &checksum)
+{
+    const auto normalized = normalize(path);
+    const auto parent = find(parentPath(normalized));
+    const auto existing = find(normalized);
+    if (normalized.isEmpty() || !parent || !parent->isDir || (existing && existing->isDir)) {
+        return nullptr;
+    }
+
+    if (isDiskBacked()) {
+        QFile file(diskPath(normalized));
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(data) != data.size()) {
+            return nullptr;
+        }
+        file.setFileTime(QDateTime::fromSecsSinceEpoch(mtime), QFileDevice::FileModificationTime);
+    }
+
+    auto &entry = existing ? _entries[normalized] : insert(normalized, false);
+    entry.size = data.size();
+    entry.mtime = mtime;
+    entry.checksum = checksum;
+    if (!isDiskBacked()) {
+        entry.data = data;
+    }
+    touch(normalized);
+    return &entry;
+}
+
+QByteArray FileTree::read(const QString &path, qint64 offset, qint64 length) const
+{
+    const auto entry = find(path);
+    if (!entry || entry->isDir || offset >= entry->size) {
+        return {};
+    }
+    if (length < 0 || offset + length > entry->size) {
+        length = entry->size - offset;
+    }
+
+    if (!isDiskBacked()) {
+        return entry->data.mid(offset, length);
+    }
+    QFile file(diskPath(normalize(path)));
+    if (!file.open(QIODevice::ReadOnly) || !file.seek(offset)) {
+        return {};
+    }
+    return file.read(length);
+}
+
+bool FileTree::remove(const QString &path)
+{
+    const auto normalized = normalize(path);
+    const auto entry = find(normalized);
+    if (normalized.isEmpty() || !entry) {
+        return false;
+    }
+
+    if (isDiskBacked()) {
+        const auto removed = entry->isDir ? QDir(diskPath(normalized)).removeRecursively() : QFile::remove(diskPath(normalized));
+        if (!removed) {
+            return false;
+        }
+    }
+
+    const auto below = children(normalized, true);
+    for (const auto &child : below) {
+        _entries.remove(child);
+    }
+    _entries.remove(normalized);
+    touch(parentPath(normalized));
+    return true;
+}
+
+bool FileTree::move(const QString &source, const QString &destination)
+{
+    const auto from = normalize(source);
+    const auto to = normalize(destination);
+    const auto parent = find(parentPath(to));
+    if (from.isEmpty() || to.isEmpty() || !find(from) || !parent || !parent->isDir
+        || to == from || to.startsWith(from + QLatin1Char('/'))) {
+        return false;
+    }
+    if (find(to) && !remove(to)) {
+        return false;
+    }
+    if (isDiskBacked() && !QDir().rename(diskPath(from), diskPath(to))) {
+        return false;
+    }
+
+    auto paths = children(from, true);
+    paths.prepend(from);
+    for (const auto &path : qAsConst(paths)) {
+        _entries.insert(to + path.mid(from.size()), _entries.take(path));
+    }
+    touch(parentPath(from));
+    touch(to);
+    return true;
+}
+
+bool FileTree::copy(const QString &source, const QString &destination)
+{
+    const auto from = normalize(source);
+    const auto to = normalize(destination);
+    const auto sourceEntry = find(from);
+    const auto parent = find(parentPath(to));
+    if (from.isEmpty() || to.isEmpty() || !sourceEntry || !parent || !parent->isDir
+        || to == from || to.startsWith(from + QLatin1Char('/'))) {
+        return false;
+    }
+    if (find(to) && !remove(to)) {
+        return false;
+    }
+
+    auto paths = children(from, true);
+    paths.prepend(from);
+    for (const auto &path : qAsConst(paths)) {
+        const auto entry = _entries.value(path);
+        const auto target = to + path.mid(from.size());
+        const auto copied = entry.isDir ? mkdir(target) : put(target, read(path), entry.mtime, entry.checksum);
+        if (!copied) {
+            return false;
+        }
+    }
+    return true;
+}
+
+FileTree::Entry &FileTree::insert(const QString &path, bool isDir)
+{
+    auto &entry = _entries[path];
+    entry.isDir = isDir;
+    entry.fileId = nextFileId();
+    entry.etag = nextEtag();
+    return entry;
+}
+
+void FileTree::touch(const QString &path)
+{
+    // The etag of a directory changes with everything below it
+    auto current = path;
+    forever {
+        const auto it = _entries.find(current);
+        if (it != _entries.end()) {
+            it->etag = nextEtag();
+        }
+        if (current.isEmpty()) {
+            break;
+        }
+        current = parentPath(current);
+    }
+}
+
+QString FileTree::diskPath(const QString &path) const
+{
+    return path.isEmpty() ? _diskRoot : _diskRoot + QLatin1Char('/') + path;
+}
+
+void FileTree::scanDisk(const QString &path)
+{
+    const auto infos = QDir(diskPath(path)).entryInfoList(QDir::AllEntries | QDir::NoDotAndDotDot | QDir::Hidden | QDir::System, QDir::Name);
+    for (const auto &info : infos) {
+        const auto childPath = path.isEmpty() ? info.fileName() : path + QLatin1Char('/') + info.fileName();
+        auto &entry = insert(childPath, info.isDir());
+        entry.mtime = info.lastModified().toSecsSinceEpoch();
+        if (info.isDir()) {
+            scanDisk(childPath);
+        } else {
+            entry.size = info.size();
+        }
+    }
+}
+
+QByteArray FileTree::nextFileId()
+{
+    return QByteArray::number(++_lastFileId).rightJustified(8, '0') + "ocmock";
+}
+
+QByteArray FileTree::nextEtag()
+{
+    return QByteArray::number(++_lastEtag, 16).rightJustified(13, '0');
+}
@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) by Nextcloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#pragma once
+
+#include <QByteArray>
+#include <QMap>
+#include <QString>
+#include <QStringList>
+
+/**
+ * @brief The files served by the mock server
+ *
+ * The metadata of all entries is kept in memory. The content lives in memory
+ * too, unless a directory on disk is given: then the tree is read from it
+ * on construction and all changes are written through to it.
+ *
+ * Paths are relative to the root, without leading or trailing slashes; the
+ * root itself is the empty path. Changing an entry changes the etags of all
+ * its parents, like the server does.
+ */
+class FileTree
+{
+public:
+    struct Entry
+    {
+        bool isDir = false;
+        qint64 size = 0;
+        qint64 mtime = 0; // seconds since the epoch
+        QByteArray etag;
+        QByteArray fileId;
+        QByteArray checksum; // "TYPE:value" as sent by the client, if any
+        QByteArray data; // content of memory backed files
+    };
+
+    /// A memory backed tree, or one backed by @a diskRoot if that is not empty
+    explicit FileTree(const QString &diskRoot = {});
+
+    [[nodiscard]] bool isDiskBacked() const { return !_diskRoot.isEmpty(); }
+
+    [[nodiscard]] static QString normalize(const QString &path);
+    [[nodiscard]] static QString parentPath(const QString &path);
+
+    [[nodiscard]] const Entry *find(const QString &path) const;
+
+    /// The paths of the children of @a path, or of all entries below it
+    [[nodiscard]] QStringList children(const QString &path, bool recursive = false) const;
+
+    /// Creates a directory; the parent has to exist and the path must be free
+    const Entry *mkdir(const QString &path);
+
+    /// Creates or replaces a file; the parent has to exist and must be a directory
+    const Entry *put(const QString &path, const QByteArray &data, qint64 mtime, const QByteArray &checksum = {});
+
+    /// Up to @a length bytes of the file at @a path from @a offset on; -1 reads to the end
+    [[nodiscard]] QByteArray read(const QString &path, qint64 offset = 0, qint64 length = -1) const;
+
+    /// Removes an entry with everything below it
+    bool remove(const QString &path);
+
+    /// Moves or copies an entry with everything below it, replacing @a destination
+    bool move(const QString &source, const QString &destination);
+    bool copy(const QString &source, const QString &destination);
+
+private:
+    Entry &insert(const QString &path, bool isDir);
+    void touch(const QString &path);
+    [[nodiscard]] QString diskPath(const QString &path) const;
+    void scanDisk(const QString &path);
+    QByteArray nextFileId();
+    QByteArray nextEtag();
+
+    QString _diskRoot;
+    QMap<QString, Entry> _entries;
+    qint64 _lastFileId = 0;
+    qint64 _lastEtag = 0;
+};
@@ -14,51 +14,258 @@
 
 #include "httpserver.h"
 
-HttpServer::HttpServer(quint16 port, QObject* parent)
-    : QTcpServer(parent)
+#include <QRandomGenerator>
+#include <QTcpSocket>
+
+namespace {
+
+constexpr auto refillIntervalMsecs = 50;
+constexpr qint64 maxHeaderSize = 64 * 1024;
+constexpr qint64 writeSliceSize = 64 * 1024;
+
+}
+
+Throttle::Throttle(qint64 bytesPerSecond, QObject *parent)
+    : QObject(parent)
+    , _bytesPerSecond(bytesPerSecond)
+{
+    if (!isLimited()) {
+        return;
+    }
+    _timer.setInterval(refillIntervalMsecs);
+    connect(&_timer, &QTimer::timeout, this, [this] {
+        // Unused bytes don't add up, so an idle period is not followed by a burst
+        _available = std::max<qint64>(_bytesPerSecond * refillIntervalMsecs / 1000, 1);
+        emit refilled();
+    });
+    _timer.start();
+}
+
+qint64 Throttle::take(qint64 wanted)
+{
+    if (!isLimited()) {
+        return wanted;
+    }
+    const auto granted = std::min(wanted, _available);
+    _available -= granted;
+    return granted;
+}
+
+HttpConnection::HttpConnection(QTcpSocket *socket, HttpServer *server)
+    : QObject(server)
+    , _socket(socket)
+    , _server(server)
+{
+    _socket->setParent(this);
+    if (_server->uploadThrottle()->isLimited()) {
+        // What isn't read stays in the kernel, which slows the client down
+        _socket->setReadBufferSize(writeSliceSize);
+    }
+
+    connect(_socket, &QTcpSocket::readyRead, this, &HttpConnection::readFromSocket);
+    connect(_socket, &QTcpSocket::bytesWritten, this, &HttpConnection::writeToSocket);
+    connect(_socket, &QTcpSocket::disconnected, this, &QObject::deleteLater);
+    connect(_server->uploadThrottle(), &Throttle::refilled, this, &HttpConnection::readFromSocket);
+    connect(_server->downloadThrottle(), &Throttle::refilled, this, &HttpConnection::writeToSocket);
+}
+
+HttpConnection::~HttpConnection()
+{
+    if (_holdsSlot) {
+        _server->releaseSlot();
+    }
+}
+
+void HttpConnection::readFromSocket()
+{
+    if (_busy || _closeAfterResponse) {
+        return;
+    }
+
+    const auto granted = _server->uploadThrottle()->take(_socket->bytesAvailable());
+    if (granted > 0) {
+        _input += _socket->read(granted);
+    }
+
+    if (_bodyLength < 0 && !parseHeaders()) {
+        return;
+    }
+    if (_input.size() < _bodyLength) {
+        return;
+    }
+    _request.body = _input.left(_bodyLength);
+    _input.remove(0, _bodyLength);
+    _bodyLength = -1;
+    dispatch();
+}
+
+bool HttpConnection::parseHeaders()
+{
+    const auto headerEnd = _input.indexOf("\r\n\r\n");
+    if (headerEnd < 0) {
+        if (_input.size() > maxHeaderSize) {
+            _busy = true;
+            _closeAfterResponse = true;
+            respond(HttpResponse::error(400, QStringLiteral("BadRequest"), QStringLiteral("The request headers are too large")));
+        }
+        return false;
+    }
+
+    const auto lines = _input.left(headerEnd).split('\n');
+    _input.remove(0, headerEnd + 4);
+
+    _request = HttpRequest();
+    const auto requestLine = lines.first().trimmed().split(' ');
+    if (requestLine.size() != 3) {
+        _busy = true;
+        _closeAfterResponse = true;
+        respond(HttpResponse::error(400, QStringLiteral("BadRequest"), QStringLiteral("Malformed request line")));
+        return false;
+    }
+    _request.method = requestLine.at(0);
+    _request.target = requestLine.at(1);
+    for (auto it = lines.cbegin() + 1; it != lines.cend(); ++it) {
+        const auto colonPosition = it->indexOf(':');
+        if (colonPosition > 0) {
+            _request.headers.insert(it->left(colonPosition).trimmed().toLower(), it->mid(colonPosition + 1).trimmed());
+        }
+    }
+
+    const auto connection = _request.header("connection").toLower();
+    _closeAfterResponse = connection == "close" || (requestLine.at(2) == "HTTP/1.0" && connection != "keep-alive");
+
+    if (!_request.header("transfer-encoding").isEmpty()) {
+        _busy = true;
+        _closeAfterResponse = true;
+        respond(HttpResponse::error(411, QStringLiteral("LengthRequired"), QStringLiteral("Only requests with a Content-Length are supported")));
+        return false;
+    }
+    if (_request.header("expect").toLower() == "100-continue") {
+        _socket->write("HTTP/1.1 100 Continue\r\n\r\n");
+    }
+    _bodyLength = _request.header("content-length").toLongLong();
+    return true;
+}
+
+void HttpConnection::dispatch()
 {
-    listen(QHostAddress::Any, port);
+    _busy = true;
+    if (!_server->acquireSlot()) {
+        respond(HttpResponse::error(503, QStringLiteral("ServiceUnavailable"), QStringLiteral("Too many concurrent requests")));
+        return;
+    }
+    _holdsSlot = true;
+
+    QTimer::singleShot(_server->nextDelay(), this, [this, request = _request] {
+        respond(_server->handle(request));
+    });
+    _request = HttpRequest();
 }
 
-void HttpServer::readClient()
+void HttpConnection::respond(const HttpResponse &response)
 {
-    QTcpSocket* socket = (QTcpSocket*)sender();
-    if (socket->canReadLine()) {
-        QStringList tokens = QString(socket->readLine()).split(QRegularExpression("[ \r\n][ \r\n]*"));
-        if (tokens[0] == "GET") {
-            QTextStream os(socket);
-            os.setAutoDetectUnicode(true);
-            os << "HTTP/1.0 200 Ok\r\n"
-                "Content-Type: text/html; charset=\"utf-8\"\r\n"
-                "\r\n"
-                "<h1>Nothing to see here</h1>\n"
-                << QDateTime::currentDateTimeUtc().toString() << "\n";
-            socket->close();
+    _output = "HTTP/1.1 " + QByteArray::number(response.status) + ' ' + HttpResponse::reasonPhrase(response.status) + "\r\n";
+    for (const auto &header : response.headers) {
+        _output += header.first + ": " + header.second + "\r\n";
+    }
+    _output += "Content-Length: " + QByteArray::number(response.body.size()) + "\r\n";
+    _output += _closeAfterResponse ? "Connection: close\r\n" : "Connection: keep-alive\r\n";
+    _output += "\r\n" + response.body;
+    _outputOffset = 0;
+    writeToSocket();
+}
 
-            QtServiceBase::instance()->logMessage("Wrote to client");
+void HttpConnection::writeToSocket()
+{
+    if (_output.isEmpty()) {
+        return;
+    }
 
-            if (socket->state() == QTcpSocket::UnconnectedState) {
-                delete socket;
-                QtServiceBase::instance()->logMessage("Connection closed");
-            }
+    // Only hand over what the throttle allows, Qt would buffer everything else
+    while (_outputOffset < _output.size() && _socket->bytesToWrite() < writeSliceSize) {
+        const auto granted = _server->downloadThrottle()->take(std::min(writeSliceSize, _output.size() - _outputOffset));
+        if (granted == 0) {
+            return;
         }
+        _socket->write(_output.constData() + _outputOffset, granted);
+        _outputOffset += granted;
+    }
+
+    if (_outputOffset == _output.size()) {
+        finishResponse();
     }
 }
-void HttpServer::discardClient()
+
+void HttpConnection::finishResponse()
 {
-    QTcpSocket* socket = (QTcpSocket*)sender();
-    socket->deleteLater();
+    _output.clear();
+    _outputOffset = 0;
+    if (_holdsSlot) {
+        _holdsSlot = false;
+        _server->releaseSlot();
+    }
 
-    QtServiceBase::instance()->logMessage("Connection closed");
+    if (_closeAfterResponse) {
+        _socket->disconnectFromHost();
+        return;
+    }
+    _busy = false;
+    // A pipelined request may already be buffered
+    if (!_input.isEmpty() || _socket->bytesAvailable() > 0) {
+        readFromSocket();
+    }
 }
 
+HttpServer::HttpServer(const MockServerOptions &options, WebDavHandler *handler, QObject *parent)
+    : QTcpServer(parent)
+    , _options(options)
+    , _handler(handler)
+    , _uploadThrottle(new Throttle(options.bytesPerSecond, this))
+    , _downloadThrottle(new Throttle(options.bytesPerSecond, this))
+{
+}
+
+bool HttpServer::start()
+{
+    return listen(QHostAddress::LocalHost, _options.port);
+}
 
-void HttpServer::incomingConnection(int socket)
+bool HttpServer::acquireSlot()
 {
-    if (disabled)
+    if (_options.maxConcurrentRequests > 0 && _activeRequests >= _options.maxConcurrentRequests) {
+        return false;
+    }
+    ++_activeRequests;
+    return true;
+}
+
+void HttpServer::releaseSlot()
+{
+    --_activeRequests;
+}
+
+int HttpServer::nextDelay() const
+{
+    const auto jitter = _options.jitterMsecs > 0 ? QRandomGenerator::global()->bounded(_options.jitterMsecs + 1) : 0;
+    return _options.latencyMsecs + jitter;
+}
+
+HttpResponse HttpServer::handle(const HttpRequest &request)
+{
+    const auto &pattern = _options.failurePattern;
+    const auto matches = pattern.pattern().isEmpty() || pattern.match(request.path()).hasMatch();
+    if (_options.failureRate > 0 && matches && QRandomGenerator::global()->generateDouble() < _options.failureRate) {
+        return HttpResponse::error(_options.failureStatus, QStringLiteral("ServiceUnavailable"), QStringLiteral("Failed on purpose"));
+    }
+    return _handler->handle(request);
+}
+
+void HttpServer::incomingConnection(qintptr socketDescriptor)
+{
+    auto socket = new QTcpSocket;
+    if (!socket->setSocketDescriptor(socketDescriptor)) {
+        delete socket;
         return;
-    QTcpSocket* s = new QTcpSocket(this);
-    connect(s, SIGNAL(readyRead()), this, SLOT(readClient()));
-    connect(s, SIGNAL(disconnected()), this, SLOT(discardClient()));
-    s->setSocketDescriptor(socket);
+    }
+    new HttpConnection(socket, this);
 }
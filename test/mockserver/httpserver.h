@@ -12,16 +12,117 @@
  * for more details.
  */
 
+#pragma once
+
 #include <QTcpServer>
+#include <QTimer>
+
+#include "mockserveroptions.h"
+#include "webdavhandler.h"
+
+class QTcpSocket;
+class HttpServer;
+
+/**
+ * @brief A token bucket shared by all connections for one direction
+ *
+ * Refilled in small slices so transfers stay smooth instead of bursting
+ * once a second.
+ */
+class Throttle : public QObject
+{
+    Q_OBJECT
+public:
+    explicit Throttle(qint64 bytesPerSecond, QObject *parent = nullptr);
+
+    [[nodiscard]] bool isLimited() const { return _bytesPerSecond > 0; }
+
+    /// Up to @a wanted bytes that may be transferred now
+    qint64 take(qint64 wanted);
+
+signals:
+    void refilled();
+
+private:
+    qint64 _bytesPerSecond;
+    qint64 _available = 0;
+    QTimer _timer;
+};
+
+/**
+ * @brief One HTTP/1.1 client connection with keep-alive
+ *
+ * Requests are handled one after the other. While a request is handled the
+ * socket is not read, so the kernel buffers fill up and the client has to
+ * wait, like with a busy server.
+ */
+class HttpConnection : public QObject
+{
+    Q_OBJECT
+public:
+    HttpConnection(QTcpSocket *socket, HttpServer *server);
+    ~HttpConnection() override;
 
+private:
+    void readFromSocket();
+    bool parseHeaders();
+    void dispatch();
+    void respond(const HttpResponse &response);
+    void writeToSocket();
+    void finishResponse();
+
+    QTcpSocket *_socket;
+    HttpServer *_server;
+
+    QByteArray _input;
+    HttpRequest _request;
+    qint64 _bodyLength = -1; // -1 while the headers are read
+    bool _busy = false;
+    bool _holdsSlot = false;
+
+    QByteArray _output;
+    qint64 _outputOffset = 0;
+    bool _closeAfterResponse = false;
+};
+
+/**
+ * @brief Serves a WebDavHandler over plain HTTP on localhost
+ *
+ * Simulates the network conditions of the options: every request is delayed
+ * by the latency plus some jitter, the bandwidth is shared by all
+ * connections, requests beyond the concurrency limit are refused and a share
+ * of the requests fails on purpose.
+ */
 class HttpServer : public QTcpServer
- {
-     Q_OBJECT
- public:
-    HttpServer(qint16 port, QObject* parent = nullptr);
-    void incomingConnection(int socket);
-
- private slots:
-     void readClient();
-     void discardClient();
- };
+{
+    Q_OBJECT
+public:
+    HttpServer(const MockServerOptions &options, WebDavHandler *handler, QObject *parent = nullptr);
+
+    /// Listens on the port of the options; port 0 picks a free one
+    bool start();
+
+    [[nodiscard]] const MockServerOptions &options() const { return _options; }
+    [[nodiscard]] Throttle *uploadThrottle() const { return _uploadThrottle; }
+    [[nodiscard]] Throttle *downloadThrottle() const { return _downloadThrottle; }
+
+    /// Reserves one of the concurrent request slots
+    bool acquireSlot();
+    void releaseSlot();
+
+    /// The latency of the next response, in milliseconds
+    [[nodiscard]] int nextDelay() const;
+
+    /// Handles a request, unless it was picked to fail
+    HttpResponse handle(const HttpRequest &request);
+
+protected:
+    void incomingConnection(qintptr socketDescriptor) override;
+
+private:
+    MockServerOptions _options;
+    WebDavHandler *_handler;
+    Throttle *_uploadThrottle;
+    Throttle *_downloadThrottle;
+    int _activeRequests = 0;
+};
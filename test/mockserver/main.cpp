@@ -12,13 +12,58 @@
  * for more details.
  */
 
+#include <QCommandLineParser>
 #include <QCoreApplication>
 
+#include <iostream>
+
 #include "httpserver.h"
+#include "webdavhandler.h"
 
-int main(int argc, char* argv[])
+int main(int argc, char *argv[])
 {
-  QCoreApplication app(argc, argv);
-  HttpServer server;
-  return app.exec();
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName(QStringLiteral("mockserver"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("A local stand-in for a Nextcloud server, to sync against without a real one."));
+    parser.addHelpOption();
+    const QCommandLineOption portOption(QStringLiteral("port"), QStringLiteral("Port to listen on, 0 picks a free one."), QStringLiteral("port"), QStringLiteral("0"));
+    const QCommandLineOption userOption(QStringLiteral("user"), QStringLiteral("Name of the user."), QStringLiteral("name"), QStringLiteral("admin"));
+    const QCommandLineOption rootOption(QStringLiteral("root"), QStringLiteral("Keep the files in this directory instead of in memory."), QStringLiteral("path"));
+    const QCommandLineOption latencyOption(QStringLiteral("latency"), QStringLiteral("Delay of every response."), QStringLiteral("msecs"), QStringLiteral("0"));
+    const QCommandLineOption jitterOption(QStringLiteral("jitter"), QStringLiteral("Random extra delay, up to this much."), QStringLiteral("msecs"), QStringLiteral("0"));
+    const QCommandLineOption bandwidthOption(QStringLiteral("bandwidth"), QStringLiteral("Throughput per direction, shared by all connections; 0 is unlimited."), QStringLiteral("kB/s"), QStringLiteral("0"));
+    const QCommandLineOption failureRateOption(QStringLiteral("failure-rate"), QStringLiteral("Share of requests that fail, between 0 and 1."), QStringLiteral("rate"), QStringLiteral("0"));
+    const QCommandLineOption failureStatusOption(QStringLiteral("failure-status"), QStringLiteral("HTTP status of failed requests."), QStringLiteral("status"), QStringLiteral("503"));
+    const QCommandLineOption failurePatternOption(QStringLiteral("fail-pattern"), QStringLiteral("Only requests to paths matching this regular expression fail."), QStringLiteral("regex"));
+    const QCommandLineOption maxConcurrentOption(QStringLiteral("max-concurrent"), QStringLiteral("Requests beyond this many at once get a 503; 0 is unlimited."), QStringLiteral("count"), QStringLiteral("0"));
+    const QCommandLineOption noChunkingOption(QStringLiteral("no-chunking"), QStringLiteral("Don't announce chunked uploads."));
+    const QCommandLineOption noBulkUploadOption(QStringLiteral("no-bulk-upload"), QStringLiteral("Don't announce bulk uploads."));
+    parser.addOptions({ portOption, userOption, rootOption, latencyOption, jitterOption, bandwidthOption,
+        failureRateOption, failureStatusOption, failurePatternOption, maxConcurrentOption, noChunkingOption, noBulkUploadOption });
+    parser.process(app);
+
+    MockServerOptions options;
+    options.port = parser.value(portOption).toUShort();
+    options.user = parser.value(userOption);
+    options.diskRoot = parser.value(rootOption);
+    options.chunking = !parser.isSet(noChunkingOption);
+    options.bulkUpload = !parser.isSet(noBulkUploadOption);
+    options.latencyMsecs = parser.value(latencyOption).toInt();
+    options.jitterMsecs = parser.value(jitterOption).toInt();
+    options.bytesPerSecond = parser.value(bandwidthOption).toLongLong() * 1000;
+    options.failureRate = parser.value(failureRateOption).toDouble();
+    options.failureStatus = parser.value(failureStatusOption).toInt();
+    options.failurePattern = QRegularExpression(parser.value(failurePatternOption));
+    options.maxConcurrentRequests = parser.value(maxConcurrentOption).toInt();
+
+    WebDavHandler handler(options);
+    HttpServer server(options, &handler);
+    if (!server.start()) {
+        std::cerr << "Could not listen: " << qPrintable(server.errorString()) << std::endl;
+        return 1;
+    }
+    std::cout << "Serving http://localhost:" << server.serverPort() << "/ for user " << qPrintable(options.user) << std::endl;
+    return app.exec();
 }
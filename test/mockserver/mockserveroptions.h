@@ -0,0 +1,44 @@
+/*
+ * Copyright (C) by Nextcloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#pragma once
+
+#include <QRegularExpression>
+#include <QString>
+
+/**
+ * @brief How the mock server behaves
+ *
+ * The network conditions are applied to every request the server handles,
+ * see HttpServer.
+ */
+struct MockServerOptions
+{
+    quint16 port = 0; // 0 picks a free port
+    QString user = QStringLiteral("admin");
+    QString diskRoot; // empty keeps the files in memory
+
+    bool chunking = true; // announce chunked upload v2
+    bool bulkUpload = true; // announce bulk upload
+
+    int latencyMsecs = 0; // added before every response
+    int jitterMsecs = 0; // random extra latency, up to this much
+    qint64 bytesPerSecond = 0; // shared by all connections and per direction, 0 is unlimited
+
+    double failureRate = 0.0; // share of requests answered with failureStatus
+    int failureStatus = 503;
+    QRegularExpression failurePattern; // only requests to matching paths fail, if set
+
+    int maxConcurrentRequests = 0; // requests beyond this get a 503, 0 is unlimited
+};
@@ -0,0 +1,664 @@
+/*
+ * Copyright (C) by Nextcloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "webdavhandler.h"
+
+#include <QBuffer>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLocale>
+#include <QRegularExpression>
+#include <QUrl>
+#include <QXmlStreamWriter>
+
+namespace {
+
+const auto davUri = QStringLiteral("DAV:");
+const auto ocUri = QStringLiteral("http://owncloud.org/ns");
+const auto ncUri = QStringLiteral("http://nextcloud.org/ns");
+const auto sabreUri = QStringLiteral("http://sabredav.org/ns");
+
+const auto remotePhp = QStringLiteral("/remote.php/");
+const auto filesRoot = QStringLiteral("dav/files/");
+const auto uploadsRoot = QStringLiteral("dav/uploads/");
+const auto legacyRoot = QStringLiteral("webdav");
+
+QByteArray httpDate(qint64 secsSinceEpoch)
+{
+    const auto dateTime = QDateTime::fromSecsSinceEpoch(secsSinceEpoch, Qt::UTC);
+    return QLocale::c().toString(dateTime, QStringLiteral("ddd, dd MMM yyyy HH:mm:ss 'GMT'")).toLatin1();
+}
+
+QByteArray quotedEtag(const QByteArray &etag)
+{
+    return '"' + etag + '"';
+}
+
+QByteArray unquotedEtag(QByteArray etag)
+{
+    etag = etag.trimmed();
+    if (etag.startsWith("W/")) {
+        etag = etag.mid(2);
+    }
+    if (etag.size() >= 2 && etag.startsWith('"') && etag.endsWith('"')) {
+        etag = etag.mid(1, etag.size() - 2);
+    }
+    return etag;
+}
+
+HttpResponse jsonResponse(const QJsonObject &object)
+{
+    HttpResponse response;
+    response.setHeader("Content-Type", "application/json; charset=utf-8");
+    response.body = QJsonDocument(object).toJson(QJsonDocument::Compact);
+    return response;
+}
+
+QString permissions(const FileTree::Entry &entry)
+{
+    return entry.isDir ? QStringLiteral("RDNVCK") : QStringLiteral("RDNVW");
+}
+
+}
+
+QString HttpRequest::path() const
+{
+    const auto queryPosition = target.indexOf('?');
+    return QUrl::fromPercentEncoding(queryPosition >= 0 ? target.left(queryPosition) : target);
+}
+
+HttpResponse HttpResponse::error(int status, const QString &exception, const QString &message)
+{
+    HttpResponse response;
+    response.status = status;
+    response.setHeader("Content-Type", "application/xml; charset=utf-8");
+
+    QBuffer buffer(&response.body);
+    buffer.open(QIODevice::WriteOnly);
+    QXmlStreamWriter xml(&buffer);
+    xml.writeNamespace(davUri, QStringLiteral("d"));
+    xml.writeNamespace(sabreUri, QStringLiteral("s"));
+    xml.writeStartDocument();
+    xml.writeStartElement(davUri, QStringLiteral("error"));
+    xml.writeTextElement(sabreUri, QStringLiteral("exception"), QStringLiteral("Sabre\\DAV\\Exception\\") + exception);
+    xml.writeTextElement(sabreUri, QStringLiteral("message"), message);
+    xml.writeEndElement();
+    xml.writeEndDocument();
+    return response;
+}
+
+QByteArray HttpResponse::reasonPhrase(int status)
+{
+    switch (status) {
+    case 200: return "OK";
+    case 201: return "Created";
+    case 204: return "No Content";
+    case 206: return "Partial Content";
+    case 207: return "Multi-Status";
+    case 400: return "Bad Request";
+    case 403: return "Forbidden";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 409: return "Conflict";
+    case 411: return "Length Required";
+    case 412: return "Precondition Failed";
+    case 416: return "Requested Range Not Satisfiable";
+    case 423: return "Locked";
+    case 500: return "Internal Server Error";
+    case 501: return "Not Implemented";
+    case 502: return "Bad Gateway";
+    case 503: return "Service Unavailable";
+    case 507: return "Insufficient Storage";
+    default: return "Unknown";
+    }
+}
+
+WebDavHandler::WebDavHandler(const MockServerOptions &options)
+    : _options(options)
+    , _files(options.diskRoot)
+{
+}
+
+WebDavHandler::Target WebDavHandler::resolve(const QString &path) const
+{
+    Target target;
+    const auto remotePhpPosition = path.indexOf(remotePhp);
+    if (remotePhpPosition < 0) {
+        return target;
+    }
+    target.mountPoint = path.left(remotePhpPosition);
+
+    const auto rest = path.mid(remotePhpPosition + remotePhp.size());
+    QString pathInNamespace;
+    if (rest.startsWith(filesRoot)) {
+        const auto userAndPath = rest.mid(filesRoot.size());
+        const auto slashPosition = userAndPath.indexOf(QLatin1Char('/'));
+        const auto user = slashPosition >= 0 ? userAndPath.left(slashPosition) : userAndPath;
+        target.davRoot = target.mountPoint + remotePhp + filesRoot + user + QLatin1Char('/');
+        pathInNamespace = slashPosition >= 0 ? userAndPath.mid(slashPosition) : QString();
+    } else if (rest.startsWith(uploadsRoot)) {
+        target.ns = Namespace::Uploads;
+        target.davRoot = target.mountPoint + remotePhp + uploadsRoot;
+        pathInNamespace = rest.mid(uploadsRoot.size());
+    } else if (rest == legacyRoot || rest.startsWith(legacyRoot + QLatin1Char('/'))) {
+        target.davRoot = target.mountPoint + remotePhp + legacyRoot + QLatin1Char('/');
+        pathInNamespace = rest.mid(legacyRoot.size());
+    } else {
+        return target;
+    }
+
+    target.path = FileTree::normalize(pathInNamespace);
+    target.valid = true;
+    return target;
+}
+
+HttpResponse WebDavHandler::handle(const HttpRequest &request)
+{
+    const auto path = request.path();
+    if (path.endsWith(QLatin1String("/status.php"))) {
+        return status();
+    }
+    if (path.contains(QLatin1String("/ocs/v1.php/")) || path.contains(QLatin1String("/ocs/v2.php/"))) {
+        return ocs(path);
+    }
+    if (request.method == "POST" && path.endsWith(QLatin1String("/remote.php/dav/bulk"))) {
+        return bulkUpload(request);
+    }
+
+    const auto target = resolve(path);
+    if (!target.valid) {
+        return HttpResponse::error(404, QStringLiteral("NotFound"), QStringLiteral("Nothing at %1").arg(path));
+    }
+
+    if (request.method == "PROPFIND") {
+        return propfind(request, target);
+    } else if (request.method == "GET" || request.method == "HEAD") {
+        return get(request, target, request.method == "GET");
+    } else if (request.method == "PUT") {
+        return put(request, target);
+    } else if (request.method == "MKCOL") {
+        return mkcol(target);
+    } else if (request.method == "DELETE") {
+        return remove(target);
+    } else if (request.method == "MOVE" || request.method == "COPY") {
+        return moveOrCopy(request, target, request.method == "MOVE");
+    } else if (request.method == "OPTIONS") {
+        HttpResponse response;
+        response.setHeader("DAV", "1, 3");
+        response.setHeader("Allow", "OPTIONS, GET, HEAD, DELETE, PROPFIND, PUT, MKCOL, MOVE, COPY");
+        return response;
+    }
+    return HttpResponse::error(501, QStringLiteral("NotImplemented"), QStringLiteral("%1 is not supported").arg(QString::fromLatin1(request.method)));
+}
+
+HttpResponse WebDavHandler::status() const
+{
+    return jsonResponse({
+        { QStringLiteral("installed"), true },
+        { QStringLiteral("maintenance"), false },
+        { QStringLiteral("needsDbUpgrade"), false },
+        { QStringLiteral("version"), QStringLiteral("27.0.0.0") },
+        { QStringLiteral("versionstring"), QStringLiteral("27.0.0") },
+        { QStringLiteral("edition"), QString() },
+        { QStringLiteral("productname"), QStringLiteral("Nextcloud") },
+        { QStringLiteral("extendedSupport"), false },
+    });
+}
+
+HttpResponse WebDavHandler::ocs(const QString &path) const
+{
+    const auto isV2 = path.contains(QLatin1String("/ocs/v2.php/"));
+    const auto ocsResponse = [isV2](int statusCode, const QJsonValue &data) {
+        const QJsonObject meta {
+            { QStringLiteral("status"), statusCode < 300 ? QStringLiteral("ok") : QStringLiteral("failure") },
+            { QStringLiteral("statuscode"), isV2 ? statusCode : (statusCode < 300 ? 100 : statusCode) },
+            { QStringLiteral("message"), QStringLiteral("OK") },
+        };
+        auto response = jsonResponse({ { QStringLiteral("ocs"), QJsonObject { { QStringLiteral("meta"), meta }, { QStringLiteral("data"), data } } } });
+        if (isV2) {
+            response.status = statusCode;
+        }
+        return response;
+    };
+
+    if (path.endsWith(QLatin1String("/cloud/capabilities"))) {
+        QJsonObject dav { { QStringLiteral("chunking"), _options.chunking ? QStringLiteral("1.0") : QString() } };
+        if (_options.bulkUpload) {
+            dav.insert(QStringLiteral("bulkupload"), QStringLiteral("1.0"));
+        }
+        const QJsonObject capabilities {
+            { QStringLiteral("core"), QJsonObject {
+                { QStringLiteral("pollinterval"), 60 },
+                { QStringLiteral("webdav-root"), QStringLiteral("remote.php/webdav") },
+                { QStringLiteral("status"), QJsonDocument::fromJson(status().body).object() },
+            } },
+            { QStringLiteral("dav"), dav },
+            { QStringLiteral("files"), QJsonObject {
+                { QStringLiteral("bigfilechunking"), true },
+                { QStringLiteral("undelete"), false },
+                { QStringLiteral("versioning"), false },
+            } },
+            { QStringLiteral("checksums"), QJsonObject {
+                { QStringLiteral("supportedTypes"), QJsonArray { QStringLiteral("MD5"), QStringLiteral("SHA1") } },
+                { QStringLiteral("preferredUploadType"), QStringLiteral("MD5") },
+            } },
+        };
+        return ocsResponse(200, QJsonObject {
+            { QStringLiteral("version"), QJsonObject { { QStringLiteral("string"), QStringLiteral("27.0.0") } } },
+            { QStringLiteral("capabilities"), capabilities },
+        });
+    }
+    if (path.endsWith(QLatin1String("/cloud/user"))) {
+        return ocsResponse(200, QJsonObject {
+            { QStringLiteral("id"), _options.user },
+            { QStringLiteral("display-name"), _options.user },
+        });
+    }
+    return ocsResponse(404, QJsonArray());
+}
+
+HttpResponse WebDavHandler::propfind(const HttpRequest &request, const Target &target)
+{
+    auto &files = tree(target.ns);
+    const auto entry = files.find(target.path);
+    if (!entry) {
+        return HttpResponse::error(404, QStringLiteral("NotFound"), QStringLiteral("File with name %1 could not be located").arg(target.path));
+    }
+
+    const auto depth = request.header("depth");
+    QStringList paths { target.path };
+    if (entry->isDir && depth != "0") {
+        paths += files.children(target.path, depth == "infinity");
+    }
+
+    HttpResponse response;
+    response.status = 207;
+    response.setHeader("Content-Type", "application/xml; charset=utf-8");
+
+    QBuffer buffer(&response.body);
+    buffer.open(QIODevice::WriteOnly);
+    QXmlStreamWriter xml(&buffer);
+    xml.writeNamespace(davUri, QStringLiteral("d"));
+    xml.writeNamespace(ocUri, QStringLiteral("oc"));
+    xml.writeNamespace(ncUri, QStringLiteral("nc"));
+    xml.writeStartDocument();
+    xml.writeStartElement(davUri, QStringLiteral("multistatus"));
+    for (const auto &path : qAsConst(paths)) {
+        const auto &info = *files.find(path);
+        auto href = QString::fromUtf8(QUrl::toPercentEncoding(target.davRoot + path, "/"));
+        if (info.isDir && !href.endsWith(QLatin1Char('/'))) {
+            href.append(QLatin1Char('/'));
+        }
+
+        xml.writeStartElement(davUri, QStringLiteral("response"));
+        xml.writeTextElement(davUri, QStringLiteral("href"), href);
+        xml.writeStartElement(davUri, QStringLiteral("propstat"));
+        xml.writeStartElement(davUri, QStringLiteral("prop"));
+        if (info.isDir) {
+            xml.writeStartElement(davUri, QStringLiteral("resourcetype"));
+            xml.writeEmptyElement(davUri, QStringLiteral("collection"));
+            xml.writeEndElement();
+
+            qint64 size = 0;
+            const auto below = files.children(path, true);
+            for (const auto &child : below) {
+                size += files.find(child)->size;
+            }
+            xml.writeTextElement(ocUri, QStringLiteral("size"), QString::number(size));
+            xml.writeTextElement(davUri, QStringLiteral("quota-used-bytes"), QString::number(size));
+            xml.writeTextElement(davUri, QStringLiteral("quota-available-bytes"), QStringLiteral("-3"));
+        } else {
+            xml.writeEmptyElement(davUri, QStringLiteral("resourcetype"));
+            xml.writeTextElement(davUri, QStringLiteral("getcontentlength"), QString::number(info.size));
+            xml.writeTextElement(ocUri, QStringLiteral("size"), QString::number(info.size));
+            xml.writeTextElement(davUri, QStringLiteral("getcontenttype"), QStringLiteral("application/octet-stream"));
+            if (!info.checksum.isEmpty()) {
+                xml.writeTextElement(ocUri, QStringLiteral("checksums"), QString::fromLatin1(info.checksum));
+            }
+        }
+        xml.writeTextElement(davUri, QStringLiteral("getlastmodified"), QString::fromLatin1(httpDate(info.mtime)));
+        xml.writeTextElement(davUri, QStringLiteral("getetag"), QString::fromLatin1(quotedEtag(info.etag)));
+        xml.writeTextElement(ocUri, QStringLiteral("id"), QString::fromLatin1(info.fileId));
+        xml.writeTextElement(ocUri, QStringLiteral("fileid"), QString::fromLatin1(info.fileId));
+        xml.writeTextElement(ocUri, QStringLiteral("permissions"), permissions(info));
+        xml.writeTextElement(ocUri, QStringLiteral("share-types"), QString());
+        xml.writeTextElement(ncUri, QStringLiteral("is-encrypted"), QStringLiteral("0"));
+        xml.writeTextElement(ncUri, QStringLiteral("lock"), QStringLiteral("0"));
+        xml.writeEndElement(); // prop
+        xml.writeTextElement(davUri, QStringLiteral("status"), QStringLiteral("HTTP/1.1 200 OK"));
+        xml.writeEndElement(); // propstat
+        xml.writeEndElement(); // response
+    }
+    xml.writeEndElement(); // multistatus
+    xml.writeEndDocument();
+    return response;
+}
+
+HttpResponse WebDavHandler::get(const HttpRequest &request, const Target &target, bool withBody)
+{
+    const auto &files = tree(target.ns);
+    const auto entry = files.find(target.path);
+    if (!entry) {
+        return HttpResponse::error(404, QStringLiteral("NotFound"), QStringLiteral("File with name %1 could not be located").arg(target.path));
+    }
+    if (entry->isDir) {
+        return HttpResponse::error(501, QStringLiteral("NotImplemented"), QStringLiteral("GET is only implemented on File objects"));
+    }
+
+    HttpResponse response;
+    qint64 offset = 0;
+    auto length = entry->size;
+    static const QRegularExpression rangeExpression(QStringLiteral("^bytes=(\\d+)-(\\d*)$"));
+    const auto range = rangeExpression.match(QString::fromLatin1(request.header("range")));
+    if (range.hasMatch()) {
+        offset = range.captured(1).toLongLong();
+        const auto last = range.captured(2).isEmpty() ? entry->size - 1 : std::min(range.captured(2).toLongLong(), entry->size - 1);
+        if (offset >= entry->size || last < offset) {
+            response = HttpResponse::error(416, QStringLiteral("RequestedRangeNotSatisfiable"), QStringLiteral("The start offset is beyond the end of the file"));
+            response.setHeader("Content-Range", "bytes */" + QByteArray::number(entry->size));
+            return response;
+        }
+        length = last - offset + 1;
+        response.status = 206;
+        response.setHeader("Content-Range", "bytes " + QByteArray::number(offset) + '-' + QByteArray::number(last) + '/' + QByteArray::number(entry->size));
+    }
+
+    response.setHeader("Content-Type", "application/octet-stream");
+    response.setHeader("Last-Modified", httpDate(entry->mtime));
+    setFileHeaders(response, *entry, false);
+    if (!entry->checksum.isEmpty()) {
+        response.setHeader("OC-Checksum", entry->checksum);
+    }
+    if (withBody) {
+        response.body = files.read(target.path, offset, length);
+    }
+    return response;
+}
+
+HttpResponse WebDavHandler::put(const HttpRequest &request, const Target &target)
+{
+    auto &files = tree(target.ns);
+    const auto existing = files.find(target.path);
+    if (existing && existing->isDir) {
+        return HttpResponse::error(409, QStringLiteral("Conflict"), QStringLiteral("%1 is a collection").arg(target.path));
+    }
+
+    if (target.ns == Namespace::Files) {
+        const auto ifMatch = request.header("if-match");
+        if (!ifMatch.isEmpty() && (!existing || unquotedEtag(ifMatch) != existing->etag)) {
+            return HttpResponse::error(412, QStringLiteral("PreconditionFailed"), QStringLiteral("An If-Match header was specified, but none of the specified ETags matched."));
+        }
+        if (request.header("if-none-match") == "*" && existing) {
+            return HttpResponse::error(412, QStringLiteral("PreconditionFailed"), QStringLiteral("An If-None-Match header was specified, but the file exists."));
+        }
+    }
+
+    const auto checksum = request.header("oc-checksum");
+    if (!checksumMatches(checksum, request.body)) {
+        return HttpResponse::error(400, QStringLiteral("BadRequest"), QStringLiteral("The computed checksum does not match the one received from the client."));
+    }
+
+    const auto mtimeHeader = request.header("x-oc-mtime");
+    const auto mtime = mtimeHeader.toLongLong();
+    if (!mtimeHeader.isEmpty() && mtime <= 0) {
+        return HttpResponse::error(400, QStringLiteral("BadRequest"), QStringLiteral("X-OC-MTime header must be a valid unix timestamp"));
+    }
+
+    const auto entry = files.put(target.path, request.body, mtime > 0 ? mtime : QDateTime::currentSecsSinceEpoch(), checksum);
+    if (!entry) {
+        return HttpResponse::error(409, QStringLiteral("Conflict"), QStringLiteral("Could not write %1, does the parent exist?").arg(target.path));
+    }
+
+    HttpResponse response;
+    response.status = existing ? 204 : 201;
+    setFileHeaders(response, *entry, mtime > 0);
+    return response;
+}
+
+HttpResponse WebDavHandler::mkcol(const Target &target)
+{
+    auto &files = tree(target.ns);
+    if (files.find(target.path)) {
+        return HttpResponse::error(405, QStringLiteral("MethodNotAllowed"), QStringLiteral("The resource you tried to create already exists"));
+    }
+
+    if (target.ns == Namespace::Uploads) {
+        // The upload folders of the user are created on demand
+        const auto parts = target.path.split(QLatin1Char('/'));
+        QString path;
+        for (const auto &part : parts) {
+            path = path.isEmpty() ? part : path + QLatin1Char('/') + part;
+            if (!files.find(path)) {
+                files.mkdir(path);
+            }
+        }
+    } else if (!files.mkdir(target.path)) {
+        return HttpResponse::error(409, QStringLiteral("Conflict"), QStringLiteral("Parent node does not exist"));
+    }
+
+    HttpResponse response;
+    response.status = 201;
+    response.setHeader("OC-FileId", files.find(target.path)->fileId);
+    return response;
+}
+
+HttpResponse WebDavHandler::remove(const Target &target)
+{
+    if (target.path.isEmpty()) {
+        return HttpResponse::error(403, QStringLiteral("Forbidden"), QStringLiteral("The root can't be deleted"));
+    }
+    if (!tree(target.ns).remove(target.path)) {
+        return HttpResponse::error(404, QStringLiteral("NotFound"), QStringLiteral("File with name %1 could not be located").arg(target.path));
+    }
+    HttpResponse response;
+    response.status = 204;
+    return response;
+}
+
+HttpResponse WebDavHandler::moveOrCopy(const HttpRequest &request, const Target &target, bool isMove)
+{
+    const auto destination = resolve(QUrl::fromEncoded(request.header("destination")).path());
+    if (!destination.valid) {
+        return HttpResponse::error(502, QStringLiteral("BadGateway"), QStringLiteral("The destination is not on this server"));
+    }
+
+    if (isMove && target.ns == Namespace::Uploads && destination.ns == Namespace::Files
+        && target.path.endsWith(QLatin1String("/.file"))) {
+        return assembleChunks(request, target, destination);
+    }
+    if (target.ns != destination.ns) {
+        return HttpResponse::error(502, QStringLiteral("BadGateway"), QStringLiteral("Can't move between namespaces"));
+    }
+
+    auto &files = tree(target.ns);
+    if (!files.find(target.path)) {
+        return HttpResponse::error(404, QStringLiteral("NotFound"), QStringLiteral("File with name %1 could not be located").arg(target.path));
+    }
+    const auto existed = files.find(destination.path) != nullptr;
+    if (existed && request.header("overwrite") == "F") {
+        return HttpResponse::error(412, QStringLiteral("PreconditionFailed"), QStringLiteral("The destination node already exists, and the overwrite header is set to false"));
+    }
+
+    const auto done = isMove ? files.move(target.path, destination.path) : files.copy(target.path, destination.path);
+    if (!done) {
+        return HttpResponse::error(409, QStringLiteral("Conflict"), QStringLiteral("The destination can't be written"));
+    }
+
+    HttpResponse response;
+    response.status = existed ? 204 : 201;
+    setFileHeaders(response, *files.find(destination.path), false);
+    return response;
+}
+
+HttpResponse WebDavHandler::assembleChunks(const HttpRequest &request, const Target &source, const Target &destination)
+{
+    const auto uploadFolder = FileTree::parentPath(source.path);
+    const auto uploadFolderEntry = _uploads.find(uploadFolder);
+    if (uploadFolder.isEmpty() || !uploadFolderEntry || !uploadFolderEntry->isDir) {
+        return HttpResponse::error(404, QStringLiteral("NotFound"), QStringLiteral("Upload %1 doesn't exist").arg(uploadFolder));
+    }
+
+    // The chunk names sort in upload order
+    QByteArray data;
+    const auto chunks = _uploads.children(uploadFolder);
+    for (const auto &chunk : chunks) {
+        data += _uploads.read(chunk);
+    }
+
+    const auto totalLength = request.header("oc-total-length");
+    if (!totalLength.isEmpty() && totalLength.toLongLong() != data.size()) {
+        return HttpResponse::error(400, QStringLiteral("BadRequest"), QStringLiteral("Expected filesize of %1 bytes but read %2 bytes").arg(QString::fromLatin1(totalLength)).arg(data.size()));
+    }
+
+    // The client conditions on the destination: If: <url> (["etag"])
+    const auto existing = _files.find(destination.path);
+    const auto ifHeader = request.header("if");
+    if (!ifHeader.isEmpty()) {
+        const auto etagStart = ifHeader.indexOf("([");
+        const auto etagEnd = ifHeader.lastIndexOf("])");
+        const auto etag = etagStart >= 0 && etagEnd > etagStart ? unquotedEtag(ifHeader.mid(etagStart + 2, etagEnd - etagStart - 2)) : QByteArray();
+        if (!existing || existing->etag != etag) {
+            return HttpResponse::error(412, QStringLiteral("PreconditionFailed"), QStringLiteral("An If-Match header was specified, but none of the specified ETags matched."));
+        }
+    }
+
+    const auto checksum = request.header("oc-checksum");
+    if (!checksumMatches(checksum, data)) {
+        return HttpResponse::error(400, QStringLiteral("BadRequest"), QStringLiteral("The computed checksum does not match the one received from the client."));
+    }
+
+    const auto mtime = request.header("x-oc-mtime").toLongLong();
+    const auto existed = existing != nullptr;
+    const auto entry = _files.put(destination.path, data, mtime > 0 ? mtime : QDateTime::currentSecsSinceEpoch(), checksum);
+    if (!entry) {
+        return HttpResponse::error(409, QStringLiteral("Conflict"), QStringLiteral("Could not write %1, does the parent exist?").arg(destination.path));
+    }
+
+    if (request.header("oc-keep-chunks") != "1") {
+        _uploads.remove(uploadFolder);
+    }
+
+    HttpResponse response;
+    response.status = existed ? 204 : 201;
+    setFileHeaders(response, *entry, mtime > 0);
+    return response;
+}
+
+HttpResponse WebDavHandler::bulkUpload(const HttpRequest &request)
+{
+    const auto contentType = request.header("content-type");
+    const auto boundaryPosition = contentType.indexOf("boundary=");
+    if (!contentType.startsWith("multipart/related") || boundaryPosition < 0) {
+        return HttpResponse::error(400, QStringLiteral("BadRequest"), QStringLiteral("Content-Type must be multipart/related"));
+    }
+    auto boundary = contentType.mid(boundaryPosition + qstrlen("boundary="));
+    const auto semicolonPosition = boundary.indexOf(';');
+    if (semicolonPosition >= 0) {
+        boundary.truncate(semicolonPosition);
+    }
+    boundary = unquotedEtag(boundary);
+    const auto delimiter = "--" + boundary;
+    const auto &body = request.body;
+
+    QJsonObject result;
+    auto position = body.indexOf(delimiter);
+    while (position >= 0) {
+        position += delimiter.size();
+        if (body.mid(position, 2) == "--") {
+            break; // the closing delimiter
+        }
+        const auto headersStart = body.indexOf("\r\n", position) + 2;
+        const auto headersEnd = body.indexOf("\r\n\r\n", headersStart);
+        const auto partEnd = headersEnd >= 0 ? body.indexOf("\r\n" + delimiter, headersEnd + 4) : -1;
+        if (headersStart < 2 || headersEnd < 0 || partEnd < 0) {
+            return HttpResponse::error(400, QStringLiteral("BadRequest"), QStringLiteral("Malformed multipart body"));
+        }
+
+        QMap<QByteArray, QByteArray> headers;
+        const auto headerLines = body.mid(headersStart, headersEnd - headersStart).split('\n');
+        for (const auto &line : headerLines) {
+            const auto colonPosition = line.indexOf(':');
+            if (colonPosition > 0) {
+                headers.insert(line.left(colonPosition).trimmed().toLower(), line.mid(colonPosition + 1).trimmed());
+            }
+        }
+        const auto data = body.mid(headersEnd + 4, partEnd - headersEnd - 4);
+        position = partEnd + 2;
+
+        const auto filePath = QString::fromUtf8(headers.value("x-file-path"));
+        const auto mtime = headers.value("x-file-mtime").toLongLong();
+        auto checksum = headers.value("x-file-md5");
+        if (!checksum.isEmpty() && !checksum.contains(':')) {
+            checksum.prepend("MD5:");
+        }
+
+        QJsonObject fileResult;
+        const FileTree::Entry *entry = nullptr;
+        if (filePath.isEmpty() || mtime <= 0) {
+            fileResult.insert(QStringLiteral("message"), QStringLiteral("X-File-Path and X-File-Mtime are required"));
+        } else if (!checksumMatches(checksum, data)) {
+            fileResult.insert(QStringLiteral("message"), QStringLiteral("Computed md5 hash is incorrect."));
+        } else if (!(entry = _files.put(filePath, data, mtime, checksum))) {
+            fileResult.insert(QStringLiteral("message"), QStringLiteral("Could not write %1, does the parent exist?").arg(filePath));
+        }
+
+        fileResult.insert(QStringLiteral("error"), entry == nullptr);
+        if (entry) {
+            fileResult.insert(QStringLiteral("etag"), QString::fromLatin1(entry->etag));
+            fileResult.insert(QStringLiteral("fileid"), QString::fromLatin1(entry->fileId));
+            fileResult.insert(QStringLiteral("permissions"), permissions(*entry));
+            fileResult.insert(QStringLiteral("X-OC-MTime"), QStringLiteral("accepted"));
+        }
+        result.insert(filePath, fileResult);
+    }
+    return jsonResponse(result);
+}
+
+void WebDavHandler::setFileHeaders(HttpResponse &response, const FileTree::Entry &entry, bool mtimeAccepted)
+{
+    response.setHeader("ETag", quotedEtag(entry.etag));
+    response.setHeader("OC-ETag", quotedEtag(entry.etag));
+    response.setHeader("OC-FileId", entry.fileId);
+    if (mtimeAccepted) {
+        response.setHeader("X-OC-MTime", "accepted");
+    }
+}
+
+bool WebDavHandler::checksumMatches(const QByteArray &checksumHeader, const QByteArray &data)
+{
+    const auto colonPosition = checksumHeader.indexOf(':');
+    if (colonPosition < 0) {
+        return true;
+    }
+
+    const auto type = checksumHeader.left(colonPosition).toUpper();
+    const auto expected = checksumHeader.mid(colonPosition + 1).toLower();
+    QCryptographicHash::Algorithm algorithm;
+    if (type == "MD5") {
+        algorithm = QCryptographicHash::Md5;
+    } else if (type == "SHA1") {
+        algorithm = QCryptographicHash::Sha1;
+    } else if (type == "SHA256") {
+        algorithm = QCryptographicHash::Sha256;
+    } else if (type == "SHA3-256") {
+        algorithm = QCryptographicHash::Sha3_256;
+    } else {
+        // Not verified, like the server does for types it doesn't know
+        return true;
+    }
+    return QCryptographicHash::hash(data, algorithm).toHex() == expected;
+}
@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) by Nextcloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#pragma once
+
+#include <QByteArray>
+#include <QMap>
+#include <QPair>
+#include <QString>
+#include <QVector>
+
+#include "filetree.h"
+#include "mockserveroptions.h"
+
+struct HttpRequest
+{
+    QByteArray method;
+    QByteArray target; // as sent, percent encoded and with the query
+    QMap<QByteArray, QByteArray> headers; // names in lower case
+    QByteArray body;
+
+    [[nodiscard]] QByteArray header(const QByteArray &name) const { return headers.value(name.toLower()); }
+    [[nodiscard]] QString path() const;
+};
+
+struct HttpResponse
+{
+    int status = 200;
+    QVector<QPair<QByteArray, QByteArray>> headers;
+    QByteArray body;
+
+    void setHeader(const QByteArray &name, const QByteArray &value) { headers.append({ name, value }); }
+    [[nodiscard]] static QByteArray reasonPhrase(int status);
+
+    /// An error with a body like the one sabre/dav sends
+    [[nodiscard]] static HttpResponse error(int status, const QString &exception, const QString &message);
+};
+
+/**
+ * @brief Answers the requests of the client like a Nextcloud server
+ *
+ * Covers what a sync needs: status.php, the OCS capabilities and user info,
+ * and WebDAV on the files of one user with PROPFIND, GET with ranges, PUT,
+ * MKCOL, MOVE, COPY and DELETE. Uploads in chunks (chunking v2 below
+ * remote.php/dav/uploads) and bulk uploads (remote.php/dav/bulk) work like
+ * on the server, including the etag preconditions and the checksums.
+ *
+ * The server may be mounted below a path, like http://host/nextcloud.
+ */
+class WebDavHandler
+{
+public:
+    explicit WebDavHandler(const MockServerOptions &options);
+
+    HttpResponse handle(const HttpRequest &request);
+
+    [[nodiscard]] FileTree &files() { return _files; }
+    [[nodiscard]] FileTree &uploads() { return _uploads; }
+
+private:
+    enum class Namespace {
+        Files,
+        Uploads,
+    };
+
+    // A request target split into the server's mount point, the namespace and the path in it
+    struct Target
+    {
+        QString mountPoint;
+        QString davRoot; // mountPoint + the url of the namespace root, ends with a slash
+        Namespace ns = Namespace::Files;
+        QString path;
+        bool valid = false;
+    };
+    [[nodiscard]] Target resolve(const QString &path) const;
+
+    HttpResponse status() const;
+    HttpResponse ocs(const QString &path) const;
+    HttpResponse propfind(const HttpRequest &request, const Target &target);
+    HttpResponse get(const HttpRequest &request, const Target &target, bool withBody);
+    HttpResponse put(const HttpRequest &request, const Target &target);
+    HttpResponse mkcol(const Target &target);
+    HttpResponse remove(const Target &target);
+    HttpResponse moveOrCopy(const HttpRequest &request, const Target &target, bool isMove);
+    HttpResponse assembleChunks(const HttpRequest &request, const Target &source, const Target &destination);
+    HttpResponse bulkUpload(const HttpRequest &request);
+
+    FileTree &tree(Namespace ns) { return ns == Namespace::Files ? _files : _uploads; }
+    static void setFileHeaders(HttpResponse &response, const FileTree::Entry &entry, bool mtimeAccepted);
+    [[nodiscard]] static bool checksumMatches(const QByteArray &checksumHeader, const QByteArray &data);
+
+    MockServerOptions _options;
+    FileTree _files;
+    FileTree _uploads;
+};
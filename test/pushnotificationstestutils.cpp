@@ -79,6 +79,11 @@ void FakeWebSocketServer::close()
 
 void FakeWebSocketServer::processTextMessageInternal(const QString &message)
 {
+    if (message.startsWith(QStringLiteral("listen "))) {
+        _listenRequests.append(message);
+        return;
+    }
+
     auto client = qobject_cast<QWebSocket *>(sender());
     emit processTextMessage(client, message);
 }
@@ -46,6 +46,9 @@ public:
 
     void clearTextMessages();
 
+    /// The "listen ..." requests the clients sent, they are not counted as text messages
+    [[nodiscard]] QStringList listenRequests() const { return _listenRequests; }
+
     static OCC::AccountPtr createAccount(const QString &username = "user", const QString &password = "password");
 
 signals:
@@ -62,6 +65,7 @@ private:
     QList<QWebSocket *> _clients;
 
     std::unique_ptr<QSignalSpy> _processTextMessageSpy;
+    QStringList _listenRequests;
 };
 
 class CredentialsStub : public OCC::AbstractCredentials
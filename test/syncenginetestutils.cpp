@@ -385,9 +385,18 @@ FakePropfindReply::FakePropfindReply(FileInfo &remoteRootFileInfo, QNetworkAcces
         xml.writeEndElement(); // response
     };
 
+    // "Depth: infinity" lists the whole subtree
+    const auto depthInfinity = request.rawHeader("Depth") == "infinity";
+    std::function<void(const FileInfo &)> writeChildrenResponses = [&](const FileInfo &dirInfo) {
+        for (const auto &childFileInfo : dirInfo.children) {
+            writeFileResponse(childFileInfo);
+            if (depthInfinity && childFileInfo.isDir)
+                writeChildrenResponses(childFileInfo);
+        }
+    };
+
     writeFileResponse(*fileInfo);
-    foreach (const FileInfo &childFileInfo, fileInfo->children)
-        writeFileResponse(childFileInfo);
+    writeChildrenResponses(*fileInfo);
     xml.writeEndElement(); // multistatus
     xml.writeEndDocument();
 
@@ -655,6 +664,85 @@ void FakeMoveReply::respond()
     emit finished();
 }
 
+FakeCopyReply::FakeCopyReply(FileInfo &remoteRootFileInfo, QNetworkAccessManager::Operation op, const QNetworkRequest &request, QObject *parent)
+    : FakeReply { parent }
+{
+    setRequest(request);
+    setUrl(request.url());
+    setOperation(op);
+    open(QIODevice::ReadOnly);
+
+    QString fileName = getFilePathFromUrl(request.url());
+    Q_ASSERT(!fileName.isEmpty());
+    QString dest = getFilePathFromUrl(QUrl::fromEncoded(request.rawHeader("Destination")));
+    Q_ASSERT(!dest.isEmpty());
+
+    const FileInfo *source = remoteRootFileInfo.find(fileName);
+    if (!source || source->isDir) {
+        _httpStatus = 404;
+    } else if (request.hasRawHeader("If-Match") && request.rawHeader("If-Match") != '"' + source->etag + '"') {
+        _httpStatus = 412;
+    } else if (request.rawHeader("Overwrite") == "F" && remoteRootFileInfo.find(dest)) {
+        _httpStatus = 412;
+    } else {
+        const auto size = source->size;
+        const auto contentChar = source->contentChar;
+        const auto checksums = source->checksums;
+        const auto lastModified = source->lastModified;
+        auto fileInfo = remoteRootFileInfo.create(dest, size, contentChar);
+        fileInfo->checksums = checksums;
+        // Like the server, ignore X-OC-Mtime
+        fileInfo->lastModified = lastModified;
+        remoteRootFileInfo.find(dest, /*invalidateEtags=*/true);
+    }
+    QMetaObject::invokeMethod(this, "respond", Qt::QueuedConnection);
+}
+
+void FakeCopyReply::respond()
+{
+    setAttribute(QNetworkRequest::HttpStatusCodeAttribute, _httpStatus);
+    if (_httpStatus == 404) {
+        setError(ContentNotFoundError, QStringLiteral("Not found"));
+    } else if (_httpStatus != 201) {
+        setError(InternalServerError, QStringLiteral("Precondition failed"));
+    }
+    emit metaDataChanged();
+    emit finished();
+}
+
+FakeProppatchReply::FakeProppatchReply(FileInfo &remoteRootFileInfo, QNetworkAccessManager::Operation op, const QNetworkRequest &request, const QByteArray &body, QObject *parent)
+    : FakeReply { parent }
+{
+    setRequest(request);
+    setUrl(request.url());
+    setOperation(op);
+    open(QIODevice::ReadOnly);
+
+    QString fileName = getFilePathFromUrl(request.url());
+    Q_ASSERT(!fileName.isEmpty());
+    if (!remoteRootFileInfo.find(fileName)) {
+        _httpStatus = 404;
+    } else {
+        // Only the modification time is supported
+        const auto match = QRegularExpression(QStringLiteral("<lastmodified[^>]*>(\\d+)</lastmodified>")).match(QString::fromUtf8(body));
+        if (match.hasMatch()) {
+            auto fileInfo = remoteRootFileInfo.find(fileName, /*invalidateEtags=*/true);
+            fileInfo->lastModified = OCC::Utility::qDateTimeFromTime_t(match.captured(1).toLongLong());
+        }
+    }
+    QMetaObject::invokeMethod(this, "respond", Qt::QueuedConnection);
+}
+
+void FakeProppatchReply::respond()
+{
+    setAttribute(QNetworkRequest::HttpStatusCodeAttribute, _httpStatus);
+    if (_httpStatus == 404) {
+        setError(ContentNotFoundError, QStringLiteral("Not found"));
+    }
+    emit metaDataChanged();
+    emit finished();
+}
+
 FakeGetReply::FakeGetReply(FileInfo &remoteRootFileInfo, QNetworkAccessManager::Operation op, const QNetworkRequest &request, QObject *parent)
     : FakeReply { parent }
 {
@@ -1070,6 +1158,10 @@ QNetworkReply *FakeQNAM::createRequest(QNetworkAccessManager::Operation op, cons
             reply = new FakeMoveReply { info, op, newRequest, this };
         } else if (verb == QLatin1String("MOVE") && isUpload) {
             reply = new FakeChunkMoveReply { info, _remoteRootFileInfo, op, newRequest, this };
+        } else if (verb == QLatin1String("COPY")) {
+            reply = new FakeCopyReply { info, op, newRequest, this };
+        } else if (verb == QLatin1String("PROPPATCH")) {
+            reply = new FakeProppatchReply { info, op, newRequest, outgoingData->readAll(), this };
         } else if (verb == QLatin1String("POST") || op == QNetworkAccessManager::PostOperation) {
             if (contentType.startsWith(QStringLiteral("multipart/related; boundary="))) {
                 reply = new FakePutMultiFileReply { info, op, newRequest, contentType, outgoingData->readAll(), this };
@@ -217,7 +217,7 @@ public:
     explicit FakePropfindReply(FileInfo &remoteRootFileInfo, QNetworkAccessManager::Operation op, const QNetworkRequest &request, QObject *parent);
     explicit FakePropfindReply(const QByteArray &replyContents, QNetworkAccessManager::Operation op, const QNetworkRequest &request, QObject *parent);
 
-    Q_INVOKABLE void respond();
+    Q_INVOKABLE virtual void respond();
 
     Q_INVOKABLE void respond404();
 
@@ -300,6 +300,36 @@ public:
     qint64 readData(char *, qint64) override { return 0; }
 };
 
+class FakeCopyReply : public FakeReply
+{
+    Q_OBJECT
+public:
+    FakeCopyReply(FileInfo &remoteRootFileInfo, QNetworkAccessManager::Operation op, const QNetworkRequest &request, QObject *parent);
+
+    Q_INVOKABLE void respond();
+
+    void abort() override { }
+    qint64 readData(char *, qint64) override { return 0; }
+
+private:
+    int _httpStatus = 201;
+};
+
+class FakeProppatchReply : public FakeReply
+{
+    Q_OBJECT
+public:
+    FakeProppatchReply(FileInfo &remoteRootFileInfo, QNetworkAccessManager::Operation op, const QNetworkRequest &request, const QByteArray &body, QObject *parent);
+
+    Q_INVOKABLE void respond();
+
+    void abort() override { }
+    qint64 readData(char *, qint64) override { return 0; }
+
+private:
+    int _httpStatus = 207;
+};
+
 class FakeGetReply : public FakeReply
 {
     Q_OBJECT
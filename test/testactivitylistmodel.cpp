@@ -561,6 +561,40 @@ private slots:
         testActivityAdd(&TestingALM::addSyncFileItemToActivityList, testSyncFileItemActivity);
     };
 
+    void testSyncFileItemActivitiesAreBounded() {
+        const auto model = testingALM();
+        QCOMPARE(model->rowCount(), 0);
+        const auto maxActivities = OCC::ActivityListModel::maxSyncFileItemActivities();
+
+        OCC::ActivityList activities;
+        for (int i = 0; i < maxActivities + 50; ++i) {
+            auto activity = testSyncFileItemActivity;
+            activity._folder = QStringLiteral("thingy");
+            activity._file = QStringLiteral("file%1").arg(i);
+            activities.append(activity);
+        }
+        model->addSyncFileItemsToActivityList(activities);
+        model->addErrorToActivityList(testSyncResultErrorActivity, OCC::ActivityListModel::ErrorType::SyncError);
+
+        // The newest ones are kept, plus a summary of the others
+        QCOMPARE(model->rowCount(), maxActivities + 2);
+        QCOMPARE(model->activityList().first()._file, QStringLiteral("file50"));
+        const auto summary = model->activityList().at(maxActivities);
+        QCOMPARE(summary._folder, QStringLiteral("thingy"));
+        QVERIFY(summary._subject.contains(QStringLiteral("50")));
+
+        // Older rows make room for new ones, the errors stay
+        auto activity = testSyncFileItemActivity;
+        activity._folder = QStringLiteral("thingy");
+        activity._file = QStringLiteral("newest");
+        model->addSyncFileItemToActivityList(activity);
+        QCOMPARE(model->rowCount(), maxActivities + 2);
+        QCOMPARE(model->activityList().first()._file, QStringLiteral("file51"));
+        QCOMPARE(model->activityList().last()._file, QStringLiteral("newest"));
+        QVERIFY(model->activityList().at(maxActivities - 1)._subject.contains(QStringLiteral("51")));
+        QCOMPARE(model->activityList().at(maxActivities)._subject, testSyncResultErrorActivity._subject);
+    }
+
     void testAddNotification() {
         testActivityAdd(&TestingALM::addNotificationToActivityList, testNotificationActivity);
     };
@@ -0,0 +1,366 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include <QtTest>
+#include "syncenginetestutils.h"
+#include "bandwidthmanager.h"
+#include "owncloudpropagator.h"
+#include <syncengine.h>
+
+using namespace OCC;
+using namespace std::chrono_literals;
+
+static constexpr qint64 kB = 1000;
+
+/*
+ * Takes in the upload like QNAM does, reading the device whenever it has
+ * data. The progress is reported at @a bytesPerSecond, the speed of the
+ * simulated link, or as soon as the data was read if that is 0. Ahead of
+ * the link, at most @a bufferBytes are read, or everything if that is -1.
+ */
+class ShapedPutReply : public FakeReply
+{
+    Q_OBJECT
+public:
+    ShapedPutReply(FileInfo &remoteRootFileInfo, QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *device, qint64 bytesPerSecond, qint64 bufferBytes, QObject *parent)
+        : FakeReply{parent}
+        , _remoteRootFileInfo(remoteRootFileInfo)
+        , _device(device)
+        , _bytesPerSecond(bytesPerSecond)
+        , _bufferBytes(bufferBytes)
+    {
+        setRequest(request);
+        setUrl(request.url());
+        setOperation(op);
+        open(QIODevice::ReadOnly);
+        connect(device, &QIODevice::readyRead, this, &ShapedPutReply::readPayload);
+        QMetaObject::invokeMethod(this, &ShapedPutReply::readPayload, Qt::QueuedConnection);
+        if (_bytesPerSecond > 0) {
+            connect(&_linkTimer, &QTimer::timeout, this, [this] {
+                _sent = qMin(qint64(_payload.size()), _sent + _bytesPerSecond * _linkTimer.interval() / 1000);
+                readPayload();
+                reportProgress();
+            });
+            _linkTimer.start(20);
+        }
+    }
+
+    void abort() override
+    {
+        _linkTimer.stop();
+        setError(OperationCanceledError, QStringLiteral("abort"));
+        emit finished();
+    }
+
+    qint64 readData(char *, qint64) override { return 0; }
+
+private:
+    void readPayload()
+    {
+        if (!_device) {
+            return;
+        }
+        while (_bufferBytes < 0 || _payload.size() < _sent + _bufferBytes) {
+            const auto wanted = _bufferBytes < 0 ? 64 * 1024 : qMin(qint64(64 * 1024), _sent + _bufferBytes - _payload.size());
+            const auto data = _device->read(wanted);
+            if (data.isEmpty()) {
+                break;
+            }
+            _payload += data;
+        }
+        if (_bytesPerSecond == 0) {
+            _sent = _payload.size();
+            reportProgress();
+        }
+    }
+
+    void reportProgress()
+    {
+        if (!_device || isFinished()) {
+            return;
+        }
+        const auto total = _device->size();
+        if (_sent > 0) {
+            emit uploadProgress(_sent, total);
+        }
+        if (_sent < total) {
+            return;
+        }
+
+        _linkTimer.stop();
+        const auto fileInfo = FakePutReply::perform(_remoteRootFileInfo, request(), _payload);
+        setRawHeader("OC-ETag", fileInfo->etag);
+        setRawHeader("ETag", fileInfo->etag);
+        setRawHeader("OC-FileID", fileInfo->fileId);
+        setRawHeader("X-OC-MTime", "accepted");
+        setAttribute(QNetworkRequest::HttpStatusCodeAttribute, 200);
+        setFinished(true);
+        emit metaDataChanged();
+        emit finished();
+    }
+
+    FileInfo &_remoteRootFileInfo;
+    QPointer<QIODevice> _device;
+    qint64 _bytesPerSecond;
+    qint64 _bufferBytes;
+    QByteArray _payload;
+    qint64 _sent = 0;
+    QTimer _linkTimer;
+};
+
+static void shapeUploads(FakeFolder &fakeFolder, QObject *parent, qint64 bytesPerSecond)
+{
+    fakeFolder.setServerOverride([&fakeFolder, parent, bytesPerSecond](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *device) -> QNetworkReply * {
+        if (op == QNetworkAccessManager::PutOperation || request.attribute(QNetworkRequest::CustomVerbAttribute) == "PUT") {
+            return new ShapedPutReply(fakeFolder.remoteModifier(), op, request, device, bytesPerSecond, -1, parent);
+        }
+        return nullptr;
+    });
+}
+
+// Samples the upload rate of the running sync's bandwidth manager
+static void sampleUploadRate(FakeFolder &fakeFolder, QTimer &sampler, const std::function<void(qint64)> &sample)
+{
+    QObject::connect(&sampler, &QTimer::timeout, &sampler, [&fakeFolder, sample] {
+        if (const auto propagator = fakeFolder.syncEngine().getPropagator()) {
+            sample(propagator->_bandwidthManager.uploadRate());
+        }
+    });
+    sampler.start(10);
+}
+
+class TestBandwidthManager : public QObject
+{
+    Q_OBJECT
+
+    qint64 _now = 0;
+
+    TokenBucket fakeClockBucket()
+    {
+        return TokenBucket([this] { return _now; });
+    }
+
+private slots:
+    void init()
+    {
+        _now = 0;
+        BandwidthManager::relativeLimitMeasuringInterval = 2s;
+        BandwidthManager::relativeLimitLimitingInterval = 20s;
+        BandwidthManager::latencyProbeInterval = 2s;
+        BandwidthManager::latencyProbeTimeout = 10s;
+    }
+
+    void testUnlimitedBucket()
+    {
+        auto bucket = fakeClockBucket();
+        QCOMPARE(bucket.take(1000 * kB), 1000 * kB);
+        QCOMPARE(bucket.msecsUntilAvailable(1000 * kB), qint64(0));
+
+        bucket.setRate(100 * kB);
+        bucket.setRate(0);
+        QCOMPARE(bucket.take(1000 * kB), 1000 * kB);
+    }
+
+    void testBucketCapacity()
+    {
+        auto bucket = fakeClockBucket();
+        // A quarter second of quota, available right away
+        bucket.setRate(400 * kB);
+        QCOMPARE(bucket.capacity(), 100 * kB);
+        QCOMPARE(bucket.available(), 100 * kB);
+
+        // Lowering the rate doesn't keep more than the new capacity
+        bucket.setRate(100 * kB);
+        QCOMPARE(bucket.capacity(), 25 * kB);
+        QCOMPARE(bucket.available(), 25 * kB);
+
+        // Low rates still allow for a burst of 16 KiB
+        bucket.setRate(kB);
+        QCOMPARE(bucket.capacity(), qint64(16 * 1024));
+        QCOMPARE(bucket.available(), qint64(16 * 1024));
+    }
+
+    void testBucketRefill()
+    {
+        auto bucket = fakeClockBucket();
+        bucket.setRate(100 * kB);
+        QCOMPARE(bucket.take(30 * kB), 25 * kB);
+        QCOMPARE(bucket.available(), qint64(0));
+        QCOMPARE(bucket.take(kB), qint64(0));
+
+        _now += std::chrono::nanoseconds(100ms).count();
+        QCOMPARE(bucket.available(), 10 * kB);
+
+        // Less than the minimum isn't handed out, unless less is wanted
+        QCOMPARE(bucket.take(20 * kB, 12 * kB), qint64(0));
+        QCOMPARE(bucket.take(5 * kB, 12 * kB), 5 * kB);
+        QCOMPARE(bucket.take(20 * kB, 4096), 5 * kB);
+
+        // Refilling stops at the capacity
+        _now += std::chrono::nanoseconds(10s).count();
+        QCOMPARE(bucket.available(), 25 * kB);
+    }
+
+    void testBucketWaitTime()
+    {
+        auto bucket = fakeClockBucket();
+        bucket.setRate(100 * kB);
+        QCOMPARE(bucket.msecsUntilAvailable(4096), qint64(0));
+        QCOMPARE(bucket.take(25 * kB), 25 * kB);
+
+        QCOMPARE(bucket.msecsUntilAvailable(4096), qint64(41));
+        _now += std::chrono::nanoseconds(20ms).count();
+        QCOMPARE(bucket.msecsUntilAvailable(4096), qint64(21));
+
+        // Never waits for more than a full bucket
+        QCOMPARE(bucket.msecsUntilAvailable(1000 * kB), qint64(230));
+    }
+
+    void testUploadLimit()
+    {
+        FakeFolder fakeFolder{FileInfo{}};
+        for (int i = 0; i < 4; ++i) {
+            fakeFolder.localModifier().insert(QStringLiteral("file%1").arg(i), 50 * 1000);
+        }
+        QObject parent;
+        shapeUploads(fakeFolder, &parent, 0);
+        // 200 kB/s allow a burst of 50 kB, the other 150 kB take at least 750 ms
+        fakeFolder.syncEngine().setNetworkLimits(200 * 1000, 0);
+
+        QElapsedTimer timer;
+        timer.start();
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QVERIFY(timer.elapsed() >= 600);
+    }
+
+    void testRelativeUploadLimitMeasuresSentBytes()
+    {
+        BandwidthManager::relativeLimitMeasuringInterval = 300ms;
+        BandwidthManager::relativeLimitLimitingInterval = 500ms;
+
+        FakeFolder fakeFolder{FileInfo{}};
+        fakeFolder.localModifier().insert(QStringLiteral("file"), 1000 * 1000);
+        QObject parent;
+        // The link takes 1 MB/s, while the device could be read all at once
+        shapeUploads(fakeFolder, &parent, 1000 * 1000);
+        fakeFolder.syncEngine().setNetworkLimits(-50, 0);
+
+        qint64 maximumRate = 0;
+        QTimer sampler;
+        sampleUploadRate(fakeFolder, sampler, [&](qint64 rate) { maximumRate = qMax(maximumRate, rate); });
+
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+
+        // 50% on average, counting the unlimited 300 ms, leave 20% of the
+        // measured 1 MB/s for the 500 ms in between. Measuring the bytes read
+        // from the device would have seen several MB/s.
+        QVERIFY(maximumRate > 0);
+        QVERIFY(maximumRate <= 250 * kB);
+    }
+
+    void testAdaptiveUploadLimit_data()
+    {
+        QTest::addColumn<bool>("congested");
+        QTest::newRow("congested") << true;
+        QTest::newRow("idle link") << false;
+    }
+
+    void testAdaptiveUploadLimit()
+    {
+        QFETCH(bool, congested);
+        BandwidthManager::latencyProbeInterval = 100ms;
+
+        FakeFolder fakeFolder{FileInfo{}};
+        fakeFolder.localModifier().insert(QStringLiteral("file"), 1000 * kB);
+        fakeFolder.syncEngine().setNetworkLimits(BandwidthSchedule::AdaptiveLimit, 0);
+
+        QObject parent;
+        int probes = 0;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *device) -> QNetworkReply * {
+            if (request.url().path().endsWith(QLatin1String("/status.php"))) {
+                ++probes;
+                // The first probe sees the idle link, the second one queues up behind the upload
+                const auto delay = congested && probes == 2 ? 300 : 0;
+                return new FakePayloadReply(op, request, QByteArrayLiteral("{}"), delay, &parent);
+            }
+            if (op == QNetworkAccessManager::PutOperation || request.attribute(QNetworkRequest::CustomVerbAttribute) == "PUT") {
+                // A link of 1 MB/s, with the buffers in between
+                return new ShapedPutReply(fakeFolder.remoteModifier(), op, request, device, 1000 * kB, 64 * kB, &parent);
+            }
+            return nullptr;
+        });
+
+        qint64 firstRate = 0;
+        QTimer sampler;
+        sampleUploadRate(fakeFolder, sampler, [&](qint64 rate) {
+            if (firstRate == 0) {
+                firstRate = rate;
+            }
+        });
+
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QVERIFY(probes >= 2);
+        if (congested) {
+            // Backed off to 70% of the throughput, which the link keeps at 1 MB/s
+            QVERIFY(firstRate > 0);
+            QVERIFY(firstRate <= 750 * kB);
+        } else {
+            QCOMPARE(firstRate, qint64(0));
+        }
+    }
+
+    void testAdaptiveUploadLimitWithAllConnectionsBusy()
+    {
+        BandwidthManager::latencyProbeInterval = 100ms;
+        BandwidthManager::latencyProbeTimeout = 200ms;
+
+        // Six small uploads run at once and take up every HTTP/1.1 connection
+        FakeFolder fakeFolder{FileInfo{}};
+        for (int i = 0; i < 6; ++i) {
+            fakeFolder.localModifier().insert(QStringLiteral("file%1").arg(i), 50 * kB);
+        }
+        fakeFolder.syncEngine().setNetworkLimits(BandwidthSchedule::AdaptiveLimit, 0);
+
+        QObject parent;
+        int runningPuts = 0;
+        int queuedProbes = 0;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *device) -> QNetworkReply * {
+            if (request.url().path().endsWith(QLatin1String("/status.php"))) {
+                // Like QNAM, a request beyond the connection limit waits for a transfer
+                // to finish, far longer than the probe may take
+                const auto queued = runningPuts >= 6;
+                queuedProbes += queued ? 1 : 0;
+                return new FakePayloadReply(op, request, QByteArrayLiteral("{}"), queued ? 2000 : 0, &parent);
+            }
+            if (op == QNetworkAccessManager::PutOperation || request.attribute(QNetworkRequest::CustomVerbAttribute) == "PUT") {
+                // An idle link of 50 kB/s per connection
+                auto reply = new ShapedPutReply(fakeFolder.remoteModifier(), op, request, device, 50 * kB, -1, &parent);
+                ++runningPuts;
+                connect(reply, &QNetworkReply::finished, &parent, [&runningPuts] { --runningPuts; });
+                return reply;
+            }
+            return nullptr;
+        });
+
+        qint64 maximumRate = 0;
+        QTimer sampler;
+        sampleUploadRate(fakeFolder, sampler, [&](qint64 rate) { maximumRate = qMax(maximumRate, rate); });
+
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+
+        // Nothing waited for a connection, and the idle link wasn't limited
+        QCOMPARE(queuedProbes, 0);
+        QCOMPARE(maximumRate, qint64(0));
+    }
+};
+
+QTEST_GUILESS_MAIN(TestBandwidthManager)
+#include "testbandwidthmanager.moc"
@@ -0,0 +1,71 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include <QtTest>
+
+#include "bandwidthschedule.h"
+
+using namespace OCC;
+
+class TestBandwidthSchedule : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testParse()
+    {
+        const auto schedule = BandwidthSchedule::fromString(QStringLiteral("09:00-17:00=100, 17:00-22:00=50%,22:00-23:00=adaptive"));
+        QCOMPARE(schedule.entries().size(), 3);
+        QCOMPARE(schedule.entries().at(0).start, QTime(9, 0));
+        QCOMPARE(schedule.entries().at(0).end, QTime(17, 0));
+        QCOMPARE(schedule.entries().at(0).limit, 100000);
+        QCOMPARE(schedule.entries().at(1).limit, -50);
+        QCOMPARE(schedule.entries().at(2).limit, BandwidthSchedule::AdaptiveLimit);
+        QCOMPARE(schedule.toString(), QStringLiteral("09:00-17:00=100,17:00-22:00=50%,22:00-23:00=adaptive"));
+
+        QVERIFY(BandwidthSchedule::fromString(QString()).isEmpty());
+    }
+
+    void testMalformedEntries()
+    {
+        const auto schedule = BandwidthSchedule::fromString(
+            QStringLiteral("9-17=100,09:00-17:00,09:00=100,25:00-26:00=100,09:00-17:00=fast,09:00-17:00=150%,09:00-17:00=-5,10:00-11:00=0"));
+        QCOMPARE(schedule.toString(), QStringLiteral("10:00-11:00=0"));
+
+        // Relative limits only work between 10% and 90%
+        QVERIFY(BandwidthSchedule::fromString(QStringLiteral("09:00-17:00=100%")).isEmpty());
+        QVERIFY(BandwidthSchedule::fromString(QStringLiteral("09:00-17:00=5%")).isEmpty());
+        QCOMPARE(BandwidthSchedule::fromString(QStringLiteral("09:00-17:00=90%")).entries().size(), 1);
+
+        // The limit in bytes has to fit
+        QCOMPARE(BandwidthSchedule::fromString(QStringLiteral("09:00-17:00=2147483")).entries().at(0).limit, 2147483000);
+        QVERIFY(BandwidthSchedule::fromString(QStringLiteral("09:00-17:00=2147484")).isEmpty());
+        QVERIFY(BandwidthSchedule::fromString(QStringLiteral("09:00-17:00=99999999999")).isEmpty());
+    }
+
+    void testLimitAt()
+    {
+        const auto schedule = BandwidthSchedule::fromString(QStringLiteral("12:00-13:00=10,09:00-17:00=100,22:00-06:00=0"));
+
+        QCOMPARE(schedule.limitAt(QTime(8, 59)), std::optional<int>());
+        QCOMPARE(schedule.limitAt(QTime(9, 0)), std::optional<int>(100000));
+        // the first matching entry wins
+        QCOMPARE(schedule.limitAt(QTime(12, 30)), std::optional<int>(10000));
+        // the end is exclusive
+        QCOMPARE(schedule.limitAt(QTime(17, 0)), std::optional<int>());
+        // wraps around midnight
+        QCOMPARE(schedule.limitAt(QTime(23, 0)), std::optional<int>(0));
+        QCOMPARE(schedule.limitAt(QTime(3, 0)), std::optional<int>(0));
+        QCOMPARE(schedule.limitAt(QTime(6, 0)), std::optional<int>());
+
+        QCOMPARE(schedule.effectiveLimit(QTime(18, 0), -75), -75);
+        QCOMPARE(schedule.effectiveLimit(QTime(10, 0), -75), 100000);
+    }
+};
+
+QTEST_APPLESS_MAIN(TestBandwidthSchedule)
+#include "testbandwidthschedule.moc"
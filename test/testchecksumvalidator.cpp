@@ -220,6 +220,45 @@ using namespace OCC::Utility;
 #endif
     }
 
+    void testChecksumCalculator()
+    {
+        QFile file(_testfile);
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        const auto data = file.readAll();
+
+        QList<QByteArray> types = {checkSumMD5C, checkSumSHA1C, checkSumSHA2C};
+#ifdef ZLIB_FOUND
+        types.append(checkSumAdlerC);
+#endif
+        for (const auto &type : types) {
+            // Fed in uneven pieces like a download
+            ChecksumCalculator calculator(type);
+            QVERIFY(calculator.isValid());
+            for (qint64 pos = 0; pos < data.size(); pos += 7001) {
+                calculator.addData(data.constData() + pos, qMin(qint64(7001), data.size() - pos));
+            }
+            QCOMPARE(calculator.result(), ComputeChecksum::computeNowOnFile(_testfile, type));
+        }
+
+        QVERIFY(!ChecksumCalculator("Klaas32").isValid());
+    }
+
+    void testValidateComputedChecksum()
+    {
+        ValidateChecksumHeader vali;
+        connect(&vali, &ValidateChecksumHeader::validated, this, &TestChecksumValidator::slotDownValidated);
+        connect(&vali, &ValidateChecksumHeader::validationFailed, this, &TestChecksumValidator::slotDownError);
+
+        _successDown = false;
+        vali.validate("SHA1:abcd", checkSumSHA1C, "abcd");
+        QVERIFY(_successDown);
+
+        _expectedError = QStringLiteral("The downloaded file does not match the checksum, it will be resumed. \"abcd\" != \"ef01\"");
+        _expectedFailureReason = ValidateChecksumHeader::FailureReason::ChecksumMismatch;
+        _errorSeen = false;
+        vali.validate("SHA1:abcd", checkSumSHA1C, "ef01");
+        QVERIFY(_errorSeen);
+    }
 
     void cleanupTestCase() {
     }
@@ -8,9 +8,30 @@
 #include <QtTest>
 #include "syncenginetestutils.h"
 #include <syncengine.h>
+#include <blocksignature.h>
+#include "common/checksums.h"
 
 using namespace OCC;
 
+static QByteArray randomContents(qint64 size, quint32 seed)
+{
+    QRandomGenerator generator(seed);
+    QByteArray contents;
+    contents.reserve(size);
+    while (contents.size() < size) {
+        const auto value = generator.generate();
+        contents.append(reinterpret_cast<const char *>(&value), static_cast<int>(qMin<qint64>(sizeof(value), size - contents.size())));
+    }
+    return contents;
+}
+
+static void writeFile(const QString &path, const QByteArray &contents)
+{
+    QFile file(path);
+    QVERIFY(file.open(QFile::WriteOnly | QFile::Truncate));
+    QCOMPARE(file.write(contents), static_cast<qint64>(contents.size()));
+}
+
 /* Upload a 1/3 of a file of given size.
  * fakeFolder needs to be synchronized */
 static void partialUpload(FakeFolder &fakeFolder, const QString &name, qint64 size)
@@ -75,6 +96,41 @@ private slots:
         QCOMPARE(fakeFolder.uploadState().children.count(), 2); // the transfer was done with chunking
     }
 
+    // The checksums are computed from the sent data and go into the MOVE
+    void testChecksumsComputedWhileUploading() {
+        FakeFolder fakeFolder{FileInfo::A12_B12_C12_S12()};
+        fakeFolder.syncEngine().account()->setCapabilities({ { "dav", QVariantMap{ {"chunking", "1.0"} } }, { "checksums", QVariantMap{ { "supportedTypes", QStringList() << "SHA1" } } } });
+        setChunkSize(fakeFolder.syncEngine(), 1 * 1000 * 1000);
+        const int size = 10 * 1000 * 1000; // 10 MB
+
+        QByteArray moveChecksumHeader;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (request.attribute(QNetworkRequest::CustomVerbAttribute) == "MOVE") {
+                moveChecksumHeader = request.rawHeader("OC-Checksum");
+            }
+            return nullptr;
+        });
+        const auto expectedChecksumHeader = [&](const QString &path) {
+            return QByteArray("SHA1:") + ComputeChecksum::computeNowOnFile(QDir(fakeFolder.localPath()).filePath(path), "SHA1");
+        };
+
+        fakeFolder.localModifier().insert("A/a0", size);
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCOMPARE(moveChecksumHeader, expectedChecksumHeader("A/a0"));
+        SyncJournalFileRecord record;
+        QVERIFY(fakeFolder.syncJournal().getFileRecord(QByteArray("A/a0"), &record));
+        QCOMPARE(record._checksumHeader, moveChecksumHeader);
+
+        // A resumed upload didn't send all data, the checksums are computed from the file then
+        moveChecksumHeader.clear();
+        fakeFolder.uploadState().children.clear(); // the finished transfer is kept around
+        partialUpload(fakeFolder, "A/a5", size);
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCOMPARE(moveChecksumHeader, expectedChecksumHeader("A/a5"));
+    }
+
     // Test resuming when there's a confusing chunk added
     void testResume1() {
         FakeFolder fakeFolder{FileInfo::A12_B12_C12_S12()};
@@ -622,7 +678,131 @@ private slots:
         QCOMPARE(fakeFolder.currentRemoteState().find("A/a0")->size, size + 1);
     }
 
+    // Test that only the changed blocks of a modified file are uploaded again
+    void testDeltaUpload()
+    {
+        FakeFolder fakeFolder{FileInfo::A12_B12_C12_S12()};
+        fakeFolder.syncEngine().account()->setCapabilities({ { "dav", QVariantMap{ {"chunking", "1.0"}, {"delta_chunking", "1.0"} } } });
+        auto options = fakeFolder.syncEngine().syncOptions();
+        options._minDeltaUploadSize = 0;
+        fakeFolder.syncEngine().setSyncOptions(options);
+        const auto localFile = QDir(fakeFolder.localPath()).filePath(QStringLiteral("A/a0"));
+
+        // The fake server only keeps the size and the first character of files,
+        // so the contents of the chunks are recorded here
+        QMap<QString, QByteArray> chunkContents;
+        QByteArray uploaded;
+        int nPUT = 0;
+        int nCOPY = 0;
+        int nMOVE = 0;
+        int nMOVEKeepingChunks = 0;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *outgoingData) -> QNetworkReply * {
+            const auto path = getFilePathFromUrl(request.url());
+            const auto verb = request.attribute(QNetworkRequest::CustomVerbAttribute).toByteArray();
+            if (op == QNetworkAccessManager::PutOperation) {
+                ++nPUT;
+                const auto payload = outgoingData->readAll();
+                chunkContents[path] = payload;
+                return new FakePutReply(fakeFolder.uploadState(), op, request, QByteArray(payload.size(), 'W'), &fakeFolder.syncEngine());
+            } else if (verb == "COPY") {
+                ++nCOPY;
+                if (fakeFolder.uploadState().find(path)) {
+                    chunkContents[getFilePathFromUrl(QUrl::fromEncoded(request.rawHeader("Destination")))] = chunkContents.value(path);
+                }
+            } else if (verb == "MOVE") {
+                ++nMOVE;
+                // The chunks need to be kept for the next upload
+                if (request.rawHeader("OC-Keep-Chunks") == "1") {
+                    ++nMOVEKeepingChunks;
+                }
+                const auto chunkFolder = path.left(path.size() - QStringLiteral(".file").size());
+                uploaded.clear();
+                for (auto it = chunkContents.constBegin(); it != chunkContents.constEnd(); ++it) {
+                    if (it.key().startsWith(chunkFolder)) {
+                        uploaded += it.value();
+                    }
+                }
+            }
+            return nullptr;
+        });
 
+        // Random contents, starting with the character the fake server assumes
+        auto contents = randomContents(3 * BlockSignature::maxBlockSize - 1000, 1);
+        contents[0] = 'W';
+        writeFile(localFile, contents);
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCOMPARE(uploaded, contents);
+        const auto blockCount = BlockSignature::computeForFile(localFile).blocks().size();
+        QVERIFY(blockCount > 2);
+        QCOMPARE(nPUT, blockCount); // the chunks are the blocks
+        QCOMPARE(nCOPY, 0);
+        QCOMPARE(nMOVE, 1);
+        QCOMPARE(nMOVEKeepingChunks, 1);
+        QCOMPARE(fakeFolder.uploadState().children.count(), 1);
+
+        // Inserting data in the middle only changes the blocks around the insertion,
+        // the blocks after it are found again at their new offsets
+        nPUT = 0;
+        contents.insert(contents.size() / 2, randomContents(1000, 2));
+        writeFile(localFile, contents);
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCOMPARE(fakeFolder.currentRemoteState().find("A/a0")->size, static_cast<qint64>(contents.size()));
+        QCOMPARE(uploaded, contents);
+        const auto newBlockCount = BlockSignature::computeForFile(localFile).blocks().size();
+        QVERIFY(nPUT >= 1);
+        QVERIFY(nPUT <= 2);
+        QCOMPARE(nPUT + nCOPY, newBlockCount);
+        QVERIFY(nCOPY >= blockCount - 2);
+        QCOMPARE(nMOVEKeepingChunks, 2);
+        // The chunks of the previous version were deleted
+        QCOMPARE(fakeFolder.uploadState().children.count(), 1);
+
+        // When the kept chunks are gone, the blocks are uploaded
+        nPUT = 0;
+        nCOPY = 0;
+        fakeFolder.uploadState().children.clear();
+        contents.append(randomContents(10, 3));
+        writeFile(localFile, contents);
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCOMPARE(uploaded, contents);
+        QCOMPARE(nPUT, BlockSignature::computeForFile(localFile).blocks().size());
+    }
+
+    // Large files use bigger blocks so they don't exceed the chunk count limit
+    void testDeltaUploadBlockSizeScaling()
+    {
+        const qint64 fiveGB = BlockSignature::minBlockSize * BlockSignature::maxBlockCount;
+        QCOMPARE(BlockSignature::blockSizeShiftForSize(0), 0);
+        QCOMPARE(BlockSignature::blockSizeShiftForSize(fiveGB - 1), 0);
+        QCOMPARE(BlockSignature::blockSizeShiftForSize(fiveGB), 1);
+        QCOMPARE(BlockSignature::blockSizeShiftForSize(4 * fiveGB), 3);
+        for (const qint64 size : { fiveGB - 1, fiveGB, 5 * fiveGB, 200 * fiveGB }) {
+            const auto shift = BlockSignature::blockSizeShiftForSize(size);
+            // Every block but the last one has at least the minimum size
+            QVERIFY(size / (BlockSignature::minBlockSize << shift) + 1 <= BlockSignature::maxBlockCount);
+        }
+
+        auto contents = randomContents(4 * BlockSignature::maxBlockSize, 4);
+        QBuffer buffer(&contents);
+        QVERIFY(buffer.open(QIODevice::ReadOnly));
+        const auto signature = BlockSignature::compute(&buffer, 1);
+        QVERIFY(signature.isValid());
+        QCOMPARE(signature.size(), static_cast<qint64>(contents.size()));
+        const auto &blocks = signature.blocks();
+        for (int i = 0; i < blocks.size() - 1; ++i) {
+            QVERIFY(blocks[i].size >= 2 * BlockSignature::minBlockSize);
+            QVERIFY(blocks[i].size <= 2 * BlockSignature::maxBlockSize);
+        }
+
+        // The scale is part of the stored signature
+        const auto restored = BlockSignature::deserialize(signature.serialize());
+        QVERIFY(restored.isValid());
+        QCOMPARE(restored.blockSizeShift(), 1);
+        QCOMPARE(restored.blocks().size(), blocks.size());
+    }
 };
 
 QTEST_GUILESS_MAIN(TestChunkingNG)
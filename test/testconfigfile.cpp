@@ -0,0 +1,84 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include <QTemporaryDir>
+#include <QtTest>
+
+#include "configfile.h"
+
+using namespace OCC;
+using namespace std::chrono_literals;
+
+class TestConfigFile : public QObject
+{
+    Q_OBJECT
+
+    QTemporaryDir _confDir;
+
+private slots:
+    void initTestCase()
+    {
+        QVERIFY(_confDir.isValid());
+        QVERIFY(ConfigFile::setConfDir(_confDir.path())); // we don't want to pollute the user's config file
+    }
+
+    void testReadAfterWrite()
+    {
+        ConfigFile cfg;
+        QCOMPARE(cfg.moveToTrash(), false);
+        cfg.setMoveToTrash(true);
+        QCOMPARE(cfg.moveToTrash(), true);
+
+        // Other instances share the cached contents
+        cfg.setRemotePollInterval(42s);
+        QCOMPARE(ConfigFile().remotePollInterval(), std::chrono::milliseconds(42s));
+        ConfigFile().setRemotePollInterval(43s);
+        QCOMPARE(cfg.remotePollInterval(), std::chrono::milliseconds(43s));
+
+        cfg.storeData(QStringLiteral("TestGroup"), QStringLiteral("key"), 1);
+        QVERIFY(cfg.dataExists(QStringLiteral("TestGroup"), QStringLiteral("key")));
+        cfg.removeData(QStringLiteral("TestGroup"), QStringLiteral("key"));
+        QVERIFY(!cfg.dataExists(QStringLiteral("TestGroup"), QStringLiteral("key")));
+    }
+
+    void testWriteThroughSettingsWithGroup()
+    {
+        ConfigFile cfg;
+        QVERIFY(!cfg.retrieveData(QStringLiteral("OtherGroup"), QStringLiteral("key")).isValid());
+
+        auto settings = ConfigFile::settingsWithGroup(QStringLiteral("OtherGroup"));
+        settings->setValue(QStringLiteral("key"), 2);
+        settings.reset();
+        QCOMPARE(cfg.retrieveData(QStringLiteral("OtherGroup"), QStringLiteral("key")).toInt(), 2);
+    }
+
+    void testExternalChange()
+    {
+        ConfigFile cfg;
+        cfg.setMoveToTrash(false);
+        QCOMPARE(cfg.moveToTrash(), false);
+
+        // Written behind the back of ConfigFile, e.g. by another process
+        {
+            QSettings settings(cfg.configFile(), QSettings::IniFormat);
+            settings.setValue(QStringLiteral("moveToTrash"), true);
+            settings.sync();
+        }
+        ConfigFile::reloadSettings();
+        QCOMPARE(cfg.moveToTrash(), true);
+
+        // The config directory changed
+        QTemporaryDir otherConfDir;
+        QVERIFY(ConfigFile::setConfDir(otherConfDir.path()));
+        QCOMPARE(cfg.moveToTrash(), false);
+        QVERIFY(ConfigFile::setConfDir(_confDir.path()));
+        QCOMPARE(cfg.moveToTrash(), true);
+    }
+};
+
+QTEST_GUILESS_MAIN(TestConfigFile)
+#include "testconfigfile.moc"
@@ -0,0 +1,316 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include <QtTest>
+#include "syncenginetestutils.h"
+#include "clientsideencryption.h"
+#include <syncengine.h>
+
+using namespace OCC;
+
+/*
+ * Serves the end-to-end encryption API for the encrypted folders of a
+ * FakeFolder. The metadata is kept per folder id, the way the server does.
+ */
+class FakeE2eeServer
+{
+public:
+    explicit FakeE2eeServer(FakeFolder &fakeFolder)
+        : _fakeFolder(fakeFolder)
+    {
+        const auto account = fakeFolder.syncEngine().account();
+        account->setCapabilities({{QStringLiteral("end-to-end-encryption"), QVariantMap{{QStringLiteral("enabled"), true}, {QStringLiteral("api-version"), QStringLiteral("1.2")}}}});
+
+        QFile certificate(QStringLiteral("e2etestsfakecert.pem"));
+        if (certificate.open(QFile::ReadOnly)) {
+            account->e2e()->_certificate = QSslCertificate(certificate.readAll());
+        }
+        QFile publicKey(QStringLiteral("e2etestsfakecertpublickey.pem"));
+        if (publicKey.open(QFile::ReadOnly)) {
+            account->e2e()->_publicKey = QSslKey(publicKey.readAll(), QSsl::KeyAlgorithm::Rsa, QSsl::EncodingFormat::Pem, QSsl::KeyType::PublicKey);
+        }
+        QFile privateKey(QStringLiteral("e2etestsfakecertprivatekey.pem"));
+        if (privateKey.open(QFile::ReadOnly)) {
+            account->e2e()->_privateKey = privateKey.readAll();
+        }
+    }
+
+    [[nodiscard]] bool hasKeys() const
+    {
+        const auto account = _fakeFolder.syncEngine().account();
+        return !account->e2e()->_publicKey.isNull() && !account->e2e()->_privateKey.isEmpty();
+    }
+
+    /// Creates the encrypted folder @a path on the server, with metadata that lists no files
+    void mkdirEncrypted(const QString &path)
+    {
+        auto &remote = _fakeFolder.remoteModifier();
+        remote.mkdir(path);
+        remote.setE2EE(path, true);
+        const FolderMetadata metadata(_fakeFolder.syncEngine().account());
+        _metadata.insert(remote.find(path)->fileId, metadata.encryptedMetadata());
+    }
+
+    /// The original names of the files the stored metadata of @a path lists, sorted
+    [[nodiscard]] QStringList fileNames(const QString &path) const
+    {
+        const auto folderId = _fakeFolder.remoteModifier().find(path)->fileId;
+        const FolderMetadata metadata(_fakeFolder.syncEngine().account(), FolderMetadata::RequiredMetadataVersion::Version1_2, reply(_metadata.value(folderId)));
+        QStringList names;
+        const auto files = metadata.files();
+        for (const auto &file : files) {
+            names.append(file.originalFilename);
+        }
+        names.sort();
+        return names;
+    }
+
+    /// Answers the requests to the encryption API, nullptr for all others
+    QNetworkReply *handle(QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *outgoingData, QObject *parent)
+    {
+        const auto path = request.url().path();
+        const auto lockApi = QStringLiteral("/end_to_end_encryption/api/v1/lock/");
+        if (path.contains(lockApi)) {
+            if (op == QNetworkAccessManager::DeleteOperation) {
+                ++unlockCount;
+                return new FakePayloadReply(op, request, QByteArrayLiteral("{}"), parent);
+            }
+            ++lockCount;
+            const QJsonObject data{{QStringLiteral("e2e-token"), QStringLiteral("token%1").arg(lockCount)}};
+            const QJsonObject ocs{{QStringLiteral("data"), data}};
+            return new FakePayloadReply(op, request, QJsonDocument(QJsonObject{{QStringLiteral("ocs"), ocs}}).toJson(), parent);
+        }
+
+        const auto metadataApi = QStringLiteral("/end_to_end_encryption/api/v1/meta-data/");
+        const auto metadataApiPos = path.indexOf(metadataApi);
+        if (metadataApiPos < 0) {
+            return nullptr;
+        }
+
+        const auto folderId = path.mid(metadataApiPos + metadataApi.size()).toUtf8();
+        if (op == QNetworkAccessManager::GetOperation) {
+            ++getMetadataCount;
+            const auto metadata = _metadata.constFind(folderId);
+            if (metadata == _metadata.cend()) {
+                return new FakeErrorReply(op, request, parent, 404);
+            }
+            return new FakePayloadReply(op, request, reply(*metadata), parent);
+        }
+
+        // Stored with POST, updated with PUT
+        ++writeMetadataCount;
+        if (failMetadataWrites) {
+            return new FakeErrorReply(op, request, parent, 500);
+        }
+        const QUrlQuery body(QString::fromUtf8(outgoingData->readAll()));
+        _metadata.insert(folderId, body.queryItemValue(QStringLiteral("metaData"), QUrl::FullyDecoded).toUtf8());
+        return new FakePayloadReply(op, request, QByteArrayLiteral("{}"), metadataWriteDelay, parent);
+    }
+
+    int getMetadataCount = 0;
+    int writeMetadataCount = 0;
+    int lockCount = 0;
+    int unlockCount = 0;
+    bool failMetadataWrites = false;
+    int metadataWriteDelay = 0;
+
+private:
+    // The metadata wrapped like the server's reply
+    static QByteArray reply(const QByteArray &metadata)
+    {
+        const QJsonObject data{{QStringLiteral("meta-data"), QString::fromUtf8(metadata)}};
+        const QJsonObject ocs{{QStringLiteral("data"), data}};
+        return QJsonDocument(QJsonObject{{QStringLiteral("ocs"), ocs}}).toJson();
+    }
+
+    FakeFolder &_fakeFolder;
+    QHash<QByteArray, QByteArray> _metadata;
+};
+
+// Collects the uploads in "enc" reported as successful before the stored metadata listed them
+static void collectUnlistedSuccesses(FakeFolder &fakeFolder, const FakeE2eeServer &server, QStringList &files)
+{
+    QObject::connect(&fakeFolder.syncEngine(), &SyncEngine::itemCompleted, &fakeFolder.syncEngine(), [&server, &files](const SyncFileItemPtr &item) {
+        if (item->_file.startsWith(QLatin1String("enc/")) && item->_status == SyncFileItem::Success
+            && !server.fileNames(QStringLiteral("enc")).contains(item->_file.mid(4))) {
+            files.append(item->_file);
+        }
+    });
+}
+
+static bool hasRecord(FakeFolder &fakeFolder, const QString &path)
+{
+    SyncJournalFileRecord record;
+    return fakeFolder.syncJournal().getFileRecord(path, &record) && record.isValid();
+}
+
+class TestE2eeSync : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testUnchangedFolderUsesCachedMetadata()
+    {
+        FakeFolder fakeFolder{FileInfo{}};
+        FakeE2eeServer server(fakeFolder);
+        QVERIFY(server.hasKeys());
+        server.mkdirEncrypted(QStringLiteral("enc"));
+
+        QObject parent;
+        QStringList propfindPaths;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *device) -> QNetworkReply * {
+            if (request.attribute(QNetworkRequest::CustomVerbAttribute) == "PROPFIND") {
+                propfindPaths.append(getFilePathFromUrl(request.url()));
+            }
+            return server.handle(op, request, device, &parent);
+        });
+
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QVERIFY(propfindPaths.contains(QStringLiteral("enc")));
+        QCOMPARE(server.getMetadataCount, 1);
+
+        // Listed again, with the same etag
+        propfindPaths.clear();
+        fakeFolder.syncJournal().schedulePathForRemoteDiscovery(QStringLiteral("enc"));
+        QVERIFY(fakeFolder.syncOnce());
+        QVERIFY(propfindPaths.contains(QStringLiteral("enc")));
+        QCOMPARE(server.getMetadataCount, 1);
+
+        // A new etag means the metadata may have changed
+        propfindPaths.clear();
+        fakeFolder.remoteModifier().find(QStringLiteral("enc"), /*invalidateEtags=*/true);
+        QVERIFY(fakeFolder.syncOnce());
+        QVERIFY(propfindPaths.contains(QStringLiteral("enc")));
+        QCOMPARE(server.getMetadataCount, 2);
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+    }
+
+    void testUploadsInOneFolderShareTheLock()
+    {
+        FakeFolder fakeFolder{FileInfo{}};
+        FakeE2eeServer server(fakeFolder);
+        QVERIFY(server.hasKeys());
+        server.mkdirEncrypted(QStringLiteral("enc"));
+        QObject parent;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *device) {
+            return server.handle(op, request, device, &parent);
+        });
+        QVERIFY(fakeFolder.syncOnce());
+
+        QStringList names;
+        for (int i = 0; i < 5; ++i) {
+            names.append(QStringLiteral("file%1").arg(i));
+            fakeFolder.localModifier().insert(QStringLiteral("enc/") + names.last(), 100);
+        }
+        QStringList unlisted;
+        collectUnlistedSuccesses(fakeFolder, server, unlisted);
+        QVERIFY(fakeFolder.syncOnce());
+
+        // Every upload was reported after the metadata listing it was written
+        QCOMPARE(unlisted, QStringList());
+        QCOMPARE(server.lockCount, 1);
+        QCOMPARE(server.unlockCount, 1);
+        QVERIFY(server.writeMetadataCount >= 1);
+        QVERIFY(server.writeMetadataCount <= names.size());
+
+        // The metadata lists all files, the server only knows their encrypted names
+        QCOMPARE(server.fileNames(QStringLiteral("enc")), names);
+        auto remote = fakeFolder.currentRemoteState();
+        QCOMPARE(remote.find(QStringLiteral("enc"))->children.size(), names.size());
+        for (const auto &name : qAsConst(names)) {
+            QVERIFY(!remote.find(QStringLiteral("enc/") + name));
+            QVERIFY(hasRecord(fakeFolder, QStringLiteral("enc/") + name));
+        }
+    }
+
+    void testAbortKeepsJournalAndMetadataInStep()
+    {
+        FakeFolder fakeFolder{FileInfo{}};
+        FakeE2eeServer server(fakeFolder);
+        QVERIFY(server.hasKeys());
+        server.mkdirEncrypted(QStringLiteral("enc"));
+        QObject parent;
+        bool abortOnWrite = false;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *device) {
+            const auto writes = server.writeMetadataCount;
+            const auto reply = server.handle(op, request, device, &parent);
+            if (abortOnWrite && server.writeMetadataCount > writes) {
+                // Abort while the first write is on its way
+                abortOnWrite = false;
+                QTimer::singleShot(0, &fakeFolder.syncEngine(), [&fakeFolder] { fakeFolder.syncEngine().abort(); });
+            }
+            return reply;
+        });
+        QVERIFY(fakeFolder.syncOnce());
+
+        QStringList names;
+        for (int i = 0; i < 5; ++i) {
+            names.append(QStringLiteral("file%1").arg(i));
+            fakeFolder.localModifier().insert(QStringLiteral("enc/") + names.last(), 100);
+        }
+        QStringList unlisted;
+        collectUnlistedSuccesses(fakeFolder, server, unlisted);
+        server.metadataWriteDelay = 100;
+        abortOnWrite = true;
+        QVERIFY(!fakeFolder.syncOnce());
+
+        // Nothing was recorded that the metadata doesn't list
+        QCOMPARE(unlisted, QStringList());
+        const auto listed = server.fileNames(QStringLiteral("enc"));
+        for (const auto &name : qAsConst(names)) {
+            if (hasRecord(fakeFolder, QStringLiteral("enc/") + name)) {
+                QVERIFY(listed.contains(name));
+            }
+        }
+
+        // The next sync uploads the rest and releases all locks
+        server.metadataWriteDelay = 0;
+        QVERIFY(fakeFolder.syncJournal().wipeErrorBlacklist() != -1);
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(unlisted, QStringList());
+        QCOMPARE(server.fileNames(QStringLiteral("enc")), names);
+        for (const auto &name : qAsConst(names)) {
+            QVERIFY(hasRecord(fakeFolder, QStringLiteral("enc/") + name));
+        }
+        QCOMPARE(server.unlockCount, server.lockCount);
+    }
+
+    void testFailedMetadataWriteRemovesUpload()
+    {
+        FakeFolder fakeFolder{FileInfo{}};
+        FakeE2eeServer server(fakeFolder);
+        QVERIFY(server.hasKeys());
+        server.mkdirEncrypted(QStringLiteral("enc"));
+        QObject parent;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *device) {
+            return server.handle(op, request, device, &parent);
+        });
+        QVERIFY(fakeFolder.syncOnce());
+
+        fakeFolder.localModifier().insert(QStringLiteral("enc/file"), 100);
+        server.failMetadataWrites = true;
+        QVERIFY(!fakeFolder.syncOnce());
+
+        // Nobody could decrypt the uploaded file, it is gone again
+        QVERIFY(!hasRecord(fakeFolder, QStringLiteral("enc/file")));
+        QCOMPARE(server.fileNames(QStringLiteral("enc")), QStringList());
+        QVERIFY(fakeFolder.currentRemoteState().find(QStringLiteral("enc"))->children.isEmpty());
+        QCOMPARE(server.lockCount, 1);
+        QCOMPARE(server.unlockCount, 1);
+
+        server.failMetadataWrites = false;
+        QVERIFY(fakeFolder.syncJournal().wipeErrorBlacklist() != -1);
+        QVERIFY(fakeFolder.syncOnce());
+        QVERIFY(hasRecord(fakeFolder, QStringLiteral("enc/file")));
+        QCOMPARE(server.fileNames(QStringLiteral("enc")), QStringList{QStringLiteral("file")});
+        QCOMPARE(fakeFolder.currentRemoteState().find(QStringLiteral("enc"))->children.size(), 1);
+    }
+};
+
+QTEST_GUILESS_MAIN(TestE2eeSync)
+#include "teste2eesync.moc"
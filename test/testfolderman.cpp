@@ -242,6 +242,65 @@ private slots:
         OCC::AccountManager::instance()->deleteAccount(accountState);
     }
 
+    void testProgressIsThrottledWhileItemsComplete()
+    {
+        QTemporaryDir dir;
+        ConfigFile::setConfDir(dir.path()); // we don't want to pollute the user's config file
+        QVERIFY(dir.isValid());
+        QDir dir2(dir.path());
+        QVERIFY(dir2.mkpath("ownCloud"));
+
+        AccountPtr account = Account::create();
+        account->setCredentials(new HttpCredentialsTest("testuser", "secret"));
+        account->setUrl(QUrl("http://example.de"));
+        AccountStatePtr newAccountState(new AccountState(account));
+        const auto folder = FolderMan::instance()->addFolder(newAccountState.data(), folderDefinition(dir2.canonicalPath() + "/ownCloud"));
+        QVERIFY(folder);
+
+        int progressCount = 0;
+        QStringList completedItems;
+        QObject receiver;
+        connect(ProgressDispatcher::instance(), &ProgressDispatcher::progressInfo, &receiver,
+            [&](const QString &alias, const ProgressInfo &) {
+                if (alias == folder->alias()) {
+                    ++progressCount;
+                }
+            });
+        connect(ProgressDispatcher::instance(), &ProgressDispatcher::itemCompleted, &receiver,
+            [&](const QString &alias, const SyncFileItemPtr &item) {
+                if (alias == folder->alias()) {
+                    completedItems.append(item->_file);
+                }
+            });
+
+        // Many items complete quickly, each followed by a progress update, as the engine does
+        const int completions = 50;
+        QStringList expectedItems;
+        ProgressInfo progress;
+        progress._status = ProgressInfo::Propagation;
+        emit folder->syncEngine().transmissionProgress(progress);
+        for (int i = 0; i < completions; ++i) {
+            auto item = SyncFileItemPtr::create();
+            item->_file = QStringLiteral("file%1").arg(i);
+            item->_instruction = CSYNC_INSTRUCTION_NEW;
+            expectedItems.append(item->_file);
+            progress._lastCompletedItem = *item;
+            emit folder->syncEngine().itemCompleted(item, ErrorCategory::NoError);
+            emit folder->syncEngine().transmissionProgress(progress);
+        }
+
+        // Every completed item is passed on, but only the first snapshot was published
+        QCOMPARE(completedItems, expectedItems);
+        QCOMPARE(progressCount, 1);
+
+        // The latest snapshot is published once the throttle interval is over
+        QTRY_COMPARE(progressCount, 2);
+        QTest::qWait(300);
+        QCOMPARE(progressCount, 2);
+
+        FolderMan::instance()->removeFolder(folder);
+    }
+
     void testCheckPathValidityForNewFolder()
     {
 #ifdef Q_OS_WIN
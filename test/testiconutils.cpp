@@ -13,6 +13,7 @@
  */
 
 #include <QTest>
+#include <QDir>
 
 #include "theme.h"
 #include "iconutils.h"
@@ -69,6 +70,31 @@ private slots:
         QVERIFY(!OCC::Ui::IconUtils::createSvgImageWithCustomColor(whiteImages.at(0), QColorConstants::Svg::blue).isNull());
     }
 
+    void testImageCache()
+    {
+        const QDir blackSvgDir(QString(QString{OCC::Theme::themePrefix}) + QStringLiteral("black"));
+        const QStringList blackImages = blackSvgDir.entryList(QStringList("*.svg"));
+        QVERIFY(!blackImages.isEmpty());
+
+        OCC::Ui::IconUtils::clearImageCache();
+        QVERIFY(OCC::Ui::IconUtils::findCachedImage(blackImages.at(0), QColorConstants::Svg::red, QSize(16, 16)).isNull());
+
+        const auto image = OCC::Ui::IconUtils::createSvgImageWithCustomColor(blackImages.at(0), QColorConstants::Svg::red, nullptr, QSize(16, 16));
+        QVERIFY(!image.isNull());
+
+        // Same source, color and size: served from the cache
+        const auto cached = OCC::Ui::IconUtils::findCachedImage(blackImages.at(0), QColorConstants::Svg::red, QSize(16, 16));
+        QCOMPARE(cached, image);
+        QCOMPARE(cached.cacheKey(), image.cacheKey());
+
+        // Other colors and sizes are cached separately
+        QVERIFY(OCC::Ui::IconUtils::findCachedImage(blackImages.at(0), QColorConstants::Svg::green, QSize(16, 16)).isNull());
+        QVERIFY(OCC::Ui::IconUtils::findCachedImage(blackImages.at(0), QColorConstants::Svg::red, QSize(32, 32)).isNull());
+
+        OCC::Ui::IconUtils::clearImageCache();
+        QVERIFY(OCC::Ui::IconUtils::findCachedImage(blackImages.at(0), QColorConstants::Svg::red, QSize(16, 16)).isNull());
+    }
+
     void testPixmapForBackground()
     {
         const QDir blackSvgDir(QString(QString{OCC::Theme::themePrefix}) + QStringLiteral("black"));
@@ -6,12 +6,12 @@
 
 #include <QtTest>
 
-#include "folderwatcher_linux.h"
+#include "inotifywatcher.h"
 #include "common/utility.h"
 
 using namespace OCC;
 
-class TestInotifyWatcher: public FolderWatcherPrivate
+class TestInotifyWatcher: public InotifyWatcher
 {
     Q_OBJECT
 
@@ -67,5 +67,5 @@ private slots:
     }
 };
 
-QTEST_APPLESS_MAIN(TestInotifyWatcher)
+QTEST_GUILESS_MAIN(TestInotifyWatcher)
 #include "testinotifywatcher.moc"
@@ -101,6 +101,36 @@ private slots:
     }
 
 #ifdef Q_OS_WIN
+    void testLockWatcherBacksOff()
+    {
+        QTemporaryDir tmp;
+        int count = 0;
+
+        LockWatcher watcher;
+        watcher.setCheckInterval(std::chrono::milliseconds(20));
+        connect(&watcher, &LockWatcher::fileUnlocked, &watcher, [&](const QString &) { ++count; });
+
+        const QString tmpFile = tmp.path() + QStringLiteral("/file.txt");
+        {
+            QFile tmp(tmpFile);
+            QVERIFY(tmp.open(QFile::WriteOnly));
+        }
+
+        auto h = makeHandle(tmpFile, 0);
+        QVERIFY(FileSystem::isFileLocked(tmpFile));
+        watcher.addFile(tmpFile);
+
+        // Checked a few times, with growing intervals, while still locked
+        QTest::qWait(300);
+        QCOMPARE(count, 0);
+        QVERIFY(watcher.contains(tmpFile));
+
+        // The release is still noticed
+        CloseHandle(h);
+        QTRY_COMPARE(count, 1);
+        QVERIFY(!watcher.contains(tmpFile));
+    }
+
     void testLockedFilePropagation()
     {
         FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
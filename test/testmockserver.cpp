@@ -0,0 +1,196 @@
+/*
+ * This software is in the public domain, furnished "as is", without technical
+ * support, and with no warranty, express or implied, as to its usefulness for
+ * any purpose.
+ *
+ */
+
+#include <QtTest>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+
+#include "httpserver.h"
+#include "webdavhandler.h"
+
+class TestMockServer : public QObject
+{
+    Q_OBJECT
+
+    QNetworkAccessManager _nam;
+
+    static QUrl url(const HttpServer &server, const QString &path)
+    {
+        return QUrl(QStringLiteral("http://127.0.0.1:%1%2").arg(server.serverPort()).arg(path));
+    }
+
+    QNetworkReply *send(const QByteArray &verb, const QUrl &url, const QByteArray &body = {}, const QMap<QByteArray, QByteArray> &headers = {})
+    {
+        QNetworkRequest request(url);
+        for (auto it = headers.cbegin(); it != headers.cend(); ++it) {
+            request.setRawHeader(it.key(), it.value());
+        }
+        auto reply = _nam.sendCustomRequest(request, verb, body);
+        QSignalSpy finished(reply, &QNetworkReply::finished);
+        if (!reply->isFinished()) {
+            finished.wait(10000);
+        }
+        reply->deleteLater();
+        return reply;
+    }
+
+    static int status(QNetworkReply *reply)
+    {
+        return reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    }
+
+private slots:
+    void testPutGetPropfind()
+    {
+        MockServerOptions options;
+        WebDavHandler handler(options);
+        HttpServer server(options, &handler);
+        QVERIFY(server.start());
+        const auto davRoot = QStringLiteral("/remote.php/dav/files/admin");
+
+        QCOMPARE(status(send("MKCOL", url(server, davRoot + "/A"))), 201);
+        QCOMPARE(status(send("MKCOL", url(server, davRoot + "/missing/B"))), 409);
+
+        auto reply = send("PUT", url(server, davRoot + "/A/a b.txt"), "hello world", { { "X-OC-Mtime", "1000" }, { "OC-Checksum", "MD5:5eb63bbbe01eeed093cb22bb8f5acdc3" } });
+        QCOMPARE(status(reply), 201);
+        QCOMPARE(reply->rawHeader("X-OC-MTime"), QByteArray("accepted"));
+        const auto etag = reply->rawHeader("OC-ETag");
+        QVERIFY(!etag.isEmpty());
+
+        QCOMPARE(status(send("PUT", url(server, davRoot + "/A/bad.txt"), "hello", { { "OC-Checksum", "MD5:00000000000000000000000000000000" } })), 400);
+        QCOMPARE(status(send("PUT", url(server, davRoot + "/A/a b.txt"), "x", { { "If-Match", "\"wrong\"" } })), 412);
+
+        reply = send("GET", url(server, davRoot + "/A/a b.txt"));
+        QCOMPARE(status(reply), 200);
+        QCOMPARE(reply->readAll(), QByteArray("hello world"));
+
+        reply = send("GET", url(server, davRoot + "/A/a b.txt"), {}, { { "Range", "bytes=6-" } });
+        QCOMPARE(status(reply), 206);
+        QCOMPARE(reply->readAll(), QByteArray("world"));
+
+        reply = send("PROPFIND", url(server, davRoot + "/A"), {}, { { "Depth", "1" } });
+        QCOMPARE(status(reply), 207);
+        const auto body = reply->readAll();
+        QVERIFY(body.contains("/remote.php/dav/files/admin/A/a%20b.txt"));
+        QVERIFY(body.contains(etag));
+        QVERIFY(body.contains("<d:getcontentlength>11</d:getcontentlength>"));
+
+        QCOMPARE(status(send("MOVE", url(server, davRoot + "/A/a b.txt"), {}, { { "Destination", url(server, davRoot + "/c.txt").toEncoded() } })), 201);
+        QVERIFY(handler.files().find(QStringLiteral("c.txt")));
+        QVERIFY(!handler.files().find(QStringLiteral("A/a b.txt")));
+        QCOMPARE(status(send("DELETE", url(server, davRoot + "/A"))), 204);
+        QCOMPARE(status(send("PROPFIND", url(server, davRoot + "/A"))), 404);
+    }
+
+    void testChunkedUpload()
+    {
+        MockServerOptions options;
+        WebDavHandler handler(options);
+        HttpServer server(options, &handler);
+        QVERIFY(server.start());
+        const auto uploadDir = QStringLiteral("/remote.php/dav/uploads/admin/42");
+
+        QCOMPARE(status(send("MKCOL", url(server, uploadDir))), 201);
+        QCOMPARE(status(send("PUT", url(server, uploadDir + "/0000000000000002"), "world")), 201);
+        QCOMPARE(status(send("PUT", url(server, uploadDir + "/0000000000000001"), "hello ")), 201);
+
+        const auto destination = url(server, QStringLiteral("/remote.php/dav/files/admin/big.bin")).toEncoded();
+        QCOMPARE(status(send("MOVE", url(server, uploadDir + "/.file"), {}, { { "Destination", destination }, { "OC-Total-Length", "99" } })), 400);
+        auto reply = send("MOVE", url(server, uploadDir + "/.file"), {}, { { "Destination", destination }, { "OC-Total-Length", "11" }, { "X-OC-Mtime", "1234" } });
+        QCOMPARE(status(reply), 201);
+        QVERIFY(!reply->rawHeader("OC-FileId").isEmpty());
+
+        QCOMPARE(handler.files().read(QStringLiteral("big.bin")), QByteArray("hello world"));
+        QCOMPARE(handler.files().find(QStringLiteral("big.bin"))->mtime, 1234);
+        QVERIFY(!handler.uploads().find(QStringLiteral("admin/42")));
+    }
+
+    void testBulkUpload()
+    {
+        MockServerOptions options;
+        WebDavHandler handler(options);
+        HttpServer server(options, &handler);
+        QVERIFY(server.start());
+
+        const QByteArray body =
+            "--boundary\r\n"
+            "X-File-Path: /one.txt\r\nX-File-Mtime: 100\r\nX-File-MD5: 5d41402abc4b2a76b9719d911017c592\r\nContent-Length: 5\r\n\r\n"
+            "hello\r\n"
+            "--boundary\r\n"
+            "X-File-Path: /two.txt\r\nX-File-Mtime: 100\r\nX-File-MD5: 00000000000000000000000000000000\r\nContent-Length: 5\r\n\r\n"
+            "world\r\n"
+            "--boundary--\r\n";
+        auto reply = send("POST", url(server, QStringLiteral("/remote.php/dav/bulk")), body, { { "Content-Type", "multipart/related; boundary=\"boundary\"" } });
+        QCOMPARE(status(reply), 200);
+        const auto result = QJsonDocument::fromJson(reply->readAll()).object();
+        QCOMPARE(result.value(QStringLiteral("/one.txt")).toObject().value(QStringLiteral("error")).toBool(), false);
+        QCOMPARE(result.value(QStringLiteral("/two.txt")).toObject().value(QStringLiteral("error")).toBool(), true);
+        QCOMPARE(handler.files().read(QStringLiteral("one.txt")), QByteArray("hello"));
+        QVERIFY(!handler.files().find(QStringLiteral("two.txt")));
+    }
+
+    void testCapabilities()
+    {
+        MockServerOptions options;
+        options.bulkUpload = false;
+        WebDavHandler handler(options);
+        HttpServer server(options, &handler);
+        QVERIFY(server.start());
+
+        QCOMPARE(status(send("GET", url(server, QStringLiteral("/status.php")))), 200);
+        auto reply = send("GET", url(server, QStringLiteral("/ocs/v1.php/cloud/capabilities?format=json")));
+        QCOMPARE(status(reply), 200);
+        const auto dav = QJsonDocument::fromJson(reply->readAll()).object()
+            .value(QStringLiteral("ocs")).toObject().value(QStringLiteral("data")).toObject()
+            .value(QStringLiteral("capabilities")).toObject().value(QStringLiteral("dav")).toObject();
+        QCOMPARE(dav.value(QStringLiteral("chunking")).toString(), QStringLiteral("1.0"));
+        QVERIFY(!dav.contains(QStringLiteral("bulkupload")));
+    }
+
+    void testNetworkConditions()
+    {
+        MockServerOptions options;
+        options.latencyMsecs = 100;
+        options.failureRate = 1.0;
+        options.failureStatus = 507;
+        options.failurePattern = QRegularExpression(QStringLiteral("\\.fail$"));
+        WebDavHandler handler(options);
+        HttpServer server(options, &handler);
+        QVERIFY(server.start());
+        const auto davRoot = QStringLiteral("/remote.php/dav/files/admin");
+
+        QElapsedTimer timer;
+        timer.start();
+        QCOMPARE(status(send("PUT", url(server, davRoot + "/ok.txt"), "data")), 201);
+        QVERIFY(timer.elapsed() >= 100);
+        QCOMPARE(status(send("PUT", url(server, davRoot + "/x.fail"), "data")), 507);
+        QVERIFY(!handler.files().find(QStringLiteral("x.fail")));
+    }
+
+    void testBandwidth()
+    {
+        MockServerOptions options;
+        options.bytesPerSecond = 100 * 1000;
+        WebDavHandler handler(options);
+        handler.files().put(QStringLiteral("big.bin"), QByteArray(50 * 1000, 'x'), 1);
+        HttpServer server(options, &handler);
+        QVERIFY(server.start());
+
+        QElapsedTimer timer;
+        timer.start();
+        auto reply = send("GET", url(server, QStringLiteral("/remote.php/dav/files/admin/big.bin")));
+        QCOMPARE(status(reply), 200);
+        QCOMPARE(reply->readAll().size(), 50 * 1000);
+        // Half a second at 100 kB/s, with some slack for the first slice
+        QVERIFY(timer.elapsed() >= 400);
+    }
+};
+
+QTEST_GUILESS_MAIN(TestMockServer)
+#include "testmockserver.moc"
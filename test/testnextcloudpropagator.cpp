@@ -7,6 +7,7 @@
 #include <QtTest>
 #include <QDebug>
 
+#include "account.h"
 #include "propagatedownload.h"
 #include "owncloudpropagator_p.h"
 
@@ -76,7 +77,36 @@ private slots:
             QCOMPARE(parseEtag(test.first), QByteArray(test.second));
         }
     }
+
+    void testItemPriority()
+    {
+        QSet<QString> bulkUploadBlackList;
+        OwncloudPropagator propagator(Account::create(), QStringLiteral("/tmp/local"), QStringLiteral("/"), nullptr, bulkUploadBlackList);
+        propagator.setUserTriggeredPaths({ QStringLiteral("A/doc.txt"), QStringLiteral("B") });
+
+        auto makeItem = [](const QString &file, SyncInstructions instruction, qint64 size) {
+            SyncFileItem item;
+            item._file = file;
+            item._type = ItemTypeFile;
+            item._instruction = instruction;
+            item._size = size;
+            return item;
+        };
+
+        QCOMPARE(propagator.priorityForItem(makeItem("A/doc.txt", CSYNC_INSTRUCTION_SYNC, 1 << 30)), PropagatorJob::UserTriggeredPriority);
+        QCOMPARE(propagator.priorityForItem(makeItem("B/sub/big", CSYNC_INSTRUCTION_NEW, 1 << 30)), PropagatorJob::UserTriggeredPriority);
+        QCOMPARE(propagator.priorityForItem(makeItem("Bx/big", CSYNC_INSTRUCTION_NEW, 1 << 30)), PropagatorJob::BulkPriority);
+        QCOMPARE(propagator.priorityForItem(makeItem("A/other.txt", CSYNC_INSTRUCTION_NEW, 10)), PropagatorJob::SmallFilePriority);
+        QCOMPARE(propagator.priorityForItem(makeItem("A/other.txt", CSYNC_INSTRUCTION_REMOVE, 1 << 30)), PropagatorJob::MetadataPriority);
+        QCOMPARE(propagator.priorityForItem(makeItem("A/other.txt", CSYNC_INSTRUCTION_UPDATE_METADATA, 1 << 30)), PropagatorJob::MetadataPriority);
+
+        auto dir = makeItem("C", CSYNC_INSTRUCTION_NEW, 0);
+        dir._type = ItemTypeDirectory;
+        QCOMPARE(propagator.priorityForItem(dir), PropagatorJob::MetadataPriority);
+
+        QVERIFY(OwncloudPropagator::priorityDeadline(PropagatorJob::SmallFilePriority) < OwncloudPropagator::priorityDeadline(PropagatorJob::BulkPriority));
+    }
 };
 
-QTEST_APPLESS_MAIN(TestNextcloudPropagator)
+QTEST_GUILESS_MAIN(TestNextcloudPropagator)
 #include "testnextcloudpropagator.moc"
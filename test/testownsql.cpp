@@ -126,6 +126,135 @@ private slots:
         }
     }
 
+    void testTypedValues()
+    {
+        SqlQuery create("CREATE TABLE typed (flag INTEGER, big INTEGER, real REAL, name TEXT, raw TEXT, missing TEXT);", _db);
+        QVERIFY(create.exec());
+
+        const qint64 big = 1LL << 40;
+        SqlQuery insert("INSERT INTO typed VALUES (?1, ?2, ?3, ?4, ?5, ?6);", _db);
+        insert.bindValue(1, true);
+        insert.bindValue(2, big);
+        insert.bindValue(3, 0.5);
+        insert.bindValue(4, QString::fromUtf8("пятницы"));
+        insert.bindValue(5, QByteArray("raw") + "data");
+        insert.bindValue(6, QString());
+        QVERIFY(insert.exec());
+
+        SqlQuery select("SELECT flag, big, real, name, raw, missing FROM typed;", _db);
+        QVERIFY(select.next().hasData);
+        QCOMPARE(select.columnCount(), 6);
+        QCOMPARE(select.value<bool>(0), true);
+        QCOMPARE(select.value<qint64>(1), big);
+        QCOMPARE(select.value<double>(2), 0.5);
+        QCOMPARE(select.value<QString>(3), QString::fromUtf8("пятницы"));
+        QCOMPARE(select.baView(4), QByteArray("rawdata"));
+        QCOMPARE(*(select.baView(4).constData() + 7), '\0');
+        QVERIFY(select.nullValue(5));
+        QVERIFY(select.value<QString>(5).isNull());
+
+        // Reading in place reuses an unshared buffer, but never writes into a shared one
+        QByteArray out("a longer value than the column");
+        const auto buffer = out.constData();
+        select.baValue(4, out);
+        QCOMPARE(out, QByteArray("rawdata"));
+        QCOMPARE(out.constData(), buffer);
+
+        const auto shared = out;
+        select.baValue(3, out);
+        QCOMPARE(out, QString::fromUtf8("пятницы").toUtf8());
+        QCOMPARE(shared, QByteArray("rawdata"));
+    }
+
+    void testBindBenchmark_data()
+    {
+        QTest::addColumn<bool>("typed");
+        QTest::newRow("variant") << false;
+        QTest::newRow("typed") << true;
+    }
+
+    void testBindBenchmark()
+    {
+        QFETCH(bool, typed);
+        SqlQuery q("SELECT ?1, ?2, ?3;", _db);
+        const QByteArray path("some/folder/with/a/file.txt");
+        const QString name = QStringLiteral("file.txt");
+        const qint64 size = 1234567;
+
+        QBENCHMARK {
+            for (int i = 0; i < 1000; ++i) {
+                q.reset_and_clear_bindings();
+                if (typed) {
+                    q.bindValue(1, path);
+                    q.bindValue(2, name);
+                    q.bindValue(3, size);
+                } else {
+                    q.bindValue(1, QVariant(path));
+                    q.bindValue(2, QVariant(name));
+                    q.bindValue(3, QVariant(size));
+                }
+            }
+        }
+    }
+
+    void testRowDecodingBenchmark_data()
+    {
+        QTest::addColumn<bool>("inPlace");
+        QTest::newRow("copy") << false;
+        QTest::newRow("in place") << true;
+    }
+
+    void testRowDecodingBenchmark()
+    {
+        QFETCH(bool, inPlace);
+
+        SqlQuery create("CREATE TABLE IF NOT EXISTS sometable (path TEXT, etag TEXT, fileid TEXT, size INTEGER);", _db);
+        QVERIFY(create.exec());
+        if (SqlQuery count("SELECT count(*) FROM sometable;", _db); !count.next().hasData || count.intValue(0) == 0) {
+            QVERIFY(_db.transaction());
+            SqlQuery insert("INSERT INTO sometable VALUES (?1, ?2, ?3, ?4);", _db);
+            for (int i = 0; i < 1000; ++i) {
+                insert.reset_and_clear_bindings();
+                insert.bindValue(1, QByteArray("some/folder/file") + QByteArray::number(i));
+                insert.bindValue(2, QByteArray::number(i * 7919, 16).rightJustified(16, '0'));
+                insert.bindValue(3, QByteArray::number(i).rightJustified(8, '0') + "ocabcdefgh");
+                insert.bindValue(4, i * 1024);
+                QVERIFY(insert.exec());
+            }
+            QVERIFY(_db.commit());
+        }
+
+        struct Row
+        {
+            QByteArray path;
+            QByteArray etag;
+            QByteArray fileId;
+            qint64 size = 0;
+        };
+
+        SqlQuery select("SELECT path, etag, fileid, size FROM sometable;", _db);
+        qint64 totalSize = 0;
+        QBENCHMARK {
+            select.reset_and_clear_bindings();
+            Row row;
+            while (select.next().hasData) {
+                if (inPlace) {
+                    select.baValue(0, row.path);
+                    select.baValue(1, row.etag);
+                    select.baValue(2, row.fileId);
+                } else {
+                    row = Row();
+                    row.path = select.baValue(0);
+                    row.etag = select.baValue(1);
+                    row.fileId = select.baValue(2);
+                }
+                row.size = select.value<qint64>(3);
+                totalSize += row.size + row.path.size();
+            }
+        }
+        QVERIFY(totalSize > 0); // mainly to avoid optimization
+    }
+
     void testDestructor()
     {
         // This test make sure that the destructor of SqlQuery works even if the SqlDatabase
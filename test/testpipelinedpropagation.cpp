@@ -0,0 +1,283 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include <QtTest>
+#include "syncenginetestutils.h"
+#include <syncengine.h>
+
+using namespace OCC;
+
+static void enablePipelinedPropagation(FakeFolder &fakeFolder)
+{
+    auto options = fakeFolder.syncEngine().syncOptions();
+    options._pipelinedPropagation = true;
+    fakeFolder.syncEngine().setSyncOptions(options);
+}
+
+/*
+ * Holds back its answer until release() was called
+ */
+template <typename OriginalReply>
+class HeldReply : public OriginalReply
+{
+public:
+    using OriginalReply::OriginalReply;
+
+    void respond() override
+    {
+        _respondPending = !_released;
+        if (_released) {
+            OriginalReply::respond();
+        }
+    }
+
+    void release()
+    {
+        _released = true;
+        if (std::exchange(_respondPending, false)) {
+            OriginalReply::respond();
+        }
+    }
+
+private:
+    bool _released = false;
+    bool _respondPending = false;
+};
+
+/*
+ * Holds back the listing of the remote folder C until the item releasedBy
+ * completed, or release() is called, so the other top-level folders are
+ * discovered and propagated first. Records the requests and the end of the
+ * discovery in events.
+ */
+class HeldListingOfC : public QObject
+{
+public:
+    HeldListingOfC(FakeFolder &fakeFolder, int httpErrorCode = 0)
+    {
+        fakeFolder.setServerOverride([this, &fakeFolder, httpErrorCode](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            const auto path = getFilePathFromUrl(request.url());
+            if (op == QNetworkAccessManager::GetOperation) {
+                events.append(QStringLiteral("GET ") + path);
+            } else if (op == QNetworkAccessManager::PutOperation) {
+                events.append(QStringLiteral("PUT ") + path);
+            } else if (request.attribute(QNetworkRequest::CustomVerbAttribute) == "PROPFIND" && path == QLatin1String("C")) {
+                if (httpErrorCode != 0) {
+                    auto reply = new HeldReply<FakeErrorReply>(op, request, this, httpErrorCode);
+                    _reply = reply;
+                    _release = [reply] { reply->release(); };
+                } else {
+                    auto reply = new HeldReply<FakePropfindReply>(fakeFolder.remoteModifier(), op, request, this);
+                    _reply = reply;
+                    _release = [reply] { reply->release(); };
+                }
+                if (_released) {
+                    _release();
+                }
+                return _reply;
+            }
+            return nullptr;
+        });
+        connect(&fakeFolder.syncEngine(), &SyncEngine::itemCompleted, this, [this](const SyncFileItemPtr &item) {
+            if (!releasedBy.isEmpty() && item->destination() == releasedBy) {
+                release();
+            }
+        });
+        connect(&fakeFolder.syncEngine(), &SyncEngine::discoveryFinished, this, [this] {
+            events.append(QStringLiteral("discovery finished"));
+        });
+    }
+
+    // For the next sync
+    void reset(const QString &nextReleasedBy)
+    {
+        events.clear();
+        releasedBy = nextReleasedBy;
+        _released = false;
+        _reply.clear();
+    }
+
+    void release()
+    {
+        _released = true;
+        if (_reply) {
+            _release();
+        }
+    }
+
+    [[nodiscard]] QNetworkReply *reply() const { return _reply; }
+
+    QStringList events;
+    QString releasedBy;
+
+private:
+    QPointer<QNetworkReply> _reply;
+    std::function<void()> _release;
+    bool _released = false;
+};
+
+class TestPipelinedPropagation : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testSubtreePropagatesBeforeDiscoveryFinishes()
+    {
+        FakeFolder fakeFolder{FileInfo::A12_B12_C12_S12()};
+        enablePipelinedPropagation(fakeFolder);
+        HeldListingOfC heldListing(fakeFolder);
+        heldListing.releasedBy = QStringLiteral("A/new");
+        const auto &events = heldListing.events;
+
+        QSignalSpy aboutToPropagate(&fakeFolder.syncEngine(), &SyncEngine::aboutToPropagate);
+        QSignalSpy itemsAdded(&fakeFolder.syncEngine(), &SyncEngine::itemsAddedToPropagation);
+        QSignalSpy started(&fakeFolder.syncEngine(), &SyncEngine::started);
+        QVector<ProgressInfo::Status> statuses;
+        connect(&fakeFolder.syncEngine(), &SyncEngine::transmissionProgress, &heldListing, [&statuses](const ProgressInfo &progress) {
+            statuses.append(progress.status());
+        });
+
+        fakeFolder.remoteModifier().insert(QStringLiteral("A/new"));
+        fakeFolder.remoteModifier().insert(QStringLiteral("C/new"));
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+
+        // A was downloaded while C was still being listed
+        const auto discoveryFinished = events.indexOf(QStringLiteral("discovery finished"));
+        QVERIFY(discoveryFinished >= 0);
+        QVERIFY(events.indexOf(QStringLiteral("GET A/new")) >= 0);
+        QVERIFY(events.indexOf(QStringLiteral("GET A/new")) < discoveryFinished);
+        QVERIFY(events.contains(QStringLiteral("GET C/new")));
+
+        // The start of the propagation is only announced once per sync
+        QCOMPARE(aboutToPropagate.count(), 1);
+        QCOMPARE(started.count(), 1);
+        QVERIFY(itemsAdded.count() >= 1);
+
+        // Once propagating, the end of the discovery doesn't report Reconcile anymore
+        const auto propagating = statuses.indexOf(ProgressInfo::Propagation);
+        QVERIFY(propagating >= 0);
+        QVERIFY(!statuses.mid(propagating).contains(ProgressInfo::Reconcile));
+
+        // The next sync behaves the same
+        heldListing.reset(QStringLiteral("A/a1"));
+        aboutToPropagate.clear();
+        fakeFolder.remoteModifier().appendByte(QStringLiteral("A/a1"));
+        fakeFolder.remoteModifier().appendByte(QStringLiteral("C/c1"));
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCOMPARE(aboutToPropagate.count(), 1);
+        QVERIFY(events.indexOf(QStringLiteral("GET A/a1")) < events.indexOf(QStringLiteral("discovery finished")));
+    }
+
+    void testDirectoryDeletedWhileChildrenAreDiscovered_data()
+    {
+        QTest::addColumn<bool>("deleteOnRemote");
+        QTest::newRow("local") << false;
+        QTest::newRow("remote") << true;
+    }
+
+    void testDirectoryDeletedWhileChildrenAreDiscovered()
+    {
+        QFETCH(bool, deleteOnRemote);
+        FakeFolder fakeFolder{FileInfo::A12_B12_C12_S12()};
+        fakeFolder.remoteModifier().mkdir(QStringLiteral("A/sub"));
+        fakeFolder.remoteModifier().insert(QStringLiteral("A/sub/x"));
+        fakeFolder.remoteModifier().insert(QStringLiteral("A/sub/y"));
+        QVERIFY(fakeFolder.syncOnce());
+
+        enablePipelinedPropagation(fakeFolder);
+        HeldListingOfC heldListing(fakeFolder);
+        heldListing.releasedBy = QStringLiteral("B/new");
+        const auto &events = heldListing.events;
+
+        // A/sub is gone, but one of its files was moved into C, which is only
+        // listed after the rest of the tree
+        auto &modifier = deleteOnRemote ? static_cast<FileModifier &>(fakeFolder.remoteModifier()) : fakeFolder.localModifier();
+        modifier.rename(QStringLiteral("A/sub/x"), QStringLiteral("C/x"));
+        modifier.remove(QStringLiteral("A/sub"));
+        fakeFolder.remoteModifier().insert(QStringLiteral("B/new"));
+        fakeFolder.remoteModifier().insert(QStringLiteral("C/remote"));
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QVERIFY(!fakeFolder.currentLocalState().find(QStringLiteral("A/sub")));
+        QVERIFY(fakeFolder.currentLocalState().find(QStringLiteral("C/x")));
+
+        // The unrelated folder didn't wait, the move was detected as such
+        QVERIFY(events.indexOf(QStringLiteral("GET B/new")) < events.indexOf(QStringLiteral("discovery finished")));
+        QVERIFY(!events.contains(QStringLiteral("GET C/x")));
+        QVERIFY(!events.contains(QStringLiteral("PUT C/x")));
+
+        // The journal matches the result
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+    }
+
+    void testAbortWhileDiscovering()
+    {
+        FakeFolder fakeFolder{FileInfo::A12_B12_C12_S12()};
+        enablePipelinedPropagation(fakeFolder);
+        HeldListingOfC heldListing(fakeFolder);
+        const auto &events = heldListing.events;
+
+        fakeFolder.remoteModifier().insert(QStringLiteral("A/new"));
+        fakeFolder.remoteModifier().insert(QStringLiteral("C/new"));
+        fakeFolder.scheduleSync();
+        fakeFolder.execUntilItemCompleted(QStringLiteral("A/new"));
+        QVERIFY(!events.contains(QStringLiteral("discovery finished")));
+
+        fakeFolder.syncEngine().abort();
+        QVERIFY(!fakeFolder.execUntilFinished());
+        QVERIFY(!fakeFolder.syncEngine().isSyncRunning());
+        QVERIFY(fakeFolder.currentLocalState().find(QStringLiteral("A/new")));
+        QVERIFY(!fakeFolder.currentLocalState().find(QStringLiteral("C/new")));
+        QVERIFY(!events.contains(QStringLiteral("discovery finished")));
+
+        // The listing of C that arrives late must not resume the aborted sync
+        if (const auto reply = heldListing.reply()) {
+            QSignalSpy listingFinished(reply, &QNetworkReply::finished);
+            heldListing.release();
+            QCOMPARE(listingFinished.count(), 1);
+        }
+        QCoreApplication::processEvents();
+        QVERIFY(!events.contains(QStringLiteral("discovery finished")));
+        QVERIFY(!fakeFolder.syncEngine().isSyncRunning());
+
+        fakeFolder.setServerOverride(nullptr);
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+    }
+
+    void testFatalDiscoveryErrorWhilePropagating()
+    {
+        FakeFolder fakeFolder{FileInfo::A12_B12_C12_S12()};
+        enablePipelinedPropagation(fakeFolder);
+        // Only errors below 403 are fatal for a sub folder
+        HeldListingOfC heldListing(fakeFolder, 400);
+        heldListing.releasedBy = QStringLiteral("A/new");
+
+        fakeFolder.remoteModifier().insert(QStringLiteral("A/new"));
+        fakeFolder.remoteModifier().insert(QStringLiteral("C/new"));
+        QSignalSpy finished(&fakeFolder.syncEngine(), &SyncEngine::finished);
+        QVERIFY(!fakeFolder.syncOnce());
+        QCOMPARE(finished.count(), 1);
+        QVERIFY(!fakeFolder.syncEngine().isSyncRunning());
+
+        // The propagation was stopped properly, what it did is in the journal
+        QVERIFY(fakeFolder.currentLocalState().find(QStringLiteral("A/new")));
+        SyncJournalFileRecord record;
+        QVERIFY(fakeFolder.syncJournal().getFileRecord(QByteArrayLiteral("A/new"), &record));
+        QVERIFY(record.isValid());
+
+        fakeFolder.setServerOverride(nullptr);
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+    }
+};
+
+QTEST_GUILESS_MAIN(TestPipelinedPropagation)
+#include "testpipelinedpropagation.moc"
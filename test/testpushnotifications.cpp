@@ -119,6 +119,25 @@ private slots:
         QVERIFY(verifyCalledOnceWithAccount(filesChangedSpy, account));
     }
 
+    void testOnWebSocketTextMessageReceived_notifyFileIdMessage_emitFileIdsChanged()
+    {
+        FakeWebSocketServer fakeServer;
+        auto account = FakeWebSocketServer::createAccount();
+        const auto socket = fakeServer.authenticateAccount(account);
+        QVERIFY(socket);
+        QTRY_VERIFY(fakeServer.listenRequests().contains(QStringLiteral("listen notify_file_id")));
+        qRegisterMetaType<QVector<qint64>>();
+        QSignalSpy fileIdsChangedSpy(account->pushNotifications(), &OCC::PushNotifications::fileIdsChanged);
+
+        socket->sendTextMessage("notify_file_id [12,345]");
+
+        // fileIdsChanged signal should be emitted with the ids
+        QVERIFY(fileIdsChangedSpy.wait());
+        QCOMPARE(fileIdsChangedSpy.count(), 1);
+        QCOMPARE(fileIdsChangedSpy.at(0).at(0).value<OCC::Account *>(), account.data());
+        QCOMPARE(fileIdsChangedSpy.at(0).at(1).value<QVector<qint64>>(), (QVector<qint64>{ 12, 345 }));
+    }
+
     void testOnWebSocketTextMessageReceived_notifyActivityMessage_emitNotification()
     {
         FakeWebSocketServer fakeServer;
@@ -0,0 +1,130 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include <QtTest>
+#include "syncenginetestutils.h"
+#include "remotedirectorycache.h"
+
+using namespace OCC;
+using namespace std::chrono_literals;
+
+// Fetches the listing of @a path and waits for it
+static bool fetchListing(RemoteDirectoryCache *cache, const QString &path)
+{
+    QSignalSpy fetchedSpy(cache, &RemoteDirectoryCache::fetched);
+    cache->fetch(path);
+    return fetchedSpy.wait() && fetchedSpy.first().first().toString() == path;
+}
+
+class TestRemoteDirectoryCache : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init()
+    {
+        RemoteDirectoryCache::uncheckedListingLifetime = 1min;
+        RemoteDirectoryCache::maximumCachedEntries = 20000;
+    }
+
+    void testEtagDecidesWhetherCurrent()
+    {
+        FakeFolder fakeFolder{FileInfo::A12_B12_C12_S12()};
+        const auto cache = RemoteDirectoryCache::forAccount(fakeFolder.account());
+        QVERIFY(!cache->listing(QStringLiteral("A")));
+
+        QVERIFY(fetchListing(cache, QStringLiteral("A")));
+        const auto etag = fakeFolder.remoteModifier().find(QStringLiteral("A"))->etag;
+        const auto listing = cache->listing(QStringLiteral("/A/"), etag);
+        QVERIFY(listing);
+        QCOMPARE(listing->etag, etag);
+        QCOMPARE(listing->folderInfos.size(), 3);
+
+        // The journal saw another etag, the listing is outdated
+        QVERIFY(!cache->listing(QStringLiteral("A"), QByteArrayLiteral("otheretag")));
+
+        cache->invalidate(QStringLiteral("A"));
+        QVERIFY(!cache->listing(QStringLiteral("A"), etag));
+    }
+
+    void testUncheckedListingsExpire()
+    {
+        RemoteDirectoryCache::uncheckedListingLifetime = 50ms;
+        FakeFolder fakeFolder{FileInfo::A12_B12_C12_S12()};
+        const auto cache = RemoteDirectoryCache::forAccount(fakeFolder.account());
+
+        QVERIFY(fetchListing(cache, QStringLiteral("A")));
+        QVERIFY(cache->listing(QStringLiteral("A")));
+
+        QTest::qWait(100);
+        QVERIFY(!cache->listing(QStringLiteral("A")));
+        // The etag check doesn't depend on the age
+        QVERIFY(cache->listing(QStringLiteral("A"), fakeFolder.remoteModifier().find(QStringLiteral("A"))->etag));
+    }
+
+    void testViewsShareListingsAndFetches()
+    {
+        FakeFolder fakeFolder{FileInfo::A12_B12_C12_S12()};
+        int propfinds = 0;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (request.attribute(QNetworkRequest::CustomVerbAttribute) == "PROPFIND") {
+                ++propfinds;
+            }
+            return nullptr;
+        });
+
+        // Two views of the same account
+        const auto cache = RemoteDirectoryCache::forAccount(fakeFolder.account());
+        QCOMPARE(RemoteDirectoryCache::forAccount(fakeFolder.account()), cache);
+
+        QSignalSpy fetchedSpy(cache, &RemoteDirectoryCache::fetched);
+        cache->fetch(QStringLiteral("B"));
+        cache->fetch(QStringLiteral("/B"));
+        QVERIFY(cache->isFetching(QStringLiteral("B/")));
+        QVERIFY(fetchedSpy.wait());
+        QCOMPARE(propfinds, 1);
+        QVERIFY(!cache->isFetching(QStringLiteral("B")));
+
+        // The second view finds the listing without asking the server
+        QVERIFY(cache->listing(QStringLiteral("B")));
+        QCOMPARE(propfinds, 1);
+
+        // Other accounts have their own cache
+        FakeFolder otherFolder{FileInfo::A12_B12_C12_S12()};
+        QVERIFY(RemoteDirectoryCache::forAccount(otherFolder.account()) != cache);
+        QVERIFY(!RemoteDirectoryCache::forAccount(otherFolder.account())->listing(QStringLiteral("B")));
+    }
+
+    void testLeastRecentlyUsedListingsAreDropped()
+    {
+        // Each listing of A, B and C costs four entries
+        RemoteDirectoryCache::maximumCachedEntries = 10;
+        FakeFolder fakeFolder{FileInfo::A12_B12_C12_S12()};
+        const auto cache = RemoteDirectoryCache::forAccount(fakeFolder.account());
+
+        QVERIFY(fetchListing(cache, QStringLiteral("A")));
+        QVERIFY(fetchListing(cache, QStringLiteral("B")));
+        QVERIFY(cache->listing(QStringLiteral("A")));
+
+        // B was used last before C came in
+        QVERIFY(cache->listing(QStringLiteral("B")));
+        QVERIFY(fetchListing(cache, QStringLiteral("C")));
+        QVERIFY(!cache->listing(QStringLiteral("A")));
+        QVERIFY(cache->listing(QStringLiteral("B")));
+        QVERIFY(cache->listing(QStringLiteral("C")));
+
+        // A listing larger than the cache is still kept on its own
+        RemoteDirectoryCache::maximumCachedEntries = 2;
+        FakeFolder smallFolder{FileInfo::A12_B12_C12_S12()};
+        const auto smallCache = RemoteDirectoryCache::forAccount(smallFolder.account());
+        QVERIFY(fetchListing(smallCache, QStringLiteral("A")));
+        QVERIFY(smallCache->listing(QStringLiteral("A")));
+    }
+};
+
+QTEST_GUILESS_MAIN(TestRemoteDirectoryCache)
+#include "testremotedirectorycache.moc"
@@ -171,6 +171,184 @@ private slots:
         QVERIFY(completeSpy.findItem("nofileid")->_errorString.contains("file id"));
         QVERIFY(completeSpy.findItem("nopermissions/A")->_errorString.contains("permission"));
     }
+
+    void testTargetedRemoteDiscovery()
+    {
+        FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
+        fakeFolder.remoteModifier().mkdir("A/sub");
+        fakeFolder.remoteModifier().insert("A/sub/x");
+        QVERIFY(fakeFolder.syncOnce());
+
+        QStringList propfindPaths;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation, const QNetworkRequest &req, QIODevice *) -> QNetworkReply * {
+            if (req.attribute(QNetworkRequest::CustomVerbAttribute) == "PROPFIND")
+                propfindPaths.append(req.url().path());
+            return nullptr;
+        });
+
+        // Only the listed folder is queried, the other changes are not seen
+        fakeFolder.remoteModifier().appendByte("A/sub/x");
+        fakeFolder.remoteModifier().appendByte("B/b1");
+        fakeFolder.syncEngine().setRemoteDiscoveryPaths({ QStringLiteral("A/sub") });
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(propfindPaths.size(), 1);
+        QVERIFY(propfindPaths.first().contains("A/sub"));
+        QCOMPARE(fakeFolder.currentLocalState().find("A/sub/x")->size, fakeFolder.currentRemoteState().find("A/sub/x")->size);
+        QVERIFY(fakeFolder.currentLocalState().find("B/b1")->size != fakeFolder.currentRemoteState().find("B/b1")->size);
+
+        // The paths only apply to one sync
+        propfindPaths.clear();
+        QVERIFY(fakeFolder.syncOnce());
+        QVERIFY(propfindPaths.size() > 1);
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+
+        // A file removed from the listed folder is removed right away
+        fakeFolder.remoteModifier().remove("A/sub/x");
+        fakeFolder.syncEngine().setRemoteDiscoveryPaths({ QStringLiteral("A/sub") });
+        QVERIFY(fakeFolder.syncOnce());
+        QVERIFY(!fakeFolder.currentLocalState().find("A/sub/x"));
+        QCOMPARE(fakeFolder.syncEngine().isAnotherSyncNeeded(), NoFollowUpSync);
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+
+        // The removal of the listed folder itself is only seen by a full discovery
+        fakeFolder.remoteModifier().remove("A/sub");
+        fakeFolder.syncEngine().setRemoteDiscoveryPaths({ QStringLiteral("A/sub") });
+        QVERIFY(fakeFolder.syncOnce());
+        QVERIFY(fakeFolder.currentLocalState().find("A/sub"));
+        QCOMPARE(fakeFolder.syncEngine().isAnotherSyncNeeded(), ImmediateFollowUp);
+        QVERIFY(fakeFolder.syncOnce());
+        QVERIFY(!fakeFolder.currentLocalState().find("A/sub"));
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+    }
+
+    void testTargetedRemoteDiscoveryKeepsLocalChanges()
+    {
+        FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
+        fakeFolder.remoteModifier().mkdir("A/sub");
+        fakeFolder.remoteModifier().insert("A/sub/x");
+        fakeFolder.remoteModifier().mkdir("A/sub/dir");
+        fakeFolder.remoteModifier().insert("A/sub/dir/y");
+        QVERIFY(fakeFolder.syncOnce());
+
+        // Gone from the listed folder on the server, but changed locally
+        fakeFolder.remoteModifier().remove("A/sub/x");
+        fakeFolder.remoteModifier().remove("A/sub/dir");
+        fakeFolder.localModifier().appendByte("A/sub/x");
+        fakeFolder.localModifier().insert("A/sub/dir/new");
+
+        ItemCompletedSpy completeSpy(fakeFolder);
+        fakeFolder.syncEngine().setRemoteDiscoveryPaths({ QStringLiteral("A/sub") });
+        QVERIFY(fakeFolder.syncOnce());
+
+        // Handled like in a full discovery, the local changes were uploaded
+        QCOMPARE(completeSpy.findItem("A/sub/x")->_direction, SyncFileItem::Up);
+        QCOMPARE(completeSpy.findItem("A/sub/dir/new")->_instruction, CSYNC_INSTRUCTION_NEW);
+        QVERIFY(fakeFolder.currentRemoteState().find("A/sub/x"));
+        QVERIFY(fakeFolder.currentRemoteState().find("A/sub/dir/new"));
+
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QVERIFY(!fakeFolder.currentLocalState().find("A/sub/dir/y"));
+    }
+
+    void testDepthInfinityDiscovery()
+    {
+        FakeFolder fakeFolder{ FileInfo{} };
+        fakeFolder.syncEngine().account()->setCapabilities({ { "dav", QVariantMap{ { "propfind", QVariantMap{ { "depth_infinity", true } } } } } });
+        fakeFolder.remoteModifier().mkdir("A");
+        fakeFolder.remoteModifier().mkdir("A/B");
+        fakeFolder.remoteModifier().mkdir("A/B/C");
+        fakeFolder.remoteModifier().mkdir("A/empty");
+        fakeFolder.remoteModifier().insert("A/a1");
+        fakeFolder.remoteModifier().insert("A/B/b1");
+        fakeFolder.remoteModifier().insert("A/B/C/c1");
+        fakeFolder.remoteModifier().mkdir("D");
+        fakeFolder.remoteModifier().insert("D/d1");
+
+        QList<QByteArray> propfindDepths;
+        int depthInfinityError = 0;
+        QString depthInfinityErrorPath;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &req, QIODevice *) -> QNetworkReply * {
+            if (req.attribute(QNetworkRequest::CustomVerbAttribute) != "PROPFIND")
+                return nullptr;
+            propfindDepths.append(req.rawHeader("Depth"));
+            if (depthInfinityError && req.rawHeader("Depth") == "infinity"
+                && (depthInfinityErrorPath.isEmpty() || getFilePathFromUrl(req.url()) == depthInfinityErrorPath))
+                return new FakeErrorReply(op, req, this, depthInfinityError);
+            return nullptr;
+        });
+
+        // The root is listed normally, each new top-level folder with its whole subtree
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCOMPARE(propfindDepths.count("infinity"), 2);
+        QCOMPARE(propfindDepths.count("1"), 1);
+
+        // Known folders are listed one by one
+        fakeFolder.remoteModifier().insert("A/B/C/c2");
+        propfindDepths.clear();
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCOMPARE(propfindDepths.count("infinity"), 0);
+
+        // Other errors only affect the folder they happened for
+        fakeFolder.remoteModifier().mkdir("G");
+        fakeFolder.remoteModifier().mkdir("G/sub");
+        fakeFolder.remoteModifier().insert("G/sub/g1");
+        fakeFolder.remoteModifier().mkdir("H");
+        fakeFolder.remoteModifier().mkdir("H/sub");
+        fakeFolder.remoteModifier().insert("H/sub/h1");
+        depthInfinityError = 500;
+        depthInfinityErrorPath = QStringLiteral("G");
+        propfindDepths.clear();
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        // G failed, then G/sub and H were listed with their subtrees
+        QCOMPARE(propfindDepths.count("infinity"), 3);
+
+        // A server refusing the request is asked once and then folder by folder
+        fakeFolder.remoteModifier().mkdir("E");
+        fakeFolder.remoteModifier().mkdir("E/F");
+        fakeFolder.remoteModifier().insert("E/F/f1");
+        fakeFolder.remoteModifier().mkdir("I");
+        fakeFolder.remoteModifier().insert("I/i1");
+        depthInfinityError = 403;
+        depthInfinityErrorPath.clear();
+        propfindDepths.clear();
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCOMPARE(propfindDepths.count("infinity"), 1);
+    }
+
+    void testDepthInfinityDiscoveryWithEncodedNames()
+    {
+        FakeFolder fakeFolder{ FileInfo{} };
+        fakeFolder.syncEngine().account()->setCapabilities({ { "dav", QVariantMap{ { "propfind", QVariantMap{ { "depth_infinity", true } } } } } });
+        const QStringList names = { QStringLiteral("with space"), QStringLiteral("per%cent"), QStringLiteral("per%25cent"),
+            QStringLiteral("hash#mark"), QStringLiteral("question?mark"), QString::fromUtf8("\xc3\xbcml\xc3\xa4ut") };
+        fakeFolder.remoteModifier().mkdir("A");
+        for (const auto &name : names) {
+            fakeFolder.remoteModifier().mkdir(QStringLiteral("A/") + name);
+            fakeFolder.remoteModifier().mkdir(QStringLiteral("A/") + name + QStringLiteral("/") + name);
+            fakeFolder.remoteModifier().insert(QStringLiteral("A/") + name + QStringLiteral("/") + name + QStringLiteral("/file"));
+        }
+
+        QList<QByteArray> propfindDepths;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation, const QNetworkRequest &req, QIODevice *) -> QNetworkReply * {
+            if (req.attribute(QNetworkRequest::CustomVerbAttribute) == "PROPFIND")
+                propfindDepths.append(req.rawHeader("Depth"));
+            return nullptr;
+        });
+
+        // Every subfolder found its prefetched listing: only the root was listed on its own
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCOMPARE(propfindDepths.count("infinity"), 1);
+        QCOMPARE(propfindDepths.count("1"), 1);
+        for (const auto &name : names) {
+            QVERIFY(fakeFolder.currentLocalState().find(QStringLiteral("A/") + name + QStringLiteral("/") + name + QStringLiteral("/file")));
+        }
+    }
 };
 
 QTEST_GUILESS_MAIN(TestRemoteDiscovery)
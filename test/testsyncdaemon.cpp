@@ -0,0 +1,122 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include <QtTest>
+#include "syncenginetestutils.h"
+#include "cmd/syncdaemon.h"
+#include <syncengine.h>
+
+using namespace OCC;
+using namespace std::chrono_literals;
+
+static QString daemonJournalPath(const FakeFolder &fakeFolder)
+{
+    // Next to the journal of the FakeFolder's own engine, which isn't used
+    return fakeFolder.localPath() + QStringLiteral(".sync_daemon.db");
+}
+
+class TestSyncDaemon : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init()
+    {
+        SyncDaemon::syncCoalescingInterval = 100ms;
+        SyncDaemon::minimumRetryDelay = 200ms;
+    }
+
+    void testSyncsLocalChanges()
+    {
+        FakeFolder fakeFolder{FileInfo::A12_B12_C12_S12()};
+        SyncDaemon daemon(fakeFolder.account(), fakeFolder.localPath(), QString(), daemonJournalPath(fakeFolder), SyncOptions(), 1h);
+        QSignalSpy finishedSpy(&daemon.syncEngine(), &SyncEngine::finished);
+        daemon.start();
+        QVERIFY(finishedSpy.wait());
+        QVERIFY(finishedSpy.last().first().toBool());
+
+        // Picked up by the local watcher, without any further request
+        fakeFolder.localModifier().insert(QStringLiteral("A/new"));
+        fakeFolder.localModifier().appendByte(QStringLiteral("B/b1"));
+        QTRY_COMPARE(fakeFolder.currentRemoteState(), fakeFolder.currentLocalState());
+    }
+
+    void testRetriesFailedSync()
+    {
+        FakeFolder fakeFolder{FileInfo::A12_B12_C12_S12()};
+        int failures = 2;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &req, QIODevice *) -> QNetworkReply * {
+            if (failures > 0 && req.attribute(QNetworkRequest::CustomVerbAttribute) == "PROPFIND") {
+                --failures;
+                return new FakeErrorReply(op, req, this, 500);
+            }
+            return nullptr;
+        });
+        fakeFolder.remoteModifier().insert(QStringLiteral("A/new"));
+
+        SyncDaemon daemon(fakeFolder.account(), fakeFolder.localPath(), QString(), daemonJournalPath(fakeFolder), SyncOptions(), 1h);
+        QSignalSpy finishedSpy(&daemon.syncEngine(), &SyncEngine::finished);
+        QElapsedTimer timer;
+        timer.start();
+        daemon.start();
+
+        QVERIFY(finishedSpy.wait());
+        QVERIFY(!finishedSpy.last().first().toBool());
+        const auto firstFailure = timer.elapsed();
+
+        // Nothing else asks for a sync, the daemon retries on its own
+        QVERIFY(finishedSpy.wait());
+        QVERIFY(!finishedSpy.last().first().toBool());
+        const auto secondFailure = timer.elapsed();
+        QVERIFY(secondFailure - firstFailure >= 150);
+
+        // The delay grows after every failure
+        QVERIFY(finishedSpy.wait());
+        QVERIFY(finishedSpy.last().first().toBool());
+        QVERIFY(timer.elapsed() - secondFailure >= 350);
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+    }
+
+    void testLocalChangeKeepsTargetedRemoteDiscovery()
+    {
+        FakeFolder fakeFolder{FileInfo::A12_B12_C12_S12()};
+        // oc:id as built by the server for the numeric file id 42
+        fakeFolder.remoteModifier().find(QStringLiteral("A"))->fileId = "00000042ocabcdef";
+
+        QStringList propfindPaths;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation, const QNetworkRequest &req, QIODevice *) -> QNetworkReply * {
+            if (req.attribute(QNetworkRequest::CustomVerbAttribute) == "PROPFIND") {
+                propfindPaths.append(getFilePathFromUrl(req.url()));
+            }
+            return nullptr;
+        });
+
+        SyncDaemon daemon(fakeFolder.account(), fakeFolder.localPath(), QString(), daemonJournalPath(fakeFolder), SyncOptions(), 1h);
+        QSignalSpy finishedSpy(&daemon.syncEngine(), &SyncEngine::finished);
+        daemon.start();
+        QVERIFY(finishedSpy.wait());
+        QVERIFY(finishedSpy.last().first().toBool());
+
+        // The local change and the push notification end up in the same run
+        SyncDaemon::syncCoalescingInterval = 500ms;
+        propfindPaths.clear();
+        fakeFolder.remoteModifier().appendByte(QStringLiteral("A/a1"));
+        fakeFolder.localModifier().insert(QStringLiteral("B/new"));
+        const QVector<qint64> fileIds = {42};
+        QVERIFY(QMetaObject::invokeMethod(&daemon, "slotFileIdsPushNotification",
+            Q_ARG(OCC::Account *, fakeFolder.account().data()), Q_ARG(QVector<qint64>, fileIds)));
+        QVERIFY(finishedSpy.wait());
+        QVERIFY(finishedSpy.last().first().toBool());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+
+        // Only the folder named by the notification was listed
+        QCOMPARE(propfindPaths, QStringList{QStringLiteral("A")});
+    }
+};
+
+QTEST_GUILESS_MAIN(TestSyncDaemon)
+#include "testsyncdaemon.moc"
@@ -865,6 +865,39 @@ private slots:
         QCOMPARE(nPUT, 3);
     }
 
+    // A bandwidth limit must neither disable parallel transfers nor be exceeded by them
+    void testParallelDownloadsWithBandwidthLimit()
+    {
+        FakeFolder fakeFolder{ FileInfo{} };
+        for (int i = 0; i < 8; ++i) {
+            fakeFolder.remoteModifier().insert(QStringLiteral("file%1").arg(i), 32 * 1000);
+        }
+        // 400 kB/s allow a burst of 100 kB, the other 156 kB take at least 390 ms
+        fakeFolder.syncEngine().setNetworkLimits(0, 400 * 1000);
+
+        int nGET = 0;
+        int nGETBeforeFirstCompletion = 0;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &, QIODevice *) -> QNetworkReply * {
+            if (op == QNetworkAccessManager::GetOperation) {
+                ++nGET;
+            }
+            return nullptr;
+        });
+        connect(&fakeFolder.syncEngine(), &SyncEngine::itemCompleted, this, [&](const SyncFileItemPtr &item) {
+            if (item->_instruction == CSYNC_INSTRUCTION_NEW && nGETBeforeFirstCompletion == 0) {
+                nGETBeforeFirstCompletion = nGET;
+            }
+        });
+
+        QElapsedTimer timer;
+        timer.start();
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCOMPARE(nGET, 8);
+        QVERIFY(nGETBeforeFirstCompletion > 1);
+        QVERIFY(timer.elapsed() >= 300);
+    }
+
 #ifndef Q_OS_WIN
     void testPropagatePermissions()
     {
@@ -1658,6 +1691,204 @@ private slots:
         fakeFolder.remoteModifier().remove(testUpperCaseFile);
         QVERIFY(fakeFolder.syncOnce());
     }
+    void testRemoteCopyOfDuplicateContent()
+    {
+        FakeFolder fakeFolder{FileInfo::A12_B12_C12_S12()};
+        auto syncOptions = fakeFolder.syncEngine().syncOptions();
+        syncOptions._minRemoteCopySize = 1000;
+        fakeFolder.syncEngine().setSyncOptions(syncOptions);
+
+        int nCOPY = 0;
+        int nPUT = 0;
+        int nPROPPATCH = 0;
+        int copyError = 0;
+        int proppatchError = 0;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (op == QNetworkAccessManager::PutOperation)
+                ++nPUT;
+            const auto verb = request.attribute(QNetworkRequest::CustomVerbAttribute).toByteArray();
+            if (verb == "PROPPATCH") {
+                ++nPROPPATCH;
+                if (proppatchError)
+                    return new FakeErrorReply(op, request, this, proppatchError);
+            }
+            if (verb == "COPY") {
+                ++nCOPY;
+                if (copyError)
+                    return new FakeErrorReply(op, request, this, copyError);
+            }
+            return nullptr;
+        });
+
+        fakeFolder.localModifier().insert("A/big", 10000);
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(nPUT, 1);
+        QCOMPARE(nCOPY, 0);
+
+        // Same size and contents: created on the server without uploading
+        nPUT = 0;
+        const auto copyMtime = QDateTime::currentDateTimeUtc().addDays(-3);
+        fakeFolder.localModifier().insert("B/copy", 10000);
+        fakeFolder.localModifier().setModTime("B/copy", copyMtime);
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(nPUT, 0);
+        QCOMPARE(nCOPY, 1);
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QVERIFY(fakeFolder.currentRemoteState().find("B/copy"));
+
+        // The copy got the modification time of the local file, not of its source
+        QCOMPARE(nPROPPATCH, 1);
+        QCOMPARE(fakeFolder.currentRemoteState().find("B/copy")->lastModified.toSecsSinceEpoch(), copyMtime.toSecsSinceEpoch());
+        QVERIFY(fakeFolder.currentRemoteState().find("A/big")->lastModified.toSecsSinceEpoch() != copyMtime.toSecsSinceEpoch());
+
+        // The journal matches the server: nothing to do
+        nCOPY = 0;
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(nPUT, 0);
+        QCOMPARE(nCOPY, 0);
+
+        // Same size but different contents: uploaded
+        fakeFolder.localModifier().insert("B/other", 10000, 'O');
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(nPUT, 1);
+        QCOMPARE(nCOPY, 0);
+
+        // Too small to be worth it
+        nPUT = 0;
+        fakeFolder.localModifier().insert("A/small", 999);
+        fakeFolder.localModifier().insert("B/small", 999);
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(nCOPY, 0);
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+
+        // A failing COPY falls back to an upload, e.g. when the source is gone
+        for (const auto error : { 404, 500 }) {
+            nPUT = 0;
+            nCOPY = 0;
+            copyError = error;
+            const auto path = QStringLiteral("C/copy%1").arg(error);
+            fakeFolder.localModifier().insert(path, 10000);
+            QVERIFY(fakeFolder.syncOnce());
+            QCOMPARE(nCOPY, 1);
+            QCOMPARE(nPUT, 1);
+            QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        }
+
+        // A copy whose modification time can't be set is replaced by an upload
+        nPUT = 0;
+        nCOPY = 0;
+        copyError = 0;
+        proppatchError = 500;
+        const auto uploadMtime = QDateTime::currentDateTimeUtc().addDays(-5);
+        fakeFolder.localModifier().insert("C/copyMtime", 10000);
+        fakeFolder.localModifier().setModTime("C/copyMtime", uploadMtime);
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(nCOPY, 1);
+        QCOMPARE(nPUT, 1);
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCOMPARE(fakeFolder.currentRemoteState().find("C/copyMtime")->lastModified.toSecsSinceEpoch(), uploadMtime.toSecsSinceEpoch());
+    }
+
+    void testPropagationPriorityOrder()
+    {
+        FakeFolder fakeFolder{FileInfo::A12_B12_C12_S12()};
+        fakeFolder.remoteModifier().insert("A/zzz");
+        QVERIFY(fakeFolder.syncOnce());
+
+        // One job at a time, so the order of the requests is the scheduling order
+        auto options = fakeFolder.syncEngine().syncOptions();
+        options._parallelNetworkJobs = 1;
+        fakeFolder.syncEngine().setSyncOptions(options);
+
+        QStringList requests;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            const auto path = getFilePathFromUrl(request.url());
+            if (op == QNetworkAccessManager::GetOperation) {
+                requests.append(QStringLiteral("GET ") + path);
+            } else if (op == QNetworkAccessManager::DeleteOperation) {
+                requests.append(QStringLiteral("DELETE ") + path);
+            }
+            return nullptr;
+        });
+
+        // Sorted by name the tasks are in the opposite order of their priority
+        fakeFolder.remoteModifier().insert("A/big", 2 * 1024 * 1024);
+        fakeFolder.remoteModifier().insert("A/small", 10);
+        fakeFolder.remoteModifier().insert("A/wanted", 2 * 1024 * 1024);
+        fakeFolder.localModifier().remove("A/zzz");
+        fakeFolder.syncEngine().setUserTriggeredPaths({ QStringLiteral("A/wanted") });
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCOMPARE(requests, QStringList({ "GET A/wanted", "DELETE A/zzz", "GET A/small", "GET A/big" }));
+
+        // The user triggered paths only apply to one sync
+        requests.clear();
+        fakeFolder.remoteModifier().appendByte("A/wanted");
+        fakeFolder.remoteModifier().appendByte("A/small");
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(requests, QStringList({ "GET A/small", "GET A/wanted" }));
+    }
+
+    void testUserTriggeredJobsBeyondTransferLimit()
+    {
+        FakeFolder fakeFolder{FileInfo::A12_B12_C12_S12()};
+
+        // One transfer at a time, and one more job for what the user is waiting for
+        auto options = fakeFolder.syncEngine().syncOptions();
+        options._parallelNetworkJobs = 2;
+        fakeFolder.syncEngine().setSyncOptions(options);
+
+        auto startedWanted = false;
+        auto otherDirectoryCreated = false;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (op != QNetworkAccessManager::GetOperation) {
+                return nullptr;
+            }
+            const auto path = getFilePathFromUrl(request.url());
+            if (path == QStringLiteral("A/big")) {
+                // Keeps the only transfer slot busy
+                return new FakeHangingReply(op, request, this);
+            }
+            if (path == QStringLiteral("E/wanted")) {
+                startedWanted = true;
+                otherDirectoryCreated = QFileInfo::exists(fakeFolder.localPath() + QStringLiteral("D"));
+                QTimer::singleShot(0, &fakeFolder.syncEngine(), [&fakeFolder] { fakeFolder.syncEngine().abort(); });
+            }
+            return nullptr;
+        });
+
+        fakeFolder.remoteModifier().insert("A/big", 2 * 1024 * 1024);
+        fakeFolder.remoteModifier().mkdir("D");
+        fakeFolder.remoteModifier().insert("D/small", 10);
+        fakeFolder.remoteModifier().mkdir("E");
+        fakeFolder.remoteModifier().insert("E/wanted", 2 * 1024 * 1024);
+        fakeFolder.syncEngine().setUserTriggeredPaths({ QStringLiteral("E/wanted") });
+        QVERIFY(!fakeFolder.syncOnce());
+
+        // The parent directory of the user triggered file was created, the other one wasn't
+        QVERIFY(startedWanted);
+        QVERIFY(!otherDirectoryCreated);
+
+        fakeFolder.setServerOverride(nullptr);
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+    }
+
+    void testStaleFlagsRemovedAfterStaleDbEntry()
+    {
+        FakeFolder fakeFolder{FileInfo::A12_B12_C12_S12()};
+        auto &pinStates = fakeFolder.syncJournal().internalPinStates();
+        pinStates.setForPath("A/a1", PinState::AlwaysLocal);
+        QVERIFY(fakeFolder.syncOnce());
+        QVERIFY(pinStates.rawForPath("A/a1"));
+
+        // Gone on both sides, discovery only drops the stale record
+        fakeFolder.localModifier().remove("A/a1");
+        fakeFolder.remoteModifier().remove("A/a1");
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QVERIFY(!pinStates.rawForPath("A/a1"));
+    }
 };
 
 QTEST_GUILESS_MAIN(TestSyncEngine)
@@ -203,6 +203,23 @@ private slots:
         QVERIFY(!_db.conflictRecord(record.path).isValid());
     }
 
+    void testE2EeFolderMetadataCache()
+    {
+        QVERIFY(_db.e2EeFolderMetadataCache("folderid", "etag1").isEmpty());
+
+        _db.setE2EeFolderMetadataCache("folderid", "etag1", "metadata1");
+        QCOMPARE(_db.e2EeFolderMetadataCache("folderid", "etag1"), QByteArray("metadata1"));
+        // Only valid as long as the folder didn't change
+        QVERIFY(_db.e2EeFolderMetadataCache("folderid", "etag2").isEmpty());
+
+        _db.setE2EeFolderMetadataCache("folderid", "etag2", "metadata2");
+        QVERIFY(_db.e2EeFolderMetadataCache("folderid", "etag1").isEmpty());
+        QCOMPARE(_db.e2EeFolderMetadataCache("folderid", "etag2"), QByteArray("metadata2"));
+
+        _db.deleteE2EeFolderMetadataCache("folderid");
+        QVERIFY(_db.e2EeFolderMetadataCache("folderid", "etag2").isEmpty());
+    }
+
     void testAvoidReadFromDbOnNextSync()
     {
         auto invalidEtag = QByteArray("_invalid_");
@@ -453,6 +470,102 @@ private slots:
         QCOMPARE(list->size(), 0);
     }
 
+    void testMaintenance()
+    {
+        SyncJournalDb db(_tempDir.path() + "/maintenance.db");
+
+        SyncJournalFileRecord record;
+        record._type = ItemTypeFile;
+        record._etag = QByteArray(200, 'e');
+        record._remotePerm = RemotePermissions::fromDbValue("RW");
+        for (int i = 0; i < 2000; ++i) {
+            record._path = "file" + QByteArray::number(i);
+            record._inode = i + 1;
+            record._fileId = "id" + QByteArray::number(i);
+            QVERIFY(db.setFileRecord(record));
+        }
+        for (int i = 0; i < 2000; ++i) {
+            QVERIFY(db.deleteFileRecord(QStringLiteral("file%1").arg(i)));
+        }
+        db.commit("test");
+
+        const auto before = db.statistics();
+        QCOMPARE(before.autoVacuum, QStringLiteral("incremental"));
+        QVERIFY(before.freePages > 0);
+        const auto metadata = std::find_if(before.tables.cbegin(), before.tables.cend(), [](const auto &table) {
+            return table.name == QLatin1String("metadata");
+        });
+        QVERIFY(metadata != before.tables.cend());
+        QCOMPARE(metadata->rows, qint64(0));
+        QVERIFY(!before.queryPlans.isEmpty());
+        for (const auto &plan : before.queryPlans) {
+            QVERIFY2(!plan.steps.isEmpty(), qPrintable(plan.name));
+        }
+
+        db.performMaintenance(true);
+        const auto after = db.statistics();
+        QVERIFY(after.freePages < before.freePages);
+        QVERIFY(after.pageCount < before.pageCount);
+
+        // Not again until the interval has passed
+        QVERIFY(db.setFileRecord(record));
+        QVERIFY(db.deleteFileRecord(QString::fromUtf8(record._path)));
+        db.commit("test");
+        const auto freePages = db.statistics().freePages;
+        db.performMaintenance();
+        QCOMPARE(db.statistics().freePages, freePages);
+
+        // Inspecting the file doesn't need a SyncJournalDb, once that let go of it
+        const auto stats = db.statistics();
+        db.close();
+        const auto readOnly = SyncJournalDb::readOnlyStatistics(db.databaseFilePath());
+        QCOMPARE(readOnly.pageCount, stats.pageCount);
+        QCOMPARE(readOnly.freePages, stats.freePages);
+        QCOMPARE(readOnly.tables.size(), stats.tables.size());
+        QCOMPARE(readOnly.queryPlans.size(), stats.queryPlans.size());
+        QCOMPARE(SyncJournalDb::readOnlyStatistics(_tempDir.path() + "/missing.db").pageCount, qint64(0));
+    }
+
+    void testPerformanceProfile()
+    {
+        constexpr qint64 MiB = 1024 * 1024;
+
+        // Automatic: a small journal is mapped, so the cache stays at sqlite's default size
+        SyncJournalDb automatic(_tempDir.path() + "/automatic.db");
+        auto applied = automatic.appliedPerformanceProfile();
+        if (applied.mmapSize <= 0) {
+            QSKIP("sqlite was built without mmap support");
+        }
+        QCOMPARE(applied.cacheSize, 2 * MiB);
+
+        // Explicit sizes are applied right away to the open database
+        SyncJournalDb::PerformanceProfile profile;
+        profile.mmapSize = 32 * MiB;
+        automatic.setPerformanceProfile(profile);
+        applied = automatic.appliedPerformanceProfile();
+        QCOMPARE(applied.mmapSize, 32 * MiB);
+        QCOMPARE(applied.cacheSize, 2 * MiB);
+
+        // Without mmap, the cache can be sized by hand
+        profile.mmapSize = 0;
+        profile.cacheSize = 8 * MiB;
+        automatic.setPerformanceProfile(profile);
+        applied = automatic.appliedPerformanceProfile();
+        QCOMPARE(applied.mmapSize, qint64(0));
+        QCOMPARE(applied.cacheSize, 8 * MiB);
+
+        // The environment wins over the profile
+        qputenv("OWNCLOUD_SQLITE_MMAP_SIZE", QByteArray::number(16 * MiB));
+        qputenv("OWNCLOUD_SQLITE_CACHE_SIZE", QByteArray::number(4 * MiB));
+        SyncJournalDb forced(_tempDir.path() + "/forced.db");
+        forced.setPerformanceProfile(profile);
+        applied = forced.appliedPerformanceProfile();
+        qunsetenv("OWNCLOUD_SQLITE_MMAP_SIZE");
+        qunsetenv("OWNCLOUD_SQLITE_CACHE_SIZE");
+        QCOMPARE(applied.mmapSize, 16 * MiB);
+        QCOMPARE(applied.cacheSize, 4 * MiB);
+    }
+
 private:
     SyncJournalDb _db;
 };
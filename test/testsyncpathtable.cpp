@@ -0,0 +1,79 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *       support, and with no warranty, express or implied, as to its usefulness for
+ *          any purpose.
+ *          */
+
+#include <QtTest>
+
+#include "syncpathtable.h"
+
+using namespace OCC;
+
+class TestSyncPathTable : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testInternIsStable()
+    {
+        SyncPathTable table;
+        QCOMPARE(table.intern(QString()), SyncPathTable::rootId);
+
+        const auto file = table.intern(QStringLiteral("A/B/file.txt"));
+        QCOMPARE(table.intern(QStringLiteral("A/B/file.txt")), file);
+        QCOMPARE(table.find(QStringLiteral("A/B/file.txt")), file);
+        QCOMPARE(table.toString(file), QStringLiteral("A/B/file.txt"));
+        QCOMPARE(table.name(file), QStringLiteral("file.txt"));
+
+        // parents are shared with siblings
+        const auto dir = table.find(QStringLiteral("A/B"));
+        QVERIFY(dir != SyncPathTable::invalidId);
+        QCOMPARE(table.parent(file), dir);
+        const auto sibling = table.intern(QStringLiteral("A/B/other.txt"));
+        QCOMPARE(table.parent(sibling), dir);
+        QCOMPARE(table.size(), 5);
+
+        QCOMPARE(table.find(QStringLiteral("A/C")), SyncPathTable::invalidId);
+        QCOMPARE(table.find(QStringLiteral("a/B")), SyncPathTable::invalidId);
+    }
+
+    void testAncestors()
+    {
+        SyncPathTable table;
+        const auto file = table.intern(QStringLiteral("A/B/C/file"));
+        const auto b = table.find(QStringLiteral("A/B"));
+        QVERIFY(table.isAncestorOrSelf(b, file));
+        QVERIFY(table.isAncestorOrSelf(file, file));
+        QVERIFY(table.isAncestorOrSelf(SyncPathTable::rootId, file));
+        QVERIFY(!table.isAncestorOrSelf(file, b));
+
+        QStringList prefixes;
+        const QString path = QStringLiteral("A/B/X/Y");
+        table.forEachAncestor(path, [&](SyncPathTable::PathId id, int prefixLength) {
+            QCOMPARE(table.toString(id), path.left(prefixLength));
+            prefixes.append(path.left(prefixLength));
+        });
+        // The walk stops at the first unknown component
+        QCOMPARE(prefixes, QStringList({ QStringLiteral("A"), QStringLiteral("A/B") }));
+
+        prefixes.clear();
+        table.forEachAncestor(QStringLiteral("A"), [&](SyncPathTable::PathId id, int) {
+            prefixes.append(table.toString(id));
+        });
+        QVERIFY(prefixes.isEmpty());
+    }
+
+    void testClear()
+    {
+        SyncPathTable table;
+        table.intern(QStringLiteral("A/B"));
+        table.clear();
+        QCOMPARE(table.size(), 1);
+        QCOMPARE(table.find(QStringLiteral("A")), SyncPathTable::invalidId);
+        QCOMPARE(table.toString(SyncPathTable::rootId), QString());
+    }
+};
+
+QTEST_APPLESS_MAIN(TestSyncPathTable)
+#include "testsyncpathtable.moc"